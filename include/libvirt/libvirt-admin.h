@@ -189,6 +189,28 @@ virAdmServerPtr virAdmConnectLookupServer(virAdmConnectPtr conn,
 
 # define VIR_THREADPOOL_JOB_QUEUE_DEPTH "jobQueueDepth"
 
+/**
+ * VIR_THREADPOOL_FAIR_QUEUING:
+ * Macro for the threadpool fairQueuing attribute: represents how the workers
+ * are shared between the clients of the server, as VIR_TYPED_PARAM_UINT
+ * holding one of the virThreadPoolFairQueuing values.
+ */
+
+# define VIR_THREADPOOL_FAIR_QUEUING "fairQueuing"
+
+typedef enum {
+    VIR_THREADPOOL_FAIR_QUEUING_NONE = 0,     /* jobs are run in the order
+                                                 they arrived */
+    VIR_THREADPOOL_FAIR_QUEUING_CLIENT = 1,   /* workers are shared fairly
+                                                 between client connections */
+    VIR_THREADPOOL_FAIR_QUEUING_IDENTITY = 2, /* workers are shared fairly
+                                                 between client identities */
+
+# ifdef VIR_ENUM_SENTINELS
+    VIR_THREADPOOL_FAIR_QUEUING_LAST
+# endif
+} virThreadPoolFairQueuing;
+
 /* Tunables for a server workerpool */
 int virAdmServerGetThreadPoolParameters(virAdmServerPtr srv,
                                         virTypedParameterPtr *params,
@@ -345,6 +367,73 @@ virAdmServerLookupClient(virAdmServerPtr srv,
 
 # define VIR_CLIENT_INFO_SELINUX_CONTEXT "selinux_context"
 
+/**
+ * VIR_CLIENT_INFO_QUEUE_WAIT_1MS:
+ * Macro represents the number of the client's requests which waited less
+ * than 1 millisecond for a worker, as VIR_TYPED_PARAM_ULLONG.
+ *
+ * NOTE: This attribute is read-only and any attempt to set it will be denied
+ * by daemon
+ */
+
+# define VIR_CLIENT_INFO_QUEUE_WAIT_1MS "queue_wait_1ms"
+
+/**
+ * VIR_CLIENT_INFO_QUEUE_WAIT_10MS:
+ * Macro represents the number of the client's requests which waited at least
+ * 1 but less than 10 milliseconds for a worker, as VIR_TYPED_PARAM_ULLONG.
+ *
+ * NOTE: This attribute is read-only and any attempt to set it will be denied
+ * by daemon
+ */
+
+# define VIR_CLIENT_INFO_QUEUE_WAIT_10MS "queue_wait_10ms"
+
+/**
+ * VIR_CLIENT_INFO_QUEUE_WAIT_100MS:
+ * Macro represents the number of the client's requests which waited at least
+ * 10 but less than 100 milliseconds for a worker, as VIR_TYPED_PARAM_ULLONG.
+ *
+ * NOTE: This attribute is read-only and any attempt to set it will be denied
+ * by daemon
+ */
+
+# define VIR_CLIENT_INFO_QUEUE_WAIT_100MS "queue_wait_100ms"
+
+/**
+ * VIR_CLIENT_INFO_QUEUE_WAIT_1S:
+ * Macro represents the number of the client's requests which waited at least
+ * 100 milliseconds but less than 1 second for a worker,
+ * as VIR_TYPED_PARAM_ULLONG.
+ *
+ * NOTE: This attribute is read-only and any attempt to set it will be denied
+ * by daemon
+ */
+
+# define VIR_CLIENT_INFO_QUEUE_WAIT_1S "queue_wait_1s"
+
+/**
+ * VIR_CLIENT_INFO_QUEUE_WAIT_10S:
+ * Macro represents the number of the client's requests which waited at least
+ * 1 but less than 10 seconds for a worker, as VIR_TYPED_PARAM_ULLONG.
+ *
+ * NOTE: This attribute is read-only and any attempt to set it will be denied
+ * by daemon
+ */
+
+# define VIR_CLIENT_INFO_QUEUE_WAIT_10S "queue_wait_10s"
+
+/**
+ * VIR_CLIENT_INFO_QUEUE_WAIT_LONG:
+ * Macro represents the number of the client's requests which waited
+ * 10 seconds or longer for a worker, as VIR_TYPED_PARAM_ULLONG.
+ *
+ * NOTE: This attribute is read-only and any attempt to set it will be denied
+ * by daemon
+ */
+
+# define VIR_CLIENT_INFO_QUEUE_WAIT_LONG "queue_wait_long"
+
 int virAdmClientGetInfo(virAdmClientPtr client,
                         virTypedParameterPtr *params,
                         int *nparams,
@@ -823,6 +823,13 @@ typedef enum {
      */
     VIR_MIGRATE_TLS               = (1 << 16),
 
+    /* Send memory pages to the destination host through several network
+     * connections. See VIR_MIGRATE_PARAM_PARALLEL_* parameters for
+     * configuring the parallel migration. This flag cannot be used with
+     * VIR_MIGRATE_TUNNELLED.
+     */
+    VIR_MIGRATE_PARALLEL          = (1 << 17),
+
 } virDomainMigrateFlags;
 
 
@@ -1008,6 +1015,14 @@ typedef enum {
  */
 # define VIR_MIGRATE_PARAM_AUTO_CONVERGE_INCREMENT  "auto_converge.increment"
 
+/**
+ * VIR_MIGRATE_PARAM_PARALLEL_CONNECTIONS:
+ *
+ * virDomainMigrate* params field: number of connections used during parallel
+ * migration. As VIR_TYPED_PARAM_INT.
+ */
+# define VIR_MIGRATE_PARAM_PARALLEL_CONNECTIONS     "parallel.connections"
+
 /* Domain migration. */
 virDomainPtr virDomainMigrate (virDomainPtr domain, virConnectPtr dconn,
                                unsigned long flags, const char *dname,
@@ -3402,6 +3417,25 @@ typedef enum {
  */
 # define VIR_DOMAIN_JOB_DISK_BPS                 "disk_bps"
 
+/**
+ * VIR_DOMAIN_JOB_DISK_MIRRORS:
+ *
+ * virDomainGetJobStats field: number of disks whose copy to the
+ * destination has already been started during migration with non-shared
+ * storage, as VIR_TYPED_PARAM_UINT. Disks which are not counted yet are
+ * waiting for other disks to finish their initial copy.
+ */
+# define VIR_DOMAIN_JOB_DISK_MIRRORS             "disk_mirrors"
+
+/**
+ * VIR_DOMAIN_JOB_DISK_MIRRORS_READY:
+ *
+ * virDomainGetJobStats field: number of disks which finished their initial
+ * copy to the destination during migration with non-shared storage, as
+ * VIR_TYPED_PARAM_UINT.
+ */
+# define VIR_DOMAIN_JOB_DISK_MIRRORS_READY       "disk_mirrors_ready"
+
 /**
  * VIR_DOMAIN_JOB_COMPRESSION_CACHE:
  *
@@ -3455,6 +3489,23 @@ typedef enum {
  */
 # define VIR_DOMAIN_JOB_AUTO_CONVERGE_THROTTLE  "auto_converge_throttle"
 
+/**
+ * VIR_DOMAIN_JOB_TUNNEL_PROCESSED:
+ *
+ * virDomainGetJobStats field: number of bytes forwarded through the
+ * libvirt connection during tunnelled migration, as VIR_TYPED_PARAM_ULLONG.
+ */
+# define VIR_DOMAIN_JOB_TUNNEL_PROCESSED        "tunnel_processed"
+
+/**
+ * VIR_DOMAIN_JOB_TUNNEL_BPS:
+ *
+ * virDomainGetJobStats field: average throughput of the libvirt connection
+ * used for tunnelled migration in Bytes per second, as
+ * VIR_TYPED_PARAM_ULLONG.
+ */
+# define VIR_DOMAIN_JOB_TUNNEL_BPS              "tunnel_bps"
+
 
 /**
  * virConnectDomainEventGenericCallback:
@@ -129,6 +129,11 @@ adminServerGetThreadPoolParameters(virNetServerPtr srv,
                               jobQueueDepth) < 0)
         goto cleanup;
 
+    if (virTypedParamsAddUInt(&tmpparams, nparams,
+                              &maxparams, VIR_THREADPOOL_FAIR_QUEUING,
+                              virNetServerGetFairQueuing(srv)) < 0)
+        goto cleanup;
+
     *params = tmpparams;
     tmpparams = NULL;
     ret = 0;
@@ -147,6 +152,7 @@ adminServerSetThreadPoolParameters(virNetServerPtr srv,
     long long int minWorkers = -1;
     long long int maxWorkers = -1;
     long long int prioWorkers = -1;
+    int fairQueuing = -1;
     virTypedParameterPtr param = NULL;
 
     virCheckFlags(0, -1);
@@ -158,9 +164,22 @@ adminServerSetThreadPoolParameters(virNetServerPtr srv,
                                VIR_TYPED_PARAM_UINT,
                                VIR_THREADPOOL_WORKERS_PRIORITY,
                                VIR_TYPED_PARAM_UINT,
+                               VIR_THREADPOOL_FAIR_QUEUING,
+                               VIR_TYPED_PARAM_UINT,
                                NULL) < 0)
         return -1;
 
+    if ((param = virTypedParamsGet(params, nparams,
+                                   VIR_THREADPOOL_FAIR_QUEUING))) {
+        if (param->value.ui >= VIR_NET_SERVER_FAIR_QUEUING_LAST) {
+            virReportError(VIR_ERR_INVALID_ARG,
+                           _("unsupported fair queuing mode %u"),
+                           param->value.ui);
+            return -1;
+        }
+        fairQueuing = param->value.ui;
+    }
+
     if ((param = virTypedParamsGet(params, nparams,
                                    VIR_THREADPOOL_WORKERS_MIN)))
         minWorkers = param->value.ui;
@@ -177,6 +196,9 @@ adminServerSetThreadPoolParameters(virNetServerPtr srv,
                                             maxWorkers, prioWorkers) < 0)
         return -1;
 
+    if (fairQueuing >= 0)
+        virNetServerSetFairQueuing(srv, fairQueuing);
+
     return 0;
 }
 
@@ -225,6 +247,16 @@ adminClientGetInfo(virNetServerClientPtr client,
     const char *attr = NULL;
     virTypedParameterPtr tmpparams = NULL;
     virIdentityPtr identity = NULL;
+    unsigned long long queueWait[VIR_NET_SERVER_CLIENT_QUEUE_WAIT_LAST];
+    const char *queueWaitFields[VIR_NET_SERVER_CLIENT_QUEUE_WAIT_LAST] = {
+        VIR_CLIENT_INFO_QUEUE_WAIT_1MS,
+        VIR_CLIENT_INFO_QUEUE_WAIT_10MS,
+        VIR_CLIENT_INFO_QUEUE_WAIT_100MS,
+        VIR_CLIENT_INFO_QUEUE_WAIT_1S,
+        VIR_CLIENT_INFO_QUEUE_WAIT_10S,
+        VIR_CLIENT_INFO_QUEUE_WAIT_LONG,
+    };
+    size_t i;
 
     virCheckFlags(0, -1);
 
@@ -294,6 +326,13 @@ adminClientGetInfo(virNetServerClientPtr client,
                                 VIR_CLIENT_INFO_SELINUX_CONTEXT, attr) < 0))
         goto cleanup;
 
+    virNetServerClientGetQueueWait(client, queueWait);
+    for (i = 0; i < VIR_NET_SERVER_CLIENT_QUEUE_WAIT_LAST; i++) {
+        if (virTypedParamsAddULLong(&tmpparams, nparams, &maxparams,
+                                    queueWaitFields[i], queueWait[i]) < 0)
+            goto cleanup;
+    }
+
     *params = tmpparams;
     tmpparams = NULL;
     ret = 0;
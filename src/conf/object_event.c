@@ -58,10 +58,24 @@ struct _virObjectEventCallback {
 typedef struct _virObjectEventCallback virObjectEventCallback;
 typedef virObjectEventCallback *virObjectEventCallbackPtr;
 
+struct _virObjectEventCallbackBucket {
+    size_t count;
+    virObjectEventCallbackPtr *callbacks;
+};
+typedef struct _virObjectEventCallbackBucket virObjectEventCallbackBucket;
+typedef virObjectEventCallbackBucket *virObjectEventCallbackBucketPtr;
+
 struct _virObjectEventCallbackList {
     unsigned int nextID;
     size_t count;
     virObjectEventCallbackPtr *callbacks;
+
+    /* The same callbacks grouped by eventID, in the order of their
+     * registration, so that dispatching an event only needs to look at
+     * the callbacks registered for its ID. Event IDs of different
+     * classes share buckets. */
+    size_t nbuckets;
+    virObjectEventCallbackBucketPtr buckets;
 };
 
 struct _virObjectEventQueue {
@@ -174,10 +188,71 @@ virObjectEventCallbackListFree(virObjectEventCallbackListPtr list)
         VIR_FREE(list->callbacks[i]);
     }
     VIR_FREE(list->callbacks);
+    for (i = 0; i < list->nbuckets; i++)
+        VIR_FREE(list->buckets[i].callbacks);
+    VIR_FREE(list->buckets);
     VIR_FREE(list);
 }
 
 
+/**
+ * virObjectEventCallbackListIndex:
+ * @cbList: the list
+ * @cb: the callback to index
+ *
+ * Internal function to add @cb to the bucket of its eventID.
+ *
+ * Returns 0 on success, -1 on failure.
+ */
+static int
+virObjectEventCallbackListIndex(virObjectEventCallbackListPtr cbList,
+                                virObjectEventCallbackPtr cb)
+{
+    virObjectEventCallbackBucketPtr bucket;
+
+    if (cb->eventID < 0) {
+        virReportError(VIR_ERR_INVALID_ARG,
+                       _("invalid event ID %d"), cb->eventID);
+        return -1;
+    }
+
+    if (cb->eventID >= (int) cbList->nbuckets &&
+        VIR_EXPAND_N(cbList->buckets, cbList->nbuckets,
+                     cb->eventID + 1 - cbList->nbuckets) < 0)
+        return -1;
+
+    bucket = &cbList->buckets[cb->eventID];
+    return VIR_APPEND_ELEMENT(bucket->callbacks, bucket->count, cb);
+}
+
+
+/**
+ * virObjectEventCallbackListUnindex:
+ * @cbList: the list
+ * @cb: the callback to drop from the index
+ *
+ * Internal function to remove @cb from the bucket of its eventID.
+ */
+static void
+virObjectEventCallbackListUnindex(virObjectEventCallbackListPtr cbList,
+                                  virObjectEventCallbackPtr cb)
+{
+    virObjectEventCallbackBucketPtr bucket;
+    size_t i;
+
+    if (cb->eventID < 0 || cb->eventID >= (int) cbList->nbuckets)
+        return;
+
+    bucket = &cbList->buckets[cb->eventID];
+    for (i = 0; i < bucket->count; i++) {
+        if (bucket->callbacks[i] == cb) {
+            VIR_DELETE_ELEMENT(bucket->callbacks, i, bucket->count);
+            return;
+        }
+    }
+}
+
+
 /**
  * virObjectEventCallbackListCount:
  * @conn: pointer to the connection
@@ -263,6 +338,7 @@ virObjectEventCallbackListRemoveID(virConnectPtr conn,
              * function won't end up with a double free error */
             if (doFreeCb && cb->freecb)
                 (*cb->freecb)(cb->opaque);
+            virObjectEventCallbackListUnindex(cbList, cb);
             virObjectEventCallbackFree(cb);
             VIR_DELETE_ELEMENT(cbList->callbacks, i, cbList->count);
             return ret;
@@ -312,6 +388,7 @@ virObjectEventCallbackListPurgeMarked(virObjectEventCallbackListPtr cbList)
             virFreeCallback freecb = cbList->callbacks[n]->freecb;
             if (freecb)
                 (*freecb)(cbList->callbacks[n]->opaque);
+            virObjectEventCallbackListUnindex(cbList, cbList->callbacks[n]);
             virObjectEventCallbackFree(cbList->callbacks[n]);
 
             VIR_DELETE_ELEMENT(cbList->callbacks, n, cbList->count);
@@ -454,9 +531,14 @@ virObjectEventCallbackListAddID(virConnectPtr conn,
     cb->filter_opaque = filter_opaque;
     cb->legacy = legacy;
 
-    if (VIR_APPEND_ELEMENT(cbList->callbacks, cbList->count, cb) < 0)
+    if (virObjectEventCallbackListIndex(cbList, cb) < 0)
         goto cleanup;
 
+    if (VIR_APPEND_ELEMENT(cbList->callbacks, cbList->count, cb) < 0) {
+        virObjectEventCallbackListUnindex(cbList, cb);
+        goto cleanup;
+    }
+
     /* When additional filtering is being done, every client callback
      * is matched to exactly one server callback.  */
     if (filter) {
@@ -699,13 +781,23 @@ virObjectEventStateDispatchCallbacks(virObjectEventStatePtr state,
                                      virObjectEventCallbackListPtr callbacks)
 {
     size_t i;
+    size_t cbCount;
+    virObjectEventCallbackBucketPtr bucket;
+
+    if (event->eventID < 0 || event->eventID >= (int) callbacks->nbuckets)
+        return;
+
     /* Cache this now, since we may be dropping the lock,
        and have more callbacks added. We're guaranteed not
-       to have any removed */
-    size_t cbCount = callbacks->count;
+       to have any removed. The bucket array may be reallocated
+       meanwhile, so always look it up again. */
+    cbCount = callbacks->buckets[event->eventID].count;
 
     for (i = 0; i < cbCount; i++) {
-        virObjectEventCallbackPtr cb = callbacks->callbacks[i];
+        virObjectEventCallbackPtr cb;
+
+        bucket = &callbacks->buckets[event->eventID];
+        cb = bucket->callbacks[i];
 
         if (!virObjectEventDispatchMatchCallback(event, cb))
             continue;
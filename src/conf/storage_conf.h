@@ -58,6 +58,19 @@ struct _virStorageVolSource {
                    * backend for partition type creation */
 };
 
+/*
+ * Identifies the state of a file based volume so that it
+ * doesn't have to be probed again if nothing has changed.
+ */
+typedef struct _virStorageVolStamp virStorageVolStamp;
+typedef virStorageVolStamp *virStorageVolStampPtr;
+struct _virStorageVolStamp {
+    bool valid;
+    unsigned long long ino;
+    unsigned long long size;
+    unsigned long long mtime; /* in nanoseconds */
+    unsigned long long ctime; /* in nanoseconds */
+};
 
 typedef struct _virStorageVolDef virStorageVolDef;
 typedef virStorageVolDef *virStorageVolDefPtr;
@@ -71,6 +84,10 @@ struct _virStorageVolDef {
 
     virStorageVolSource source;
     virStorageSource target;
+
+    /* Runtime only: attributes of the file backing the volume as of
+     * the last probe, used to skip unchanged volumes on pool refresh */
+    virStorageVolStamp stamp;
 };
 
 typedef struct _virStorageVolDefList virStorageVolDefList;
@@ -285,10 +285,7 @@ virNetworkObjMacMgrAdd(virNetworkObjPtr obj,
     if (!(file = virMacMapFileName(dnsmasqStateDir, obj->def->bridge)))
         goto cleanup;
 
-    if (virMacMapAdd(obj->macmap, domain, macStr) < 0)
-        goto cleanup;
-
-    if (virMacMapWriteFile(obj->macmap, file) < 0)
+    if (virMacMapAddPersistent(obj->macmap, file, domain, macStr) < 0)
         goto cleanup;
 
     ret = 0;
@@ -316,10 +313,7 @@ virNetworkObjMacMgrDel(virNetworkObjPtr obj,
     if (!(file = virMacMapFileName(dnsmasqStateDir, obj->def->bridge)))
         goto cleanup;
 
-    if (virMacMapRemove(obj->macmap, domain, macStr) < 0)
-        goto cleanup;
-
-    if (virMacMapWriteFile(obj->macmap, file) < 0)
+    if (virMacMapRemovePersistent(obj->macmap, file, domain, macStr) < 0)
         goto cleanup;
 
     ret = 0;
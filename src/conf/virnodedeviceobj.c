@@ -46,6 +46,16 @@ struct _virNodeDeviceObjList {
      * for O(1), lockless lookup-by-name */
     virHashTable *objs;
 
+    /* The following tables don't hold a reference to the objects,
+     * they are kept in sync with @objs under the write lock */
+
+    /* sysfs path -> virNodeDeviceObj mapping
+     * for O(1) lookup-by-sysfs-path */
+    virHashTable *sysfsPaths;
+
+    /* for each capability type: name string -> virNodeDeviceObj mapping
+     * of devices having a capability of that type, allocated on first use */
+    virHashTable *caps[VIR_NODE_DEV_CAP_LAST];
 };
 
 
@@ -182,15 +192,80 @@ virNodeDeviceFindVPORTCapDef(const virNodeDeviceObj *obj)
 }
 
 
+/* virNodeDeviceObjListCapBaseType:
+ * @type: capability type
+ *
+ * Some capability types are not stored in the device definition on their
+ * own, but are flags of another capability (see virNodeDeviceObjHasCap).
+ *
+ * Returns:
+ * The type of capability which can imply @type or @type itself
+ */
+static int
+virNodeDeviceObjListCapBaseType(int type)
+{
+    switch ((virNodeDevCapType) type) {
+    case VIR_NODE_DEV_CAP_FC_HOST:
+    case VIR_NODE_DEV_CAP_VPORTS:
+        return VIR_NODE_DEV_CAP_SCSI_HOST;
+
+    case VIR_NODE_DEV_CAP_MDEV_TYPES:
+        return VIR_NODE_DEV_CAP_PCI_DEV;
+
+    case VIR_NODE_DEV_CAP_SYSTEM:
+    case VIR_NODE_DEV_CAP_PCI_DEV:
+    case VIR_NODE_DEV_CAP_USB_DEV:
+    case VIR_NODE_DEV_CAP_USB_INTERFACE:
+    case VIR_NODE_DEV_CAP_NET:
+    case VIR_NODE_DEV_CAP_SCSI_HOST:
+    case VIR_NODE_DEV_CAP_SCSI_TARGET:
+    case VIR_NODE_DEV_CAP_SCSI:
+    case VIR_NODE_DEV_CAP_STORAGE:
+    case VIR_NODE_DEV_CAP_SCSI_GENERIC:
+    case VIR_NODE_DEV_CAP_DRM:
+    case VIR_NODE_DEV_CAP_MDEV:
+    case VIR_NODE_DEV_CAP_CCW_DEV:
+    case VIR_NODE_DEV_CAP_LAST:
+        break;
+    }
+
+    return type;
+}
+
+
+/* virNodeDeviceObjListSearch:
+ * @devs: list of node devices
+ * @type: capability type the searched device has, or -1
+ * @callback: matching function
+ * @data: data for @callback
+ *
+ * Searches for a device matching @callback. If @type is not -1, only
+ * devices with a capability which can imply @type are visited rather
+ * than all of them.
+ *
+ * Returns:
+ * Locked and referenced device object or NULL if not found
+ */
 static virNodeDeviceObjPtr
 virNodeDeviceObjListSearch(virNodeDeviceObjListPtr devs,
+                           int type,
                            virHashSearcher callback,
                            const void *data)
 {
-    virNodeDeviceObjPtr obj;
+    virNodeDeviceObjPtr obj = NULL;
+    int base;
 
     virObjectRWLockRead(devs);
-    obj = virHashSearch(devs->objs, callback, data, NULL);
+    if (type < 0) {
+        obj = virHashSearch(devs->objs, callback, data, NULL);
+    } else {
+        if (devs->caps[type])
+            obj = virHashSearch(devs->caps[type], callback, data, NULL);
+
+        base = virNodeDeviceObjListCapBaseType(type);
+        if (!obj && base != type && devs->caps[base])
+            obj = virHashSearch(devs->caps[base], callback, data, NULL);
+    }
     virObjectRef(obj);
     virObjectRWUnlock(devs);
 
@@ -201,30 +276,22 @@ virNodeDeviceObjListSearch(virNodeDeviceObjListPtr devs,
 }
 
 
-static int
-virNodeDeviceObjListFindBySysfsPathCallback(const void *payload,
-                                            const void *name ATTRIBUTE_UNUSED,
-                                            const void *opaque)
-{
-    virNodeDeviceObjPtr obj = (virNodeDeviceObjPtr) payload;
-    const char *sysfs_path = opaque;
-    int want = 0;
-
-    virObjectLock(obj);
-    if (STREQ_NULLABLE(obj->def->sysfs_path, sysfs_path))
-        want = 1;
-    virObjectUnlock(obj);
-    return want;
-}
-
-
 virNodeDeviceObjPtr
 virNodeDeviceObjListFindBySysfsPath(virNodeDeviceObjListPtr devs,
                                     const char *sysfs_path)
 {
-    return virNodeDeviceObjListSearch(devs,
-                                      virNodeDeviceObjListFindBySysfsPathCallback,
-                                      sysfs_path);
+    virNodeDeviceObjPtr obj;
+
+    if (!sysfs_path)
+        return NULL;
+
+    virObjectRWLockRead(devs);
+    obj = virObjectRef(virHashLookup(devs->sysfsPaths, sysfs_path));
+    virObjectRWUnlock(devs);
+    if (obj)
+        virObjectLock(obj);
+
+    return obj;
 }
 
 
@@ -287,7 +354,7 @@ virNodeDeviceObjListFindByWWNs(virNodeDeviceObjListPtr devs,
     struct virNodeDeviceObjListFindByWWNsData data = {
         .parent_wwnn = parent_wwnn, .parent_wwpn = parent_wwpn };
 
-    return virNodeDeviceObjListSearch(devs,
+    return virNodeDeviceObjListSearch(devs, VIR_NODE_DEV_CAP_SCSI_HOST,
                                       virNodeDeviceObjListFindByWWNsCallback,
                                       &data);
 }
@@ -317,7 +384,7 @@ static virNodeDeviceObjPtr
 virNodeDeviceObjListFindByFabricWWN(virNodeDeviceObjListPtr devs,
                                     const char *parent_fabric_wwn)
 {
-    return virNodeDeviceObjListSearch(devs,
+    return virNodeDeviceObjListSearch(devs, VIR_NODE_DEV_CAP_SCSI_HOST,
                                       virNodeDeviceObjListFindByFabricWWNCallback,
                                       parent_fabric_wwn);
 }
@@ -329,11 +396,11 @@ virNodeDeviceObjListFindByCapCallback(const void *payload,
                                       const void *opaque)
 {
     virNodeDeviceObjPtr obj = (virNodeDeviceObjPtr) payload;
-    const char *matchstr = opaque;
+    const int *type = opaque;
     int want = 0;
 
     virObjectLock(obj);
-    if (virNodeDeviceObjHasCapStr(obj, matchstr))
+    if (virNodeDeviceObjHasCap(obj, *type))
         want = 1;
     virObjectUnlock(obj);
     return want;
@@ -342,11 +409,11 @@ virNodeDeviceObjListFindByCapCallback(const void *payload,
 
 static virNodeDeviceObjPtr
 virNodeDeviceObjListFindByCap(virNodeDeviceObjListPtr devs,
-                              const char *cap)
+                              int type)
 {
-    return virNodeDeviceObjListSearch(devs,
+    return virNodeDeviceObjListSearch(devs, type,
                                       virNodeDeviceObjListFindByCapCallback,
-                                      cap);
+                                      &type);
 }
 
 
@@ -397,7 +464,7 @@ virNodeDeviceObjListFindSCSIHostByWWNs(virNodeDeviceObjListPtr devs,
     struct virNodeDeviceObjListFindSCSIHostByWWNsData data = {
         .wwnn = wwnn, .wwpn = wwpn };
 
-    return virNodeDeviceObjListSearch(devs,
+    return virNodeDeviceObjListSearch(devs, VIR_NODE_DEV_CAP_SCSI_HOST,
                                       virNodeDeviceObjListFindSCSIHostByWWNsCallback,
                                       &data);
 }
@@ -407,7 +474,11 @@ static void
 virNodeDeviceObjListDispose(void *obj)
 {
     virNodeDeviceObjListPtr devs = obj;
+    size_t i;
 
+    for (i = 0; i < VIR_NODE_DEV_CAP_LAST; i++)
+        virHashFree(devs->caps[i]);
+    virHashFree(devs->sysfsPaths);
     virHashFree(devs->objs);
 }
 
@@ -423,7 +494,8 @@ virNodeDeviceObjListNew(void)
     if (!(devs = virObjectRWLockableNew(virNodeDeviceObjListClass)))
         return NULL;
 
-    if (!(devs->objs = virHashCreate(50, virObjectFreeHashData))) {
+    if (!(devs->objs = virHashCreate(50, virObjectFreeHashData)) ||
+        !(devs->sysfsPaths = virHashCreate(50, NULL))) {
         virObjectUnref(devs);
         return NULL;
     }
@@ -439,6 +511,65 @@ virNodeDeviceObjListFree(virNodeDeviceObjListPtr devs)
 }
 
 
+/* Removes entries of @obj from the secondary lookup tables of @devs.
+ * Entries referring to a different object are kept. */
+static void
+virNodeDeviceObjListUnindex(virNodeDeviceObjListPtr devs,
+                            virNodeDeviceObjPtr obj,
+                            virNodeDeviceDefPtr def)
+{
+    virNodeDevCapsDefPtr cap;
+    virHashTablePtr table;
+
+    if (def->sysfs_path &&
+        virHashLookup(devs->sysfsPaths, def->sysfs_path) == obj)
+        virHashRemoveEntry(devs->sysfsPaths, def->sysfs_path);
+
+    for (cap = def->caps; cap; cap = cap->next) {
+        if (cap->data.type < 0 || cap->data.type >= VIR_NODE_DEV_CAP_LAST)
+            continue;
+
+        table = devs->caps[cap->data.type];
+        if (table && virHashLookup(table, def->name) == obj)
+            virHashRemoveEntry(table, def->name);
+    }
+}
+
+
+/* Adds @obj with definition @def into the secondary lookup tables
+ * of @devs. On failure, no entries for @obj are left behind. */
+static int
+virNodeDeviceObjListIndex(virNodeDeviceObjListPtr devs,
+                          virNodeDeviceObjPtr obj,
+                          virNodeDeviceDefPtr def)
+{
+    virNodeDevCapsDefPtr cap;
+    virHashTablePtr *table;
+
+    if (def->sysfs_path &&
+        virHashUpdateEntry(devs->sysfsPaths, def->sysfs_path, obj) < 0)
+        goto error;
+
+    for (cap = def->caps; cap; cap = cap->next) {
+        if (cap->data.type < 0 || cap->data.type >= VIR_NODE_DEV_CAP_LAST)
+            continue;
+
+        table = &devs->caps[cap->data.type];
+        if (!*table && !(*table = virHashCreate(10, NULL)))
+            goto error;
+
+        if (virHashUpdateEntry(*table, def->name, obj) < 0)
+            goto error;
+    }
+
+    return 0;
+
+ error:
+    virNodeDeviceObjListUnindex(devs, obj, def);
+    return -1;
+}
+
+
 virNodeDeviceObjPtr
 virNodeDeviceObjListAssignDef(virNodeDeviceObjListPtr devs,
                               virNodeDeviceDefPtr def)
@@ -449,6 +580,12 @@ virNodeDeviceObjListAssignDef(virNodeDeviceObjListPtr devs,
 
     if ((obj = virNodeDeviceObjListFindByNameLocked(devs, def->name))) {
         virObjectLock(obj);
+        virNodeDeviceObjListUnindex(devs, obj, obj->def);
+        if (virNodeDeviceObjListIndex(devs, obj, def) < 0) {
+            ignore_value(virNodeDeviceObjListIndex(devs, obj, obj->def));
+            virNodeDeviceObjEndAPI(&obj);
+            goto cleanup;
+        }
         virNodeDeviceDefFree(obj->def);
         obj->def = def;
     } else {
@@ -460,6 +597,13 @@ virNodeDeviceObjListAssignDef(virNodeDeviceObjListPtr devs,
             goto cleanup;
         }
 
+        if (virNodeDeviceObjListIndex(devs, obj, def) < 0) {
+            virObjectUnlock(obj);
+            virHashRemoveEntry(devs->objs, def->name);
+            obj = NULL;
+            goto cleanup;
+        }
+
         obj->def = def;
         virObjectRef(obj);
     }
@@ -484,6 +628,7 @@ virNodeDeviceObjListRemove(virNodeDeviceObjListPtr devs,
     virObjectUnlock(obj);
     virObjectRWLockWrite(devs);
     virObjectLock(obj);
+    virNodeDeviceObjListUnindex(devs, obj, def);
     virHashRemoveEntry(devs->objs, def->name);
     virObjectUnlock(obj);
     virObjectUnref(obj);
@@ -595,10 +740,9 @@ static int
 virNodeDeviceObjListFindVportParentHost(virNodeDeviceObjListPtr devs)
 {
     virNodeDeviceObjPtr obj = NULL;
-    const char *cap = virNodeDevCapTypeToString(VIR_NODE_DEV_CAP_VPORTS);
     int ret;
 
-    if (!(obj = virNodeDeviceObjListFindByCap(devs, cap))) {
+    if (!(obj = virNodeDeviceObjListFindByCap(devs, VIR_NODE_DEV_CAP_VPORTS))) {
         virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
                        _("Could not find any vport capable device"));
         return -1;
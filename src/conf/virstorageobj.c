@@ -41,6 +41,7 @@ static virClassPtr virStoragePoolObjClass;
 static virClassPtr virStoragePoolObjListClass;
 static virClassPtr virStorageVolObjClass;
 static virClassPtr virStorageVolObjListClass;
+static virClassPtr virStorageVolPathIndexClass;
 
 static void
 virStoragePoolObjDispose(void *opaque);
@@ -50,6 +51,8 @@ static void
 virStorageVolObjDispose(void *opaque);
 static void
 virStorageVolObjListDispose(void *opaque);
+static void
+virStorageVolPathIndexDispose(void *opaque);
 
 
 
@@ -59,6 +62,10 @@ struct _virStorageVolObj {
     virObjectLockable parent;
 
     virStorageVolDefPtr voldef;
+
+    /* device node the target path of the volume resolves to, if the
+     * pool points somewhere like /dev/disk/by-path */
+    char *devpath;
 };
 
 typedef struct _virStorageVolObjList virStorageVolObjList;
@@ -79,6 +86,38 @@ struct _virStorageVolObjList {
     virHashTable *objsPath;
 };
 
+/* Volumes of all pools in a virStoragePoolObjList indexed by path,
+ * shared by the list and all of its pools */
+typedef struct _virStorageVolPathIndex virStorageVolPathIndex;
+typedef virStorageVolPathIndex *virStorageVolPathIndexPtr;
+struct _virStorageVolPathIndex {
+    virObjectLockable parent;
+
+    /* path string -> virStorageVolPathIndexPools mapping
+     * for (1), lookup-by-path across all pools */
+    virHashTable *paths;
+};
+
+/* A pool holding a volume known under an indexed path */
+typedef struct _virStorageVolPathIndexEntry virStorageVolPathIndexEntry;
+typedef virStorageVolPathIndexEntry *virStorageVolPathIndexEntryPtr;
+struct _virStorageVolPathIndexEntry {
+    unsigned char uuid[VIR_UUID_BUFLEN];
+
+    /* target path of the volume if the indexed path is its device
+     * node, NULL if it is the target path itself */
+    char *target;
+};
+
+/* All pools holding a volume known under an indexed path, in the order
+ * they added it */
+typedef struct _virStorageVolPathIndexPools virStorageVolPathIndexPools;
+typedef virStorageVolPathIndexPools *virStorageVolPathIndexPoolsPtr;
+struct _virStorageVolPathIndexPools {
+    size_t nentries;
+    virStorageVolPathIndexEntryPtr entries;
+};
+
 struct _virStoragePoolObj {
     virObjectLockable parent;
 
@@ -92,6 +131,9 @@ struct _virStoragePoolObj {
     virStoragePoolDefPtr newDef;
 
     virStorageVolObjListPtr volumes;
+
+    /* index of the list the pool belongs to, NULL if there's none */
+    virStorageVolPathIndexPtr volPaths;
 };
 
 struct _virStoragePoolObjList {
@@ -104,6 +146,8 @@ struct _virStoragePoolObjList {
     /* name string -> virStoragePoolObj mapping
      * for (1), lockless lookup-by-name */
     virHashTable *objsName;
+
+    virStorageVolPathIndexPtr volPaths;
 };
 
 
@@ -122,6 +166,12 @@ virStorageVolObjOnceInit(void)
                                                   virStorageVolObjListDispose)))
         return -1;
 
+    if (!(virStorageVolPathIndexClass = virClassNew(virClassForObjectLockable(),
+                                                    "virStorageVolPathIndex",
+                                                    sizeof(virStorageVolPathIndex),
+                                                    virStorageVolPathIndexDispose)))
+        return -1;
+
     return 0;
 }
 
@@ -165,6 +215,7 @@ virStorageVolObjDispose(void *opaque)
         return;
 
     virStorageVolDefFree(obj->voldef);
+    VIR_FREE(obj->devpath);
 }
 
 
@@ -204,6 +255,234 @@ virStorageVolObjListDispose(void *opaque)
 }
 
 
+static void
+virStorageVolPathIndexPoolsFree(void *payload,
+                                const void *name ATTRIBUTE_UNUSED)
+{
+    virStorageVolPathIndexPoolsPtr pools = payload;
+    size_t i;
+
+    if (!pools)
+        return;
+
+    for (i = 0; i < pools->nentries; i++)
+        VIR_FREE(pools->entries[i].target);
+    VIR_FREE(pools->entries);
+    VIR_FREE(pools);
+}
+
+
+static virStorageVolPathIndexPtr
+virStorageVolPathIndexNew(void)
+{
+    virStorageVolPathIndexPtr index;
+
+    if (virStorageVolObjInitialize() < 0)
+        return NULL;
+
+    if (!(index = virObjectLockableNew(virStorageVolPathIndexClass)))
+        return NULL;
+
+    if (!(index->paths = virHashCreate(50, virStorageVolPathIndexPoolsFree))) {
+        virObjectUnref(index);
+        return NULL;
+    }
+
+    return index;
+}
+
+
+static void
+virStorageVolPathIndexDispose(void *opaque)
+{
+    virStorageVolPathIndexPtr index = opaque;
+
+    if (!index)
+        return;
+
+    virHashFree(index->paths);
+}
+
+
+static ssize_t
+virStorageVolPathIndexPoolsFind(virStorageVolPathIndexPoolsPtr pools,
+                                const unsigned char *uuid,
+                                const char *target)
+{
+    size_t i;
+
+    for (i = 0; i < pools->nentries; i++) {
+        if (memcmp(pools->entries[i].uuid, uuid, VIR_UUID_BUFLEN) == 0 &&
+            STREQ_NULLABLE(pools->entries[i].target, target))
+            return i;
+    }
+
+    return -1;
+}
+
+
+/* Records that @path is a volume of the pool @uuid, or the device node
+ * of its volume @target. Pools claiming the same path are kept in the
+ * order they added it. */
+static int
+virStorageVolPathIndexAdd(virStorageVolPathIndexPtr index,
+                          const char *path,
+                          const unsigned char *uuid,
+                          const char *target)
+{
+    virStorageVolPathIndexPoolsPtr pools;
+    virStorageVolPathIndexEntry entry;
+    int ret = -1;
+
+    if (!index || !path)
+        return 0;
+
+    memset(&entry, 0, sizeof(entry));
+    memcpy(entry.uuid, uuid, VIR_UUID_BUFLEN);
+    if (VIR_STRDUP(entry.target, target) < 0)
+        return -1;
+
+    virObjectLock(index);
+    if (!(pools = virHashLookup(index->paths, path))) {
+        if (VIR_ALLOC(pools) < 0)
+            goto cleanup;
+
+        if (virHashAddEntry(index->paths, path, pools) < 0) {
+            VIR_FREE(pools);
+            goto cleanup;
+        }
+    }
+
+    if (virStorageVolPathIndexPoolsFind(pools, uuid, target) < 0 &&
+        VIR_APPEND_ELEMENT(pools->entries, pools->nentries, entry) < 0) {
+        if (pools->nentries == 0)
+            virHashRemoveEntry(index->paths, path);
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virObjectUnlock(index);
+    VIR_FREE(entry.target);
+    return ret;
+}
+
+
+/* Drops the claim of the pool @uuid on @path added by
+ * virStorageVolPathIndexAdd, other pools keep theirs. */
+static void
+virStorageVolPathIndexRemove(virStorageVolPathIndexPtr index,
+                             const char *path,
+                             const unsigned char *uuid,
+                             const char *target)
+{
+    virStorageVolPathIndexPoolsPtr pools;
+    ssize_t i;
+
+    if (!index || !path)
+        return;
+
+    virObjectLock(index);
+    if ((pools = virHashLookup(index->paths, path)) &&
+        (i = virStorageVolPathIndexPoolsFind(pools, uuid, target)) >= 0) {
+        VIR_FREE(pools->entries[i].target);
+        VIR_DELETE_ELEMENT(pools->entries, i, pools->nentries);
+
+        if (pools->nentries == 0)
+            virHashRemoveEntry(index->paths, path);
+    }
+    virObjectUnlock(index);
+}
+
+
+/*
+ * Volumes of pools pointing somewhere like /dev/disk/by-path are
+ * symlinks to device nodes, and users often refer to them by the
+ * device node. Returns the device node @voldef of @obj resolves to,
+ * or NULL if there is none or it is the target path itself.
+ */
+static char *
+virStorageVolObjGetDevPath(virStoragePoolObjPtr obj,
+                           virStorageVolDefPtr voldef)
+{
+    const char *poolpath = obj->def->target.path;
+    char *devpath = NULL;
+
+    /* Logical pools are under /dev but already have stable paths */
+    if (!obj->volPaths ||
+        obj->def->type == VIR_STORAGE_POOL_LOGICAL ||
+        !poolpath || !STRPREFIX(poolpath, "/dev/") || STREQ(poolpath, "/dev/") ||
+        !voldef->target.path)
+        return NULL;
+
+    if (virFileResolveAllLinks(voldef->target.path, &devpath) < 0)
+        return NULL;
+
+    if (STREQ(devpath, voldef->target.path))
+        VIR_FREE(devpath);
+
+    return devpath;
+}
+
+
+static int
+virStorageVolPathIndexAddVol(virStoragePoolObjPtr obj,
+                             virStorageVolObjPtr volobj)
+{
+    const char *target = volobj->voldef->target.path;
+
+    if (virStorageVolPathIndexAdd(obj->volPaths, target,
+                                  obj->def->uuid, NULL) < 0)
+        return -1;
+
+    if (volobj->devpath &&
+        virStorageVolPathIndexAdd(obj->volPaths, volobj->devpath,
+                                  obj->def->uuid, target) < 0) {
+        virStorageVolPathIndexRemove(obj->volPaths, target,
+                                     obj->def->uuid, NULL);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static void
+virStorageVolPathIndexRemoveVol(virStoragePoolObjPtr obj,
+                                virStorageVolObjPtr volobj)
+{
+    const char *target = volobj->voldef->target.path;
+
+    virStorageVolPathIndexRemove(obj->volPaths, target, obj->def->uuid, NULL);
+    if (volobj->devpath)
+        virStorageVolPathIndexRemove(obj->volPaths, volobj->devpath,
+                                     obj->def->uuid, target);
+}
+
+
+static int
+virStorageVolPathIndexRemovePoolCb(void *payload,
+                                   const void *name ATTRIBUTE_UNUSED,
+                                   void *opaque)
+{
+    virStorageVolPathIndexRemoveVol(opaque, payload);
+    return 0;
+}
+
+
+/* Drops all volumes of locked @obj from the index */
+static void
+virStorageVolPathIndexRemovePool(virStoragePoolObjPtr obj)
+{
+    if (!obj->volPaths)
+        return;
+
+    virHashForEach(obj->volumes->objsPath,
+                   virStorageVolPathIndexRemovePoolCb, obj);
+}
+
+
 static int
 virStoragePoolObjOnceInit(void)
 {
@@ -378,6 +657,7 @@ virStoragePoolObjDispose(void *opaque)
 
     virStoragePoolObjClearVols(obj);
     virObjectUnref(obj->volumes);
+    virObjectUnref(obj->volPaths);
 
     virStoragePoolDefFree(obj->def);
     virStoragePoolDefFree(obj->newDef);
@@ -394,6 +674,7 @@ virStoragePoolObjListDispose(void *opaque)
 
     virHashFree(pools->objs);
     virHashFree(pools->objsName);
+    virObjectUnref(pools->volPaths);
 }
 
 
@@ -409,7 +690,8 @@ virStoragePoolObjListNew(void)
         return NULL;
 
     if (!(pools->objs = virHashCreate(20, virObjectFreeHashData)) ||
-        !(pools->objsName = virHashCreate(20, virObjectFreeHashData))) {
+        !(pools->objsName = virHashCreate(20, virObjectFreeHashData)) ||
+        !(pools->volPaths = virStorageVolPathIndexNew())) {
         virObjectUnref(pools);
         return NULL;
     }
@@ -530,6 +812,11 @@ virStoragePoolObjRemove(virStoragePoolObjListPtr pools,
     virObjectLock(obj);
     virHashRemoveEntry(pools->objs, uuidstr);
     virHashRemoveEntry(pools->objsName, obj->def->name);
+    virObjectRWLockRead(obj->volumes);
+    virStorageVolPathIndexRemovePool(obj);
+    virObjectRWUnlock(obj->volumes);
+    virObjectUnref(obj->volPaths);
+    obj->volPaths = NULL;
     virObjectUnlock(obj);
     virObjectUnref(obj);
     virObjectRWUnlock(pools);
@@ -606,6 +893,67 @@ virStoragePoolObjFindByName(virStoragePoolObjListPtr pools,
 }
 
 
+/**
+ * virStoragePoolObjFindByVolPath
+ * @pools: Storage pool object list pointer
+ * @path: Path of the volume to find
+ * @voldef: filled with the volume definition found
+ *
+ * Find the active pool holding a volume with target path @path using
+ * the index of volume paths maintained for all pools in @pools, which
+ * avoids searching each pool in turn. Device nodes the volumes of pools
+ * with stable paths resolve to are indexed too. If several pools claim
+ * @path, the one which added it first wins.
+ *
+ * Returns: Locked and reffed storage pool object or NULL if not found
+ */
+virStoragePoolObjPtr
+virStoragePoolObjFindByVolPath(virStoragePoolObjListPtr pools,
+                               const char *path,
+                               virStorageVolDefPtr *voldef)
+{
+    virStoragePoolObjPtr obj = NULL;
+    virStorageVolPathIndexPoolsPtr value;
+    virStorageVolPathIndexEntryPtr entries = NULL;
+    size_t nentries = 0;
+    size_t i;
+
+    *voldef = NULL;
+
+    /* Pools are looked up without holding the index lock, which is
+     * taken with pool locks held when volumes are added or removed */
+    virObjectLock(pools->volPaths);
+    if ((value = virHashLookup(pools->volPaths->paths, path)) &&
+        VIR_ALLOC_N_QUIET(entries, value->nentries) == 0) {
+        for (i = 0; i < value->nentries; i++) {
+            memcpy(entries[i].uuid, value->entries[i].uuid, VIR_UUID_BUFLEN);
+            if (VIR_STRDUP_QUIET(entries[i].target,
+                                 value->entries[i].target) < 0)
+                break;
+        }
+        nentries = i;
+    }
+    virObjectUnlock(pools->volPaths);
+
+    for (i = 0; i < nentries && !*voldef; i++) {
+        const char *target = entries[i].target ? entries[i].target : path;
+
+        if (!(obj = virStoragePoolObjFindByUUID(pools, entries[i].uuid)))
+            continue;
+
+        if (!virStoragePoolObjIsActive(obj) ||
+            !(*voldef = virStorageVolDefFindByPath(obj, target)))
+            virStoragePoolObjEndAPI(&obj);
+    }
+
+    for (i = 0; i < nentries; i++)
+        VIR_FREE(entries[i].target);
+    VIR_FREE(entries);
+
+    return obj;
+}
+
+
 static virStoragePoolObjPtr
 virStoragePoolSourceFindDuplicateDevices(virStoragePoolObjPtr obj,
                                          virStoragePoolDefPtr def)
@@ -626,18 +974,76 @@ virStoragePoolSourceFindDuplicateDevices(virStoragePoolObjPtr obj,
 void
 virStoragePoolObjClearVols(virStoragePoolObjPtr obj)
 {
+    virStorageVolPathIndexRemovePool(obj);
     virHashRemoveAll(obj->volumes->objsKey);
     virHashRemoveAll(obj->volumes->objsName);
     virHashRemoveAll(obj->volumes->objsPath);
 }
 
 
+struct _virStoragePoolObjPruneVolsData {
+    virHashTablePtr keep;
+    virStorageVolDefPtr *voldefs;
+    size_t nvoldefs;
+};
+
+static int
+virStoragePoolObjPruneVolsCb(void *payload,
+                             const void *name,
+                             void *opaque)
+{
+    virStorageVolObjPtr volobj = payload;
+    struct _virStoragePoolObjPruneVolsData *data = opaque;
+
+    if (virHashLookup(data->keep, name))
+        return 0;
+
+    return VIR_APPEND_ELEMENT(data->voldefs, data->nvoldefs, volobj->voldef);
+}
+
+
+/**
+ * virStoragePoolObjPruneVols:
+ * @obj: storage pool object
+ * @keep: hash table keyed by names of volumes to keep
+ *
+ * Remove all volumes of @obj whose name is not found in @keep.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virStoragePoolObjPruneVols(virStoragePoolObjPtr obj,
+                           virHashTablePtr keep)
+{
+    struct _virStoragePoolObjPruneVolsData data = { .keep = keep };
+    size_t i;
+    int ret = -1;
+
+    virObjectRWLockRead(obj->volumes);
+    if (virHashForEach(obj->volumes->objsName,
+                       virStoragePoolObjPruneVolsCb, &data) < 0) {
+        virObjectRWUnlock(obj->volumes);
+        goto cleanup;
+    }
+    virObjectRWUnlock(obj->volumes);
+
+    for (i = 0; i < data.nvoldefs; i++)
+        virStoragePoolObjRemoveVol(obj, data.voldefs[i]);
+
+    ret = 0;
+ cleanup:
+    VIR_FREE(data.voldefs);
+    return ret;
+}
+
+
 int
 virStoragePoolObjAddVol(virStoragePoolObjPtr obj,
                         virStorageVolDefPtr voldef)
 {
     virStorageVolObjPtr volobj = NULL;
     virStorageVolObjListPtr volumes = obj->volumes;
+    char *devpath = virStorageVolObjGetDevPath(obj, voldef);
 
     virObjectRWLockWrite(volumes);
 
@@ -662,6 +1068,16 @@ virStoragePoolObjAddVol(virStoragePoolObjPtr obj,
     virObjectRef(volobj);
 
     volobj->voldef = voldef;
+    VIR_STEAL_PTR(volobj->devpath, devpath);
+    if (virStorageVolPathIndexAddVol(obj, volobj) < 0) {
+        /* the caller keeps @voldef on failure */
+        volobj->voldef = NULL;
+        virHashRemoveEntry(volumes->objsKey, voldef->key);
+        virHashRemoveEntry(volumes->objsName, voldef->name);
+        virHashRemoveEntry(volumes->objsPath, voldef->target.path);
+        goto error;
+    }
+
     virObjectRWUnlock(volumes);
     virStorageVolObjEndAPI(&volobj);
     return 0;
@@ -669,6 +1085,7 @@ virStoragePoolObjAddVol(virStoragePoolObjPtr obj,
  error:
     virStorageVolObjEndAPI(&volobj);
     virObjectRWUnlock(volumes);
+    VIR_FREE(devpath);
     return -1;
 }
 
@@ -693,6 +1110,7 @@ virStoragePoolObjRemoveVol(virStoragePoolObjPtr obj,
 
     virObjectRef(volobj);
     virObjectLock(volobj);
+    virStorageVolPathIndexRemoveVol(obj, volobj);
     virHashRemoveEntry(volumes->objsKey, voldef->key);
     virHashRemoveEntry(volumes->objsName, voldef->name);
     virHashRemoveEntry(volumes->objsPath, voldef->target.path);
@@ -1099,6 +1517,7 @@ virStoragePoolObjAssignDef(virStoragePoolObjListPtr pools,
     }
     virObjectRef(obj);
     obj->def = def;
+    obj->volPaths = virObjectRef(pools->volPaths);
     virObjectRWUnlock(pools);
     return obj;
 
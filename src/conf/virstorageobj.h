@@ -23,6 +23,7 @@
 # include "internal.h"
 
 # include "storage_conf.h"
+# include "virhash.h"
 
 typedef struct _virStoragePoolObj virStoragePoolObj;
 typedef virStoragePoolObj *virStoragePoolObjPtr;
@@ -120,6 +121,11 @@ virStoragePoolObjPtr
 virStoragePoolObjFindByName(virStoragePoolObjListPtr pools,
                             const char *name);
 
+virStoragePoolObjPtr
+virStoragePoolObjFindByVolPath(virStoragePoolObjListPtr pools,
+                               const char *path,
+                               virStorageVolDefPtr *voldef);
+
 int
 virStoragePoolObjAddVol(virStoragePoolObjPtr obj,
                         virStorageVolDefPtr voldef);
@@ -164,6 +170,10 @@ virStorageVolDefFindByName(virStoragePoolObjPtr obj,
 void
 virStoragePoolObjClearVols(virStoragePoolObjPtr obj);
 
+int
+virStoragePoolObjPruneVols(virStoragePoolObjPtr obj,
+                           virHashTablePtr keep);
+
 typedef bool
 (*virStoragePoolVolumeACLFilter)(virConnectPtr conn,
                                  virStoragePoolDefPtr pool,
@@ -123,6 +123,11 @@ typedef enum {
      * Support for driver close callback rpc
      */
     VIR_DRV_FEATURE_REMOTE_CLOSE_CALLBACK = 15,
+
+    /*
+     * Support for compact encoding of bulk domain stats
+     */
+    VIR_DRV_FEATURE_REMOTE_COMPACT_DOMAIN_STATS = 16,
 } virDrvFeature;
 
 
@@ -74,6 +74,7 @@
 #include "network_event.h"
 #include "virhook.h"
 #include "virjson.h"
+#include "virlease.h"
 
 #define VIR_FROM_THIS VIR_FROM_NETWORK
 #define MAX_BRIDGE_ID 256
@@ -371,11 +372,11 @@ networkRemoveInactive(virNetworkDriverStatePtr driver,
     /* dnsmasq */
     dnsmasqDelete(dctx);
     unlink(leasefile);
-    unlink(customleasefile);
+    virLeaseDeleteFile(customleasefile);
     unlink(configfile);
 
     /* MAC map manager */
-    unlink(macMapFile);
+    virMacMapDeleteFile(macMapFile);
 
     /* radvd */
     unlink(radvdconfigfile);
@@ -1504,11 +1505,20 @@ networkDnsmasqConfContents(virNetworkObjPtr obj,
 
     /* Even if there are currently no static hosts, if we're
      * listening for DHCP, we should write a 0-length hosts
-     * file to allow for runtime additions.
+     * file to allow for runtime additions. Where possible, give each
+     * host its own file so that dnsmasq picks up new hosts without
+     * having to be reloaded.
      */
-    if (ipv4def || ipv6def)
-        virBufferAsprintf(&configbuf, "dhcp-hostsfile=%s\n",
-                          dctx->hostsfile->path);
+    if (ipv4def || ipv6def) {
+        if (dnsmasqCapsGet(caps, DNSMASQ_CAPS_DHCP_HOSTSDIR)) {
+            dnsmasqUseHostsdir(dctx, true);
+            virBufferAsprintf(&configbuf, "dhcp-hostsdir=%s\n",
+                              dctx->hostsfile->dir);
+        } else {
+            virBufferAsprintf(&configbuf, "dhcp-hostsfile=%s\n",
+                              dctx->hostsfile->path);
+        }
+    }
 
     /* Likewise, always create this file and put it on the
      * commandline, to allow for runtime additions.
@@ -1705,8 +1715,9 @@ networkStartDhcpDaemon(virNetworkDriverStatePtr driver,
 
 /* networkRefreshDhcpDaemon:
  *  Update dnsmasq config files, then send a SIGHUP so that it rereads
- *  them.   This only works for the dhcp-hostsfile and the
- *  addn-hosts file.
+ *  them.   This only works for the dhcp-hostsfile, the dhcp-hostsdir
+ *  and the addn-hosts file. No SIGHUP is needed if all that changed
+ *  is hosts added to a dhcp-hostsdir, dnsmasq watches it by itself.
  *
  *  Returns 0 on success, -1 on failure.
  */
@@ -1720,6 +1731,7 @@ networkRefreshDhcpDaemon(virNetworkDriverStatePtr driver,
     pid_t dnsmasqPid;
     virNetworkIPDefPtr ipdef, ipv4def, ipv6def;
     dnsmasqContext *dctx = NULL;
+    bool reload;
 
     /* if no IP addresses specified, nothing to do */
     if (!virNetworkDefGetIPByIndex(def, AF_UNSPEC, 0))
@@ -1736,6 +1748,9 @@ networkRefreshDhcpDaemon(virNetworkDriverStatePtr driver,
         goto cleanup;
     }
 
+    /* stick to the hosts layout the running dnsmasq was started with */
+    dnsmasqUseHostsdir(dctx, virFileIsDir(dctx->hostsfile->dir));
+
     /* Look for first IPv4 address that has dhcp defined.
      * We only support dhcp-host config on one IPv4 subnetwork
      * and on one IPv6 subnetwork.
@@ -1765,7 +1780,7 @@ networkRefreshDhcpDaemon(virNetworkDriverStatePtr driver,
     if (networkBuildDnsmasqHostsList(dctx, &def->dns) < 0)
         goto cleanup;
 
-    if ((ret = dnsmasqSave(dctx)) < 0)
+    if ((ret = dnsmasqUpdate(dctx, &reload)) < 0 || !reload)
         goto cleanup;
 
     dnsmasqPid = virNetworkObjGetDnsmasqPid(obj);
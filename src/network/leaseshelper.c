@@ -221,6 +221,9 @@ main(int argc, char **argv)
         if (virLeasePrintLeases(leases_array_new, server_duid) < 0)
             goto cleanup;
 
+        /* The index is just an optimization for readers which fall back
+         * to the leases file if it is missing or out of date. */
+        ignore_value(virLeaseWriteIndex(leases_array_new, custom_lease_file));
         break;
 
     case VIR_LEASE_ACTION_OLD:
@@ -243,6 +246,8 @@ main(int argc, char **argv)
         /* Write to file */
         if (virFileRewriteStr(custom_lease_file, 0644, leases_str) < 0)
             goto cleanup;
+
+        ignore_value(virLeaseWriteIndex(leases_array_new, custom_lease_file));
         break;
 
     case VIR_LEASE_ACTION_LAST:
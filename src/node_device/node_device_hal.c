@@ -450,10 +450,8 @@ dev_create(const char *udi)
     char *parent_key = NULL;
     virNodeDeviceObjPtr obj = NULL;
     virNodeDeviceDefPtr def = NULL;
-    virNodeDeviceDefPtr objdef;
     const char *name = hal_name(udi);
     int rv;
-    char *devicePath = NULL;
 
     nodeDeviceLock();
     ctx = DRV_STATE_HAL_CTX(driver);
@@ -479,15 +477,10 @@ dev_create(const char *udi)
         goto cleanup;
 
     /* Some devices don't have a path in sysfs, so ignore failure */
-    (void)get_str_prop(ctx, udi, "linux.sysfs_path", &devicePath);
+    (void)get_str_prop(ctx, udi, "linux.sysfs_path", &def->sysfs_path);
 
-    if (!(obj = virNodeDeviceObjListAssignDef(driver->devs, def))) {
-        VIR_FREE(devicePath);
+    if (!(obj = virNodeDeviceObjListAssignDef(driver->devs, def)))
         goto failure;
-    }
-    objdef = virNodeDeviceObjGetDef(obj);
-
-    objdef->sysfs_path = devicePath;
 
     virNodeDeviceObjEndAPI(&obj);
 
@@ -546,21 +539,15 @@ device_removed(LibHalContext *ctx ATTRIBUTE_UNUSED,
 
 
 static void
-device_cap_added(LibHalContext *ctx,
+device_cap_added(LibHalContext *ctx ATTRIBUTE_UNUSED,
                  const char *udi, const char *cap)
 {
     const char *name = hal_name(udi);
-    virNodeDeviceObjPtr obj;
-    virNodeDeviceDefPtr def;
-
     VIR_DEBUG("%s %s", cap, name);
-    if ((obj = virNodeDeviceObjListFindByName(driver->devs, name))) {
-        def = virNodeDeviceObjGetDef(obj);
-        (void)gather_capability(ctx, udi, cap, &def->caps);
-        virNodeDeviceObjEndAPI(&obj);
-    } else {
-        VIR_DEBUG("no device named %s", name);
-    }
+
+    /* The device list indexes devices by their capabilities, so
+     * rediscover the device rather than altering its caps in place */
+    dev_refresh(udi);
 }
 
 
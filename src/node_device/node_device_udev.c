@@ -31,6 +31,7 @@
 #include "node_device_event.h"
 #include "node_device_driver.h"
 #include "node_device_udev.h"
+#include "node_device_udevpriv.h"
 #include "virerror.h"
 #include "driver.h"
 #include "datatypes.h"
@@ -43,6 +44,8 @@
 #include "virstring.h"
 #include "virnetdev.h"
 #include "virmdev.h"
+#include "virhostcpu.h"
+#include "virtime.h"
 
 #define VIR_FROM_THIS VIR_FROM_NODEDEV
 
@@ -52,6 +55,15 @@ VIR_LOG_INIT("node_device.node_device_udev");
 # define TYPE_RAID 12
 #endif
 
+/* Maximum number of threads gathering details of devices found during
+ * the initial enumeration and the minimum number of devices per thread */
+#define UDEV_ENUMERATE_MAX_WORKERS 8
+#define UDEV_ENUMERATE_MIN_DEVICES 32
+
+/* Maximum number of uevents received from the monitor and handled
+ * at once */
+#define UDEV_EVENT_BATCH_MAX 256
+
 typedef struct _udevEventData udevEventData;
 typedef udevEventData *udevEventDataPtr;
 
@@ -360,6 +372,10 @@ udevLogFunction(struct udev *udev ATTRIBUTE_UNUSED,
 #endif
 
 
+/* libpciaccess loads the PCI ID database lazily into a global table,
+ * serialize the lookups from enumeration threads */
+static virMutex udevPCIIdsLock = VIR_MUTEX_INITIALIZER;
+
 static int
 udevTranslatePCIIds(unsigned int vendor,
                     unsigned int product,
@@ -368,6 +384,7 @@ udevTranslatePCIIds(unsigned int vendor,
 {
     struct pci_id_match m;
     const char *vendor_name = NULL, *device_name = NULL;
+    int ret = -1;
 
     m.vendor_id = vendor;
     m.device_id = product;
@@ -377,6 +394,8 @@ udevTranslatePCIIds(unsigned int vendor,
     m.device_class_mask = 0;
     m.match_data = 0;
 
+    virMutexLock(&udevPCIIdsLock);
+
     /* pci_get_strings returns void */
     pci_get_strings(&m,
                     &device_name,
@@ -386,9 +405,13 @@ udevTranslatePCIIds(unsigned int vendor,
 
     if (VIR_STRDUP(*vendor_string, vendor_name) < 0 ||
         VIR_STRDUP(*product_string, device_name) < 0)
-        return -1;
+        goto cleanup;
 
-    return 0;
+    ret = 0;
+
+ cleanup:
+    virMutexUnlock(&udevPCIIdsLock);
+    return ret;
 }
 
 
@@ -1356,14 +1379,14 @@ udevSetParent(struct udev_device *device,
 }
 
 
+/* Gathers all the details of @device except its parent, which is looked
+ * up in the device list. Doesn't touch the device list, so it may be
+ * called for several devices in parallel. */
 static int
-udevAddOneDevice(struct udev_device *device)
+udevNewDeviceDef(struct udev_device *device,
+                 virNodeDeviceDefPtr *defret)
 {
     virNodeDeviceDefPtr def = NULL;
-    virNodeDeviceObjPtr obj = NULL;
-    virNodeDeviceDefPtr objdef;
-    virObjectEventPtr event = NULL;
-    bool new_device = true;
     int ret = -1;
 
     if (VIR_ALLOC(def) != 0)
@@ -1387,6 +1410,31 @@ udevAddOneDevice(struct udev_device *device)
     if (udevGetDeviceDetails(device, def) != 0)
         goto cleanup;
 
+    VIR_STEAL_PTR(*defret, def);
+    ret = 0;
+
+ cleanup:
+    if (ret != 0) {
+        VIR_DEBUG("Discarding device %d %p %s", ret, def,
+                  def ? NULLSTR(def->sysfs_path) : "");
+        virNodeDeviceDefFree(def);
+    }
+
+    return ret;
+}
+
+
+/* Puts @def of @device into the device list. Consumes @def. */
+static int
+udevAssignDeviceDef(struct udev_device *device,
+                    virNodeDeviceDefPtr def)
+{
+    virNodeDeviceObjPtr obj = NULL;
+    virNodeDeviceDefPtr objdef;
+    virObjectEventPtr event = NULL;
+    bool new_device = true;
+    int ret = -1;
+
     if (udevSetParent(device, def) != 0)
         goto cleanup;
 
@@ -1427,28 +1475,71 @@ udevAddOneDevice(struct udev_device *device)
 
 
 static int
-udevProcessDeviceListEntry(struct udev *udev,
-                           struct udev_list_entry *list_entry)
+udevAddOneDevice(struct udev_device *device)
 {
-    struct udev_device *device;
-    const char *name = NULL;
-    int ret = -1;
+    virNodeDeviceDefPtr def = NULL;
+
+    if (udevNewDeviceDef(device, &def) < 0)
+        return -1;
+
+    return udevAssignDeviceDef(device, def);
+}
 
-    name = udev_list_entry_get_name(list_entry);
 
-    device = udev_device_new_from_syspath(udev, name);
+typedef struct _udevEnumerateWorker udevEnumerateWorker;
+typedef udevEnumerateWorker *udevEnumerateWorkerPtr;
+struct _udevEnumerateWorker {
+    virThread thread;
+    bool started;
 
-    if (device != NULL) {
-        if (udevAddOneDevice(device) != 0) {
+    /* each worker uses its own context, libudev is not thread safe */
+    struct udev *udev;
+
+    /* arrays shared by all workers, each one processing entries
+     * @first, @first + @step, @first + 2 * @step, ... */
+    const char **names;
+    struct udev_device **devices;
+    virNodeDeviceDefPtr *defs;
+    size_t ndevices;
+    size_t first;
+    size_t step;
+};
+
+
+static void
+udevEnumerateWorkerRun(void *opaque)
+{
+    udevEnumerateWorkerPtr worker = opaque;
+    size_t i;
+
+    for (i = worker->first; i < worker->ndevices; i += worker->step) {
+        if (!(worker->devices[i] = udev_device_new_from_syspath(worker->udev,
+                                                                worker->names[i])))
+            continue;
+
+        if (udevNewDeviceDef(worker->devices[i], &worker->defs[i]) != 0) {
             VIR_DEBUG("Failed to create node device for udev device '%s'",
-                      name);
+                      worker->names[i]);
         }
-        ret = 0;
     }
+}
 
-    udev_device_unref(device);
 
-    return ret;
+static size_t
+udevEnumerateWorkersCount(size_t ndevices)
+{
+    int ncpus = virHostCPUGetCount();
+    size_t nworkers = ndevices / UDEV_ENUMERATE_MIN_DEVICES;
+
+    if (ncpus < 0) {
+        virResetLastError();
+        ncpus = 1;
+    }
+
+    nworkers = MIN(nworkers, ncpus);
+    nworkers = MIN(nworkers, UDEV_ENUMERATE_MAX_WORKERS);
+
+    return MAX(nworkers, 1);
 }
 
 
@@ -1476,13 +1567,30 @@ udevEnumerateAddMatches(struct udev_enumerate *udev_enumerate)
 }
 
 
+/* Devices are enumerated in two phases: the details of the devices,
+ * which mostly means reading sysfs, are gathered in parallel by several
+ * workers and then the devices are put into the device list one by one
+ * in the order in which udev listed them so that parents are found
+ * before their children. */
 static int
 udevEnumerateDevices(struct udev *udev)
 {
     struct udev_enumerate *udev_enumerate = NULL;
     struct udev_list_entry *list_entry = NULL;
+    udevEnumerateWorkerPtr workers = NULL;
+    size_t maxworkers;
+    size_t nworkers = 0;
+    const char **names = NULL;
+    struct udev_device **devices = NULL;
+    virNodeDeviceDefPtr *defs = NULL;
+    size_t ndevices = 0;
+    unsigned long long then = 0;
+    unsigned long long now = 0;
+    size_t i;
     int ret = -1;
 
+    ignore_value(virTimeMillisNowRaw(&then));
+
     udev_enumerate = udev_enumerate_new(udev);
     if (udevEnumerateAddMatches(udev_enumerate) < 0)
         goto cleanup;
@@ -1497,11 +1605,98 @@ udevEnumerateDevices(struct udev *udev)
 
     udev_list_entry_foreach(list_entry,
                             udev_enumerate_get_list_entry(udev_enumerate)) {
+        const char *name = udev_list_entry_get_name(list_entry);
 
-        udevProcessDeviceListEntry(udev, list_entry);
+        if (VIR_APPEND_ELEMENT(names, ndevices, name) < 0) {
+            ret = -1;
+            goto cleanup;
+        }
     }
 
+    maxworkers = udevEnumerateWorkersCount(ndevices);
+
+    if (VIR_ALLOC_N(devices, ndevices) < 0 ||
+        VIR_ALLOC_N(defs, ndevices) < 0 ||
+        VIR_ALLOC_N(workers, maxworkers) < 0) {
+        ret = -1;
+        goto cleanup;
+    }
+
+    for (nworkers = 0; nworkers < maxworkers; nworkers++) {
+        udevEnumerateWorkerPtr worker = &workers[nworkers];
+
+        worker->names = names;
+        worker->devices = devices;
+        worker->defs = defs;
+        worker->ndevices = ndevices;
+        worker->first = nworkers;
+        worker->step = maxworkers;
+
+        /* the first worker runs in this thread */
+        if (nworkers == 0) {
+            worker->udev = udev_ref(udev);
+            continue;
+        }
+
+        if (!(worker->udev = udev_new())) {
+            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                           _("failed to create udev context"));
+            ret = -1;
+            goto cleanup;
+        }
+#if HAVE_UDEV_LOGGING
+        udev_set_log_fn(worker->udev, (udevLogFunctionPtr) udevLogFunction);
+#endif
+
+        /* if a thread can't be created, process its share of devices
+         * once the other workers are running */
+        if (virThreadCreate(&worker->thread, true,
+                            udevEnumerateWorkerRun, worker) < 0) {
+            VIR_WARN("Failed to create udev enumeration thread: %s",
+                     virGetLastErrorMessage());
+            virResetLastError();
+        } else {
+            worker->started = true;
+        }
+    }
+
+    for (i = 0; i < nworkers; i++) {
+        if (!workers[i].started)
+            udevEnumerateWorkerRun(&workers[i]);
+    }
+
+    for (i = 0; i < nworkers; i++) {
+        if (workers[i].started) {
+            virThreadJoin(&workers[i].thread);
+            workers[i].started = false;
+        }
+    }
+
+    for (i = 0; i < ndevices; i++) {
+        if (defs[i])
+            ignore_value(udevAssignDeviceDef(devices[i], defs[i]));
+        defs[i] = NULL;
+    }
+
+    ignore_value(virTimeMillisNowRaw(&now));
+    VIR_INFO("Enumerated %zu udev devices using %zu threads in %llu ms",
+             ndevices, nworkers, now - then);
+
  cleanup:
+    for (i = 0; i < nworkers; i++) {
+        if (workers[i].started)
+            virThreadJoin(&workers[i].thread);
+    }
+    for (i = 0; defs && i < ndevices; i++) {
+        virNodeDeviceDefFree(defs[i]);
+        udev_device_unref(devices[i]);
+    }
+    for (i = 0; i < nworkers; i++)
+        udev_unref(workers[i].udev);
+    VIR_FREE(workers);
+    VIR_FREE(defs);
+    VIR_FREE(devices);
+    VIR_FREE(names);
     udev_enumerate_unref(udev_enumerate);
     return ret;
 }
@@ -1566,6 +1761,78 @@ udevHandleOneDevice(struct udev_device *device)
 }
 
 
+/**
+ * udevEventBatchCoalesce:
+ * @syspaths: sysfs paths of the devices of a batch of uevents
+ * @nevents: number of uevents in the batch
+ * @handle: filled with the indexes of the uevents to handle
+ *
+ * When a device shows up several times in a batch, only its last uevent
+ * is handled, but at the position of the first one so that parents which
+ * were added in the same batch are known before their children.
+ *
+ * Returns the number of indexes stored in @handle.
+ */
+size_t
+udevEventBatchCoalesce(const char **syspaths,
+                       size_t nevents,
+                       size_t *handle)
+{
+    size_t nhandle = 0;
+    size_t i;
+    size_t j;
+
+    for (i = 0; i < nevents; i++) {
+        size_t last = i;
+        bool seen = false;
+
+        for (j = 0; j < i && !seen; j++)
+            seen = STREQ_NULLABLE(syspaths[j], syspaths[i]);
+
+        if (seen)
+            continue;
+
+        for (j = i + 1; j < nevents; j++) {
+            if (STREQ_NULLABLE(syspaths[j], syspaths[i]))
+                last = j;
+        }
+
+        handle[nhandle++] = last;
+    }
+
+    return nhandle;
+}
+
+
+/* Handles a batch of at most UDEV_EVENT_BATCH_MAX uevents received
+ * from the monitor, see udevEventBatchCoalesce. */
+static void
+udevHandleDeviceBatch(struct udev_device **devices,
+                      size_t ndevices)
+{
+    const char *syspaths[UDEV_EVENT_BATCH_MAX];
+    size_t handle[UDEV_EVENT_BATCH_MAX];
+    unsigned long long then = 0;
+    unsigned long long now = 0;
+    size_t nhandle;
+    size_t i;
+
+    ignore_value(virTimeMillisNowRaw(&then));
+
+    for (i = 0; i < ndevices; i++)
+        syspaths[i] = udev_device_get_syspath(devices[i]);
+
+    nhandle = udevEventBatchCoalesce(syspaths, ndevices, handle);
+
+    for (i = 0; i < nhandle; i++)
+        udevHandleOneDevice(devices[handle[i]]);
+
+    ignore_value(virTimeMillisNowRaw(&now));
+    VIR_DEBUG("Handled %zu uevents for %zu devices in %llu ms",
+              ndevices, nhandle, now - then);
+}
+
+
 /* the caller must be holding the udevEventData object lock prior to calling
  * this function
  */
@@ -1600,7 +1867,11 @@ static void
 udevEventHandleThread(void *opaque ATTRIBUTE_UNUSED)
 {
     udevEventDataPtr priv = driver->privateData;
+    struct udev_device *devices[UDEV_EVENT_BATCH_MAX];
     struct udev_device *device = NULL;
+    size_t ndevices;
+    size_t i;
+    int err;
 
     /* continue rather than break from the loop on non-fatal errors */
     while (1) {
@@ -1619,38 +1890,46 @@ udevEventHandleThread(void *opaque ATTRIBUTE_UNUSED)
             return;
         }
 
-        errno = 0;
-        device = udev_monitor_receive_device(priv->udev_monitor);
+        /* drain whatever is queued in the monitor so that bursts of
+         * uevents are handled together */
+        ndevices = 0;
+        do {
+            errno = 0;
+            device = udev_monitor_receive_device(priv->udev_monitor);
+            err = errno;
+            if (device)
+                devices[ndevices++] = device;
+        } while (device && ndevices < UDEV_EVENT_BATCH_MAX);
+
+        /* POSIX allows both EAGAIN and EWOULDBLOCK to be used
+         * interchangeably when the read would block or timeout was fired
+         */
+        VIR_WARNINGS_NO_WLOGICALOP_EQUAL_EXPR
+        if (!device && (err == EAGAIN || err == EWOULDBLOCK))
+            priv->dataReady = false;
+        VIR_WARNINGS_RESET
         virObjectUnlock(priv);
 
+        udevHandleDeviceBatch(devices, ndevices);
+        for (i = 0; i < ndevices; i++)
+            udev_device_unref(devices[i]);
+
         if (!device) {
-            if (errno == 0) {
+            if (err == 0) {
                 virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
                                _("failed to receive device from udev monitor"));
                 return;
             }
 
-            /* POSIX allows both EAGAIN and EWOULDBLOCK to be used
-             * interchangeably when the read would block or timeout was fired
-             */
             VIR_WARNINGS_NO_WLOGICALOP_EQUAL_EXPR
-            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            if (err != EAGAIN && err != EWOULDBLOCK) {
             VIR_WARNINGS_RESET
-                virReportSystemError(errno, "%s",
+                virReportSystemError(err, "%s",
                                      _("failed to receive device from udev "
                                        "monitor"));
                 return;
             }
-
-            virObjectLock(priv);
-            priv->dataReady = false;
-            virObjectUnlock(priv);
-
-            continue;
         }
-
-        udevHandleOneDevice(device);
-        udev_device_unref(device);
     }
 }
 
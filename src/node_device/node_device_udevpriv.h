@@ -0,0 +1,33 @@
+/*
+ * node_device_udevpriv.h: private declarations for udev node devices
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __NODE_DEVICE_UDEVPRIV_H__
+# define __NODE_DEVICE_UDEVPRIV_H__
+
+# include "internal.h"
+
+/*
+ * This header file should never be used outside unit tests.
+ */
+
+size_t udevEventBatchCoalesce(const char **syspaths,
+                              size_t nevents,
+                              size_t *handle);
+
+#endif /* __NODE_DEVICE_UDEVPRIV_H__ */
@@ -176,6 +176,9 @@ qemuBlockJobEventProcess(virQEMUDriverPtr driver,
         disk->mirrorState = VIR_DOMAIN_DISK_MIRROR_STATE_NONE;
         disk->mirrorJob = VIR_DOMAIN_BLOCK_JOB_TYPE_UNKNOWN;
         disk->src->id = 0;
+        /* The job rewrote headers within the chain, don't trust the
+         * cached copies even if timestamps didn't advance. */
+        virStorageFileHeaderCacheInvalidateChain(disk->src);
         ignore_value(qemuDomainDetermineDiskChain(driver, vm, disk,
                                                   true, true));
         ignore_value(qemuBlockNodeNamesDetect(driver, vm, asyncJob));
@@ -684,6 +684,10 @@ int virQEMUDriverConfigLoadFile(virQEMUDriverConfigPtr cfg,
         goto cleanup;
     }
 
+    if (virConfGetValueUInt(conf, "migration_max_parallel_disks",
+                            &cfg->migrationMaxParallelDisks) < 0)
+        goto cleanup;
+
     if (virConfGetValueString(conf, "user", &user) < 0)
         goto cleanup;
     if (user && virGetUserID(user, &cfg->user) < 0)
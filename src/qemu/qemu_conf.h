@@ -194,6 +194,7 @@ struct _virQEMUDriverConfig {
     char *migrationAddress;
     unsigned int migrationPortMin;
     unsigned int migrationPortMax;
+    unsigned int migrationMaxParallelDisks;
 
     bool logTimestamp;
     bool stdioLogD;
@@ -334,6 +334,7 @@ qemuDomainObjResetAsyncJob(qemuDomainObjPrivatePtr priv)
     job->spiceMigrated = false;
     job->postcopyEnabled = false;
     job->dumpCompleted = false;
+    job->tunnel = NULL;
     VIR_FREE(job->error);
     VIR_FREE(job->current);
 }
@@ -623,6 +624,15 @@ qemuDomainMigrationJobInfoToParams(qemuDomainJobInfoPtr jobInfo,
                                 stats->disk_bps) < 0)
         goto error;
 
+    if (mirrorStats->disks &&
+        (virTypedParamsAddUInt(&par, &npar, &maxpar,
+                               VIR_DOMAIN_JOB_DISK_MIRRORS,
+                               mirrorStats->disks) < 0 ||
+         virTypedParamsAddUInt(&par, &npar, &maxpar,
+                               VIR_DOMAIN_JOB_DISK_MIRRORS_READY,
+                               mirrorStats->ready) < 0))
+        goto error;
+
     if (stats->xbzrle_set) {
         if (virTypedParamsAddULLong(&par, &npar, &maxpar,
                                     VIR_DOMAIN_JOB_COMPRESSION_CACHE,
@@ -648,6 +658,15 @@ qemuDomainMigrationJobInfoToParams(qemuDomainJobInfoPtr jobInfo,
                              stats->cpu_throttle_percentage) < 0)
         goto error;
 
+    if (jobInfo->tunnelStats.transferred &&
+        (virTypedParamsAddULLong(&par, &npar, &maxpar,
+                                 VIR_DOMAIN_JOB_TUNNEL_PROCESSED,
+                                 jobInfo->tunnelStats.transferred) < 0 ||
+         virTypedParamsAddULLong(&par, &npar, &maxpar,
+                                 VIR_DOMAIN_JOB_TUNNEL_BPS,
+                                 jobInfo->tunnelStats.bps) < 0))
+        goto error;
+
  done:
     *type = qemuDomainJobStatusToType(jobInfo->status);
     *params = par;
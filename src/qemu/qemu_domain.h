@@ -123,8 +123,20 @@ typedef qemuDomainMirrorStats *qemuDomainMirrorStatsPtr;
 struct _qemuDomainMirrorStats {
     unsigned long long transferred;
     unsigned long long total;
+    unsigned int disks; /* number of started mirrors */
+    unsigned int ready; /* mirrors which finished initial sync */
 };
 
+typedef struct _qemuDomainTunnelStats qemuDomainTunnelStats;
+typedef qemuDomainTunnelStats *qemuDomainTunnelStatsPtr;
+struct _qemuDomainTunnelStats {
+    unsigned long long transferred; /* bytes sent through the tunnel */
+    unsigned long long bps; /* average throughput since the tunnel started */
+};
+
+typedef struct _qemuMigrationIOThread qemuMigrationIOThread;
+typedef qemuMigrationIOThread *qemuMigrationIOThreadPtr;
+
 typedef struct _qemuDomainJobInfo qemuDomainJobInfo;
 typedef qemuDomainJobInfo *qemuDomainJobInfoPtr;
 struct _qemuDomainJobInfo {
@@ -151,6 +163,7 @@ struct _qemuDomainJobInfo {
         qemuMonitorDumpStats dump;
     } stats;
     qemuDomainMirrorStats mirrorStats;
+    qemuDomainTunnelStats tunnelStats;
 };
 
 struct qemuDomainJobObj {
@@ -177,6 +190,7 @@ struct qemuDomainJobObj {
     bool postcopyEnabled;               /* post-copy migration was enabled */
     char *error;                        /* job event completion error */
     bool dumpCompleted;                 /* dump completed */
+    qemuMigrationIOThreadPtr tunnel;    /* tunnelled migration IO thread */
 };
 
 typedef void (*qemuDomainCleanupCallback)(virQEMUDriverPtr driver,
@@ -1226,6 +1226,7 @@ qemuConnectSupportsFeature(virConnectPtr conn, int feature)
     case VIR_DRV_FEATURE_PROGRAM_KEEPALIVE:
     case VIR_DRV_FEATURE_REMOTE:
     case VIR_DRV_FEATURE_REMOTE_CLOSE_CALLBACK:
+    case VIR_DRV_FEATURE_REMOTE_COMPACT_DOMAIN_STATS:
     case VIR_DRV_FEATURE_REMOTE_EVENT_CALLBACK:
     default:
         return 0;
@@ -12215,7 +12216,7 @@ qemuDomainMigratePrepare2(virConnectPtr dconn,
                                         NULL, 0, NULL, NULL, /* No cookies */
                                         uri_in, uri_out,
                                         &def, origname, NULL, 0, NULL, 0,
-                                        compression, flags);
+                                        compression, NULL, flags);
 
  cleanup:
     VIR_FREE(compression);
@@ -12454,7 +12455,7 @@ qemuDomainMigratePrepare3(virConnectPtr dconn,
                                         cookieout, cookieoutlen,
                                         uri_in, uri_out,
                                         &def, origname, NULL, 0, NULL, 0,
-                                        compression, flags);
+                                        compression, NULL, flags);
 
  cleanup:
     VIR_FREE(compression);
@@ -12486,6 +12487,7 @@ qemuDomainMigratePrepare3Params(virConnectPtr dconn,
     const char **migrate_disks = NULL;
     char *origname = NULL;
     qemuMigrationCompressionPtr compression = NULL;
+    qemuMonitorMigrationParamsPtr migParams = NULL;
     int ret = -1;
 
     virCheckFlagsGoto(QEMU_MIGRATION_FLAGS, cleanup);
@@ -12519,6 +12521,9 @@ qemuDomainMigratePrepare3Params(virConnectPtr dconn,
     if (!(compression = qemuMigrationAnyCompressionParse(params, nparams, flags)))
         goto cleanup;
 
+    if (!(migParams = qemuMigrationParams(params, nparams, flags)))
+        goto cleanup;
+
     if (flags & VIR_MIGRATE_TUNNELLED) {
         /* this is a logical error; we never should have gotten here with
          * VIR_MIGRATE_TUNNELLED set
@@ -12541,10 +12546,11 @@ qemuDomainMigratePrepare3Params(virConnectPtr dconn,
                                         uri_in, uri_out,
                                         &def, origname, listenAddress,
                                         nmigrate_disks, migrate_disks, nbdPort,
-                                        compression, flags);
+                                        compression, migParams, flags);
 
  cleanup:
     VIR_FREE(compression);
+    qemuMigrationParamsFree(&migParams);
     VIR_FREE(migrate_disks);
     VIR_FREE(origname);
     virDomainDefFree(def);
@@ -19513,25 +19519,26 @@ qemuConnectGetDomainCapabilities(virConnectPtr conn,
 }
 
 
+/* Data shared by the stats workers across all domains queried by a single
+ * virConnectGetAllDomainStats call. */
+typedef struct _qemuDomainStatsCache qemuDomainStatsCache;
+typedef qemuDomainStatsCache *qemuDomainStatsCachePtr;
+struct _qemuDomainStatsCache {
+    virNetDevTapStatsCachePtr ifstats;
+};
+
+
 static int
 qemuDomainGetStatsState(virQEMUDriverPtr driver ATTRIBUTE_UNUSED,
                         virDomainObjPtr dom,
-                        virDomainStatsRecordPtr record,
-                        int *maxparams,
+                        virTypedParamListPtr params,
+                        qemuDomainStatsCachePtr cache ATTRIBUTE_UNUSED,
                         unsigned int privflags ATTRIBUTE_UNUSED)
 {
-    if (virTypedParamsAddInt(&record->params,
-                             &record->nparams,
-                             maxparams,
-                             "state.state",
-                             dom->state.state) < 0)
+    if (virTypedParamListAddInt(params, "state.state", dom->state.state) < 0)
         return -1;
 
-    if (virTypedParamsAddInt(&record->params,
-                             &record->nparams,
-                             maxparams,
-                             "state.reason",
-                             dom->state.reason) < 0)
+    if (virTypedParamListAddInt(params, "state.reason", dom->state.reason) < 0)
         return -1;
 
     return 0;
@@ -19552,8 +19559,8 @@ typedef enum {
 static int
 qemuDomainGetStatsCpu(virQEMUDriverPtr driver ATTRIBUTE_UNUSED,
                       virDomainObjPtr dom,
-                      virDomainStatsRecordPtr record,
-                      int *maxparams,
+                      virTypedParamListPtr params,
+                      qemuDomainStatsCachePtr cache ATTRIBUTE_UNUSED,
                       unsigned int privflags ATTRIBUTE_UNUSED)
 {
     qemuDomainObjPrivatePtr priv = dom->privateData;
@@ -19566,25 +19573,13 @@ qemuDomainGetStatsCpu(virQEMUDriverPtr driver ATTRIBUTE_UNUSED,
         return 0;
 
     err = virCgroupGetCpuacctUsage(priv->cgroup, &cpu_time);
-    if (!err && virTypedParamsAddULLong(&record->params,
-                                        &record->nparams,
-                                        maxparams,
-                                        "cpu.time",
-                                        cpu_time) < 0)
+    if (!err && virTypedParamListAddULLong(params, "cpu.time", cpu_time) < 0)
         return -1;
 
     err = virCgroupGetCpuacctStat(priv->cgroup, &user_time, &sys_time);
-    if (!err && virTypedParamsAddULLong(&record->params,
-                                        &record->nparams,
-                                        maxparams,
-                                        "cpu.user",
-                                        user_time) < 0)
+    if (!err && virTypedParamListAddULLong(params, "cpu.user", user_time) < 0)
         return -1;
-    if (!err && virTypedParamsAddULLong(&record->params,
-                                        &record->nparams,
-                                        maxparams,
-                                        "cpu.system",
-                                        sys_time) < 0)
+    if (!err && virTypedParamListAddULLong(params, "cpu.system", sys_time) < 0)
         return -1;
 
     return 0;
@@ -19593,8 +19588,8 @@ qemuDomainGetStatsCpu(virQEMUDriverPtr driver ATTRIBUTE_UNUSED,
 static int
 qemuDomainGetStatsBalloon(virQEMUDriverPtr driver,
                           virDomainObjPtr dom,
-                          virDomainStatsRecordPtr record,
-                          int *maxparams,
+                          virTypedParamListPtr params,
+                          qemuDomainStatsCachePtr cache ATTRIBUTE_UNUSED,
                           unsigned int privflags)
 {
     qemuDomainObjPrivatePtr priv = dom->privateData;
@@ -19612,18 +19607,12 @@ qemuDomainGetStatsBalloon(virQEMUDriverPtr driver,
         err = -1;
     }
 
-    if (!err && virTypedParamsAddULLong(&record->params,
-                                        &record->nparams,
-                                        maxparams,
-                                        "balloon.current",
-                                        cur_balloon) < 0)
+    if (!err && virTypedParamListAddULLong(params, "balloon.current",
+                                           cur_balloon) < 0)
         return -1;
 
-    if (virTypedParamsAddULLong(&record->params,
-                                &record->nparams,
-                                maxparams,
-                                "balloon.maximum",
-                                virDomainDefGetMemoryTotal(dom->def)) < 0)
+    if (virTypedParamListAddULLong(params, "balloon.maximum",
+                                   virDomainDefGetMemoryTotal(dom->def)) < 0)
         return -1;
 
     if (!HAVE_JOB(privflags) || !virDomainObjIsActive(dom))
@@ -19636,11 +19625,8 @@ qemuDomainGetStatsBalloon(virQEMUDriverPtr driver,
 
 #define STORE_MEM_RECORD(TAG, NAME) \
     if (stats[i].tag == VIR_DOMAIN_MEMORY_STAT_ ##TAG) \
-        if (virTypedParamsAddULLong(&record->params, \
-                                    &record->nparams, \
-                                    maxparams, \
-                                    "balloon." NAME, \
-                                    stats[i].val) < 0) \
+        if (virTypedParamListAddULLong(params, "balloon." NAME, \
+                                       stats[i].val) < 0) \
             return -1;
 
     for (i = 0; i < nr_stats; i++) {
@@ -19664,30 +19650,23 @@ qemuDomainGetStatsBalloon(virQEMUDriverPtr driver,
 static int
 qemuDomainGetStatsVcpu(virQEMUDriverPtr driver,
                        virDomainObjPtr dom,
-                       virDomainStatsRecordPtr record,
-                       int *maxparams,
+                       virTypedParamListPtr params,
+                       qemuDomainStatsCachePtr cache ATTRIBUTE_UNUSED,
                        unsigned int privflags)
 {
     virDomainVcpuDefPtr vcpu;
     qemuDomainVcpuPrivatePtr vcpupriv;
     size_t i;
     int ret = -1;
-    char param_name[VIR_TYPED_PARAM_FIELD_LENGTH];
     virVcpuInfoPtr cpuinfo = NULL;
     unsigned long long *cpuwait = NULL;
 
-    if (virTypedParamsAddUInt(&record->params,
-                              &record->nparams,
-                              maxparams,
-                              "vcpu.current",
-                              virDomainDefGetVcpus(dom->def)) < 0)
+    if (virTypedParamListAddUInt(params, "vcpu.current",
+                                 virDomainDefGetVcpus(dom->def)) < 0)
         return -1;
 
-    if (virTypedParamsAddUInt(&record->params,
-                              &record->nparams,
-                              maxparams,
-                              "vcpu.maximum",
-                              virDomainDefGetVcpusMax(dom->def)) < 0)
+    if (virTypedParamListAddUInt(params, "vcpu.maximum",
+                                 virDomainDefGetVcpusMax(dom->def)) < 0)
         return -1;
 
     if (VIR_ALLOC_N(cpuinfo, virDomainDefGetVcpus(dom->def)) < 0 ||
@@ -19710,34 +19689,21 @@ qemuDomainGetStatsVcpu(virQEMUDriverPtr driver,
     }
 
     for (i = 0; i < virDomainDefGetVcpus(dom->def); i++) {
-        snprintf(param_name, VIR_TYPED_PARAM_FIELD_LENGTH,
-                 "vcpu.%u.state", cpuinfo[i].number);
-        if (virTypedParamsAddInt(&record->params,
-                                 &record->nparams,
-                                 maxparams,
-                                 param_name,
-                                 cpuinfo[i].state) < 0)
+        if (virTypedParamListSetPrefix(params, "vcpu.%u.",
+                                       cpuinfo[i].number) < 0)
+            goto cleanup;
+
+        if (virTypedParamListAddInt(params, "state", cpuinfo[i].state) < 0)
             goto cleanup;
 
         /* stats below are available only if the VM is alive */
         if (!virDomainObjIsActive(dom))
             continue;
 
-        snprintf(param_name, VIR_TYPED_PARAM_FIELD_LENGTH,
-                 "vcpu.%u.time", cpuinfo[i].number);
-        if (virTypedParamsAddULLong(&record->params,
-                                    &record->nparams,
-                                    maxparams,
-                                    param_name,
-                                    cpuinfo[i].cpuTime) < 0)
+        if (virTypedParamListAddULLong(params, "time",
+                                       cpuinfo[i].cpuTime) < 0)
             goto cleanup;
-        snprintf(param_name, VIR_TYPED_PARAM_FIELD_LENGTH,
-                 "vcpu.%u.wait", cpuinfo[i].number);
-        if (virTypedParamsAddULLong(&record->params,
-                                    &record->nparams,
-                                    maxparams,
-                                    param_name,
-                                    cpuwait[i]) < 0)
+        if (virTypedParamListAddULLong(params, "wait", cpuwait[i]) < 0)
             goto cleanup;
 
         /* state below is extracted from the individual vcpu structs */
@@ -19747,13 +19713,8 @@ qemuDomainGetStatsVcpu(virQEMUDriverPtr driver,
         vcpupriv = QEMU_DOMAIN_VCPU_PRIVATE(vcpu);
 
         if (vcpupriv->halted != VIR_TRISTATE_BOOL_ABSENT) {
-            snprintf(param_name, VIR_TYPED_PARAM_FIELD_LENGTH,
-                     "vcpu.%u.halted", cpuinfo[i].number);
-            if (virTypedParamsAddBoolean(&record->params,
-                                         &record->nparams,
-                                         maxparams,
-                                         param_name,
-                                         vcpupriv->halted == VIR_TRISTATE_BOOL_YES) < 0)
+            if (virTypedParamListAddBoolean(params, "halted",
+                                            vcpupriv->halted == VIR_TRISTATE_BOOL_YES) < 0)
                 goto cleanup;
         }
     }
@@ -19766,59 +19727,71 @@ qemuDomainGetStatsVcpu(virQEMUDriverPtr driver,
     return ret;
 }
 
-#define QEMU_ADD_COUNT_PARAM(record, maxparams, type, count) \
+#define QEMU_ADD_COUNT_PARAM(params, type, count) \
 do { \
-    char param_name[VIR_TYPED_PARAM_FIELD_LENGTH]; \
-    snprintf(param_name, VIR_TYPED_PARAM_FIELD_LENGTH, "%s.count", type); \
-    if (virTypedParamsAddUInt(&(record)->params, \
-                              &(record)->nparams, \
-                              maxparams, \
-                              param_name, \
-                              count) < 0) \
+    if (virTypedParamListAddUInt(params, type ".count", count) < 0) \
         goto cleanup; \
 } while (0)
 
-#define QEMU_ADD_NAME_PARAM(record, maxparams, type, subtype, num, name) \
+#define QEMU_ADD_NAME_PARAM(params, subtype, name) \
 do { \
-    char param_name[VIR_TYPED_PARAM_FIELD_LENGTH]; \
-    snprintf(param_name, VIR_TYPED_PARAM_FIELD_LENGTH, \
-             "%s.%zu.%s", type, num, subtype); \
-    if (virTypedParamsAddString(&(record)->params, \
-                                &(record)->nparams, \
-                                maxparams, \
-                                param_name, \
-                                name) < 0) \
+    if (virTypedParamListAddString(params, subtype, name) < 0) \
         goto cleanup; \
 } while (0)
 
-#define QEMU_ADD_NET_PARAM(record, maxparams, num, name, value) \
+#define QEMU_ADD_NET_PARAM(params, name, value) \
 do { \
-    char param_name[VIR_TYPED_PARAM_FIELD_LENGTH]; \
-    snprintf(param_name, VIR_TYPED_PARAM_FIELD_LENGTH, \
-             "net.%zu.%s", num, name); \
-    if (value >= 0 && virTypedParamsAddULLong(&(record)->params, \
-                                              &(record)->nparams, \
-                                              maxparams, \
-                                              param_name, \
-                                              value) < 0) \
-        return -1; \
+    if (value >= 0 && virTypedParamListAddULLong(params, name, value) < 0) \
+        goto cleanup; \
 } while (0)
 
 static int
 qemuDomainGetStatsInterface(virQEMUDriverPtr driver ATTRIBUTE_UNUSED,
                             virDomainObjPtr dom,
-                            virDomainStatsRecordPtr record,
-                            int *maxparams,
+                            virTypedParamListPtr params,
+                            qemuDomainStatsCachePtr cache,
                             unsigned int privflags ATTRIBUTE_UNUSED)
 {
     size_t i;
     struct _virDomainInterfaceStats tmp;
+    const char **ovsIfnames = NULL;
+    virDomainInterfaceStatsPtr ovsStats = NULL;
+    size_t novs = 0;
     int ret = -1;
 
     if (!virDomainObjIsActive(dom))
         return 0;
 
-    QEMU_ADD_COUNT_PARAM(record, maxparams, "net", dom->def->nnets);
+    QEMU_ADD_COUNT_PARAM(params, "net", dom->def->nnets);
+
+    /* Statistics of all vhost-user interfaces are fetched from OVS at once
+     * rather than spawning ovs-vsctl for every single interface. */
+    for (i = 0; i < dom->def->nnets; i++) {
+        virDomainNetDefPtr net = dom->def->nets[i];
+
+        if (net->ifname &&
+            virDomainNetGetActualType(net) == VIR_DOMAIN_NET_TYPE_VHOSTUSER)
+            novs++;
+    }
+
+    if (novs > 0) {
+        if (VIR_ALLOC_N(ovsIfnames, dom->def->nnets) < 0 ||
+            VIR_ALLOC_N(ovsStats, dom->def->nnets) < 0)
+            goto cleanup;
+
+        for (i = 0; i < dom->def->nnets; i++) {
+            virDomainNetDefPtr net = dom->def->nets[i];
+
+            if (net->ifname &&
+                virDomainNetGetActualType(net) == VIR_DOMAIN_NET_TYPE_VHOSTUSER)
+                ovsIfnames[i] = net->ifname;
+        }
+
+        /* On failure all counters stay set to -1 and are not reported */
+        if (virNetDevOpenvswitchInterfaceStatsList(ovsIfnames, dom->def->nnets,
+                                                   ovsStats) < 0)
+            virResetLastError();
+    }
 
     /* Check the path is one of the domain's network interfaces. */
     for (i = 0; i < dom->def->nnets; i++) {
@@ -19832,96 +19805,67 @@ qemuDomainGetStatsInterface(virQEMUDriverPtr driver ATTRIBUTE_UNUSED,
 
         actualType = virDomainNetGetActualType(net);
 
-        QEMU_ADD_NAME_PARAM(record, maxparams,
-                            "net", "name", i, net->ifname);
+        if (virTypedParamListSetPrefix(params, "net.%zu.", i) < 0)
+            goto cleanup;
+
+        QEMU_ADD_NAME_PARAM(params, "name", net->ifname);
 
         if (actualType == VIR_DOMAIN_NET_TYPE_VHOSTUSER) {
-            if (virNetDevOpenvswitchInterfaceStats(net->ifname, &tmp) < 0) {
-                virResetLastError();
-                continue;
-            }
+            tmp = ovsStats[i];
         } else {
-            if (virNetDevTapInterfaceStats(net->ifname, &tmp,
-                                           !virDomainNetTypeSharesHostView(net)) < 0) {
+            if (virNetDevTapStatsCacheLookup(cache->ifstats, net->ifname, &tmp,
+                                             !virDomainNetTypeSharesHostView(net)) < 0) {
                 virResetLastError();
                 continue;
             }
         }
 
-        QEMU_ADD_NET_PARAM(record, maxparams, i,
-                           "rx.bytes", tmp.rx_bytes);
-        QEMU_ADD_NET_PARAM(record, maxparams, i,
-                           "rx.pkts", tmp.rx_packets);
-        QEMU_ADD_NET_PARAM(record, maxparams, i,
-                           "rx.errs", tmp.rx_errs);
-        QEMU_ADD_NET_PARAM(record, maxparams, i,
-                           "rx.drop", tmp.rx_drop);
-        QEMU_ADD_NET_PARAM(record, maxparams, i,
-                           "tx.bytes", tmp.tx_bytes);
-        QEMU_ADD_NET_PARAM(record, maxparams, i,
-                           "tx.pkts", tmp.tx_packets);
-        QEMU_ADD_NET_PARAM(record, maxparams, i,
-                           "tx.errs", tmp.tx_errs);
-        QEMU_ADD_NET_PARAM(record, maxparams, i,
-                           "tx.drop", tmp.tx_drop);
+        QEMU_ADD_NET_PARAM(params, "rx.bytes", tmp.rx_bytes);
+        QEMU_ADD_NET_PARAM(params, "rx.pkts", tmp.rx_packets);
+        QEMU_ADD_NET_PARAM(params, "rx.errs", tmp.rx_errs);
+        QEMU_ADD_NET_PARAM(params, "rx.drop", tmp.rx_drop);
+        QEMU_ADD_NET_PARAM(params, "tx.bytes", tmp.tx_bytes);
+        QEMU_ADD_NET_PARAM(params, "tx.pkts", tmp.tx_packets);
+        QEMU_ADD_NET_PARAM(params, "tx.errs", tmp.tx_errs);
+        QEMU_ADD_NET_PARAM(params, "tx.drop", tmp.tx_drop);
     }
 
     ret = 0;
  cleanup:
+    VIR_FREE(ovsIfnames);
+    VIR_FREE(ovsStats);
     return ret;
 }
 
 #undef QEMU_ADD_NET_PARAM
 
-#define QEMU_ADD_BLOCK_PARAM_UI(record, maxparams, num, name, value) \
+#define QEMU_ADD_BLOCK_PARAM_UI(params, name, value) \
     do { \
-        char param_name[VIR_TYPED_PARAM_FIELD_LENGTH]; \
-        snprintf(param_name, VIR_TYPED_PARAM_FIELD_LENGTH, \
-                 "block.%zu.%s", num, name); \
-        if (virTypedParamsAddUInt(&(record)->params, \
-                                  &(record)->nparams, \
-                                  maxparams, \
-                                  param_name, \
-                                  value) < 0) \
+        if (virTypedParamListAddUInt(params, name, value) < 0) \
             goto cleanup; \
     } while (0)
 
 /* expects a LL, but typed parameter must be ULL */
-#define QEMU_ADD_BLOCK_PARAM_LL(record, maxparams, num, name, value) \
+#define QEMU_ADD_BLOCK_PARAM_LL(params, name, value) \
 do { \
-    char param_name[VIR_TYPED_PARAM_FIELD_LENGTH]; \
-    snprintf(param_name, VIR_TYPED_PARAM_FIELD_LENGTH, \
-             "block.%zu.%s", num, name); \
-    if (value >= 0 && virTypedParamsAddULLong(&(record)->params, \
-                                              &(record)->nparams, \
-                                              maxparams, \
-                                              param_name, \
-                                              value) < 0) \
+    if (value >= 0 && virTypedParamListAddULLong(params, name, value) < 0) \
         goto cleanup; \
 } while (0)
 
-#define QEMU_ADD_BLOCK_PARAM_ULL(record, maxparams, num, name, value) \
+#define QEMU_ADD_BLOCK_PARAM_ULL(params, name, value) \
 do { \
-    char param_name[VIR_TYPED_PARAM_FIELD_LENGTH]; \
-    snprintf(param_name, VIR_TYPED_PARAM_FIELD_LENGTH, \
-             "block.%zu.%s", num, name); \
-    if (virTypedParamsAddULLong(&(record)->params, \
-                                &(record)->nparams, \
-                                maxparams, \
-                                param_name, \
-                                value) < 0) \
+    if (virTypedParamListAddULLong(params, name, value) < 0) \
         goto cleanup; \
 } while (0)
 
-/* refresh information by opening images on the disk */
+/* refresh information by opening images on the disk; expects the
+ * "block.N." prefix to be set on @params */
 static int
 qemuDomainGetStatsOneBlockFallback(virQEMUDriverPtr driver,
                                    virQEMUDriverConfigPtr cfg,
                                    virDomainObjPtr dom,
-                                   virDomainStatsRecordPtr record,
-                                   int *maxparams,
-                                   virStorageSourcePtr src,
-                                   size_t block_idx)
+                                   virTypedParamListPtr params,
+                                   virStorageSourcePtr src)
 {
     int ret = -1;
 
@@ -19934,14 +19878,11 @@ qemuDomainGetStatsOneBlockFallback(virQEMUDriverPtr driver,
     }
 
     if (src->allocation)
-        QEMU_ADD_BLOCK_PARAM_ULL(record, maxparams, block_idx,
-                                 "allocation", src->allocation);
+        QEMU_ADD_BLOCK_PARAM_ULL(params, "allocation", src->allocation);
     if (src->capacity)
-        QEMU_ADD_BLOCK_PARAM_ULL(record, maxparams, block_idx,
-                                 "capacity", src->capacity);
+        QEMU_ADD_BLOCK_PARAM_ULL(params, "capacity", src->capacity);
     if (src->physical)
-        QEMU_ADD_BLOCK_PARAM_ULL(record, maxparams, block_idx,
-                                 "physical", src->physical);
+        QEMU_ADD_BLOCK_PARAM_ULL(params, "physical", src->physical);
     ret = 0;
  cleanup:
     return ret;
@@ -19949,10 +19890,8 @@ qemuDomainGetStatsOneBlockFallback(virQEMUDriverPtr driver,
 
 
 static int
-qemuDomainGetStatsOneBlockNode(virDomainStatsRecordPtr record,
-                               int *maxparams,
+qemuDomainGetStatsOneBlockNode(virTypedParamListPtr params,
                                virStorageSourcePtr src,
-                               size_t block_idx,
                                virHashTablePtr nodedata)
 {
     virJSONValuePtr data;
@@ -19963,8 +19902,7 @@ qemuDomainGetStatsOneBlockNode(virDomainStatsRecordPtr record,
         (data = virHashLookup(nodedata, src->nodestorage))) {
         if (virJSONValueObjectGetNumberUlong(data, "write_threshold", &tmp) == 0 &&
             tmp > 0)
-            QEMU_ADD_BLOCK_PARAM_ULL(record, maxparams, block_idx,
-                                     "threshold", tmp);
+            QEMU_ADD_BLOCK_PARAM_ULL(params, "threshold", tmp);
     }
 
     ret = 0;
@@ -19978,8 +19916,7 @@ static int
 qemuDomainGetStatsOneBlock(virQEMUDriverPtr driver,
                            virQEMUDriverConfigPtr cfg,
                            virDomainObjPtr dom,
-                           virDomainStatsRecordPtr record,
-                           int *maxparams,
+                           virTypedParamListPtr params,
                            virDomainDiskDefPtr disk,
                            virStorageSourcePtr src,
                            size_t block_idx,
@@ -19994,20 +19931,20 @@ qemuDomainGetStatsOneBlock(virQEMUDriverPtr driver,
     if (disk->info.alias)
         alias = qemuDomainStorageAlias(disk->info.alias, backing_idx);
 
-    QEMU_ADD_NAME_PARAM(record, maxparams, "block", "name", block_idx,
-                        disk->dst);
+    if (virTypedParamListSetPrefix(params, "block.%zu.", block_idx) < 0)
+        goto cleanup;
+
+    QEMU_ADD_NAME_PARAM(params, "name", disk->dst);
     if (virStorageSourceIsLocalStorage(src) && src->path)
-        QEMU_ADD_NAME_PARAM(record, maxparams, "block", "path",
-                            block_idx, src->path);
+        QEMU_ADD_NAME_PARAM(params, "path", src->path);
     if (backing_idx)
-        QEMU_ADD_BLOCK_PARAM_UI(record, maxparams, block_idx, "backingIndex",
-                                backing_idx);
+        QEMU_ADD_BLOCK_PARAM_UI(params, "backingIndex", backing_idx);
 
     /* the VM is offline so we have to go and load the stast from the disk by
      * ourselves */
     if (!virDomainObjIsActive(dom)) {
-        ret = qemuDomainGetStatsOneBlockFallback(driver, cfg, dom, record,
-                                                 maxparams, src, block_idx);
+        ret = qemuDomainGetStatsOneBlockFallback(driver, cfg, dom, params,
+                                                 src);
         goto cleanup;
     }
 
@@ -20019,43 +19956,30 @@ qemuDomainGetStatsOneBlock(virQEMUDriverPtr driver,
         goto cleanup;
     }
 
-    QEMU_ADD_BLOCK_PARAM_LL(record, maxparams, block_idx,
-                            "rd.reqs", entry->rd_req);
-    QEMU_ADD_BLOCK_PARAM_LL(record, maxparams, block_idx,
-                            "rd.bytes", entry->rd_bytes);
-    QEMU_ADD_BLOCK_PARAM_LL(record, maxparams, block_idx,
-                            "rd.times", entry->rd_total_times);
-    QEMU_ADD_BLOCK_PARAM_LL(record, maxparams, block_idx,
-                            "wr.reqs", entry->wr_req);
-    QEMU_ADD_BLOCK_PARAM_LL(record, maxparams, block_idx,
-                            "wr.bytes", entry->wr_bytes);
-    QEMU_ADD_BLOCK_PARAM_LL(record, maxparams, block_idx,
-                            "wr.times", entry->wr_total_times);
-    QEMU_ADD_BLOCK_PARAM_LL(record, maxparams, block_idx,
-                            "fl.reqs", entry->flush_req);
-    QEMU_ADD_BLOCK_PARAM_LL(record, maxparams, block_idx,
-                            "fl.times", entry->flush_total_times);
+    QEMU_ADD_BLOCK_PARAM_LL(params, "rd.reqs", entry->rd_req);
+    QEMU_ADD_BLOCK_PARAM_LL(params, "rd.bytes", entry->rd_bytes);
+    QEMU_ADD_BLOCK_PARAM_LL(params, "rd.times", entry->rd_total_times);
+    QEMU_ADD_BLOCK_PARAM_LL(params, "wr.reqs", entry->wr_req);
+    QEMU_ADD_BLOCK_PARAM_LL(params, "wr.bytes", entry->wr_bytes);
+    QEMU_ADD_BLOCK_PARAM_LL(params, "wr.times", entry->wr_total_times);
+    QEMU_ADD_BLOCK_PARAM_LL(params, "fl.reqs", entry->flush_req);
+    QEMU_ADD_BLOCK_PARAM_LL(params, "fl.times", entry->flush_total_times);
 
-    QEMU_ADD_BLOCK_PARAM_ULL(record, maxparams, block_idx,
-                             "allocation", entry->wr_highest_offset);
+    QEMU_ADD_BLOCK_PARAM_ULL(params, "allocation", entry->wr_highest_offset);
 
     if (entry->capacity)
-        QEMU_ADD_BLOCK_PARAM_ULL(record, maxparams, block_idx,
-                                 "capacity", entry->capacity);
+        QEMU_ADD_BLOCK_PARAM_ULL(params, "capacity", entry->capacity);
     if (entry->physical) {
-        QEMU_ADD_BLOCK_PARAM_ULL(record, maxparams, block_idx,
-                                 "physical", entry->physical);
+        QEMU_ADD_BLOCK_PARAM_ULL(params, "physical", entry->physical);
     } else {
         if (qemuDomainStorageUpdatePhysical(driver, cfg, dom, src) == 0) {
-            QEMU_ADD_BLOCK_PARAM_ULL(record, maxparams, block_idx,
-                                     "physical", src->physical);
+            QEMU_ADD_BLOCK_PARAM_ULL(params, "physical", src->physical);
         } else {
             virResetLastError();
         }
     }
 
-    if (qemuDomainGetStatsOneBlockNode(record, maxparams, src, block_idx,
-                                       nodedata) < 0)
+    if (qemuDomainGetStatsOneBlockNode(params, src, nodedata) < 0)
         goto cleanup;
 
     ret = 0;
@@ -20068,8 +19992,8 @@ qemuDomainGetStatsOneBlock(virQEMUDriverPtr driver,
 static int
 qemuDomainGetStatsBlock(virQEMUDriverPtr driver,
                         virDomainObjPtr dom,
-                        virDomainStatsRecordPtr record,
-                        int *maxparams,
+                        virTypedParamListPtr params,
+                        qemuDomainStatsCachePtr cache ATTRIBUTE_UNUSED,
                         unsigned int privflags)
 {
     size_t i;
@@ -20082,7 +20006,7 @@ qemuDomainGetStatsBlock(virQEMUDriverPtr driver,
     virQEMUDriverConfigPtr cfg = virQEMUDriverGetConfig(driver);
     bool fetchnodedata = virQEMUCapsGet(priv->qemuCaps,
                                         QEMU_CAPS_QUERY_NAMED_BLOCK_NODES);
-    int count_index = -1;
+    size_t count_index;
     size_t visited = 0;
     bool visitBacking = !!(privflags & QEMU_DOMAIN_STATS_BACKING);
 
@@ -20112,8 +20036,8 @@ qemuDomainGetStatsBlock(virQEMUDriverPtr driver,
     /* When listing backing chains, it's easier to fix up the count
      * after the iteration than it is to iterate twice; but we still
      * want count listed first.  */
-    count_index = record->nparams;
-    QEMU_ADD_COUNT_PARAM(record, maxparams, "block", 0);
+    count_index = params->npar;
+    QEMU_ADD_COUNT_PARAM(params, "block", 0);
 
     for (i = 0; i < dom->def->ndisks; i++) {
         virDomainDiskDefPtr disk = dom->def->disks[i];
@@ -20122,7 +20046,7 @@ qemuDomainGetStatsBlock(virQEMUDriverPtr driver,
 
         while (virStorageSourceIsBacking(src) &&
                (backing_idx == 0 || visitBacking)) {
-            if (qemuDomainGetStatsOneBlock(driver, cfg, dom, record, maxparams,
+            if (qemuDomainGetStatsOneBlock(driver, cfg, dom, params,
                                            disk, src, visited, backing_idx,
                                            stats, nodestats) < 0)
                 goto cleanup;
@@ -20132,7 +20056,7 @@ qemuDomainGetStatsBlock(virQEMUDriverPtr driver,
         }
     }
 
-    record->params[count_index].value.ui = visited;
+    params->par[count_index].value.ui = visited;
     ret = 0;
 
  cleanup:
@@ -20154,23 +20078,15 @@ qemuDomainGetStatsBlock(virQEMUDriverPtr driver,
 static int
 qemuDomainGetStatsPerfOneEvent(virPerfPtr perf,
                                virPerfEventType type,
-                               virDomainStatsRecordPtr record,
-                               int *maxparams)
+                               virTypedParamListPtr params)
 {
-    char param_name[VIR_TYPED_PARAM_FIELD_LENGTH];
     uint64_t value = 0;
 
     if (virPerfReadEvent(perf, type, &value) < 0)
         return -1;
 
-    snprintf(param_name, VIR_TYPED_PARAM_FIELD_LENGTH, "perf.%s",
-             virPerfEventTypeToString(type));
-
-    if (virTypedParamsAddULLong(&record->params,
-                                &record->nparams,
-                                maxparams,
-                                param_name,
-                                value) < 0)
+    if (virTypedParamListAddULLong(params, virPerfEventTypeToString(type),
+                                   value) < 0)
         return -1;
 
     return 0;
@@ -20179,20 +20095,22 @@ qemuDomainGetStatsPerfOneEvent(virPerfPtr perf,
 static int
 qemuDomainGetStatsPerf(virQEMUDriverPtr driver ATTRIBUTE_UNUSED,
                        virDomainObjPtr dom,
-                       virDomainStatsRecordPtr record,
-                       int *maxparams,
+                       virTypedParamListPtr params,
+                       qemuDomainStatsCachePtr cache ATTRIBUTE_UNUSED,
                        unsigned int privflags ATTRIBUTE_UNUSED)
 {
     size_t i;
     qemuDomainObjPrivatePtr priv = dom->privateData;
     int ret = -1;
 
+    if (virTypedParamListSetPrefix(params, "perf.") < 0)
+        goto cleanup;
+
     for (i = 0; i < VIR_PERF_EVENT_LAST; i++) {
         if (!virPerfEventIsEnabled(priv->perf, i))
              continue;
 
-        if (qemuDomainGetStatsPerfOneEvent(priv->perf, i,
-                                           record, maxparams) < 0)
+        if (qemuDomainGetStatsPerfOneEvent(priv->perf, i, params) < 0)
             goto cleanup;
     }
 
@@ -20205,8 +20123,8 @@ qemuDomainGetStatsPerf(virQEMUDriverPtr driver ATTRIBUTE_UNUSED,
 typedef int
 (*qemuDomainGetStatsFunc)(virQEMUDriverPtr driver,
                           virDomainObjPtr dom,
-                          virDomainStatsRecordPtr record,
-                          int *maxparams,
+                          virTypedParamListPtr params,
+                          qemuDomainStatsCachePtr cache,
                           unsigned int flags);
 
 struct qemuDomainGetStatsWorker {
@@ -20269,42 +20187,75 @@ qemuDomainGetStatsNeedMonitor(unsigned int stats)
 }
 
 
+/* Returns an upper estimate of the number of typed parameters the
+ * workers selected by @stats produce for @dom, so that the record
+ * can be allocated at once. */
+static size_t
+qemuDomainGetStatsEstimate(virDomainObjPtr dom,
+                           unsigned int stats)
+{
+    size_t count = 0;
+
+    if (stats & VIR_DOMAIN_STATS_STATE)
+        count += 2;
+    if (stats & VIR_DOMAIN_STATS_CPU_TOTAL)
+        count += 3;
+    if (stats & VIR_DOMAIN_STATS_BALLOON)
+        count += 2 + VIR_DOMAIN_MEMORY_STAT_NR;
+    if (stats & VIR_DOMAIN_STATS_VCPU)
+        count += 2 + 4 * virDomainDefGetVcpus(dom->def);
+    if (stats & VIR_DOMAIN_STATS_INTERFACE)
+        count += 1 + 9 * dom->def->nnets;
+    if (stats & VIR_DOMAIN_STATS_BLOCK)
+        count += 1 + 16 * dom->def->ndisks;
+    if (stats & VIR_DOMAIN_STATS_PERF)
+        count += VIR_PERF_EVENT_LAST;
+
+    return count;
+}
+
+
 static int
 qemuDomainGetStats(virConnectPtr conn,
                    virDomainObjPtr dom,
                    unsigned int stats,
                    virDomainStatsRecordPtr *record,
+                   qemuDomainStatsCachePtr cache,
                    unsigned int flags)
 {
-    int maxparams = 0;
-    virDomainStatsRecordPtr tmp;
+    virTypedParamListPtr params = NULL;
+    virDomainStatsRecordPtr tmp = NULL;
     size_t i;
     int ret = -1;
 
-    if (VIR_ALLOC(tmp) < 0)
+    if (!(params = virTypedParamListNew(qemuDomainGetStatsEstimate(dom,
+                                                                   stats))))
         goto cleanup;
 
     for (i = 0; qemuDomainGetStatsWorkers[i].func; i++) {
         if (stats & qemuDomainGetStatsWorkers[i].stats) {
-            if (qemuDomainGetStatsWorkers[i].func(conn->privateData, dom, tmp,
-                                                  &maxparams, flags) < 0)
+            virTypedParamListClearPrefix(params);
+            if (qemuDomainGetStatsWorkers[i].func(conn->privateData, dom,
+                                                  params, cache, flags) < 0)
                 goto cleanup;
         }
     }
 
+    if (VIR_ALLOC(tmp) < 0)
+        goto cleanup;
+
     if (!(tmp->dom = virGetDomain(conn, dom->def->name,
                                   dom->def->uuid, dom->def->id)))
         goto cleanup;
 
+    tmp->nparams = virTypedParamListStealParams(params, &tmp->params);
     *record = tmp;
     tmp = NULL;
     ret = 0;
 
  cleanup:
-    if (tmp) {
-        virTypedParamsFree(tmp->params, tmp->nparams);
-        VIR_FREE(tmp);
-    }
+    virTypedParamListFree(params);
+    VIR_FREE(tmp);
 
     return ret;
 }
@@ -20323,6 +20274,7 @@ qemuConnectGetAllDomainStats(virConnectPtr conn,
     virDomainObjPtr vm;
     size_t nvms;
     virDomainStatsRecordPtr *tmpstats = NULL;
+    qemuDomainStatsCache cache = { NULL };
     bool enforce = !!(flags & VIR_CONNECT_GET_ALL_DOMAINS_STATS_ENFORCE_STATS);
     int nstats = 0;
     size_t i;
@@ -20363,6 +20315,9 @@ qemuConnectGetAllDomainStats(virConnectPtr conn,
     if (qemuDomainGetStatsNeedMonitor(stats))
         privflags |= QEMU_DOMAIN_STATS_HAVE_JOB;
 
+    if (!(cache.ifstats = virNetDevTapStatsCacheNew()))
+        goto cleanup;
+
     for (i = 0; i < nvms; i++) {
         virDomainStatsRecordPtr tmp = NULL;
         domflags = 0;
@@ -20377,7 +20332,7 @@ qemuConnectGetAllDomainStats(virConnectPtr conn,
 
         if (flags & VIR_CONNECT_GET_ALL_DOMAINS_STATS_BACKING)
             domflags |= QEMU_DOMAIN_STATS_BACKING;
-        if (qemuDomainGetStats(conn, vm, stats, &tmp, domflags) < 0) {
+        if (qemuDomainGetStats(conn, vm, stats, &tmp, &cache, domflags) < 0) {
             if (HAVE_JOB(domflags) && vm)
                 qemuDomainObjEndJob(driver, vm);
 
@@ -20402,6 +20357,7 @@ qemuConnectGetAllDomainStats(virConnectPtr conn,
  cleanup:
     virDomainStatsRecordListFree(tmpstats);
     virObjectListFreeCount(vms, nvms);
+    virNetDevTapStatsCacheFree(cache.ifstats);
 
     return ret;
 }
@@ -51,6 +51,7 @@
 #include "virtime.h"
 #include "locking/domain_lock.h"
 #include "rpc/virnetsocket.h"
+#include "rpc/virnetprotocol.h"
 #include "virstoragefile.h"
 #include "viruri.h"
 #include "virhook.h"
@@ -620,6 +621,7 @@ qemuMigrationDstStopNBDServer(virQEMUDriverPtr driver,
  * qemuMigrationSrcDriveMirrorReady:
  * @driver: qemu driver
  * @vm: domain
+ * @pending: where to store the number of mirrors which are not ready yet
  *
  * Check the status of all drive-mirrors started by
  * qemuMigrationSrcDriveMirror. Any pending block job events
@@ -632,7 +634,8 @@ qemuMigrationDstStopNBDServer(virQEMUDriverPtr driver,
 static int
 qemuMigrationSrcDriveMirrorReady(virQEMUDriverPtr driver,
                                  virDomainObjPtr vm,
-                                 qemuDomainAsyncJob asyncJob)
+                                 qemuDomainAsyncJob asyncJob,
+                                 size_t *pending)
 {
     size_t i;
     size_t notReady = 0;
@@ -665,6 +668,9 @@ qemuMigrationSrcDriveMirrorReady(virQEMUDriverPtr driver,
             notReady++;
     }
 
+    if (pending)
+        *pending = notReady;
+
     if (notReady) {
         VIR_DEBUG("Waiting for %zu disk mirrors to get ready", notReady);
         return 0;
@@ -908,6 +914,58 @@ qemuMigrationSrcCancelDriveMirror(virQEMUDriverPtr driver,
 }
 
 
+static int
+qemuMigrationSrcDriveMirrorStart(virQEMUDriverPtr driver,
+                                 virDomainObjPtr vm,
+                                 virDomainDiskDefPtr disk,
+                                 const char *host,
+                                 int port,
+                                 unsigned long long speed,
+                                 unsigned int mirror_flags)
+{
+    qemuDomainObjPrivatePtr priv = vm->privateData;
+    qemuDomainDiskPrivatePtr diskPriv = QEMU_DOMAIN_DISK_PRIVATE(disk);
+    virQEMUDriverConfigPtr cfg = virQEMUDriverGetConfig(driver);
+    char *diskAlias = NULL;
+    char *nbd_dest = NULL;
+    int mon_ret;
+    int ret = -1;
+
+    if (!(diskAlias = qemuAliasFromDisk(disk)) ||
+        (virAsprintf(&nbd_dest, "nbd:%s:%d:exportname=%s",
+                     host, port, diskAlias) < 0))
+        goto cleanup;
+
+    if (qemuDomainObjEnterMonitorAsync(driver, vm,
+                                       QEMU_ASYNC_JOB_MIGRATION_OUT) < 0)
+        goto cleanup;
+
+    qemuBlockJobSyncBegin(disk);
+    /* Force "raw" format for NBD export */
+    mon_ret = qemuMonitorDriveMirror(priv->mon, diskAlias, nbd_dest,
+                                     "raw", speed, 0, 0, mirror_flags);
+
+    if (qemuDomainObjExitMonitor(driver, vm) < 0 || mon_ret < 0) {
+        qemuBlockJobSyncEnd(driver, vm, QEMU_ASYNC_JOB_MIGRATION_OUT, disk);
+        goto cleanup;
+    }
+    diskPriv->migrating = true;
+
+    if (virDomainSaveStatus(driver->xmlopt, cfg->stateDir, vm, driver->caps) < 0) {
+        VIR_WARN("Failed to save status on vm %s", vm->def->name);
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virObjectUnref(cfg);
+    VIR_FREE(diskAlias);
+    VIR_FREE(nbd_dest);
+    return ret;
+}
+
+
 /**
  * qemuMigrationDriveMirror:
  * @driver: qemu driver
@@ -925,6 +983,11 @@ qemuMigrationSrcCancelDriveMirror(virQEMUDriverPtr driver,
  * expected to call qemuMigrationSrcCancelDriveMirror to stop all
  * running mirrors.
  *
+ * At most migration_max_parallel_disks mirrors (see qemu.conf) are
+ * performing their initial sync at any time, the remaining disks are
+ * queued and their mirrors are started once some of the running ones
+ * become ready.
+ *
  * Returns 0 on success (@migrate_flags updated),
  *        -1 otherwise.
  */
@@ -943,16 +1006,18 @@ qemuMigrationSrcDriveMirror(virQEMUDriverPtr driver,
     int ret = -1;
     int port;
     size_t i;
-    char *diskAlias = NULL;
-    char *nbd_dest = NULL;
+    size_t pending = 0;
     char *hoststr = NULL;
     unsigned long long mirror_speed = speed;
     unsigned int mirror_flags = VIR_DOMAIN_BLOCK_REBASE_REUSE_EXT;
+    unsigned int maxParallel;
     int rv;
     virQEMUDriverConfigPtr cfg = virQEMUDriverGetConfig(driver);
 
     VIR_DEBUG("Starting drive mirrors for domain %s", vm->def->name);
 
+    maxParallel = cfg->migrationMaxParallelDisks;
+
     if (mirror_speed > LLONG_MAX >> 20) {
         virReportError(VIR_ERR_OVERFLOW,
                        _("bandwidth must be less than %llu"),
@@ -976,48 +1041,35 @@ qemuMigrationSrcDriveMirror(virQEMUDriverPtr driver,
     if (*migrate_flags & QEMU_MONITOR_MIGRATE_NON_SHARED_INC)
         mirror_flags |= VIR_DOMAIN_BLOCK_REBASE_SHALLOW;
 
-    for (i = 0; i < vm->def->ndisks; i++) {
-        virDomainDiskDefPtr disk = vm->def->disks[i];
-        qemuDomainDiskPrivatePtr diskPriv = QEMU_DOMAIN_DISK_PRIVATE(disk);
-        int mon_ret;
-
-        /* check whether disk should be migrated */
-        if (!qemuMigrationAnyCopyDisk(disk, nmigrate_disks, migrate_disks))
-            continue;
-
-        if (!(diskAlias = qemuAliasFromDisk(disk)) ||
-            (virAsprintf(&nbd_dest, "nbd:%s:%d:exportname=%s",
-                         hoststr, port, diskAlias) < 0))
-            goto cleanup;
-
-        if (qemuDomainObjEnterMonitorAsync(driver, vm,
-                                           QEMU_ASYNC_JOB_MIGRATION_OUT) < 0)
-            goto cleanup;
+    i = 0;
+    for (;;) {
+        /* start queued mirrors while there is room for them */
+        for (; i < vm->def->ndisks; i++) {
+            virDomainDiskDefPtr disk = vm->def->disks[i];
 
-        qemuBlockJobSyncBegin(disk);
-        /* Force "raw" format for NBD export */
-        mon_ret = qemuMonitorDriveMirror(priv->mon, diskAlias, nbd_dest,
-                                         "raw", mirror_speed, 0, 0, mirror_flags);
-        VIR_FREE(diskAlias);
-        VIR_FREE(nbd_dest);
+            /* check whether disk should be migrated */
+            if (!qemuMigrationAnyCopyDisk(disk, nmigrate_disks, migrate_disks))
+                continue;
 
-        if (qemuDomainObjExitMonitor(driver, vm) < 0 || mon_ret < 0) {
-            qemuBlockJobSyncEnd(driver, vm, QEMU_ASYNC_JOB_MIGRATION_OUT, disk);
-            goto cleanup;
-        }
-        diskPriv->migrating = true;
+            if (maxParallel && pending >= maxParallel)
+                break;
 
-        if (virDomainSaveStatus(driver->xmlopt, cfg->stateDir, vm, driver->caps) < 0) {
-            VIR_WARN("Failed to save status on vm %s", vm->def->name);
-            goto cleanup;
+            if (qemuMigrationSrcDriveMirrorStart(driver, vm, disk, hoststr,
+                                                 port, mirror_speed,
+                                                 mirror_flags) < 0)
+                goto cleanup;
+            pending++;
         }
-    }
 
-    while ((rv = qemuMigrationSrcDriveMirrorReady(driver, vm,
-                                                  QEMU_ASYNC_JOB_MIGRATION_OUT)) != 1) {
+        rv = qemuMigrationSrcDriveMirrorReady(driver, vm,
+                                              QEMU_ASYNC_JOB_MIGRATION_OUT,
+                                              &pending);
         if (rv < 0)
             goto cleanup;
 
+        if (rv == 1 && i == vm->def->ndisks)
+            break;
+
         if (priv->job.abortJob) {
             priv->job.current->status = QEMU_DOMAIN_JOB_STATUS_CANCELED;
             virReportError(VIR_ERR_OPERATION_ABORTED, _("%s: %s"),
@@ -1032,6 +1084,10 @@ qemuMigrationSrcDriveMirror(virQEMUDriverPtr driver,
             goto cleanup;
         }
 
+        /* some mirrors got ready, more disks can be started right away */
+        if (i < vm->def->ndisks && pending < maxParallel)
+            continue;
+
         if (virDomainObjWait(vm) < 0)
             goto cleanup;
     }
@@ -1046,8 +1102,6 @@ qemuMigrationSrcDriveMirror(virQEMUDriverPtr driver,
 
  cleanup:
     virObjectUnref(cfg);
-    VIR_FREE(diskAlias);
-    VIR_FREE(nbd_dest);
     VIR_FREE(hoststr);
     return ret;
 }
@@ -1444,6 +1498,10 @@ qemuMigrationUpdateJobType(qemuDomainJobInfoPtr jobInfo)
 }
 
 
+static void
+qemuMigrationSrcTunnelGetStats(qemuMigrationIOThreadPtr io,
+                               qemuDomainTunnelStatsPtr stats);
+
 int
 qemuMigrationAnyFetchStats(virQEMUDriverPtr driver,
                            virDomainObjPtr vm,
@@ -1465,6 +1523,9 @@ qemuMigrationAnyFetchStats(virQEMUDriverPtr driver,
 
     jobInfo->stats.mig = stats;
 
+    if (priv->job.tunnel)
+        qemuMigrationSrcTunnelGetStats(priv->job.tunnel, &jobInfo->tunnelStats);
+
     return 0;
 }
 
@@ -1499,7 +1560,8 @@ qemuMigrationJobName(virDomainObjPtr vm)
 static int
 qemuMigrationJobCheckStatus(virQEMUDriverPtr driver,
                             virDomainObjPtr vm,
-                            qemuDomainAsyncJob asyncJob)
+                            qemuDomainAsyncJob asyncJob,
+                            bool query)
 {
     qemuDomainObjPrivatePtr priv = vm->privateData;
     qemuDomainJobInfoPtr jobInfo = priv->job.current;
@@ -1507,7 +1569,7 @@ qemuMigrationJobCheckStatus(virQEMUDriverPtr driver,
     bool events = virQEMUCapsGet(priv->qemuCaps, QEMU_CAPS_MIGRATION_EVENT);
     int ret = -1;
 
-    if (!events ||
+    if (!events || query ||
         jobInfo->stats.mig.status == QEMU_MONITOR_MIGRATION_STATUS_ERROR) {
         if (qemuMigrationAnyFetchStats(driver, vm, asyncJob, jobInfo, &error) < 0)
             return -1;
@@ -1555,8 +1617,22 @@ enum qemuMigrationCompletedFlags {
     QEMU_MIGRATION_COMPLETED_CHECK_STORAGE  = (1 << 1),
     QEMU_MIGRATION_COMPLETED_POSTCOPY       = (1 << 2),
     QEMU_MIGRATION_COMPLETED_PRE_SWITCHOVER = (1 << 3),
+    /* Query migration status even if QEMU sends migration events */
+    QEMU_MIGRATION_COMPLETED_QUERY          = (1 << 4),
 };
 
+/* Without migration events we have to poll QEMU for the migration status.
+ * The interval grows while migration is far from completion and drops back
+ * to the minimum once it may converge soon. (in milliseconds) */
+#define QEMU_MIGRATION_POLL_MIN 50
+#define QEMU_MIGRATION_POLL_MAX 1000
+
+/* Even with migration events we occasionally ask QEMU about the migration
+ * status in case an event got lost, backing off while nothing happens.
+ * (in milliseconds) */
+#define QEMU_MIGRATION_EVENT_TIMEOUT_MIN 1000
+#define QEMU_MIGRATION_EVENT_TIMEOUT_MAX 30000
+
 
 /**
  * Returns 1 if migration completed successfully,
@@ -1575,12 +1651,13 @@ qemuMigrationAnyCompleted(virQEMUDriverPtr driver,
     qemuDomainJobInfoPtr jobInfo = priv->job.current;
     int pauseReason;
 
-    if (qemuMigrationJobCheckStatus(driver, vm, asyncJob) < 0)
+    if (qemuMigrationJobCheckStatus(driver, vm, asyncJob,
+                                    flags & QEMU_MIGRATION_COMPLETED_QUERY) < 0)
         goto error;
 
     /* This flag should only be set when run on src host */
     if (flags & QEMU_MIGRATION_COMPLETED_CHECK_STORAGE &&
-        qemuMigrationSrcDriveMirrorReady(driver, vm, asyncJob) < 0)
+        qemuMigrationSrcDriveMirrorReady(driver, vm, asyncJob, NULL) < 0)
         goto error;
 
     if (flags & QEMU_MIGRATION_COMPLETED_ABORT_ON_ERROR &&
@@ -1652,6 +1729,24 @@ qemuMigrationAnyCompleted(virQEMUDriverPtr driver,
 }
 
 
+static unsigned long long
+qemuMigrationSrcNextPollInterval(qemuDomainJobInfoPtr jobInfo,
+                                 unsigned long long interval)
+{
+    qemuMonitorMigrationStats *stats = &jobInfo->stats.mig;
+
+    if (jobInfo->status != QEMU_DOMAIN_JOB_STATUS_MIGRATING ||
+        stats->ram_bps == 0)
+        return QEMU_MIGRATION_POLL_MIN;
+
+    /* the remaining memory could be sent before the next check */
+    if (stats->ram_remaining * 1000 / stats->ram_bps <= 2 * interval)
+        return QEMU_MIGRATION_POLL_MIN;
+
+    return MIN(interval * 2, QEMU_MIGRATION_POLL_MAX);
+}
+
+
 /* Returns 0 on success, -2 when migration needs to be cancelled, or -1 when
  * QEMU reports failed migration.
  */
@@ -1665,27 +1760,52 @@ qemuMigrationSrcWaitForCompletion(virQEMUDriverPtr driver,
     qemuDomainObjPrivatePtr priv = vm->privateData;
     qemuDomainJobInfoPtr jobInfo = priv->job.current;
     bool events = virQEMUCapsGet(priv->qemuCaps, QEMU_CAPS_MIGRATION_EVENT);
+    unsigned long long interval;
+    unsigned int checkFlags = flags;
     int rv;
 
+    if (events)
+        interval = QEMU_MIGRATION_EVENT_TIMEOUT_MIN;
+    else
+        interval = QEMU_MIGRATION_POLL_MIN;
+
     jobInfo->status = QEMU_DOMAIN_JOB_STATUS_MIGRATING;
 
     while ((rv = qemuMigrationAnyCompleted(driver, vm, asyncJob,
-                                           dconn, flags)) != 1) {
+                                           dconn, checkFlags)) != 1) {
+        unsigned long long now;
+
         if (rv < 0)
             return rv;
 
+        checkFlags = flags;
+
+        /* Waiting on the domain condition rather than sleeping lets any
+         * event which may affect the migration wake us up early. */
+        if (virTimeMillisNow(&now) < 0 ||
+            (rv = virDomainObjWaitUntil(vm, now + interval)) < 0) {
+            jobInfo->status = QEMU_DOMAIN_JOB_STATUS_FAILED;
+            return -2;
+        }
+
         if (events) {
-            if (virDomainObjWait(vm) < 0) {
+            if (!virDomainObjIsActive(vm)) {
+                virReportError(VIR_ERR_OPERATION_FAILED, "%s",
+                               _("domain is not running"));
                 jobInfo->status = QEMU_DOMAIN_JOB_STATUS_FAILED;
                 return -2;
             }
-        } else {
-            /* Poll every 50ms for progress & to allow cancellation */
-            struct timespec ts = { .tv_sec = 0, .tv_nsec = 50 * 1000 * 1000ull };
 
-            virObjectUnlock(vm);
-            nanosleep(&ts, NULL);
-            virObjectLock(vm);
+            if (rv == 1) {
+                VIR_DEBUG("No migration event in %llums, querying QEMU",
+                          interval);
+                checkFlags |= QEMU_MIGRATION_COMPLETED_QUERY;
+                interval = MIN(interval * 2, QEMU_MIGRATION_EVENT_TIMEOUT_MAX);
+            } else {
+                interval = QEMU_MIGRATION_EVENT_TIMEOUT_MIN;
+            }
+        } else {
+            interval = qemuMigrationSrcNextPollInterval(jobInfo, interval);
         }
     }
 
@@ -2480,6 +2600,12 @@ qemuMigrationParams(virTypedParameterPtr params,
 {
     qemuMonitorMigrationParamsPtr migParams;
 
+    if ((flags & VIR_MIGRATE_PARALLEL) && (flags & VIR_MIGRATE_TUNNELLED)) {
+        virReportError(VIR_ERR_ARGUMENT_UNSUPPORTED, "%s",
+                       _("parallel migration cannot be tunnelled"));
+        return NULL;
+    }
+
     if (VIR_ALLOC(migParams) < 0)
         return NULL;
 
@@ -2500,6 +2626,7 @@ qemuMigrationParams(virTypedParameterPtr params,
 
     GET(AUTO_CONVERGE_INITIAL, cpuThrottleInitial);
     GET(AUTO_CONVERGE_INCREMENT, cpuThrottleIncrement);
+    GET(PARALLEL_CONNECTIONS, multifdChannels);
 
 #undef GET
 
@@ -2511,6 +2638,21 @@ qemuMigrationParams(virTypedParameterPtr params,
         goto error;
     }
 
+    if (migParams->multifdChannels_set &&
+        !(flags & VIR_MIGRATE_PARALLEL)) {
+        virReportError(VIR_ERR_INVALID_ARG, "%s",
+                       _("Turn parallel migration on to tune it"));
+        goto error;
+    }
+
+    if (migParams->multifdChannels_set &&
+        migParams->multifdChannels < 1) {
+        virReportError(VIR_ERR_INVALID_ARG,
+                       _("invalid number of parallel connections: %d"),
+                       migParams->multifdChannels);
+        goto error;
+    }
+
     return migParams;
 
  error:
@@ -2616,6 +2758,7 @@ qemuMigrationDstPrepareAny(virQEMUDriverPtr driver,
                            const char **migrate_disks,
                            int nbdPort,
                            qemuMigrationCompressionPtr compression,
+                           qemuMonitorMigrationParamsPtr srcParams,
                            unsigned long flags)
 {
     virDomainObjPtr vm = NULL;
@@ -2874,6 +3017,19 @@ qemuMigrationDstPrepareAny(virQEMUDriverPtr driver,
                                        QEMU_ASYNC_JOB_MIGRATION_IN) < 0)
         goto stopjob;
 
+    if (qemuMigrationOptionSet(driver, vm,
+                               QEMU_MONITOR_MIGRATION_CAPS_MULTIFD,
+                               flags & VIR_MIGRATE_PARALLEL,
+                               QEMU_ASYNC_JOB_MIGRATION_IN) < 0)
+        goto stopjob;
+
+    /* The destination has to expect as many connections as the source
+     * is going to open */
+    if (srcParams && srcParams->multifdChannels_set) {
+        migParams.multifdChannels_set = true;
+        migParams.multifdChannels = srcParams->multifdChannels;
+    }
+
     if (qemuMigrationParamsSet(driver, vm, QEMU_ASYNC_JOB_MIGRATION_IN,
                                &migParams) < 0)
         goto stopjob;
@@ -3025,7 +3181,7 @@ qemuMigrationDstPrepareTunnel(virQEMUDriverPtr driver,
     ret = qemuMigrationDstPrepareAny(driver, dconn, cookiein, cookieinlen,
                                      cookieout, cookieoutlen, def, origname,
                                      st, NULL, 0, false, NULL, 0, NULL, 0,
-                                     compression, flags);
+                                     compression, NULL, flags);
     VIR_FREE(compression);
     return ret;
 }
@@ -3070,6 +3226,7 @@ qemuMigrationDstPrepareDirect(virQEMUDriverPtr driver,
                               const char **migrate_disks,
                               int nbdPort,
                               qemuMigrationCompressionPtr compression,
+                              qemuMonitorMigrationParamsPtr migParams,
                               unsigned long flags)
 {
     unsigned short port = 0;
@@ -3193,7 +3350,7 @@ qemuMigrationDstPrepareDirect(virQEMUDriverPtr driver,
                                      NULL, uri ? uri->scheme : "tcp",
                                      port, autoPort, listenAddress,
                                      nmigrate_disks, migrate_disks, nbdPort,
-                                     compression, flags);
+                                     compression, migParams, flags);
  cleanup:
     virURIFree(uri);
     VIR_FREE(hostname);
@@ -3443,10 +3600,13 @@ struct _qemuMigrationSpec {
     } fwd;
 };
 
-#define TUNNEL_SEND_BUF_SIZE 65536
+/* Drain as much of the pipe as QEMU managed to fill in one go so that the
+ * tunnel keeps up with it. The data is still sent in messages of at most
+ * VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX bytes, which is all a destination
+ * daemon running an older release accepts in a stream message. */
+#define TUNNEL_SEND_BUF_SIZE (1024 * 1024)
+#define TUNNEL_SEND_MSG_SIZE VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX
 
-typedef struct _qemuMigrationIOThread qemuMigrationIOThread;
-typedef qemuMigrationIOThread *qemuMigrationIOThreadPtr;
 struct _qemuMigrationIOThread {
     virThread thread;
     virStreamPtr st;
@@ -3454,14 +3614,64 @@ struct _qemuMigrationIOThread {
     virError err;
     int wakeupRecvFD;
     int wakeupSendFD;
+
+    virMutex lock; /* protects the counters below */
+    unsigned long long started; /* monotonic, in microseconds */
+    unsigned long long transferred;
 };
 
+
+/**
+ * qemuMigrationSrcTunnelRead:
+ * @fd: non-blocking file descriptor QEMU writes migration data to
+ * @buffer: buffer to fill
+ * @len: size of @buffer
+ * @eof: set to true once QEMU closed its end of @fd
+ *
+ * Reads as much data as is immediately available from @fd, up to @len bytes,
+ * so that a single wakeup forwards everything QEMU managed to write while
+ * the previous data was being sent.
+ *
+ * Returns the number of bytes read or -1 on error.
+ */
+static ssize_t
+qemuMigrationSrcTunnelRead(int fd,
+                           char *buffer,
+                           size_t len,
+                           bool *eof)
+{
+    size_t got = 0;
+
+    while (got < len) {
+        ssize_t r = read(fd, buffer + got, len - got);
+
+        if (r < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            return -1;
+        }
+
+        if (r == 0) {
+            *eof = true;
+            break;
+        }
+
+        got += r;
+    }
+
+    return got;
+}
+
+
 static void qemuMigrationSrcIOFunc(void *arg)
 {
     qemuMigrationIOThreadPtr data = arg;
     char *buffer = NULL;
     struct pollfd fds[2];
     int timeout = -1;
+    bool eof = false;
     virErrorPtr err = NULL;
 
     VIR_DEBUG("Running migration tunnel; stream=%p, sock=%d",
@@ -3470,6 +3680,20 @@ static void qemuMigrationSrcIOFunc(void *arg)
     if (VIR_ALLOC_N(buffer, TUNNEL_SEND_BUF_SIZE) < 0)
         goto abrt;
 
+    if (virSetNonBlock(data->sock) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("Unable to set migration tunnel non-blocking"));
+        goto abrt;
+    }
+
+#ifdef F_SETPIPE_SZ
+    /* Let QEMU queue a whole message worth of data while we are busy
+     * sending the previous one. This is just an optimization, the
+     * tunnel works with the default pipe size too. */
+    if (fcntl(data->sock, F_SETPIPE_SZ, TUNNEL_SEND_BUF_SIZE) < 0)
+        VIR_DEBUG("Unable to resize migration pipe: errno=%d", errno);
+#endif
+
     fds[0].fd = data->sock;
     fds[1].fd = data->wakeupRecvFD;
 
@@ -3517,20 +3741,33 @@ static void qemuMigrationSrcIOFunc(void *arg)
         }
 
         if (fds[0].revents & (POLLIN | POLLERR | POLLHUP)) {
-            int nbytes;
+            ssize_t nbytes;
+            ssize_t sent = 0;
 
-            nbytes = saferead(data->sock, buffer, TUNNEL_SEND_BUF_SIZE);
-            if (nbytes > 0) {
-                if (virStreamSend(data->st, buffer, nbytes) < 0)
-                    goto error;
-            } else if (nbytes < 0) {
+            nbytes = qemuMigrationSrcTunnelRead(data->sock, buffer,
+                                                TUNNEL_SEND_BUF_SIZE, &eof);
+            if (nbytes < 0) {
                 virReportSystemError(errno, "%s",
                         _("tunnelled migration failed to read from qemu"));
                 goto abrt;
-            } else {
-                /* EOF; get out of here */
-                break;
             }
+
+            while (sent < nbytes) {
+                size_t len = MIN(nbytes - sent, TUNNEL_SEND_MSG_SIZE);
+
+                if (virStreamSend(data->st, buffer + sent, len) < 0)
+                    goto error;
+
+                sent += len;
+
+                virMutexLock(&data->lock);
+                data->transferred += len;
+                virMutexUnlock(&data->lock);
+            }
+
+            /* EOF; get out of here */
+            if (eof)
+                break;
         }
     }
 
@@ -3581,16 +3818,26 @@ qemuMigrationSrcStartTunnel(virStreamPtr st,
     if (VIR_ALLOC(io) < 0)
         goto error;
 
+    if (virMutexInit(&io->lock) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("Unable to initialize mutex"));
+        VIR_FREE(io);
+        goto error;
+    }
+
     io->st = st;
     io->sock = sock;
     io->wakeupRecvFD = wakeupFD[0];
     io->wakeupSendFD = wakeupFD[1];
+    if (virTimeMonotonicMicrosNowRaw(&io->started) < 0)
+        io->started = 0;
 
     if (virThreadCreate(&io->thread, true,
                         qemuMigrationSrcIOFunc,
                         io) < 0) {
         virReportSystemError(errno, "%s",
                              _("Unable to create migration thread"));
+        virMutexDestroy(&io->lock);
         goto error;
     }
 
@@ -3603,8 +3850,28 @@ qemuMigrationSrcStartTunnel(virStreamPtr st,
     return NULL;
 }
 
+
+static void
+qemuMigrationSrcTunnelGetStats(qemuMigrationIOThreadPtr io,
+                               qemuDomainTunnelStatsPtr stats)
+{
+    unsigned long long now;
+
+    virMutexLock(&io->lock);
+    stats->transferred = io->transferred;
+    virMutexUnlock(&io->lock);
+
+    stats->bps = 0;
+    if (io->started && virTimeMonotonicMicrosNowRaw(&now) == 0 &&
+        now > io->started)
+        stats->bps = stats->transferred * 1000000 / (now - io->started);
+}
+
+
 static int
-qemuMigrationSrcStopTunnel(qemuMigrationIOThreadPtr io, bool error)
+qemuMigrationSrcStopTunnel(qemuMigrationIOThreadPtr io,
+                           bool error,
+                           qemuDomainTunnelStatsPtr stats)
 {
     int rv = -1;
     char stop = error ? 1 : 0;
@@ -3618,6 +3885,9 @@ qemuMigrationSrcStopTunnel(qemuMigrationIOThreadPtr io, bool error)
 
     virThreadJoin(&io->thread);
 
+    if (stats)
+        qemuMigrationSrcTunnelGetStats(io, stats);
+
     /* Forward error from the IO thread, to this thread */
     if (io->err.code != VIR_ERR_OK) {
         if (error)
@@ -3633,6 +3903,7 @@ qemuMigrationSrcStopTunnel(qemuMigrationIOThreadPtr io, bool error)
  cleanup:
     VIR_FORCE_CLOSE(io->wakeupSendFD);
     VIR_FORCE_CLOSE(io->wakeupRecvFD);
+    virMutexDestroy(&io->lock);
     VIR_FREE(io);
     return rv;
 }
@@ -3872,6 +4143,12 @@ qemuMigrationSrcRun(virQEMUDriverPtr driver,
                                        QEMU_ASYNC_JOB_MIGRATION_OUT) < 0)
         goto error;
 
+    if (qemuMigrationOptionSet(driver, vm,
+                               QEMU_MONITOR_MIGRATION_CAPS_MULTIFD,
+                               flags & VIR_MIGRATE_PARALLEL,
+                               QEMU_ASYNC_JOB_MIGRATION_OUT) < 0)
+        goto error;
+
     if (qemuMigrationAnyCapsGet(vm, QEMU_MONITOR_MIGRATION_CAPS_PAUSE_BEFORE_SWITCHOVER) &&
         qemuMigrationOptionSet(driver, vm,
                                QEMU_MONITOR_MIGRATION_CAPS_PAUSE_BEFORE_SWITCHOVER,
@@ -3950,6 +4227,7 @@ qemuMigrationSrcRun(virQEMUDriverPtr driver,
     if (spec->fwdType != MIGRATION_FWD_DIRECT) {
         if (!(iothread = qemuMigrationSrcStartTunnel(spec->fwd.stream, fd)))
             goto error;
+        priv->job.tunnel = iothread;
         /* If we've created a tunnel, then the 'fd' will be closed in the
          * qemuMigrationIOFunc as data->sock.
          */
@@ -4026,8 +4304,12 @@ qemuMigrationSrcRun(virQEMUDriverPtr driver,
         qemuMigrationIOThreadPtr io;
 
         VIR_STEAL_PTR(io, iothread);
-        if (qemuMigrationSrcStopTunnel(io, false) < 0)
+        priv->job.tunnel = NULL;
+        if (qemuMigrationSrcStopTunnel(io, false,
+                                       &priv->job.current->tunnelStats) < 0)
             goto error;
+        if (priv->job.completed)
+            priv->job.completed->tunnelStats = priv->job.current->tunnelStats;
     }
 
     if (priv->job.completed) {
@@ -4084,8 +4366,10 @@ qemuMigrationSrcRun(virQEMUDriverPtr driver,
                                           QEMU_ASYNC_JOB_MIGRATION_OUT,
                                           dconn);
 
-    if (iothread)
-        qemuMigrationSrcStopTunnel(iothread, true);
+    if (iothread) {
+        priv->job.tunnel = NULL;
+        qemuMigrationSrcStopTunnel(iothread, true, NULL);
+    }
 
     if (priv->job.current->status != QEMU_DOMAIN_JOB_STATUS_CANCELED)
         priv->job.current->status = QEMU_DOMAIN_JOB_STATUS_FAILED;
@@ -4506,6 +4790,17 @@ qemuMigrationSrcPerformPeer2Peer3(virQEMUDriverPtr driver,
         if (qemuMigrationAnyCompressionDump(compression, &params, &nparams,
                                             &maxparams, &flags) < 0)
             goto cleanup;
+
+        if (migParams->multifdChannels_set &&
+            virTypedParamsAddInt(&params, &nparams, &maxparams,
+                                 VIR_MIGRATE_PARAM_PARALLEL_CONNECTIONS,
+                                 migParams->multifdChannels) < 0)
+            goto cleanup;
+    } else if (migParams->multifdChannels_set) {
+        virReportError(VIR_ERR_ARGUMENT_UNSUPPORTED, "%s",
+                       _("Destination does not support setting the number "
+                         "of parallel migration connections"));
+        goto cleanup;
     }
 
     if (virDomainObjGetState(vm, NULL) == VIR_DOMAIN_PAUSED)
@@ -6149,8 +6444,14 @@ qemuMigrationSrcFetchMirrorStats(virQEMUDriverPtr driver,
         qemuDomainDiskPrivatePtr diskPriv = QEMU_DOMAIN_DISK_PRIVATE(disk);
         qemuMonitorBlockJobInfoPtr data;
 
-        if (!diskPriv->migrating ||
-            !(data = virHashLookup(blockinfo, disk->info.alias)))
+        if (!diskPriv->migrating)
+            continue;
+
+        stats->disks++;
+        if (disk->mirrorState == VIR_DOMAIN_DISK_MIRROR_STATE_READY)
+            stats->ready++;
+
+        if (!(data = virHashLookup(blockinfo, disk->info.alias)))
             continue;
 
         stats->transferred += data->cur;
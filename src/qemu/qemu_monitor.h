@@ -673,6 +673,9 @@ struct _qemuMonitorMigrationParams {
 
     bool blockIncremental_set;
     bool blockIncremental;
+
+    bool multifdChannels_set;
+    int multifdChannels;
 };
 
 int qemuMonitorGetMigrationParams(qemuMonitorPtr mon,
@@ -752,6 +755,7 @@ typedef enum {
     QEMU_MONITOR_MIGRATION_CAPS_POSTCOPY,
     QEMU_MONITOR_MIGRATION_CAPS_COMPRESS,
     QEMU_MONITOR_MIGRATION_CAPS_PAUSE_BEFORE_SWITCHOVER,
+    QEMU_MONITOR_MIGRATION_CAPS_MULTIFD,
 
     QEMU_MONITOR_MIGRATION_CAPS_LAST
 } qemuMonitorMigrationCaps;
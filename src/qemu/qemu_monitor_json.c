@@ -2812,6 +2812,7 @@ qemuMonitorJSONGetMigrationParams(qemuMonitorPtr mon,
     PARSE_ULONG(maxBandwidth, "max-bandwidth");
     PARSE_ULONG(downtimeLimit, "downtime-limit");
     PARSE_BOOL(blockIncremental, "block-incremental");
+    PARSE_INT(multifdChannels, "multifd-channels");
 
 #undef PARSE_SET
 #undef PARSE_INT
@@ -2877,6 +2878,7 @@ qemuMonitorJSONSetMigrationParams(qemuMonitorPtr mon,
     APPEND_ULONG(maxBandwidth, "max-bandwidth");
     APPEND_ULONG(downtimeLimit, "downtime-limit");
     APPEND_BOOL(blockIncremental, "block-incremental");
+    APPEND_INT(multifdChannels, "multifd-channels");
 
 #undef APPEND
 #undef APPEND_INT
@@ -49,6 +49,7 @@
 #include "viralloc.h"
 #include "virconf.h"
 #include "virnetlink.h"
+#include "vircommand.h"
 #include "virnetdaemon.h"
 #include "remote_daemon_dispatch.h"
 #include "virhook.h"
@@ -648,6 +649,51 @@ daemonSetupLogging(struct daemonConfig *config,
 }
 
 
+/*
+ * Set up the way the workers of @srv are shared between clients
+ */
+static int
+daemonSetupFairQueuing(virNetServerPtr srv,
+                       struct daemonConfig *config)
+{
+    char **tmp;
+    int mode;
+
+    if ((mode = virNetServerFairQueuingTypeFromString(config->fair_queuing)) < 0) {
+        virReportError(VIR_ERR_CONF_SYNTAX,
+                       _("unknown fair_queuing mode '%s'"),
+                       config->fair_queuing);
+        return -1;
+    }
+
+    for (tmp = config->fair_queuing_weights; tmp && *tmp; tmp++) {
+        const char *sep = strrchr(*tmp, ':');
+        char *identity = NULL;
+        unsigned int weight;
+        int rc;
+
+        if (!sep || sep == *tmp ||
+            virStrToLong_uip(sep + 1, NULL, 10, &weight) < 0) {
+            virReportError(VIR_ERR_CONF_SYNTAX,
+                           _("malformed fair_queuing_weights entry '%s'"),
+                           *tmp);
+            return -1;
+        }
+
+        if (VIR_STRNDUP(identity, *tmp, sep - *tmp) < 0)
+            return -1;
+
+        rc = virNetServerSetFairQueuingWeight(srv, identity, weight);
+        VIR_FREE(identity);
+        if (rc < 0)
+            return -1;
+    }
+
+    virNetServerSetFairQueuing(srv, mode);
+    return 0;
+}
+
+
 static int
 daemonSetupAccessManager(struct daemonConfig *config)
 {
@@ -690,6 +736,7 @@ static void daemonReloadHandlerThread(void *opague ATTRIBUTE_UNUSED)
                 VIR_HOOK_DAEMON_OP_RELOAD, SIGHUP, "SIGHUP", NULL, NULL);
     if (virStateReload() < 0)
         VIR_WARN("Error while reloading drivers");
+    remoteACLCacheFlushAll();
 }
 
 static void daemonReloadHandler(virNetDaemonPtr dmn ATTRIBUTE_UNUSED,
@@ -1280,6 +1327,13 @@ int main(int argc, char **argv) {
     }
     umask(old_umask);
 
+    /* Fork the helper while we are still small and single threaded */
+    if (config->spawn_helper &&
+        virCommandSpawnServerStart() < 0) {
+        ret = VIR_DAEMON_ERR_INIT;
+        goto cleanup;
+    }
+
     if (virNetlinkStartup() < 0) {
         ret = VIR_DAEMON_ERR_INIT;
         goto cleanup;
@@ -1307,6 +1361,11 @@ int main(int argc, char **argv) {
         goto cleanup;
     }
 
+    if (daemonSetupFairQueuing(srv, config) < 0) {
+        ret = VIR_DAEMON_ERR_CONFIG;
+        goto cleanup;
+    }
+
     if (virNetDaemonAddServer(dmn, srv) < 0) {
         ret = VIR_DAEMON_ERR_INIT;
         goto cleanup;
@@ -1502,6 +1561,8 @@ int main(int argc, char **argv) {
 
     virNetlinkShutdown();
 
+    virCommandSpawnServerStop();
+
     if (pid_file_fd != -1)
         virPidFileReleasePath(pid_file, pid_file_fd);
 
@@ -33,6 +33,7 @@
 # include "lxc_protocol.h"
 # include "qemu_protocol.h"
 # include "virthread.h"
+# include "remote_daemon_aclcache.h"
 
 # if WITH_SASL
 #  include "virnetsaslcontext.h"
@@ -65,6 +66,9 @@ struct daemonClientPrivate {
     size_t nsecretEventCallbacks;
     bool closeRegistered;
 
+    /* Recent ACL decisions on relaying events to this client */
+    remoteACLCachePtr eventACLCache;
+
 # if WITH_SASL
     virNetSASLSessionPtr sasl;
 # endif
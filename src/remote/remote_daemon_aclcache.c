@@ -0,0 +1,217 @@
+/*
+ * remote_daemon_aclcache.c: cache of access control decisions
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "remote_daemon_aclcache.h"
+#include "viralloc.h"
+#include "viratomic.h"
+#include "virhash.h"
+#include "virstring.h"
+#include "virthread.h"
+#include "virtime.h"
+#include "viruuid.h"
+
+#define VIR_FROM_THIS VIR_FROM_RPC
+
+/* Flush the cache rather than grow past this */
+#define REMOTE_ACL_CACHE_MAX 1024
+
+typedef struct _remoteACLCacheEntry remoteACLCacheEntry;
+typedef remoteACLCacheEntry *remoteACLCacheEntryPtr;
+struct _remoteACLCacheEntry {
+    bool allowed;
+    int generation;
+    unsigned long long expires;     /* monotonic, in us */
+};
+
+struct _remoteACLCache {
+    virMutex lock;
+    virHashTablePtr entries;
+    unsigned long long ttl;         /* in us */
+};
+
+/* Bumped to invalidate the decisions held by all caches */
+static int remoteACLCacheGeneration;
+
+
+/**
+ * remoteACLCacheNew:
+ * @ttl: how long decisions stay valid, in ms
+ *
+ * Returns a new, empty cache or NULL on failure.
+ */
+remoteACLCachePtr
+remoteACLCacheNew(unsigned int ttl)
+{
+    remoteACLCachePtr cache;
+
+    if (VIR_ALLOC(cache) < 0)
+        return NULL;
+
+    cache->ttl = ttl * 1000ull;
+
+    if (virMutexInit(&cache->lock) < 0) {
+        VIR_FREE(cache);
+        return NULL;
+    }
+
+    if (!(cache->entries = virHashCreate(10, virHashValueFree))) {
+        virMutexDestroy(&cache->lock);
+        VIR_FREE(cache);
+        return NULL;
+    }
+
+    return cache;
+}
+
+
+void
+remoteACLCacheFree(remoteACLCachePtr cache)
+{
+    if (!cache)
+        return;
+
+    virHashFree(cache->entries);
+    virMutexDestroy(&cache->lock);
+    VIR_FREE(cache);
+}
+
+
+/*
+ * The access drivers may look at both the UUID and the name of an
+ * object (e.g. polkit passes both on to the policy), so both are part
+ * of the key. @uuid is NULL for objects which have none.
+ */
+static char *
+remoteACLCacheKey(const char *kind,
+                  const unsigned char *uuid,
+                  const char *name)
+{
+    char uuidstr[VIR_UUID_STRING_BUFLEN] = "";
+    char *key;
+
+    if (uuid)
+        virUUIDFormat(uuid, uuidstr);
+
+    if (virAsprintfQuiet(&key, "%s:%s:%s", kind, uuidstr,
+                         name ? name : "") < 0)
+        return NULL;
+
+    return key;
+}
+
+
+/**
+ * remoteACLCacheLookup:
+ * @cache: the cache
+ * @kind: type of the object and operation checked
+ * @uuid: UUID of the object, or NULL
+ * @name: name of the object, or NULL
+ * @allowed: filled with the cached decision
+ *
+ * Returns true and fills @allowed if a valid decision was found.
+ */
+bool
+remoteACLCacheLookup(remoteACLCachePtr cache,
+                     const char *kind,
+                     const unsigned char *uuid,
+                     const char *name,
+                     bool *allowed)
+{
+    remoteACLCacheEntryPtr entry;
+    unsigned long long now;
+    char *key = NULL;
+    bool ret = false;
+
+    if (virTimeMonotonicMicrosNowRaw(&now) < 0 ||
+        !(key = remoteACLCacheKey(kind, uuid, name)))
+        return false;
+
+    virMutexLock(&cache->lock);
+    if ((entry = virHashLookup(cache->entries, key)) &&
+        entry->generation == virAtomicIntGet(&remoteACLCacheGeneration) &&
+        entry->expires > now) {
+        *allowed = entry->allowed;
+        ret = true;
+    }
+    virMutexUnlock(&cache->lock);
+
+    VIR_FREE(key);
+    return ret;
+}
+
+
+/**
+ * remoteACLCacheStore:
+ * @cache: the cache
+ * @kind: type of the object and operation checked
+ * @uuid: UUID of the object, or NULL
+ * @name: name of the object, or NULL
+ * @allowed: the decision
+ *
+ * Remember @allowed for the TTL of @cache. Failures
+ * are ignored, as they only mean the check is repeated next time.
+ */
+void
+remoteACLCacheStore(remoteACLCachePtr cache,
+                    const char *kind,
+                    const unsigned char *uuid,
+                    const char *name,
+                    bool allowed)
+{
+    remoteACLCacheEntryPtr entry = NULL;
+    unsigned long long now;
+    char *key = NULL;
+
+    if (virTimeMonotonicMicrosNowRaw(&now) < 0 ||
+        !(key = remoteACLCacheKey(kind, uuid, name)) ||
+        VIR_ALLOC_QUIET(entry) < 0)
+        goto cleanup;
+
+    entry->allowed = allowed;
+    entry->generation = virAtomicIntGet(&remoteACLCacheGeneration);
+    /* On the monotonic clock, so that stepping the system time back
+     * does not keep decisions alive for longer */
+    entry->expires = now + cache->ttl;
+
+    virMutexLock(&cache->lock);
+    if (virHashSize(cache->entries) >= REMOTE_ACL_CACHE_MAX)
+        virHashRemoveAll(cache->entries);
+
+    if (virHashUpdateEntry(cache->entries, key, entry) == 0)
+        entry = NULL;
+    virMutexUnlock(&cache->lock);
+
+ cleanup:
+    VIR_FREE(entry);
+    VIR_FREE(key);
+}
+
+
+/**
+ * remoteACLCacheFlushAll:
+ *
+ * Forget the decisions held by all caches, so that changes to the
+ * access control policy take effect immediately.
+ */
+void
+remoteACLCacheFlushAll(void)
+{
+    virAtomicIntInc(&remoteACLCacheGeneration);
+}
@@ -0,0 +1,49 @@
+/*
+ * remote_daemon_aclcache.h: cache of access control decisions
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __REMOTE_DAEMON_ACLCACHE_H__
+# define __REMOTE_DAEMON_ACLCACHE_H__
+
+# include "internal.h"
+
+typedef struct _remoteACLCache remoteACLCache;
+typedef remoteACLCache *remoteACLCachePtr;
+
+/* How long a decision stays valid, in ms */
+# define REMOTE_ACL_CACHE_TTL 5000
+
+remoteACLCachePtr remoteACLCacheNew(unsigned int ttl);
+void remoteACLCacheFree(remoteACLCachePtr cache);
+
+bool remoteACLCacheLookup(remoteACLCachePtr cache,
+                          const char *kind,
+                          const unsigned char *uuid,
+                          const char *name,
+                          bool *allowed)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2) ATTRIBUTE_NONNULL(5);
+
+void remoteACLCacheStore(remoteACLCachePtr cache,
+                         const char *kind,
+                         const unsigned char *uuid,
+                         const char *name,
+                         bool allowed)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2);
+
+void remoteACLCacheFlushAll(void);
+
+#endif /* __REMOTE_DAEMON_ACLCACHE_H__ */
@@ -155,6 +155,9 @@ daemonConfigNew(bool privileged ATTRIBUTE_UNUSED)
 
     data->max_client_requests = 5;
 
+    if (VIR_STRDUP(data->fair_queuing, "none") < 0)
+        goto error;
+
     data->audit_level = 1;
     data->audit_logging = 0;
 
@@ -172,6 +175,8 @@ daemonConfigNew(bool privileged ATTRIBUTE_UNUSED)
 
     data->ovs_timeout = VIR_NETDEV_OVS_DEFAULT_TIMEOUT;
 
+    data->spawn_helper = false;
+
     localhost = virGetHostname();
     if (localhost == NULL) {
         /* we couldn't resolve the hostname; assume that we are
@@ -238,6 +243,14 @@ daemonConfigFree(struct daemonConfig *data)
     VIR_FREE(data->sasl_allowed_username_list);
     VIR_FREE(data->tls_priority);
 
+    VIR_FREE(data->fair_queuing);
+    tmp = data->fair_queuing_weights;
+    while (tmp && *tmp) {
+        VIR_FREE(*tmp);
+        tmp++;
+    }
+    VIR_FREE(data->fair_queuing_weights);
+
     VIR_FREE(data->key_file);
     VIR_FREE(data->ca_file);
     VIR_FREE(data->cert_file);
@@ -350,6 +363,12 @@ daemonConfigLoadOptions(struct daemonConfig *data,
     if (virConfGetValueUInt(conf, "max_client_requests", &data->max_client_requests) < 0)
         goto error;
 
+    if (virConfGetValueString(conf, "fair_queuing", &data->fair_queuing) < 0)
+        goto error;
+    if (virConfGetValueStringList(conf, "fair_queuing_weights", false,
+                                  &data->fair_queuing_weights) < 0)
+        goto error;
+
     if (virConfGetValueUInt(conf, "admin_min_workers", &data->admin_min_workers) < 0)
         goto error;
     if (virConfGetValueUInt(conf, "admin_max_workers", &data->admin_max_workers) < 0)
@@ -391,6 +410,9 @@ daemonConfigLoadOptions(struct daemonConfig *data,
     if (virConfGetValueUInt(conf, "ovs_timeout", &data->ovs_timeout) < 0)
         goto error;
 
+    if (virConfGetValueBool(conf, "spawn_helper", &data->spawn_helper) < 0)
+        goto error;
+
     return 0;
 
  error:
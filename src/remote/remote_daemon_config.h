@@ -73,6 +73,9 @@ struct daemonConfig {
 
     unsigned int max_client_requests;
 
+    char *fair_queuing;
+    char **fair_queuing_weights;
+
     unsigned int log_level;
     char *log_filters;
     char *log_outputs;
@@ -93,6 +96,8 @@ struct daemonConfig {
     unsigned int admin_keepalive_count;
 
     unsigned int ovs_timeout;
+
+    bool spawn_helper;
 };
 
 
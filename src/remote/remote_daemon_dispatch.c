@@ -132,6 +132,43 @@ remoteEventCallbackFree(void *opaque)
 }
 
 
+/*
+ * Look up whether relaying events about the object of type @kind
+ * identified by @uuid and @name to @client was recently allowed or
+ * denied.
+ *
+ * Returns true and fills @allowed if a valid decision was found.
+ */
+static bool
+remoteRelayACLCacheLookup(virNetServerClientPtr client,
+                          const char *kind,
+                          const unsigned char *uuid,
+                          const char *name,
+                          bool *allowed)
+{
+    struct daemonClientPrivate *priv = virNetServerClientGetPrivateData(client);
+
+    if (!priv->eventACLCache)
+        return false;
+
+    return remoteACLCacheLookup(priv->eventACLCache, kind, uuid, name, allowed);
+}
+
+
+static void
+remoteRelayACLCacheStore(virNetServerClientPtr client,
+                         const char *kind,
+                         const unsigned char *uuid,
+                         const char *name,
+                         bool allowed)
+{
+    struct daemonClientPrivate *priv = virNetServerClientGetPrivateData(client);
+
+    if (priv->eventACLCache)
+        remoteACLCacheStore(priv->eventACLCache, kind, uuid, name, allowed);
+}
+
+
 static bool
 remoteRelayDomainEventCheckACL(virNetServerClientPtr client,
                                virConnectPtr conn, virDomainPtr dom)
@@ -140,6 +177,10 @@ remoteRelayDomainEventCheckACL(virNetServerClientPtr client,
     virIdentityPtr identity = NULL;
     bool ret = false;
 
+    if (remoteRelayACLCacheLookup(client, "domain", dom->uuid, dom->name,
+                                  &ret))
+        return ret;
+
     /* For now, we just create a virDomainDef with enough contents to
      * satisfy what viraccessdriverpolkit.c references.  This is a bit
      * fragile, but I don't know of anything better.  */
@@ -152,6 +193,7 @@ remoteRelayDomainEventCheckACL(virNetServerClientPtr client,
     if (virIdentitySetCurrent(identity) < 0)
         goto cleanup;
     ret = virConnectDomainEventRegisterAnyCheckACL(conn, &def);
+    remoteRelayACLCacheStore(client, "domain", dom->uuid, dom->name, ret);
 
  cleanup:
     ignore_value(virIdentitySetCurrent(NULL));
@@ -168,6 +210,10 @@ remoteRelayNetworkEventCheckACL(virNetServerClientPtr client,
     virIdentityPtr identity = NULL;
     bool ret = false;
 
+    if (remoteRelayACLCacheLookup(client, "network", net->uuid, net->name,
+                                  &ret))
+        return ret;
+
     /* For now, we just create a virNetworkDef with enough contents to
      * satisfy what viraccessdriverpolkit.c references.  This is a bit
      * fragile, but I don't know of anything better.  */
@@ -179,6 +225,7 @@ remoteRelayNetworkEventCheckACL(virNetServerClientPtr client,
     if (virIdentitySetCurrent(identity) < 0)
         goto cleanup;
     ret = virConnectNetworkEventRegisterAnyCheckACL(conn, &def);
+    remoteRelayACLCacheStore(client, "network", net->uuid, net->name, ret);
 
  cleanup:
     ignore_value(virIdentitySetCurrent(NULL));
@@ -195,6 +242,10 @@ remoteRelayStoragePoolEventCheckACL(virNetServerClientPtr client,
     virIdentityPtr identity = NULL;
     bool ret = false;
 
+    if (remoteRelayACLCacheLookup(client, "storage-pool",
+                                  pool->uuid, pool->name, &ret))
+        return ret;
+
     /* For now, we just create a virStoragePoolDef with enough contents to
      * satisfy what viraccessdriverpolkit.c references.  This is a bit
      * fragile, but I don't know of anything better.  */
@@ -206,6 +257,8 @@ remoteRelayStoragePoolEventCheckACL(virNetServerClientPtr client,
     if (virIdentitySetCurrent(identity) < 0)
         goto cleanup;
     ret = virConnectStoragePoolEventRegisterAnyCheckACL(conn, &def);
+    remoteRelayACLCacheStore(client, "storage-pool",
+                             pool->uuid, pool->name, ret);
 
  cleanup:
     ignore_value(virIdentitySetCurrent(NULL));
@@ -222,6 +275,10 @@ remoteRelayNodeDeviceEventCheckACL(virNetServerClientPtr client,
     virIdentityPtr identity = NULL;
     bool ret = false;
 
+    if (remoteRelayACLCacheLookup(client, "node-device", NULL, dev->name,
+                                  &ret))
+        return ret;
+
     /* For now, we just create a virNodeDeviceDef with enough contents to
      * satisfy what viraccessdriverpolkit.c references.  This is a bit
      * fragile, but I don't know of anything better.  */
@@ -232,6 +289,7 @@ remoteRelayNodeDeviceEventCheckACL(virNetServerClientPtr client,
     if (virIdentitySetCurrent(identity) < 0)
         goto cleanup;
     ret = virConnectNodeDeviceEventRegisterAnyCheckACL(conn, &def);
+    remoteRelayACLCacheStore(client, "node-device", NULL, dev->name, ret);
 
  cleanup:
     ignore_value(virIdentitySetCurrent(NULL));
@@ -248,6 +306,12 @@ remoteRelaySecretEventCheckACL(virNetServerClientPtr client,
     virIdentityPtr identity = NULL;
     bool ret = false;
 
+    /* The usage type of a secret cannot change without its UUID
+     * changing too, so the usage ID is enough to tell them apart */
+    if (remoteRelayACLCacheLookup(client, "secret", secret->uuid,
+                                  secret->usageID, &ret))
+        return ret;
+
     /* For now, we just create a virSecretDef with enough contents to
      * satisfy what viraccessdriverpolkit.c references.  This is a bit
      * fragile, but I don't know of anything better.  */
@@ -260,6 +324,8 @@ remoteRelaySecretEventCheckACL(virNetServerClientPtr client,
     if (virIdentitySetCurrent(identity) < 0)
         goto cleanup;
     ret = virConnectSecretEventRegisterAnyCheckACL(conn, &def);
+    remoteRelayACLCacheStore(client, "secret", secret->uuid,
+                             secret->usageID, ret);
 
  cleanup:
     ignore_value(virIdentitySetCurrent(NULL));
@@ -275,6 +341,10 @@ remoteRelayDomainQemuMonitorEventCheckACL(virNetServerClientPtr client,
     virIdentityPtr identity = NULL;
     bool ret = false;
 
+    if (remoteRelayACLCacheLookup(client, "qemu-monitor",
+                                  dom->uuid, dom->name, &ret))
+        return ret;
+
     /* For now, we just create a virDomainDef with enough contents to
      * satisfy what viraccessdriverpolkit.c references.  This is a bit
      * fragile, but I don't know of anything better.  */
@@ -286,6 +356,8 @@ remoteRelayDomainQemuMonitorEventCheckACL(virNetServerClientPtr client,
     if (virIdentitySetCurrent(identity) < 0)
         goto cleanup;
     ret = virConnectDomainQemuMonitorEventRegisterCheckACL(conn, &def);
+    remoteRelayACLCacheStore(client, "qemu-monitor",
+                             dom->uuid, dom->name, ret);
 
  cleanup:
     ignore_value(virIdentitySetCurrent(NULL));
@@ -1741,6 +1813,7 @@ void remoteClientFree(void *data)
     if (priv->conn)
         virConnectClose(priv->conn);
 
+    remoteACLCacheFree(priv->eventACLCache);
     VIR_FREE(priv);
 }
 
@@ -1771,6 +1844,12 @@ void *remoteClientNew(virNetServerClientPtr client,
         return NULL;
     }
 
+    if (!(priv->eventACLCache = remoteACLCacheNew(REMOTE_ACL_CACHE_TTL))) {
+        virMutexDestroy(&priv->lock);
+        VIR_FREE(priv);
+        return NULL;
+    }
+
     virNetServerClientSetCloseHook(client, remoteClientCloseFunc);
     return priv;
 }
@@ -4668,6 +4747,7 @@ static int remoteDispatchConnectSupportsFeature(virNetServerPtr server ATTRIBUTE
     case VIR_DRV_FEATURE_FD_PASSING:
     case VIR_DRV_FEATURE_REMOTE_EVENT_CALLBACK:
     case VIR_DRV_FEATURE_REMOTE_CLOSE_CALLBACK:
+    case VIR_DRV_FEATURE_REMOTE_COMPACT_DOMAIN_STATS:
         supported = 1;
         break;
     case VIR_DRV_FEATURE_MIGRATION_V1:
@@ -6517,45 +6597,35 @@ remoteDispatchNetworkGetDHCPLeases(virNetServerPtr server ATTRIBUTE_UNUSED,
 
 
 static int
-remoteDispatchConnectGetAllDomainStats(virNetServerPtr server ATTRIBUTE_UNUSED,
-                                       virNetServerClientPtr client,
-                                       virNetMessagePtr msg ATTRIBUTE_UNUSED,
-                                       virNetMessageErrorPtr rerr,
-                                       remote_connect_get_all_domain_stats_args *args,
-                                       remote_connect_get_all_domain_stats_ret *ret)
+remoteDispatchGetDomainStats(struct daemonClientPrivate *priv,
+                             remote_nonnull_domain *remoteDoms,
+                             unsigned int nremoteDoms,
+                             unsigned int stats,
+                             unsigned int flags,
+                             virDomainStatsRecordPtr **retStats)
 {
-    int rv = -1;
-    size_t i;
-    struct daemonClientPrivate *priv = virNetServerClientGetPrivateData(client);
-    virDomainStatsRecordPtr *retStats = NULL;
-    int nrecords = 0;
     virDomainPtr *doms = NULL;
+    int nrecords = -1;
+    size_t i;
 
     if (!priv->conn) {
         virReportError(VIR_ERR_INTERNAL_ERROR, "%s", _("connection not open"));
         goto cleanup;
     }
 
-    if (args->doms.doms_len) {
-        if (VIR_ALLOC_N(doms, args->doms.doms_len + 1) < 0)
+    if (nremoteDoms) {
+        if (VIR_ALLOC_N(doms, nremoteDoms + 1) < 0)
             goto cleanup;
 
-        for (i = 0; i < args->doms.doms_len; i++) {
-            if (!(doms[i] = get_nonnull_domain(priv->conn, args->doms.doms_val[i])))
+        for (i = 0; i < nremoteDoms; i++) {
+            if (!(doms[i] = get_nonnull_domain(priv->conn, remoteDoms[i])))
                 goto cleanup;
         }
 
-        if ((nrecords = virDomainListGetStats(doms,
-                                              args->stats,
-                                              &retStats,
-                                              args->flags)) < 0)
-            goto cleanup;
+        nrecords = virDomainListGetStats(doms, stats, retStats, flags);
     } else {
-        if ((nrecords = virConnectGetAllDomainStats(priv->conn,
-                                                    args->stats,
-                                                    &retStats,
-                                                    args->flags)) < 0)
-            goto cleanup;
+        nrecords = virConnectGetAllDomainStats(priv->conn, stats,
+                                               retStats, flags);
     }
 
     if (nrecords > REMOTE_CONNECT_GET_ALL_DOMAIN_STATS_MAX) {
@@ -6563,9 +6633,37 @@ remoteDispatchConnectGetAllDomainStats(virNetServerPtr server ATTRIBUTE_UNUSED,
                        _("Number of domain stats records is %d, "
                          "which exceeds max limit: %d"),
                        nrecords, REMOTE_CONNECT_GET_ALL_DOMAIN_STATS_MAX);
-        goto cleanup;
+        nrecords = -1;
     }
 
+ cleanup:
+    virObjectListFree(doms);
+    return nrecords;
+}
+
+
+static int
+remoteDispatchConnectGetAllDomainStats(virNetServerPtr server ATTRIBUTE_UNUSED,
+                                       virNetServerClientPtr client,
+                                       virNetMessagePtr msg ATTRIBUTE_UNUSED,
+                                       virNetMessageErrorPtr rerr,
+                                       remote_connect_get_all_domain_stats_args *args,
+                                       remote_connect_get_all_domain_stats_ret *ret)
+{
+    int rv = -1;
+    size_t i;
+    struct daemonClientPrivate *priv = virNetServerClientGetPrivateData(client);
+    virDomainStatsRecordPtr *retStats = NULL;
+    int nrecords = 0;
+
+    if ((nrecords = remoteDispatchGetDomainStats(priv,
+                                                 args->doms.doms_val,
+                                                 args->doms.doms_len,
+                                                 args->stats,
+                                                 args->flags,
+                                                 &retStats)) < 0)
+        goto cleanup;
+
     if (nrecords) {
         if (VIR_ALLOC_N(ret->retStats.retStats_val, nrecords) < 0)
             goto cleanup;
@@ -6596,7 +6694,98 @@ remoteDispatchConnectGetAllDomainStats(virNetServerPtr server ATTRIBUTE_UNUSED,
         virNetMessageSaveError(rerr);
 
     virDomainStatsRecordListFree(retStats);
-    virObjectListFree(doms);
+
+    return rv;
+}
+
+
+static int
+remoteDispatchConnectGetAllDomainStatsCompact(virNetServerPtr server ATTRIBUTE_UNUSED,
+                                              virNetServerClientPtr client,
+                                              virNetMessagePtr msg ATTRIBUTE_UNUSED,
+                                              virNetMessageErrorPtr rerr,
+                                              remote_connect_get_all_domain_stats_compact_args *args,
+                                              remote_connect_get_all_domain_stats_compact_ret *ret)
+{
+    int rv = -1;
+    size_t i;
+    struct daemonClientPrivate *priv = virNetServerClientGetPrivateData(client);
+    virDomainStatsRecordPtr *retStats = NULL;
+    virTypedParamsDictPtr dict = NULL;
+    int nrecords = 0;
+
+    if ((nrecords = remoteDispatchGetDomainStats(priv,
+                                                 args->doms.doms_val,
+                                                 args->doms.doms_len,
+                                                 args->stats,
+                                                 args->flags,
+                                                 &retStats)) < 0)
+        goto cleanup;
+
+    if (!(dict = virTypedParamsDictNew()))
+        goto cleanup;
+
+    if (nrecords) {
+        if (VIR_ALLOC_N(ret->retStats.retStats_val, nrecords) < 0)
+            goto cleanup;
+
+        ret->retStats.retStats_len = nrecords;
+
+        for (i = 0; i < nrecords; i++) {
+            remote_domain_stats_compact_record *dst = ret->retStats.retStats_val + i;
+            unsigned long long *values = NULL;
+            unsigned int nvalues = 0;
+            size_t j;
+
+            make_nonnull_domain(&dst->dom, retStats[i]->dom);
+
+            if (virTypedParamsPack(dict,
+                                   retStats[i]->params,
+                                   retStats[i]->nparams,
+                                   &dst->keys.keys_val,
+                                   &values,
+                                   &nvalues,
+                                   &dst->strings.strings_val,
+                                   &dst->strings.strings_len,
+                                   VIR_TYPED_PARAM_STRING_OKAY) < 0)
+                goto cleanup;
+            dst->keys.keys_len = nvalues;
+
+            /* uint64_t need not be unsigned long long */
+            if (VIR_ALLOC_N(dst->values.values_val, nvalues) < 0) {
+                VIR_FREE(values);
+                goto cleanup;
+            }
+            dst->values.values_len = nvalues;
+
+            for (j = 0; j < nvalues; j++)
+                dst->values.values_val[j] = values[j];
+            VIR_FREE(values);
+        }
+    }
+
+    if (dict->nfields > REMOTE_CONNECT_GET_ALL_DOMAIN_STATS_MAX) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Number of domain stats fields is %zu, "
+                         "which exceeds max limit: %d"),
+                       dict->nfields, REMOTE_CONNECT_GET_ALL_DOMAIN_STATS_MAX);
+        goto cleanup;
+    }
+
+    ret->fields.fields_len = dict->nfields;
+    ret->types.types_len = dict->nfields;
+    VIR_STEAL_PTR(ret->fields.fields_val, dict->fields);
+    VIR_STEAL_PTR(ret->types.types_val, dict->types);
+    dict->nfields = 0;
+
+    rv = 0;
+
+ cleanup:
+    if (rv < 0)
+        virNetMessageSaveError(rerr);
+
+    virTypedParamsDictFree(dict);
+    virDomainStatsRecordListFree(retStats);
 
     return rv;
 }
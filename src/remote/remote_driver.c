@@ -98,6 +98,7 @@ struct private_data {
     bool serverKeepAlive;       /* Does server support keepalive protocol? */
     bool serverEventFilter;     /* Does server support modern event filtering */
     bool serverCloseCallback;   /* Does server support driver close callback */
+    bool serverCompactStats;    /* Does server support compact bulk stats */
 
     virObjectEventStatePtr eventState;
     virConnectCloseCallbackDataPtr closeCallback;
@@ -1237,6 +1238,9 @@ doRemoteOpen(virConnectPtr conn,
                  "by the remote side.");
     }
 
+    priv->serverCompactStats = remoteConnectSupportsFeatureUnlocked(conn,
+                                    priv, VIR_DRV_FEATURE_REMOTE_COMPACT_DOMAIN_STATS);
+
     /* Successful. */
     retcode = VIR_DRV_OPEN_SUCCESS;
 
@@ -7595,6 +7599,126 @@ remoteNetworkGetDHCPLeases(virNetworkPtr net,
 }
 
 
+static int
+remoteConnectGetAllDomainStatsCompact(virConnectPtr conn,
+                                      virDomainPtr *doms,
+                                      unsigned int ndoms,
+                                      unsigned int stats,
+                                      virDomainStatsRecordPtr **retStats,
+                                      unsigned int flags)
+{
+    struct private_data *priv = conn->privateData;
+    int rv = -1;
+    size_t i;
+    remote_connect_get_all_domain_stats_compact_args args;
+    remote_connect_get_all_domain_stats_compact_ret ret;
+    virDomainStatsRecordPtr elem = NULL;
+    virDomainStatsRecordPtr *tmpret = NULL;
+    unsigned long long *values = NULL;
+
+    memset(&args, 0, sizeof(args));
+
+    if (ndoms) {
+        if (VIR_ALLOC_N(args.doms.doms_val, ndoms) < 0)
+            goto cleanup;
+
+        for (i = 0; i < ndoms; i++)
+            make_nonnull_domain(args.doms.doms_val + i, doms[i]);
+    }
+    args.doms.doms_len = ndoms;
+
+    args.stats = stats;
+    args.flags = flags;
+
+    memset(&ret, 0, sizeof(ret));
+
+    remoteDriverLock(priv);
+    if (call(conn, priv, 0, REMOTE_PROC_CONNECT_GET_ALL_DOMAIN_STATS_COMPACT,
+             (xdrproc_t)xdr_remote_connect_get_all_domain_stats_compact_args, (char *)&args,
+             (xdrproc_t)xdr_remote_connect_get_all_domain_stats_compact_ret, (char *)&ret) == -1) {
+        remoteDriverUnlock(priv);
+        goto cleanup;
+    }
+    remoteDriverUnlock(priv);
+
+    if (ret.retStats.retStats_len > REMOTE_DOMAIN_LIST_MAX) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Number of stats entries is %d, which exceeds max limit: %d"),
+                       ret.retStats.retStats_len, REMOTE_DOMAIN_LIST_MAX);
+        goto cleanup;
+    }
+
+    if (ret.fields.fields_len != ret.types.types_len) {
+        virReportError(VIR_ERR_RPC, "%s",
+                       _("mismatched stats fields and types"));
+        goto cleanup;
+    }
+
+    *retStats = NULL;
+
+    if (VIR_ALLOC_N(tmpret, ret.retStats.retStats_len + 1) < 0)
+        goto cleanup;
+
+    for (i = 0; i < ret.retStats.retStats_len; i++) {
+        remote_domain_stats_compact_record *rec = ret.retStats.retStats_val + i;
+        size_t j;
+
+        if (rec->keys.keys_len != rec->values.values_len) {
+            virReportError(VIR_ERR_RPC, "%s",
+                           _("mismatched stats keys and values"));
+            goto cleanup;
+        }
+
+        if (VIR_ALLOC(elem) < 0)
+            goto cleanup;
+
+        if (!(elem->dom = get_nonnull_domain(conn, rec->dom)))
+            goto cleanup;
+
+        /* uint64_t need not be unsigned long long */
+        VIR_FREE(values);
+        if (VIR_ALLOC_N(values, rec->values.values_len) < 0)
+            goto cleanup;
+
+        for (j = 0; j < rec->values.values_len; j++)
+            values[j] = rec->values.values_val[j];
+
+        if (virTypedParamsUnpack(ret.fields.fields_val,
+                                 ret.types.types_val,
+                                 ret.fields.fields_len,
+                                 rec->keys.keys_val,
+                                 values,
+                                 rec->values.values_len,
+                                 rec->strings.strings_val,
+                                 rec->strings.strings_len,
+                                 REMOTE_CONNECT_GET_ALL_DOMAIN_STATS_MAX,
+                                 &elem->params,
+                                 &elem->nparams) < 0)
+            goto cleanup;
+
+        tmpret[i] = elem;
+        elem = NULL;
+    }
+
+    *retStats = tmpret;
+    tmpret = NULL;
+    rv = ret.retStats.retStats_len;
+
+ cleanup:
+    if (elem) {
+        virObjectUnref(elem->dom);
+        VIR_FREE(elem);
+    }
+    virDomainStatsRecordListFree(tmpret);
+    VIR_FREE(values);
+    VIR_FREE(args.doms.doms_val);
+    xdr_free((xdrproc_t)xdr_remote_connect_get_all_domain_stats_compact_ret,
+             (char *) &ret);
+
+    return rv;
+}
+
+
 static int
 remoteConnectGetAllDomainStats(virConnectPtr conn,
                                virDomainPtr *doms,
@@ -7611,6 +7735,10 @@ remoteConnectGetAllDomainStats(virConnectPtr conn,
     virDomainStatsRecordPtr elem = NULL;
     virDomainStatsRecordPtr *tmpret = NULL;
 
+    if (priv->serverCompactStats)
+        return remoteConnectGetAllDomainStatsCompact(conn, doms, ndoms, stats,
+                                                     retStats, flags);
+
     memset(&args, 0, sizeof(args));
 
     if (ndoms) {
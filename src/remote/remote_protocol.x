@@ -3299,6 +3299,29 @@ struct remote_connect_get_all_domain_stats_ret {
     remote_domain_stats_record retStats<REMOTE_DOMAIN_LIST_MAX>;
 };
 
+/* Same as remote_domain_stats_record, but each stats field refers to
+ * an entry in the fields/types dictionary sent once for all records.
+ * Strings hold values of string fields, the corresponding value is an index
+ * into the strings array. */
+struct remote_domain_stats_compact_record {
+    remote_nonnull_domain dom;
+    unsigned int keys<REMOTE_CONNECT_GET_ALL_DOMAIN_STATS_MAX>;
+    unsigned hyper values<REMOTE_CONNECT_GET_ALL_DOMAIN_STATS_MAX>;
+    remote_nonnull_string strings<REMOTE_CONNECT_GET_ALL_DOMAIN_STATS_MAX>;
+};
+
+struct remote_connect_get_all_domain_stats_compact_args {
+    remote_nonnull_domain doms<REMOTE_DOMAIN_LIST_MAX>;
+    unsigned int stats;
+    unsigned int flags;
+};
+
+struct remote_connect_get_all_domain_stats_compact_ret {
+    remote_nonnull_string fields<REMOTE_CONNECT_GET_ALL_DOMAIN_STATS_MAX>;
+    int types<REMOTE_CONNECT_GET_ALL_DOMAIN_STATS_MAX>;
+    remote_domain_stats_compact_record retStats<REMOTE_DOMAIN_LIST_MAX>;
+};
+
 struct remote_domain_fsinfo {
     remote_nonnull_string mountpoint;
     remote_nonnull_string name;
@@ -6135,5 +6158,12 @@ enum remote_procedure {
      * @priority: high
      * @acl: storage_pool:getattr
      */
-    REMOTE_PROC_STORAGE_POOL_LOOKUP_BY_TARGET_PATH = 391
+    REMOTE_PROC_STORAGE_POOL_LOOKUP_BY_TARGET_PATH = 391,
+
+    /**
+     * @generate: none
+     * @acl: connect:search_domains
+     * @aclfilter: domain:read
+     */
+    REMOTE_PROC_CONNECT_GET_ALL_DOMAIN_STATS_COMPACT = 392
 };
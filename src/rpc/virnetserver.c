@@ -31,6 +31,7 @@
 #include "virthreadpool.h"
 #include "virnetservermdns.h"
 #include "virstring.h"
+#include "virtime.h"
 
 #define VIR_FROM_THIS VIR_FROM_RPC
 
@@ -44,6 +45,15 @@ struct _virNetServerJob {
     virNetServerClientPtr client;
     virNetMessagePtr msg;
     virNetServerProgramPtr prog;
+    unsigned long long queued;          /* when the job was queued, in us */
+};
+
+typedef struct _virNetServerFairWeight virNetServerFairWeight;
+typedef virNetServerFairWeight *virNetServerFairWeightPtr;
+
+struct _virNetServerFairWeight {
+    char *identity;
+    unsigned int weight;
 };
 
 struct _virNetServer {
@@ -53,6 +63,10 @@ struct _virNetServer {
 
     virThreadPoolPtr workers;
 
+    int fairQueuing;                    /* virNetServerFairQueuing */
+    size_t nfairWeights;
+    virNetServerFairWeightPtr fairWeights;
+
     char *mdnsGroupName;
     virNetServerMDNSPtr mdns;
     virNetServerMDNSGroupPtr mdnsGroup;
@@ -104,6 +118,9 @@ static int virNetServerOnceInit(void)
 
 VIR_ONCE_GLOBAL_INIT(virNetServer)
 
+VIR_ENUM_IMPL(virNetServerFairQueuing, VIR_NET_SERVER_FAIR_QUEUING_LAST,
+              "none", "client", "identity")
+
 unsigned long long virNetServerNextClientID(virNetServerPtr srv)
 {
     unsigned long long val;
@@ -163,9 +180,15 @@ static void virNetServerHandleJob(void *jobOpaque, void *opaque)
     virNetServerPtr srv = opaque;
     virNetServerJobPtr job = jobOpaque;
 
+    unsigned long long now;
+
     VIR_DEBUG("server=%p client=%p message=%p prog=%p",
               srv, job->client, job->msg, job->prog);
 
+    if (job->queued && virTimeMonotonicMicrosNowRaw(&now) == 0 &&
+        now >= job->queued)
+        virNetServerClientAddQueueWait(job->client, now - job->queued);
+
     if (virNetServerProcessMsg(srv, job->client, job->prog, job->msg) < 0)
         goto error;
 
@@ -182,6 +205,61 @@ static void virNetServerHandleJob(void *jobOpaque, void *opaque)
     VIR_FREE(job);
 }
 
+/*
+ * Works out which flow of the worker pool the requests of @client
+ * are queued to, and the weight of that flow. Clients which have not
+ * authenticated yet always get a flow of their own.
+ * The @srv must be locked when this function is called.
+ */
+static int
+virNetServerGetJobFlow(virNetServerPtr srv,
+                       virNetServerClientPtr client,
+                       char **flow,
+                       unsigned int *weight)
+{
+    virIdentityPtr identity = NULL;
+    const char *name = NULL;
+    size_t i;
+    int ret = -1;
+
+    *flow = NULL;
+    *weight = 1;
+
+    if (srv->fairQueuing == VIR_NET_SERVER_FAIR_QUEUING_NONE)
+        return 0;
+
+    if (virNetServerClientIsAuthenticated(client)) {
+        if (!(identity = virNetServerClientGetIdentity(client)))
+            goto cleanup;
+
+        if (virIdentityGetSASLUserName(identity, &name) < 0 ||
+            (!name && virIdentityGetX509DName(identity, &name) < 0) ||
+            (!name && virIdentityGetUNIXUserName(identity, &name) < 0))
+            goto cleanup;
+    }
+
+    for (i = 0; name && i < srv->nfairWeights; i++) {
+        if (STREQ(srv->fairWeights[i].identity, name)) {
+            *weight = srv->fairWeights[i].weight;
+            break;
+        }
+    }
+
+    if (srv->fairQueuing == VIR_NET_SERVER_FAIR_QUEUING_IDENTITY && name) {
+        if (virAsprintf(flow, "identity:%s", name) < 0)
+            goto cleanup;
+    } else {
+        if (virAsprintf(flow, "client:%llu",
+                        virNetServerClientGetID(client)) < 0)
+            goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    virObjectUnref(identity);
+    return ret;
+}
+
 static void virNetServerDispatchNewMessage(virNetServerClientPtr client,
                                            virNetMessagePtr msg,
                                            void *opaque)
@@ -189,6 +267,8 @@ static void virNetServerDispatchNewMessage(virNetServerClientPtr client,
     virNetServerPtr srv = opaque;
     virNetServerProgramPtr prog = NULL;
     unsigned int priority = 0;
+    char *flow = NULL;
+    unsigned int weight;
     size_t i;
 
     VIR_DEBUG("server=%p client=%p message=%p",
@@ -205,11 +285,16 @@ static void virNetServerDispatchNewMessage(virNetServerClientPtr client,
     if (srv->workers) {
         virNetServerJobPtr job;
 
+        if (virNetServerGetJobFlow(srv, client, &flow, &weight) < 0)
+            goto error;
+
         if (VIR_ALLOC(job) < 0)
             goto error;
 
         job->client = client;
         job->msg = msg;
+        if (virTimeMonotonicMicrosNowRaw(&job->queued) < 0)
+            job->queued = 0;
 
         if (prog) {
             job->prog = virObjectRef(prog);
@@ -217,7 +302,8 @@ static void virNetServerDispatchNewMessage(virNetServerClientPtr client,
         }
 
         virObjectRef(client);
-        if (virThreadPoolSendJob(srv->workers, priority, job) < 0) {
+        if (virThreadPoolSendJobFull(srv->workers, priority,
+                                     flow, weight, job) < 0) {
             virObjectUnref(client);
             VIR_FREE(job);
             virObjectUnref(prog);
@@ -229,12 +315,14 @@ static void virNetServerDispatchNewMessage(virNetServerClientPtr client,
     }
 
     virObjectUnlock(srv);
+    VIR_FREE(flow);
     return;
 
  error:
     virNetMessageFree(msg);
     virNetServerClientClose(client);
     virObjectUnlock(srv);
+    VIR_FREE(flow);
 }
 
 /**
@@ -814,6 +902,10 @@ void virNetServerDispose(void *obj)
 
     virThreadPoolFree(srv->workers);
 
+    for (i = 0; i < srv->nfairWeights; i++)
+        VIR_FREE(srv->fairWeights[i].identity);
+    VIR_FREE(srv->fairWeights);
+
     for (i = 0; i < srv->nservices; i++)
         virObjectUnref(srv->services[i]);
     VIR_FREE(srv->services);
@@ -970,6 +1062,77 @@ virNetServerSetThreadPoolParameters(virNetServerPtr srv,
     return ret;
 }
 
+int
+virNetServerGetFairQueuing(virNetServerPtr srv)
+{
+    int ret;
+
+    virObjectLock(srv);
+    ret = srv->fairQueuing;
+    virObjectUnlock(srv);
+
+    return ret;
+}
+
+void
+virNetServerSetFairQueuing(virNetServerPtr srv,
+                           int mode)
+{
+    virObjectLock(srv);
+    srv->fairQueuing = mode;
+    virObjectUnlock(srv);
+}
+
+/**
+ * virNetServerSetFairQueuingWeight:
+ * @srv: server
+ * @identity: SASL user name, x509 distinguished name or UNIX user name
+ * @weight: relative share of the workers, 1 by default
+ *
+ * Sets how large a share of the worker threads the requests of
+ * clients authenticated as @identity get when fair queuing is enabled.
+ *
+ * Returns 0 on success, -1 on error
+ */
+int
+virNetServerSetFairQueuingWeight(virNetServerPtr srv,
+                                 const char *identity,
+                                 unsigned int weight)
+{
+    virNetServerFairWeight fairWeight = { NULL, weight };
+    int ret = -1;
+    size_t i;
+
+    if (weight == 0) {
+        virReportError(VIR_ERR_INVALID_ARG,
+                       _("Weight of identity '%s' must be greater than zero"),
+                       identity);
+        return -1;
+    }
+
+    virObjectLock(srv);
+
+    for (i = 0; i < srv->nfairWeights; i++) {
+        if (STREQ(srv->fairWeights[i].identity, identity)) {
+            srv->fairWeights[i].weight = weight;
+            ret = 0;
+            goto cleanup;
+        }
+    }
+
+    if (VIR_STRDUP(fairWeight.identity, identity) < 0 ||
+        VIR_APPEND_ELEMENT(srv->fairWeights, srv->nfairWeights,
+                           fairWeight) < 0) {
+        VIR_FREE(fairWeight.identity);
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    virObjectUnlock(srv);
+    return ret;
+}
+
 size_t
 virNetServerGetMaxClients(virNetServerPtr srv)
 {
@@ -32,6 +32,19 @@
 # include "virnetserverservice.h"
 # include "virobject.h"
 # include "virjson.h"
+# include "virutil.h"
+
+/* How the worker threads are shared between the clients, the values
+ * match virThreadPoolFairQueuing from the admin API */
+typedef enum {
+    VIR_NET_SERVER_FAIR_QUEUING_NONE = 0, /* first come, first served */
+    VIR_NET_SERVER_FAIR_QUEUING_CLIENT,   /* fair share per connection */
+    VIR_NET_SERVER_FAIR_QUEUING_IDENTITY, /* fair share per user */
+
+    VIR_NET_SERVER_FAIR_QUEUING_LAST
+} virNetServerFairQueuing;
+
+VIR_ENUM_DECL(virNetServerFairQueuing)
 
 
 virNetServerPtr virNetServerNew(const char *name,
@@ -102,6 +115,13 @@ int virNetServerSetThreadPoolParameters(virNetServerPtr srv,
                                         long long int maxWorkers,
                                         long long int prioWorkers);
 
+int virNetServerGetFairQueuing(virNetServerPtr srv);
+void virNetServerSetFairQueuing(virNetServerPtr srv,
+                                int mode);
+int virNetServerSetFairQueuingWeight(virNetServerPtr srv,
+                                     const char *identity,
+                                     unsigned int weight);
+
 unsigned long long virNetServerNextClientID(virNetServerPtr srv);
 
 virNetServerClientPtr virNetServerGetClient(virNetServerPtr srv,
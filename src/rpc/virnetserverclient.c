@@ -100,6 +100,10 @@ struct _virNetServerClient
      * throttling calculations */
     size_t nrequests;
     size_t nrequests_max;
+
+    /* How long the requests waited for a worker, see
+     * virNetServerClientQueueWait */
+    unsigned long long queueWait[VIR_NET_SERVER_CLIENT_QUEUE_WAIT_LAST];
     /* Zero or one messages being received. Zero if
      * nrequests >= max_clients and throttling */
     virNetMessagePtr rx;
@@ -1746,3 +1750,47 @@ virNetServerClientSetQuietEOF(virNetServerClientPtr client)
 {
     virNetSocketSetQuietEOF(client->sock);
 }
+
+
+/**
+ * virNetServerClientAddQueueWait:
+ * @client: the client
+ * @us: time a request spent in the worker pool queue
+ *
+ * Accounts a request of @client which waited @us microseconds
+ * before a worker picked it up.
+ */
+void
+virNetServerClientAddQueueWait(virNetServerClientPtr client,
+                               unsigned long long us)
+{
+    size_t i = 0;
+    unsigned long long limit = 1000;
+
+    while (i < VIR_NET_SERVER_CLIENT_QUEUE_WAIT_LONG && us >= limit) {
+        limit *= 10;
+        i++;
+    }
+
+    virObjectLock(client);
+    client->queueWait[i]++;
+    virObjectUnlock(client);
+}
+
+
+/**
+ * virNetServerClientGetQueueWait:
+ * @client: the client
+ * @waits: array of VIR_NET_SERVER_CLIENT_QUEUE_WAIT_LAST counters
+ *
+ * Fills @waits with the number of requests of @client which waited
+ * for a worker for less than 1ms, 10ms, 100ms, 1s, 10s and longer.
+ */
+void
+virNetServerClientGetQueueWait(virNetServerClientPtr client,
+                               unsigned long long *waits)
+{
+    virObjectLock(client);
+    memcpy(waits, client->queueWait, sizeof(client->queueWait));
+    virObjectUnlock(client);
+}
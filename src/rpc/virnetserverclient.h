@@ -43,6 +43,19 @@ typedef void (*virNetServerClientDispatchFunc)(virNetServerClientPtr client,
                                                virNetMessagePtr msg,
                                                void *opaque);
 
+/* Buckets of the histogram of time the requests of a client spent
+ * waiting for a worker thread */
+typedef enum {
+    VIR_NET_SERVER_CLIENT_QUEUE_WAIT_1MS = 0,
+    VIR_NET_SERVER_CLIENT_QUEUE_WAIT_10MS,
+    VIR_NET_SERVER_CLIENT_QUEUE_WAIT_100MS,
+    VIR_NET_SERVER_CLIENT_QUEUE_WAIT_1S,
+    VIR_NET_SERVER_CLIENT_QUEUE_WAIT_10S,
+    VIR_NET_SERVER_CLIENT_QUEUE_WAIT_LONG,
+
+    VIR_NET_SERVER_CLIENT_QUEUE_WAIT_LAST
+} virNetServerClientQueueWait;
+
 typedef int (*virNetServerClientFilterFunc)(virNetServerClientPtr client,
                                             virNetMessagePtr msg,
                                             void *opaque);
@@ -180,4 +193,9 @@ int virNetServerClientGetInfo(virNetServerClientPtr client,
 
 void virNetServerClientSetQuietEOF(virNetServerClientPtr client);
 
+void virNetServerClientAddQueueWait(virNetServerClientPtr client,
+                                    unsigned long long us);
+void virNetServerClientGetQueueWait(virNetServerClientPtr client,
+                                    unsigned long long *waits);
+
 #endif /* __VIR_NET_SERVER_CLIENT_H__ */
@@ -40,7 +40,9 @@
 #include "virscsivhost.h"
 #include "virstoragefile.h"
 #include "virstring.h"
+#include "virtime.h"
 #include "virutil.h"
+#include "virhash.h"
 
 #define VIR_FROM_THIS VIR_FROM_SECURITY
 
@@ -85,6 +87,7 @@ struct _virSecurityDACChownList {
     virSecurityDACDataPtr priv;
     virSecurityDACChownItemPtr *items;
     size_t nItems;
+    virHashTablePtr paths; /* path => item, to merge repeated chowns */
 };
 
 
@@ -101,6 +104,17 @@ virSecurityDACChownListAppend(virSecurityDACChownListPtr list,
     char *tmp = NULL;
     virSecurityDACChownItemPtr item = NULL;
 
+    /* The same file is often reached several times, e.g. a backing image
+     * shared by multiple disks. Only the last requested owner matters. */
+    if (path && (item = virHashLookup(list->paths, path))) {
+        VIR_DEBUG("Merging chown of '%s' to '%ld:%ld' into queued one",
+                  path, (long) uid, (long) gid);
+        item->src = src;
+        item->uid = uid;
+        item->gid = gid;
+        return 0;
+    }
+
     if (VIR_ALLOC(item) < 0)
         return -1;
 
@@ -117,6 +131,10 @@ virSecurityDACChownListAppend(virSecurityDACChownListPtr list,
 
     tmp = NULL;
 
+    if (path &&
+        virHashAddEntry(list->paths, path, list->items[list->nItems - 1]) < 0)
+        goto cleanup;
+
     ret = 0;
  cleanup:
     VIR_FREE(tmp);
@@ -133,6 +151,7 @@ virSecurityDACChownListFree(void *opaque)
     if (!list)
         return;
 
+    virHashFree(list->paths);
     for (i = 0; i < list->nItems; i++) {
         VIR_FREE(list->items[i]->path);
         VIR_FREE(list->items[i]);
@@ -195,8 +214,12 @@ virSecurityDACTransactionRun(pid_t pid ATTRIBUTE_UNUSED,
                              void *opaque)
 {
     virSecurityDACChownListPtr list = opaque;
+    unsigned long long start = 0;
+    unsigned long long end = 0;
     size_t i;
 
+    ignore_value(virTimeMillisNow(&start));
+
     for (i = 0; i < list->nItems; i++) {
         virSecurityDACChownItemPtr item = list->items[i];
 
@@ -209,6 +232,9 @@ virSecurityDACTransactionRun(pid_t pid ATTRIBUTE_UNUSED,
             return -1;
     }
 
+    ignore_value(virTimeMillisNow(&end));
+    VIR_DEBUG("Relabelled %zu paths in %llu ms", list->nItems, end - start);
+
     return 0;
 }
 
@@ -470,10 +496,15 @@ virSecurityDACTransactionStart(virSecurityManagerPtr mgr)
 
     list->priv = priv;
 
+    if (!(list->paths = virHashCreate(32, NULL))) {
+        VIR_FREE(list);
+        return -1;
+    }
+
     if (virThreadLocalSet(&chownList, list) < 0) {
         virReportSystemError(errno, "%s",
                              _("Unable to set thread local variable"));
-        VIR_FREE(list);
+        virSecurityDACChownListFree(list);
         return -1;
     }
 
@@ -486,10 +517,11 @@ virSecurityDACTransactionStart(virSecurityManagerPtr mgr)
  * @pid: domain's PID
  *
  * Enters the @pid namespace (usually @pid refers to a domain) and
- * performs all the chown()-s on the list. Note that the transaction is
- * also freed, therefore new one has to be started after successful
- * return from this function. Also it is considered as error if there's
- * no transaction set and this function is called.
+ * performs all the chown()-s on the list. If @pid is -1 the chown()-s
+ * are performed directly by the calling process. Note that the
+ * transaction is also freed, therefore new one has to be started after
+ * successful return from this function. Also it is considered as error
+ * if there's no transaction set and this function is called.
  *
  * Returns: 0 on success,
  *         -1 otherwise.
@@ -514,10 +546,15 @@ virSecurityDACTransactionCommit(virSecurityManagerPtr mgr ATTRIBUTE_UNUSED,
         goto cleanup;
     }
 
-    if (virProcessRunInMountNamespace(pid,
-                                      virSecurityDACTransactionRun,
-                                      list) < 0)
-        goto cleanup;
+    if (pid == -1) {
+        if (virSecurityDACTransactionRun(pid, list) < 0)
+            goto cleanup;
+    } else {
+        if (virProcessRunInMountNamespace(pid,
+                                          virSecurityDACTransactionRun,
+                                          list) < 0)
+            goto cleanup;
+    }
 
     ret = 0;
  cleanup:
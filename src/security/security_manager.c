@@ -267,10 +267,11 @@ virSecurityManagerTransactionStart(virSecurityManagerPtr mgr)
  * @pid: domain's PID
  *
  * Enters the @pid namespace (usually @pid refers to a domain) and
- * performs all the operations on the transaction list. Note that the
- * transaction is also freed, therefore new one has to be started after
- * successful return from this function. Also it is considered as error
- * if there's no transaction set and this function is called.
+ * performs all the operations on the transaction list. If @pid is -1,
+ * the operations are performed in the calling process instead. Note that
+ * the transaction is also freed, therefore new one has to be started
+ * after successful return from this function. Also it is considered as
+ * error if there's no transaction set and this function is called.
  *
  * Returns: 0 on success,
  *         -1 otherwise.
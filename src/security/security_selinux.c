@@ -48,6 +48,7 @@
 #include "virconf.h"
 #include "virtpm.h"
 #include "virstring.h"
+#include "virtime.h"
 
 #define VIR_FROM_THIS VIR_FROM_SECURITY
 
@@ -93,6 +94,7 @@ struct _virSecuritySELinuxContextList {
     bool privileged;
     virSecuritySELinuxContextItemPtr *items;
     size_t nItems;
+    virHashTablePtr paths; /* path => item, to merge repeated relabels */
 };
 
 #define SECURITY_SELINUX_VOID_DOI       "0"
@@ -126,6 +128,20 @@ virSecuritySELinuxContextListAppend(virSecuritySELinuxContextListPtr list,
 {
     int ret = -1;
     virSecuritySELinuxContextItemPtr item = NULL;
+    char *tmp = NULL;
+
+    /* The same file is often reached several times, e.g. a backing image
+     * shared by multiple disks. Only the last requested context matters. */
+    if ((item = virHashLookup(list->paths, path))) {
+        VIR_DEBUG("Merging relabel of '%s' to '%s' into queued one",
+                  path, tcon);
+        if (VIR_STRDUP(tmp, tcon) < 0)
+            return -1;
+        VIR_FREE(item->tcon);
+        item->tcon = tmp;
+        item->optional = optional;
+        return 0;
+    }
 
     if (VIR_ALLOC(item) < 0)
         return -1;
@@ -138,6 +154,10 @@ virSecuritySELinuxContextListAppend(virSecuritySELinuxContextListPtr list,
     if (VIR_APPEND_ELEMENT(list->items, list->nItems, item) < 0)
         goto cleanup;
 
+    if (virHashAddEntry(list->paths, path,
+                        list->items[list->nItems - 1]) < 0)
+        goto cleanup;
+
     ret = 0;
  cleanup:
     virSecuritySELinuxContextItemFree(item);
@@ -153,9 +173,11 @@ virSecuritySELinuxContextListFree(void *opaque)
     if (!list)
         return;
 
+    virHashFree(list->paths);
     for (i = 0; i < list->nItems; i++)
         virSecuritySELinuxContextItemFree(list->items[i]);
 
+    VIR_FREE(list->items);
     VIR_FREE(list);
 }
 
@@ -212,8 +234,12 @@ virSecuritySELinuxTransactionRun(pid_t pid ATTRIBUTE_UNUSED,
                                  void *opaque)
 {
     virSecuritySELinuxContextListPtr list = opaque;
+    unsigned long long start = 0;
+    unsigned long long end = 0;
     size_t i;
 
+    ignore_value(virTimeMillisNow(&start));
+
     for (i = 0; i < list->nItems; i++) {
         virSecuritySELinuxContextItemPtr item = list->items[i];
 
@@ -225,6 +251,9 @@ virSecuritySELinuxTransactionRun(pid_t pid ATTRIBUTE_UNUSED,
             return -1;
     }
 
+    ignore_value(virTimeMillisNow(&end));
+    VIR_DEBUG("Relabelled %zu paths in %llu ms", list->nItems, end - start);
+
     return 0;
 }
 
@@ -1025,10 +1054,15 @@ virSecuritySELinuxTransactionStart(virSecurityManagerPtr mgr)
 
     list->privileged = privileged;
 
+    if (!(list->paths = virHashCreate(32, NULL))) {
+        VIR_FREE(list);
+        return -1;
+    }
+
     if (virThreadLocalSet(&contextList, list) < 0) {
         virReportSystemError(errno, "%s",
                              _("Unable to set thread local variable"));
-        VIR_FREE(list);
+        virSecuritySELinuxContextListFree(list);
         return -1;
     }
 
@@ -1041,10 +1075,12 @@ virSecuritySELinuxTransactionStart(virSecurityManagerPtr mgr)
  * @pid: domain's PID
  *
  * Enters the @pid namespace (usually @pid refers to a domain) and
- * performs all the sefilecon()-s on the list. Note that the
- * transaction is also freed, therefore new one has to be started after
- * successful return from this function. Also it is considered as error
- * if there's no transaction set and this function is called.
+ * performs all the sefilecon()-s on the list. If @pid is -1 the
+ * setfilecon()-s are performed directly by the calling process. Note
+ * that the transaction is also freed, therefore new one has to be
+ * started after successful return from this function. Also it is
+ * considered as error if there's no transaction set and this function
+ * is called.
  *
  * Returns: 0 on success,
  *         -1 otherwise.
@@ -1054,7 +1090,7 @@ virSecuritySELinuxTransactionCommit(virSecurityManagerPtr mgr ATTRIBUTE_UNUSED,
                                     pid_t pid)
 {
     virSecuritySELinuxContextListPtr list;
-    int ret = 0;
+    int ret = -1;
 
     list = virThreadLocalGet(&contextList);
     if (!list)
@@ -1066,10 +1102,15 @@ virSecuritySELinuxTransactionCommit(virSecurityManagerPtr mgr ATTRIBUTE_UNUSED,
         goto cleanup;
     }
 
-    if (virProcessRunInMountNamespace(pid,
-                                      virSecuritySELinuxTransactionRun,
-                                      list) < 0)
-        goto cleanup;
+    if (pid == -1) {
+        if (virSecuritySELinuxTransactionRun(pid, list) < 0)
+            goto cleanup;
+    } else {
+        if (virProcessRunInMountNamespace(pid,
+                                          virSecuritySELinuxTransactionRun,
+                                          list) < 0)
+            goto cleanup;
+    }
 
     ret = 0;
  cleanup:
@@ -1153,6 +1194,18 @@ virSecuritySELinuxSetFileconHelper(const char *path, const char *tcon,
     else if (rc > 0)
         return 0;
 
+    /* Skip the relabel if @path already has the desired context, which
+     * is common when restarting domains on shared storage. */
+    if (getfilecon_raw(path, &econ) >= 0) {
+        bool same = STREQ(tcon, econ);
+
+        freecon(econ);
+        if (same) {
+            VIR_DEBUG("SELinux context on '%s' is already '%s'", path, tcon);
+            return 0;
+        }
+    }
+
     VIR_INFO("Setting SELinux context on '%s' to '%s'", path, tcon);
 
     if (setfilecon_raw(path, (VIR_SELINUX_CTX_CONST char *) tcon) < 0) {
@@ -94,6 +94,9 @@ struct _virStorageBackend {
     virStorageBackendStartPool startPool;
     virStorageBackendBuildPool buildPool;
     virStorageBackendRefreshPool refreshPool; /* Must be non-NULL */
+    /* refreshPool updates the list of volumes itself rather than
+     * relying on it being cleared beforehand */
+    bool refreshIncremental;
     virStorageBackendStopPool stopPool;
     virStorageBackendDeletePool deletePool;
 
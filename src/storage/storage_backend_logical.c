@@ -26,16 +26,18 @@
 #include <sys/wait.h>
 #include <sys/stat.h>
 #include <stdio.h>
-#include <regex.h>
 #include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
 
 #include "virerror.h"
 #include "storage_backend_logical.h"
+#include "storage_backend_logical_priv.h"
 #include "storage_conf.h"
 #include "vircommand.h"
 #include "viralloc.h"
+#include "viratomic.h"
+#include "virjson.h"
 #include "virlog.h"
 #include "virfile.h"
 #include "virstring.h"
@@ -125,123 +127,148 @@ virStorageBackendLogicalInitializeDevice(const char *path)
 #define VIR_STORAGE_VOL_LOGICAL_SEGTYPE_MIRROR  "mirror"
 #define VIR_STORAGE_VOL_LOGICAL_SEGTYPE_RAID    "raid"
 
-struct virStorageBackendLogicalPoolVolData {
-    virStoragePoolObjPtr pool;
-    virStorageVolDefPtr vol;
+/* Fields describing a segment of a logical volume, in the order in
+ * which they are requested from lvs */
+enum {
+    VIR_STORAGE_VOL_LOGICAL_FIELD_NAME,
+    VIR_STORAGE_VOL_LOGICAL_FIELD_ORIGIN,
+    VIR_STORAGE_VOL_LOGICAL_FIELD_UUID,
+    VIR_STORAGE_VOL_LOGICAL_FIELD_DEVICES,
+    VIR_STORAGE_VOL_LOGICAL_FIELD_SEGTYPE,
+    VIR_STORAGE_VOL_LOGICAL_FIELD_STRIPES,
+    VIR_STORAGE_VOL_LOGICAL_FIELD_SEG_SIZE,
+    VIR_STORAGE_VOL_LOGICAL_FIELD_VG_EXTENT_SIZE,
+    VIR_STORAGE_VOL_LOGICAL_FIELD_SIZE,
+    VIR_STORAGE_VOL_LOGICAL_FIELD_LV_ATTR,
+
+    VIR_STORAGE_VOL_LOGICAL_FIELD_LAST
 };
 
+/* Keys of the fields above in JSON reports */
+static const char *virStorageBackendLogicalJSONFields[] = {
+    "lv_name", "origin", "lv_uuid", "devices", "segtype", "stripes",
+    "seg_size", "vg_extent_size", "lv_size", "lv_attr",
+};
+verify(ARRAY_CARDINALITY(virStorageBackendLogicalJSONFields) ==
+       VIR_STORAGE_VOL_LOGICAL_FIELD_LAST);
+
+#define VIR_STORAGE_VOL_LOGICAL_REPORT_FIELDS \
+    "lv_name,origin,lv_uuid,devices,segtype,stripes,seg_size," \
+    "vg_extent_size,lv_size,lv_attr,vg_size,vg_free"
+
+/* Whether lvs and vgs support --reportformat json, which needs lvm2
+ * 2.02.158 or newer. -1 until probed. */
+static int virStorageBackendLogicalJSONReport = -1;
+
+
+static const char *
+virStorageBackendLogicalReportGet(virJSONValuePtr row,
+                                  const char *field)
+{
+    const char *val = virJSONValueObjectGetString(row, field);
+
+    if (!val)
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("missing field '%s' in LVM report"), field);
+    return val;
+}
+
+
+static int
+virStorageBackendLogicalReportGetULL(virJSONValuePtr row,
+                                     const char *field,
+                                     unsigned long long *val)
+{
+    const char *str;
+
+    if (!(str = virStorageBackendLogicalReportGet(row, field)))
+        return -1;
+
+    if (virStrToLong_ull(str, NULL, 10, val) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("malformed value '%s' of field '%s' in LVM report"),
+                       str, field);
+        return -1;
+    }
+
+    return 0;
+}
+
+
 static int
 virStorageBackendLogicalParseVolExtents(virStorageVolDefPtr vol,
-                                        char **const groups)
+                                        const char *const *fields)
 {
-    int nextents, ret = -1;
-    const char *regex_unit = "(\\S+)\\((\\S+)\\)";
-    char *regex = NULL;
-    regex_t *reg = NULL;
-    regmatch_t *vars = NULL;
-    char *p = NULL;
-    size_t i;
-    int err, nvars;
+    const char *segtype = fields[VIR_STORAGE_VOL_LOGICAL_FIELD_SEGTYPE];
+    const char *devices = fields[VIR_STORAGE_VOL_LOGICAL_FIELD_DEVICES];
+    int nextents;
     unsigned long long offset, size, length;
+    char **devs = NULL;
+    size_t ndevs = 0;
+    size_t i;
+    int ret = -1;
     virStorageVolSourceExtent extent;
 
     memset(&extent, 0, sizeof(extent));
 
-    /* Assume 1 extent (the regex for 'devices' is "(\\S+)") and only
-     * check the 'stripes' field if we have a striped, mirror, or one of
-     * the raid (raid1, raid4, raid5*, raid6*, or raid10) segtypes in which
-     * case the stripes field will denote the number of lv's within the
-     * 'devices' field in order to generate the proper regex to decode
-     * the field
+    /* Assume 1 extent and only check the 'stripes' field if we have a
+     * striped, mirror, or one of the raid (raid1, raid4, raid5*, raid6*,
+     * or raid10) segtypes in which case the stripes field will denote
+     * the number of lv's within the 'devices' field
      */
     nextents = 1;
-    if (STREQ(groups[4], VIR_STORAGE_VOL_LOGICAL_SEGTYPE_STRIPED) ||
-        STREQ(groups[4], VIR_STORAGE_VOL_LOGICAL_SEGTYPE_MIRROR) ||
-        STRPREFIX(groups[4], VIR_STORAGE_VOL_LOGICAL_SEGTYPE_RAID)) {
-        if (virStrToLong_i(groups[5], NULL, 10, &nextents) < 0) {
+    if (STREQ(segtype, VIR_STORAGE_VOL_LOGICAL_SEGTYPE_STRIPED) ||
+        STREQ(segtype, VIR_STORAGE_VOL_LOGICAL_SEGTYPE_MIRROR) ||
+        STRPREFIX(segtype, VIR_STORAGE_VOL_LOGICAL_SEGTYPE_RAID)) {
+        if (virStrToLong_i(fields[VIR_STORAGE_VOL_LOGICAL_FIELD_STRIPES],
+                           NULL, 10, &nextents) < 0 ||
+            nextents <= 0) {
             virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
                            _("malformed volume extent stripes value"));
-            goto cleanup;
+            return -1;
         }
     }
 
-    if (virStrToLong_ull(groups[6], NULL, 10, &length) < 0) {
+    if (virStrToLong_ull(fields[VIR_STORAGE_VOL_LOGICAL_FIELD_SEG_SIZE],
+                         NULL, 10, &length) < 0) {
         virReportError(VIR_ERR_INTERNAL_ERROR,
                        "%s", _("malformed volume extent length value"));
-        goto cleanup;
+        return -1;
     }
 
-    if (virStrToLong_ull(groups[7], NULL, 10, &size) < 0) {
+    if (virStrToLong_ull(fields[VIR_STORAGE_VOL_LOGICAL_FIELD_VG_EXTENT_SIZE],
+                         NULL, 10, &size) < 0) {
         virReportError(VIR_ERR_INTERNAL_ERROR,
                        "%s", _("malformed volume extent size value"));
-        goto cleanup;
-    }
-
-    /* Allocate space for 'nextents' regex_unit strings plus a comma for each */
-    if (VIR_ALLOC_N(regex, nextents * (strlen(regex_unit) + 1) + 1) < 0)
-        goto cleanup;
-    strcat(regex, regex_unit);
-    for (i = 1; i < nextents; i++) {
-        /* "," is the separator of "devices" field */
-        strcat(regex, ",");
-        strcat(regex, regex_unit);
+        return -1;
     }
 
-    if (VIR_ALLOC(reg) < 0)
-        goto cleanup;
-
-    /* Each extent has a "path:offset" pair, and vars[0] will
-     * be the whole matched string.
-     */
-    nvars = (nextents * 2) + 1;
-    if (VIR_ALLOC_N(vars, nvars) < 0)
-        goto cleanup;
-
-    err = regcomp(reg, regex, REG_EXTENDED);
-    if (err != 0) {
-        char error[100];
-        regerror(err, reg, error, sizeof(error));
-        virReportError(VIR_ERR_INTERNAL_ERROR,
-                       _("Failed to compile regex %s"),
-                       error);
+    /* "devices" is a comma separated list of "path(offset)" pairs */
+    if (!(devs = virStringSplitCount(devices, ",", 0, &ndevs)))
         goto cleanup;
-    }
 
-    err = regexec(reg, groups[3], nvars, vars, 0);
-    regfree(reg);
-    if (err != 0) {
+    if (ndevs < nextents) {
         virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
                        _("malformed volume extent devices value"));
         goto cleanup;
     }
 
-    p = groups[3];
-
-    /* vars[0] is skipped */
     for (i = 0; i < nextents; i++) {
-        size_t j;
-        int len;
-        char *offset_str = NULL;
-
-        j = (i * 2) + 1;
-        len = vars[j].rm_eo - vars[j].rm_so;
-        p[vars[j].rm_eo] = '\0';
+        char *start = strrchr(devs[i], '(');
+        char *end;
 
-        if (VIR_STRNDUP(extent.path,
-                        p + vars[j].rm_so, len) < 0)
+        if (!start || start == devs[i] ||
+            virStrToLong_ull(start + 1, &end, 10, &offset) < 0 ||
+            STRNEQ(end, ")")) {
+            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                           _("malformed volume extent devices value"));
             goto cleanup;
+        }
+        *start = '\0';
 
-        len = vars[j + 1].rm_eo - vars[j + 1].rm_so;
-        if (VIR_STRNDUP(offset_str, p + vars[j + 1].rm_so, len) < 0)
+        if (VIR_STRDUP(extent.path, devs[i]) < 0)
             goto cleanup;
 
-        if (virStrToLong_ull(offset_str, NULL, 10, &offset) < 0) {
-            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                           _("malformed volume extent offset value"));
-            VIR_FREE(offset_str);
-            goto cleanup;
-        }
-        VIR_FREE(offset_str);
         extent.start = offset * size;
         extent.end = (offset * size) + length;
 
@@ -253,28 +280,32 @@ virStorageBackendLogicalParseVolExtents(virStorageVolDefPtr vol,
     ret = 0;
 
  cleanup:
-    VIR_FREE(regex);
-    VIR_FREE(reg);
-    VIR_FREE(vars);
+    virStringListFree(devs);
     VIR_FREE(extent.path);
     return ret;
 }
 
 
+/*
+ * Add a segment described by @fields, indexed by
+ * VIR_STORAGE_VOL_LOGICAL_FIELD_*, to the volume it belongs to in
+ * @report, creating the volume on its first segment.
+ */
 static int
-virStorageBackendLogicalMakeVol(char **const groups,
-                                void *opaque)
+virStorageBackendLogicalReportAddSegment(virStorageBackendLogicalReportPtr report,
+                                         const char *targetPath,
+                                         const char *const *fields)
 {
-    struct virStorageBackendLogicalPoolVolData *data = opaque;
-    virStoragePoolObjPtr pool = data->pool;
-    virStoragePoolDefPtr def = virStoragePoolObjGetDef(pool);
+    const char *name = fields[VIR_STORAGE_VOL_LOGICAL_FIELD_NAME];
+    const char *origin = fields[VIR_STORAGE_VOL_LOGICAL_FIELD_ORIGIN];
+    const char *attrs = fields[VIR_STORAGE_VOL_LOGICAL_FIELD_LV_ATTR];
     virStorageVolDefPtr vol = NULL;
     bool is_new_vol = false;
+    size_t i;
     int ret = -1;
-    const char *attrs = groups[9];
 
     /* Skip inactive volume */
-    if (attrs[4] != 'a')
+    if (strlen(attrs) < 5 || attrs[4] != 'a')
         return 0;
 
     /*
@@ -285,92 +316,385 @@ virStorageBackendLogicalMakeVol(char **const groups,
     if (attrs[0] == 't')
         return 0;
 
-    /* See if we're only looking for a specific volume */
-    if (data->vol != NULL) {
-        vol = data->vol;
-        if (STRNEQ(vol->name, groups[0]))
-            return 0;
-    }
+    /* Segments which are not backed by any device (e.g. thin volumes)
+     * have no extents we could describe. */
+    if (STREQ(fields[VIR_STORAGE_VOL_LOGICAL_FIELD_DEVICES], ""))
+        return 0;
 
-    /* Or filling in more data on an existing volume */
-    if (vol == NULL)
-        vol = virStorageVolDefFindByName(pool, groups[0]);
+    /* NB can be multiple rows per volume if they have many extents,
+     * LVM reports them one after another */
+    for (i = report->nvols; i > 0; i--) {
+        if (STREQ(report->vols[i - 1]->name, name)) {
+            vol = report->vols[i - 1];
+            break;
+        }
+    }
 
-    /* Or a completely new volume */
-    if (vol == NULL) {
+    if (!vol) {
         if (VIR_ALLOC(vol) < 0)
             return -1;
 
         is_new_vol = true;
         vol->type = VIR_STORAGE_VOL_BLOCK;
 
-        if (VIR_STRDUP(vol->name, groups[0]) < 0)
+        if (VIR_STRDUP(vol->name, name) < 0 ||
+            VIR_STRDUP(vol->key, fields[VIR_STORAGE_VOL_LOGICAL_FIELD_UUID]) < 0)
             goto cleanup;
 
-    }
+        if (virAsprintf(&vol->target.path, "%s/%s", targetPath, name) < 0)
+            goto cleanup;
+
+        /* Mark the (s) sparse/snapshot lv, e.g. the lv created using
+         * the --virtualsize/-V option. We've already ignored the (t)hin
+         * pool definition. In the manner libvirt defines these, the
+         * thin pool is hidden to the lvs output, except as the name
+         * in brackets [] described for the origin (backingStore).
+         */
+        if (attrs[0] == 's')
+            vol->target.sparse = true;
+
+        /* Skips the backingStore of lv created with "--virtualsize",
+         * its original device "/dev/$vgname/$lvname_vorigin" is
+         * just for lvm internal use, one should never use it.
+         *
+         * (lvs outputs "[$lvname_vorigin] for field "origin" if the
+         *  lv is created with "--virtualsize").
+         */
+        if (origin && STRNEQ(origin, "") && origin[0] != '[') {
+            if (VIR_ALLOC(vol->target.backingStore) < 0)
+                goto cleanup;
+
+            if (virAsprintf(&vol->target.backingStore->path, "%s/%s",
+                            targetPath, origin) < 0)
+                goto cleanup;
+
+            vol->target.backingStore->format = VIR_STORAGE_POOL_LOGICAL_LVM2;
+            vol->target.backingStore->type = VIR_STORAGE_TYPE_BLOCK;
+        }
 
-    if (vol->target.path == NULL) {
-        if (virAsprintf(&vol->target.path, "%s/%s",
-                        def->target.path, vol->name) < 0)
+        if (virStrToLong_ull(fields[VIR_STORAGE_VOL_LOGICAL_FIELD_SIZE], NULL,
+                             10, &vol->target.allocation) < 0) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           "%s", _("malformed volume allocation value"));
             goto cleanup;
+        }
     }
 
-    /* Mark the (s) sparse/snapshot lv, e.g. the lv created using
-     * the --virtualsize/-V option. We've already ignored the (t)hin
-     * pool definition. In the manner libvirt defines these, the
-     * thin pool is hidden to the lvs output, except as the name
-     * in brackets [] described for the groups[1] (backingStore).
-     */
-    if (attrs[0] == 's')
-        vol->target.sparse = true;
+    if (virStorageBackendLogicalParseVolExtents(vol, fields) < 0)
+        goto cleanup;
 
-    /* Skips the backingStore of lv created with "--virtualsize",
-     * its original device "/dev/$vgname/$lvname_vorigin" is
-     * just for lvm internal use, one should never use it.
-     *
-     * (lvs outputs "[$lvname_vorigin] for field "origin" if the
-     *  lv is created with "--virtualsize").
-     */
-    if (groups[1] && STRNEQ(groups[1], "") && (groups[1][0] != '[')) {
-        if (VIR_ALLOC(vol->target.backingStore) < 0)
-            goto cleanup;
+    if (is_new_vol &&
+        VIR_APPEND_ELEMENT(report->vols, report->nvols, vol) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    if (is_new_vol)
+        virStorageVolDefFree(vol);
+    return ret;
+}
 
-        if (virAsprintf(&vol->target.backingStore->path, "%s/%s",
-                        def->target.path, groups[1]) < 0)
-            goto cleanup;
 
-        vol->target.backingStore->format = VIR_STORAGE_POOL_LOGICAL_LVM2;
-        vol->target.backingStore->type = VIR_STORAGE_TYPE_BLOCK;
+static int
+virStorageBackendLogicalParseReportRow(virJSONValuePtr row,
+                                       const char *targetPath,
+                                       virStorageBackendLogicalReportPtr report)
+{
+    const char *fields[VIR_STORAGE_VOL_LOGICAL_FIELD_LAST];
+    size_t i;
+
+    /* Every row carries the volume group stats, whether it describes
+     * a volume group or a segment of one of its logical volumes. */
+    if (!report->haveVGStats) {
+        if (virStorageBackendLogicalReportGetULL(row, "vg_size",
+                                                 &report->vgSize) < 0 ||
+            virStorageBackendLogicalReportGetULL(row, "vg_free",
+                                                 &report->vgFree) < 0)
+            return -1;
+        report->haveVGStats = true;
     }
 
-    if (!vol->key && VIR_STRDUP(vol->key, groups[2]) < 0)
+    /* Plain vgs row */
+    if (virJSONValueObjectHasKey(row, "lv_name") != 1)
+        return 0;
+
+    for (i = 0; i < VIR_STORAGE_VOL_LOGICAL_FIELD_LAST; i++) {
+        const char *key = virStorageBackendLogicalJSONFields[i];
+
+        if (i == VIR_STORAGE_VOL_LOGICAL_FIELD_ORIGIN)
+            fields[i] = virJSONValueObjectGetString(row, key);
+        else if (!(fields[i] = virStorageBackendLogicalReportGet(row, key)))
+            return -1;
+    }
+
+    return virStorageBackendLogicalReportAddSegment(report, targetPath,
+                                                    fields);
+}
+
+
+/**
+ * virStorageBackendLogicalParseReport:
+ * @output: JSON formatted output of lvs or vgs
+ * @targetPath: target path of the pool the volumes belong to
+ * @report: report to fill in
+ *
+ * Parse the output of "lvs --reportformat json" (or "vgs") into a list
+ * of volume definitions and the volume group stats. Rows belonging to
+ * the same logical volume are merged into one definition holding all of
+ * its extents. Inactive volumes and thin pools are skipped. Volumes are
+ * not probed on the host, that is up to the caller.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virStorageBackendLogicalParseReport(const char *output,
+                                    const char *targetPath,
+                                    virStorageBackendLogicalReportPtr report)
+{
+    /* Depending on the requested fields LVM names the rows after the
+     * seg, lv or vg report type */
+    const char *types[] = { "seg", "lv", "vg" };
+    virJSONValuePtr json = NULL;
+    virJSONValuePtr reports;
+    size_t i, j, k;
+    int ret = -1;
+
+    if (!(json = virJSONValueFromString(output)))
         goto cleanup;
 
-    if (virStorageBackendUpdateVolInfo(vol, false,
-                                       VIR_STORAGE_VOL_OPEN_DEFAULT, 0) < 0)
+    if (!(reports = virJSONValueObjectGetArray(json, "report"))) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("missing 'report' array in LVM output"));
         goto cleanup;
+    }
 
-    if (virStrToLong_ull(groups[8], NULL, 10, &vol->target.allocation) < 0) {
-        virReportError(VIR_ERR_INTERNAL_ERROR,
-                       "%s", _("malformed volume allocation value"));
+    for (i = 0; i < virJSONValueArraySize(reports); i++) {
+        virJSONValuePtr item = virJSONValueArrayGet(reports, i);
+
+        for (j = 0; j < ARRAY_CARDINALITY(types); j++) {
+            virJSONValuePtr rows = virJSONValueObjectGetArray(item, types[j]);
+
+            if (!rows)
+                continue;
+
+            for (k = 0; k < virJSONValueArraySize(rows); k++) {
+                if (virStorageBackendLogicalParseReportRow(virJSONValueArrayGet(rows, k),
+                                                           targetPath,
+                                                           report) < 0)
+                    goto cleanup;
+            }
+        }
+    }
+
+    ret = 0;
+
+ cleanup:
+    virJSONValueFree(json);
+    return ret;
+}
+
+
+void
+virStorageBackendLogicalReportClear(virStorageBackendLogicalReportPtr report)
+{
+    size_t i;
+
+    for (i = 0; i < report->nvols; i++)
+        virStorageVolDefFree(report->vols[i]);
+    VIR_FREE(report->vols);
+    memset(report, 0, sizeof(*report));
+}
+
+
+/*
+ * Whether the installed lvm2 is able to produce JSON reports. Probed by
+ * running "lvs --reportformat json" once, older versions reject the
+ * unknown option. Any other failure, such as a VG being locked, only
+ * means the plain report is used this time and lvm is probed again.
+ */
+static bool
+virStorageBackendLogicalHaveJSONReport(void)
+{
+    int have = virAtomicIntGet(&virStorageBackendLogicalJSONReport);
+    virCommandPtr cmd;
+    char *errbuf = NULL;
+    int status;
+
+    if (have >= 0)
+        return have == 1;
+
+    cmd = virCommandNewArgList(LVS,
+                               "--reportformat", "json",
+                               "--options", "lv_name",
+                               NULL);
+    virCommandSetErrorBuffer(cmd, &errbuf);
+
+    if (virCommandRun(cmd, &status) < 0) {
+        /* Not knowing is not fatal, the plain report will likely fail
+         * the same way and report the error then */
+        virResetLastError();
         goto cleanup;
     }
 
-    if (virStorageBackendLogicalParseVolExtents(vol, groups) < 0)
+    if (status == 0) {
+        have = 1;
+    } else if (errbuf && strstr(errbuf, "reportformat")) {
+        /* "unrecognized option '--reportformat'" */
+        have = 0;
+    } else {
+        VIR_DEBUG("Unable to probe JSON report support of lvm: %s",
+                  NULLSTR(errbuf));
         goto cleanup;
+    }
+
+    VIR_DEBUG("JSON reports %s by lvm", have ? "supported" : "not supported");
+    virAtomicIntSet(&virStorageBackendLogicalJSONReport, have);
 
-    if (is_new_vol && virStoragePoolObjAddVol(pool, vol) < 0)
+ cleanup:
+    virCommandFree(cmd);
+    VIR_FREE(errbuf);
+    return have == 1;
+}
+
+
+/**
+ * virStorageBackendLogicalResetJSONReport:
+ *
+ * Forget whether lvm supports JSON reports, so that it is probed again
+ * next time a report is needed.
+ */
+void
+virStorageBackendLogicalResetJSONReport(void)
+{
+    virAtomicIntSet(&virStorageBackendLogicalJSONReport, -1);
+}
+
+
+static int
+virStorageBackendLogicalRunReport(virCommandPtr cmd,
+                                  const char *targetPath,
+                                  virStorageBackendLogicalReportPtr report)
+{
+    char *output = NULL;
+    int ret = -1;
+
+    virCommandSetOutputBuffer(cmd, &output);
+
+    if (virCommandRun(cmd, NULL) < 0)
         goto cleanup;
-    vol = NULL;
+
+    ret = virStorageBackendLogicalParseReport(output, targetPath, report);
+
+ cleanup:
+    VIR_FREE(output);
+    return ret;
+}
+
+
+static int
+virStorageBackendLogicalGetJSONReport(const char *vgname,
+                                      const char *lvname,
+                                      const char *targetPath,
+                                      virStorageBackendLogicalReportPtr report)
+{
+    /*
+     * # lvs --reportformat json --units b --nosuffix --options \
+     *   "lv_name,origin,lv_uuid,devices,segtype,stripes,seg_size,vg_extent_size,lv_size,lv_attr,vg_size,vg_free" VGNAME
+     *
+     * {
+     *   "report": [
+     *     {
+     *       "seg": [
+     *         {"lv_name":"test_stripes", "origin":"", "lv_uuid":"fSLSZH-zAS2-yAIb-n4mV-Al9u-HA3V-oo9K1B",
+     *          "devices":"/dev/sdc1(10240),/dev/sdd1(0)", "segtype":"striped", "stripes":"2",
+     *          "seg_size":"42949672960", "vg_extent_size":"4194304", "lv_size":"42949672960",
+     *          "lv_attr":"-wi-a-----", "vg_size":"10603200512", "vg_free":"4328521728"},
+     *         ...
+     *       ]
+     *     }
+     *   ]
+     * }
+     *
+     * Every segment is reported in a row of its own, all of them carry
+     * the volume group stats, so a single call is enough to refresh the
+     * whole pool. The JSON output is unaffected by the characters which
+     * made every separator unsuitable for the plain output (':' in names
+     * of encrypted volumes, ',' in the "devices" field).
+     */
+    virCommandPtr cmd = NULL;
+    int ret = -1;
+
+    cmd = virCommandNewArgList(LVS,
+                               "--reportformat", "json",
+                               "--units", "b",
+                               "--nosuffix",
+                               "--options",
+                               VIR_STORAGE_VOL_LOGICAL_REPORT_FIELDS,
+                               NULL);
+    if (lvname)
+        virCommandAddArgFormat(cmd, "%s/%s", vgname, lvname);
+    else
+        virCommandAddArg(cmd, vgname);
+
+    if (virStorageBackendLogicalRunReport(cmd, targetPath, report) < 0)
+        goto cleanup;
+
+    /* A volume group without any logical volume yields no rows */
+    if (!lvname && !report->haveVGStats) {
+        virCommandFree(cmd);
+        cmd = virCommandNewArgList(VGS,
+                                   "--reportformat", "json",
+                                   "--units", "b",
+                                   "--nosuffix",
+                                   "--options", "vg_size,vg_free",
+                                   vgname,
+                                   NULL);
+
+        if (virStorageBackendLogicalRunReport(cmd, targetPath, report) < 0)
+            goto cleanup;
+    }
 
     ret = 0;
 
  cleanup:
-    if (is_new_vol)
-        virStorageVolDefFree(vol);
+    virCommandFree(cmd);
     return ret;
 }
 
+
+struct virStorageBackendLogicalLegacyData {
+    virStorageBackendLogicalReportPtr report;
+    const char *targetPath;
+};
+
+static int
+virStorageBackendLogicalMakeVol(char **const groups,
+                                void *opaque)
+{
+    struct virStorageBackendLogicalLegacyData *data = opaque;
+
+    return virStorageBackendLogicalReportAddSegment(data->report,
+                                                    data->targetPath,
+                                                    (const char *const *)groups);
+}
+
+
+static int
+virStorageBackendLogicalMakeVGStats(char **const groups,
+                                    void *opaque)
+{
+    struct virStorageBackendLogicalLegacyData *data = opaque;
+    virStorageBackendLogicalReportPtr report = data->report;
+
+    if (virStrToLong_ull(groups[0], NULL, 10, &report->vgSize) < 0 ||
+        virStrToLong_ull(groups[1], NULL, 10, &report->vgFree) < 0)
+        return -1;
+    report->haveVGStats = true;
+
+    return 0;
+}
+
 #define VIR_STORAGE_VOL_LOGICAL_PREFIX_REGEX "^\\s*"
 #define VIR_STORAGE_VOL_LOGICAL_LV_NAME_REGEX "(\\S+)#"
 #define VIR_STORAGE_VOL_LOGICAL_ORIGIN_REGEX "(\\S*)#"
@@ -384,7 +708,7 @@ virStorageBackendLogicalMakeVol(char **const groups,
 #define VIR_STORAGE_VOL_LOGICAL_LV_ATTR_REGEX "(\\S+)#"
 #define VIR_STORAGE_VOL_LOGICAL_SUFFIX_REGEX "?\\s*$"
 
-#define VIR_STORAGE_VOL_LOGICAL_REGEX_COUNT 10
+#define VIR_STORAGE_VOL_LOGICAL_REGEX_COUNT VIR_STORAGE_VOL_LOGICAL_FIELD_LAST
 #define VIR_STORAGE_VOL_LOGICAL_REGEX \
            VIR_STORAGE_VOL_LOGICAL_PREFIX_REGEX \
            VIR_STORAGE_VOL_LOGICAL_LV_NAME_REGEX \
@@ -400,8 +724,10 @@ virStorageBackendLogicalMakeVol(char **const groups,
            VIR_STORAGE_VOL_LOGICAL_SUFFIX_REGEX
 
 static int
-virStorageBackendLogicalFindLVs(virStoragePoolObjPtr pool,
-                                virStorageVolDefPtr vol)
+virStorageBackendLogicalGetLegacyReport(const char *vgname,
+                                        const char *lvname,
+                                        const char *targetPath,
+                                        virStorageBackendLogicalReportPtr report)
 {
     /*
      * # lvs --separator # --noheadings --units b --unbuffered --nosuffix --options \
@@ -434,13 +760,26 @@ virStorageBackendLogicalFindLVs(virStoragePoolObjPtr pool,
     int vars[] = {
         VIR_STORAGE_VOL_LOGICAL_REGEX_COUNT
     };
-    int ret = -1;
-    virCommandPtr cmd;
-    virStoragePoolDefPtr def = virStoragePoolObjGetDef(pool);
-    struct virStorageBackendLogicalPoolVolData cbdata = {
-        .pool = pool,
-        .vol = vol,
+    /*
+     *  # vgs --separator : --noheadings --units b --unbuffered --nosuffix --options "vg_size,vg_free" VGNAME
+     *    10603200512:4328521728
+     *
+     * Pull out size & free
+     *
+     * NB vgs from some distros (e.g. SLES10 SP2) outputs trailing ":" on each line
+     */
+    const char *vgregexes[] = {
+        "^\\s*(\\S+):([0-9]+):?\\s*$"
+    };
+    int vgvars[] = {
+        2
     };
+    struct virStorageBackendLogicalLegacyData data = {
+        .report = report,
+        .targetPath = targetPath,
+    };
+    virCommandPtr cmd = NULL;
+    int ret = -1;
 
     cmd = virCommandNewArgList(LVS,
                                "--separator", "#",
@@ -450,41 +789,195 @@ virStorageBackendLogicalFindLVs(virStoragePoolObjPtr pool,
                                "--nosuffix",
                                "--options",
                                "lv_name,origin,uuid,devices,segtype,stripes,seg_size,vg_extent_size,size,lv_attr",
-                               def->source.name,
                                NULL);
+    if (lvname)
+        virCommandAddArgFormat(cmd, "%s/%s", vgname, lvname);
+    else
+        virCommandAddArg(cmd, vgname);
+
     if (virCommandRunRegex(cmd,
                            1,
                            regexes,
                            vars,
                            virStorageBackendLogicalMakeVol,
-                           &cbdata,
+                           &data,
                            "lvs",
                            NULL) < 0)
         goto cleanup;
 
+    if (!lvname) {
+        virCommandFree(cmd);
+        cmd = virCommandNewArgList(VGS,
+                                   "--separator", ":",
+                                   "--noheadings",
+                                   "--units", "b",
+                                   "--unbuffered",
+                                   "--nosuffix",
+                                   "--options", "vg_size,vg_free",
+                                   vgname,
+                                   NULL);
+
+        /* Now get basic volgrp metadata */
+        if (virCommandRunRegex(cmd,
+                               1,
+                               vgregexes,
+                               vgvars,
+                               virStorageBackendLogicalMakeVGStats,
+                               &data,
+                               "vgs",
+                               NULL) < 0)
+            goto cleanup;
+    }
+
     ret = 0;
+
  cleanup:
     virCommandFree(cmd);
     return ret;
 }
 
-static int
-virStorageBackendLogicalRefreshPoolFunc(char **const groups,
-                                        void *data)
+
+/**
+ * virStorageBackendLogicalGetReport:
+ * @vgname: name of the volume group
+ * @lvname: name of a single logical volume to report, or NULL
+ * @targetPath: target path of the pool the volumes belong to
+ * @report: report to fill in
+ *
+ * Ask LVM about the volume @lvname of @vgname, or about all volumes of
+ * @vgname along with the volume group stats if @lvname is NULL. JSON
+ * reports are used if the installed lvm2 supports them, the plain
+ * separated output is parsed otherwise.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virStorageBackendLogicalGetReport(const char *vgname,
+                                  const char *lvname,
+                                  const char *targetPath,
+                                  virStorageBackendLogicalReportPtr report)
 {
-    virStoragePoolObjPtr pool = data;
-    virStoragePoolDefPtr def = virStoragePoolObjGetDef(pool);
+    int ret;
 
-    if (virStrToLong_ull(groups[0], NULL, 10, &def->capacity) < 0)
+    if (virStorageBackendLogicalHaveJSONReport())
+        ret = virStorageBackendLogicalGetJSONReport(vgname, lvname,
+                                                    targetPath, report);
+    else
+        ret = virStorageBackendLogicalGetLegacyReport(vgname, lvname,
+                                                      targetPath, report);
+    if (ret < 0)
         return -1;
-    if (virStrToLong_ull(groups[1], NULL, 10, &def->available) < 0)
+
+    if (!lvname && !report->haveVGStats) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("no stats reported for volume group '%s'"),
+                       vgname);
         return -1;
-    def->allocation = def->capacity - def->available;
+    }
 
     return 0;
 }
 
 
+/*
+ * Fill @vol with what LVM reported in @lv, stealing as much as possible.
+ */
+static void
+virStorageBackendLogicalUpdateVol(virStorageVolDefPtr vol,
+                                  virStorageVolDefPtr lv)
+{
+    size_t i;
+
+    if (!vol->target.path)
+        VIR_STEAL_PTR(vol->target.path, lv->target.path);
+
+    if (!vol->key)
+        VIR_STEAL_PTR(vol->key, lv->key);
+
+    if (lv->target.backingStore) {
+        virStorageSourceFree(vol->target.backingStore);
+        VIR_STEAL_PTR(vol->target.backingStore, lv->target.backingStore);
+    }
+
+    vol->target.sparse = lv->target.sparse;
+    vol->target.allocation = lv->target.allocation;
+
+    for (i = 0; i < vol->source.nextent; i++)
+        VIR_FREE(vol->source.extents[i].path);
+    VIR_FREE(vol->source.extents);
+    VIR_STEAL_PTR(vol->source.extents, lv->source.extents);
+    vol->source.nextent = lv->source.nextent;
+    lv->source.nextent = 0;
+}
+
+
+/*
+ * Query LVM about either a single volume @vol, or all volumes of @pool
+ * when @vol is NULL. In the latter case the pool's capacity and
+ * allocation are updated too.
+ */
+static int
+virStorageBackendLogicalFindLVs(virStoragePoolObjPtr pool,
+                                virStorageVolDefPtr vol)
+{
+    virStoragePoolDefPtr def = virStoragePoolObjGetDef(pool);
+    virStorageBackendLogicalReport report;
+    size_t i;
+    int ret = -1;
+
+    memset(&report, 0, sizeof(report));
+
+    if (virStorageBackendLogicalGetReport(def->source.name,
+                                          vol ? vol->name : NULL,
+                                          def->target.path, &report) < 0)
+        goto cleanup;
+
+    for (i = 0; i < report.nvols; i++) {
+        virStorageVolDefPtr lv = report.vols[i];
+        virStorageVolDefPtr cur;
+
+        if (vol) {
+            if (STRNEQ(vol->name, lv->name))
+                continue;
+            cur = vol;
+        } else {
+            cur = virStorageVolDefFindByName(pool, lv->name);
+        }
+
+        if (cur) {
+            virStorageBackendLogicalUpdateVol(cur, lv);
+        } else {
+            cur = lv;
+            report.vols[i] = NULL;
+        }
+
+        if (virStorageBackendUpdateVolInfo(cur, false,
+                                           VIR_STORAGE_VOL_OPEN_DEFAULT, 0) < 0) {
+            if (cur == lv)
+                virStorageVolDefFree(lv);
+            goto cleanup;
+        }
+
+        if (cur == lv && virStoragePoolObjAddVol(pool, lv) < 0) {
+            virStorageVolDefFree(lv);
+            goto cleanup;
+        }
+    }
+
+    if (!vol) {
+        def->capacity = report.vgSize;
+        def->available = report.vgFree;
+        def->allocation = def->capacity - def->available;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virStorageBackendLogicalReportClear(&report);
+    return ret;
+}
+
+
 static int
 virStorageBackendLogicalFindPoolSourcesFunc(char **const groups,
                                             void *data)
@@ -798,60 +1291,23 @@ virStorageBackendLogicalBuildPool(virStoragePoolObjPtr pool,
 static int
 virStorageBackendLogicalRefreshPool(virStoragePoolObjPtr pool)
 {
-    /*
-     *  # vgs --separator : --noheadings --units b --unbuffered --nosuffix --options "vg_size,vg_free" VGNAME
-     *    10603200512:4328521728
-     *
-     * Pull out size & free
-     *
-     * NB vgs from some distros (e.g. SLES10 SP2) outputs trailing ":" on each line
-     */
-    const char *regexes[] = {
-        "^\\s*(\\S+):([0-9]+):?\\s*$"
-    };
-    int vars[] = {
-        2
-    };
-    virStoragePoolDefPtr def = virStoragePoolObjGetDef(pool);
-    virCommandPtr cmd = NULL;
     int ret = -1;
 
     virWaitForDevices();
 
-    /* Get list of all logical volumes */
+    /* Get list of all logical volumes along with basic volgrp metadata */
     if (virStorageBackendLogicalFindLVs(pool, NULL) < 0)
         goto cleanup;
 
-    cmd = virCommandNewArgList(VGS,
-                               "--separator", ":",
-                               "--noheadings",
-                               "--units", "b",
-                               "--unbuffered",
-                               "--nosuffix",
-                               "--options", "vg_size,vg_free",
-                               def->source.name,
-                               NULL);
-
-    /* Now get basic volgrp metadata */
-    if (virCommandRunRegex(cmd,
-                           1,
-                           regexes,
-                           vars,
-                           virStorageBackendLogicalRefreshPoolFunc,
-                           pool,
-                           "vgs",
-                           NULL) < 0)
-        goto cleanup;
-
     ret = 0;
 
  cleanup:
-    virCommandFree(cmd);
     if (ret < 0)
         virStoragePoolObjClearVols(pool);
     return ret;
 }
 
+
 /*
  * This is actually relatively safe; if you happen to try to "stop" the
  * pool that your / is on, for instance, you will get failure like:
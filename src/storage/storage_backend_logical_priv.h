@@ -0,0 +1,46 @@
+/*
+ * storage_backend_logical_priv.h: header for functions necessary in tests
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __VIR_STORAGE_BACKEND_LOGICAL_PRIV_H__
+# define __VIR_STORAGE_BACKEND_LOGICAL_PRIV_H__
+
+# include "conf/storage_conf.h"
+
+typedef struct _virStorageBackendLogicalReport virStorageBackendLogicalReport;
+typedef virStorageBackendLogicalReport *virStorageBackendLogicalReportPtr;
+struct _virStorageBackendLogicalReport {
+    bool haveVGStats;
+    unsigned long long vgSize;
+    unsigned long long vgFree;
+
+    size_t nvols;
+    virStorageVolDefPtr *vols;
+};
+
+int virStorageBackendLogicalParseReport(const char *output,
+                                        const char *targetPath,
+                                        virStorageBackendLogicalReportPtr report);
+int virStorageBackendLogicalGetReport(const char *vgname,
+                                      const char *lvname,
+                                      const char *targetPath,
+                                      virStorageBackendLogicalReportPtr report);
+void virStorageBackendLogicalReportClear(virStorageBackendLogicalReportPtr report);
+
+void virStorageBackendLogicalResetJSONReport(void);
+
+#endif /* __VIR_STORAGE_BACKEND_LOGICAL_PRIV_H__ */
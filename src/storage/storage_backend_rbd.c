@@ -33,6 +33,8 @@
 #include "base64.h"
 #include "viruuid.h"
 #include "virstring.h"
+#include "virthread.h"
+#include "virhash.h"
 #include "virrandom.h"
 #include "rados/librados.h"
 #include "rbd/librbd.h"
@@ -43,15 +45,56 @@
 
 VIR_LOG_INIT("storage.storage_backend_rbd");
 
+/* Pooled connections which were idle for longer than this many seconds
+ * are checked to be still usable before being handed out again */
+#define VIR_STORAGE_RBD_STATE_CHECK_INTERVAL 60
+
 struct _virStorageBackendRBDState {
+    virObject parent;
+
     rados_t cluster;
     rados_ioctx_t ioctx;
     time_t starttime;
+
+    /* The rest is protected by virStorageBackendRBDStatesLock */
+    char *fingerprint; /* pool configuration the connection was made for */
+    time_t lastused;
+    bool broken;
 };
 
 typedef struct _virStorageBackendRBDState virStorageBackendRBDState;
 typedef virStorageBackendRBDState *virStorageBackendRBDStatePtr;
 
+static virClassPtr virStorageBackendRBDStateClass;
+static void virStorageBackendRBDStateDispose(void *obj);
+
+/* Connections kept open for active pools, keyed by pool UUID */
+static virHashTablePtr virStorageBackendRBDStates;
+static virMutex virStorageBackendRBDStatesLock;
+
+static int
+virStorageBackendRBDStateOnceInit(void)
+{
+    if (!(virStorageBackendRBDStateClass = virClassNew(virClassForObject(),
+                                                       "virStorageBackendRBDState",
+                                                       sizeof(virStorageBackendRBDState),
+                                                       virStorageBackendRBDStateDispose)))
+        return -1;
+
+    if (virMutexInit(&virStorageBackendRBDStatesLock) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("unable to initialize RBD connection lock"));
+        return -1;
+    }
+
+    if (!(virStorageBackendRBDStates = virHashCreate(10, virObjectFreeHashData)))
+        return -1;
+
+    return 0;
+}
+
+VIR_ONCE_GLOBAL_INIT(virStorageBackendRBDState)
+
 static int
 virStorageBackendRBDRADOSConfSet(rados_t cluster,
                                  const char *option,
@@ -238,14 +281,57 @@ virStorageBackendRBDCloseRADOSConn(virStorageBackendRBDStatePtr ptr)
 
 
 static void
-virStorageBackendRBDFreeState(virStorageBackendRBDStatePtr *ptr)
+virStorageBackendRBDStateDispose(void *obj)
 {
-    if (!*ptr)
-        return;
+    virStorageBackendRBDStatePtr ptr = obj;
+
+    virStorageBackendRBDCloseRADOSConn(ptr);
+    VIR_FREE(ptr->fingerprint);
+}
 
-    virStorageBackendRBDCloseRADOSConn(*ptr);
 
-    VIR_FREE(*ptr);
+static void
+virStorageBackendRBDReleaseState(virStorageBackendRBDStatePtr *ptr)
+{
+    virObjectUnref(*ptr);
+    *ptr = NULL;
+}
+
+
+/*
+ * Describes everything a RADOS connection depends on, so that a pooled
+ * connection is not reused once the pool was redefined differently.
+ */
+static char *
+virStorageBackendRBDStateFingerprint(virStoragePoolDefPtr def)
+{
+    virBuffer buf = VIR_BUFFER_INITIALIZER;
+    virStorageAuthDefPtr authdef = def->source.auth;
+    char uuidstr[VIR_UUID_STRING_BUFLEN];
+    size_t i;
+
+    virBufferAsprintf(&buf, "pool=%s", def->source.name);
+
+    if (authdef) {
+        virBufferAsprintf(&buf, " user=%s", NULLSTR(authdef->username));
+        if (authdef->seclookupdef.type == VIR_SECRET_LOOKUP_TYPE_UUID) {
+            virUUIDFormat(authdef->seclookupdef.u.uuid, uuidstr);
+            virBufferAsprintf(&buf, " secret=%s", uuidstr);
+        } else {
+            virBufferAsprintf(&buf, " usage=%s",
+                              NULLSTR(authdef->seclookupdef.u.usage));
+        }
+    }
+
+    for (i = 0; i < def->source.nhost; i++)
+        virBufferAsprintf(&buf, " mon=%s:%d",
+                          NULLSTR(def->source.hosts[i].name),
+                          def->source.hosts[i].port);
+
+    if (virBufferCheckError(&buf) < 0)
+        return NULL;
+
+    return virBufferContentAndReset(&buf);
 }
 
 
@@ -255,9 +341,15 @@ virStorageBackendRBDNewState(virStoragePoolObjPtr pool)
     virStorageBackendRBDStatePtr ptr;
     virStoragePoolDefPtr def = virStoragePoolObjGetDef(pool);
 
-    if (VIR_ALLOC(ptr) < 0)
+    if (virStorageBackendRBDStateInitialize() < 0)
         return NULL;
 
+    if (!(ptr = virObjectNew(virStorageBackendRBDStateClass)))
+        return NULL;
+
+    if (!(ptr->fingerprint = virStorageBackendRBDStateFingerprint(def)))
+        goto error;
+
     if (virStorageBackendRBDOpenRADOSConn(ptr, &def->source) < 0)
         goto error;
 
@@ -267,11 +359,125 @@ virStorageBackendRBDNewState(virStoragePoolObjPtr pool)
     return ptr;
 
  error:
-    virStorageBackendRBDFreeState(&ptr);
+    virStorageBackendRBDReleaseState(&ptr);
     return NULL;
 }
 
 
+/*
+ * Marks the connection as unusable, it is replaced by a new one the next
+ * time the pool needs one.
+ */
+static void
+virStorageBackendRBDStateSetBroken(virStorageBackendRBDStatePtr ptr)
+{
+    virMutexLock(&virStorageBackendRBDStatesLock);
+    ptr->broken = true;
+    virMutexUnlock(&virStorageBackendRBDStatesLock);
+}
+
+
+/**
+ * virStorageBackendRBDGetState:
+ * @pool: storage pool object
+ *
+ * Returns a reference to the RADOS connection of @pool, opening one
+ * if there is none yet or the one in use became unusable. Connecting,
+ * reading the configuration and authenticating is expensive, so the
+ * connection is kept open until the pool is stopped.
+ *
+ * Returns the connection which has to be released by
+ * virStorageBackendRBDReleaseState(), NULL on error.
+ */
+static virStorageBackendRBDStatePtr
+virStorageBackendRBDGetState(virStoragePoolObjPtr pool)
+{
+    virStoragePoolDefPtr def = virStoragePoolObjGetDef(pool);
+    virStorageBackendRBDStatePtr ptr = NULL;
+    char uuidstr[VIR_UUID_STRING_BUFLEN];
+    char *fingerprint = NULL;
+    struct rados_cluster_stat_t clusterstat;
+    bool check = false;
+    time_t now = time(NULL);
+
+    if (virStorageBackendRBDStateInitialize() < 0)
+        return NULL;
+
+    if (!(fingerprint = virStorageBackendRBDStateFingerprint(def)))
+        return NULL;
+
+    virUUIDFormat(def->uuid, uuidstr);
+
+    virMutexLock(&virStorageBackendRBDStatesLock);
+    if ((ptr = virHashLookup(virStorageBackendRBDStates, uuidstr))) {
+        if (ptr->broken || STRNEQ(ptr->fingerprint, fingerprint)) {
+            ptr = NULL;
+        } else {
+            check = now - ptr->lastused >= VIR_STORAGE_RBD_STATE_CHECK_INTERVAL;
+            ptr->lastused = now;
+            virObjectRef(ptr);
+        }
+    }
+    virMutexUnlock(&virStorageBackendRBDStatesLock);
+
+    /* A cheap monitor round trip tells whether a connection which was
+     * not used for a while survived e.g. a restart of the cluster */
+    if (ptr && check && rados_cluster_stat(ptr->cluster, &clusterstat) < 0) {
+        VIR_DEBUG("RADOS connection of pool %s is not usable anymore",
+                  def->name);
+        virStorageBackendRBDStateSetBroken(ptr);
+        virStorageBackendRBDReleaseState(&ptr);
+    }
+
+    if (ptr) {
+        VIR_DEBUG("Reusing RADOS connection of pool %s", def->name);
+        goto cleanup;
+    }
+
+    VIR_DEBUG("Opening new RADOS connection for pool %s", def->name);
+
+    if (!(ptr = virStorageBackendRBDNewState(pool)))
+        goto cleanup;
+
+    ptr->lastused = now;
+
+    virMutexLock(&virStorageBackendRBDStatesLock);
+    if (virHashUpdateEntry(virStorageBackendRBDStates, uuidstr, ptr) < 0) {
+        /* The connection is still usable for this one operation */
+        VIR_WARN("Failed to remember RADOS connection of pool %s",
+                 def->name);
+    } else {
+        virObjectRef(ptr);
+    }
+    virMutexUnlock(&virStorageBackendRBDStatesLock);
+
+ cleanup:
+    VIR_FREE(fingerprint);
+    return ptr;
+}
+
+
+/*
+ * Closes the connection of @pool once the last operation using it is
+ * finished.
+ */
+static void
+virStorageBackendRBDDropState(virStoragePoolObjPtr pool)
+{
+    virStoragePoolDefPtr def = virStoragePoolObjGetDef(pool);
+    char uuidstr[VIR_UUID_STRING_BUFLEN];
+
+    if (virStorageBackendRBDStateInitialize() < 0)
+        return;
+
+    virUUIDFormat(def->uuid, uuidstr);
+
+    virMutexLock(&virStorageBackendRBDStatesLock);
+    virHashRemoveEntry(virStorageBackendRBDStates, uuidstr);
+    virMutexUnlock(&virStorageBackendRBDStatesLock);
+}
+
+
 static int
 volStorageBackendRBDGetFeatures(rbd_image_t image,
                                 const char *volname,
@@ -365,14 +571,14 @@ volStorageBackendRBDRefreshVolInfo(virStorageVolDefPtr vol,
     uint64_t features;
 
     if ((r = rbd_open_read_only(ptr->ioctx, vol->name, &image, NULL)) < 0) {
-        ret = -r;
+        ret = r;
         virReportSystemError(-r, _("failed to open the RBD image '%s'"),
                              vol->name);
         goto cleanup;
     }
 
     if ((r = rbd_stat(image, &info, sizeof(info))) < 0) {
-        ret = -r;
+        ret = r;
         virReportSystemError(-r, _("failed to stat the RBD image '%s'"),
                              vol->name);
         goto cleanup;
@@ -419,6 +625,144 @@ volStorageBackendRBDRefreshVolInfo(virStorageVolDefPtr vol,
     return ret;
 }
 
+/* Minimal number of images to query per worker thread and maximal
+ * number of worker threads querying images during pool refresh */
+#define VIR_STORAGE_RBD_REFRESH_MIN_IMAGES 16
+#define VIR_STORAGE_RBD_REFRESH_MAX_WORKERS 8
+
+typedef struct _virStorageBackendRBDRefreshWorker virStorageBackendRBDRefreshWorker;
+typedef virStorageBackendRBDRefreshWorker *virStorageBackendRBDRefreshWorkerPtr;
+struct _virStorageBackendRBDRefreshWorker {
+    virThread thread;
+    bool started;
+
+    virStoragePoolObjPtr pool;
+    virStorageBackendRBDStatePtr ptr;
+
+    /* arrays shared by all workers, each one processing entries
+     * @first, @first + @step, @first + 2 * @step, ... */
+    virStorageVolDefPtr *vols;
+    int *results;
+    size_t nvols;
+    size_t first;
+    size_t step;
+
+    /* error of the first image failing to be queried */
+    virErrorPtr error;
+};
+
+
+/* It could be that a volume has been deleted through a different route
+ * then libvirt and that will cause a -ENOENT to be returned.
+ *
+ * Another possibility is that there is something wrong with the placement
+ * group (PG) that RBD image's header is in and that causes -ETIMEDOUT
+ * to be returned.
+ *
+ * Do not error out and simply ignore the volume
+ */
+#define VIR_STORAGE_RBD_IGNORE_VOL_ERROR(r) \
+    ((r) == -ENOENT || (r) == -ETIMEDOUT)
+
+
+static void
+virStorageBackendRBDRefreshWorkerRun(void *opaque)
+{
+    virStorageBackendRBDRefreshWorkerPtr worker = opaque;
+    size_t i;
+    int r;
+
+    for (i = worker->first; i < worker->nvols; i += worker->step) {
+        r = volStorageBackendRBDRefreshVolInfo(worker->vols[i],
+                                               worker->pool, worker->ptr);
+        worker->results[i] = r;
+
+        if (r < 0 && !VIR_STORAGE_RBD_IGNORE_VOL_ERROR(r)) {
+            worker->error = virSaveLastError();
+            break;
+        }
+    }
+}
+
+
+/*
+ * Queries all images in @vols. Every query needs several round trips
+ * to the OSDs, so if there are enough images they are queried by
+ * several threads sharing the connection in parallel.
+ *
+ * Returns 0 on success with the result of each query in @results,
+ * -1 if querying of any image failed.
+ */
+static int
+virStorageBackendRBDRefreshVols(virStoragePoolObjPtr pool,
+                                virStorageBackendRBDStatePtr ptr,
+                                virStorageVolDefPtr *vols,
+                                size_t nvols,
+                                int *results)
+{
+    virStorageBackendRBDRefreshWorkerPtr workers = NULL;
+    size_t nworkers = MIN(nvols / VIR_STORAGE_RBD_REFRESH_MIN_IMAGES,
+                          VIR_STORAGE_RBD_REFRESH_MAX_WORKERS);
+    size_t i;
+    int ret = -1;
+
+    if (nworkers < 1)
+        nworkers = 1;
+
+    if (VIR_ALLOC_N(workers, nworkers) < 0)
+        return -1;
+
+    VIR_DEBUG("Querying %zu RBD images in %zu threads", nvols, nworkers);
+
+    for (i = 0; i < nworkers; i++) {
+        workers[i].pool = pool;
+        workers[i].ptr = ptr;
+        workers[i].vols = vols;
+        workers[i].results = results;
+        workers[i].nvols = nvols;
+        workers[i].first = i;
+        workers[i].step = nworkers;
+    }
+
+    /* The first share of images is queried by the calling thread */
+    for (i = 1; i < nworkers; i++) {
+        if (virThreadCreate(&workers[i].thread, true,
+                            virStorageBackendRBDRefreshWorkerRun,
+                            &workers[i]) < 0) {
+            VIR_WARN("Failed to create RBD image query thread");
+            continue;
+        }
+        workers[i].started = true;
+    }
+
+    /* ... as well as shares of workers which failed to start */
+    for (i = 0; i < nworkers; i++) {
+        if (!workers[i].started)
+            virStorageBackendRBDRefreshWorkerRun(&workers[i]);
+    }
+
+    for (i = 0; i < nworkers; i++) {
+        if (workers[i].started)
+            virThreadJoin(&workers[i].thread);
+    }
+
+    for (i = 0; i < nworkers; i++) {
+        if (workers[i].error) {
+            virSetError(workers[i].error);
+            goto cleanup;
+        }
+    }
+
+    ret = 0;
+
+ cleanup:
+    for (i = 0; i < nworkers; i++)
+        virFreeError(workers[i].error);
+    VIR_FREE(workers);
+    return ret;
+}
+
+
 static int
 virStorageBackendRBDRefreshPool(virStoragePoolObjPtr pool)
 {
@@ -431,18 +775,24 @@ virStorageBackendRBDRefreshPool(virStoragePoolObjPtr pool)
     virStorageBackendRBDStatePtr ptr = NULL;
     struct rados_cluster_stat_t clusterstat;
     struct rados_pool_stat_t poolstat;
+    virStorageVolDefPtr *vols = NULL;
+    size_t nvols = 0;
+    int *results = NULL;
+    size_t i;
 
-    if (!(ptr = virStorageBackendRBDNewState(pool)))
+    if (!(ptr = virStorageBackendRBDGetState(pool)))
         goto cleanup;
 
     if ((r = rados_cluster_stat(ptr->cluster, &clusterstat)) < 0) {
         virReportSystemError(-r, "%s", _("failed to stat the RADOS cluster"));
+        virStorageBackendRBDStateSetBroken(ptr);
         goto cleanup;
     }
 
     if ((r = rados_ioctx_pool_stat(ptr->ioctx, &poolstat)) < 0) {
         virReportSystemError(-r, _("failed to stat the RADOS pool '%s'"),
                              def->source.name);
+        virStorageBackendRBDStateSetBroken(ptr);
         goto cleanup;
     }
 
@@ -478,37 +828,30 @@ virStorageBackendRBDRefreshPool(virStoragePoolObjPtr pool)
         if (VIR_ALLOC(vol) < 0)
             goto cleanup;
 
-        if (VIR_STRDUP(vol->name, name) < 0) {
-            VIR_FREE(vol);
+        if (VIR_STRDUP(vol->name, name) < 0 ||
+            VIR_APPEND_ELEMENT(vols, nvols, vol) < 0) {
+            virStorageVolDefFree(vol);
             goto cleanup;
         }
 
         name += strlen(name) + 1;
+    }
 
-        r = volStorageBackendRBDRefreshVolInfo(vol, pool, ptr);
-
-        /* It could be that a volume has been deleted through a different route
-         * then libvirt and that will cause a -ENOENT to be returned.
-         *
-         * Another possibility is that there is something wrong with the placement
-         * group (PG) that RBD image's header is in and that causes -ETIMEDOUT
-         * to be returned.
-         *
-         * Do not error out and simply ignore the volume
-         */
-        if (r < 0) {
-            if (r == -ENOENT || r == -ETIMEDOUT)
-                continue;
+    if (VIR_ALLOC_N(results, nvols) < 0)
+        goto cleanup;
 
-            virStorageVolDefFree(vol);
-            goto cleanup;
-        }
+    if (virStorageBackendRBDRefreshVols(pool, ptr, vols, nvols, results) < 0)
+        goto cleanup;
 
-        if (virStoragePoolObjAddVol(pool, vol) < 0) {
-            virStorageVolDefFree(vol);
+    for (i = 0; i < nvols; i++) {
+        if (results[i] < 0)
+            continue;
+
+        if (virStoragePoolObjAddVol(pool, vols[i]) < 0) {
             virStoragePoolObjClearVols(pool);
             goto cleanup;
         }
+        vols[i] = NULL;
     }
 
     VIR_DEBUG("Found %zu images in RBD pool %s",
@@ -517,11 +860,23 @@ virStorageBackendRBDRefreshPool(virStoragePoolObjPtr pool)
     ret = 0;
 
  cleanup:
+    for (i = 0; i < nvols; i++)
+        virStorageVolDefFree(vols[i]);
+    VIR_FREE(vols);
+    VIR_FREE(results);
     VIR_FREE(names);
-    virStorageBackendRBDFreeState(&ptr);
+    virStorageBackendRBDReleaseState(&ptr);
     return ret;
 }
 
+
+static int
+virStorageBackendRBDStopPool(virStoragePoolObjPtr pool)
+{
+    virStorageBackendRBDDropState(pool);
+    return 0;
+}
+
 static int
 virStorageBackendRBDCleanupSnapshots(rados_ioctx_t ioctx,
                                      virStoragePoolSourcePtr source,
@@ -618,7 +973,7 @@ virStorageBackendRBDDeleteVol(virStoragePoolObjPtr pool,
     if (flags & VIR_STORAGE_VOL_DELETE_ZEROED)
         VIR_WARN("%s", "This storage backend does not support zeroed removal of volumes");
 
-    if (!(ptr = virStorageBackendRBDNewState(pool)))
+    if (!(ptr = virStorageBackendRBDGetState(pool)))
         goto cleanup;
 
     if (flags & VIR_STORAGE_VOL_DELETE_WITH_SNAPSHOTS) {
@@ -639,7 +994,7 @@ virStorageBackendRBDDeleteVol(virStoragePoolObjPtr pool,
     ret = 0;
 
  cleanup:
-    virStorageBackendRBDFreeState(&ptr);
+    virStorageBackendRBDReleaseState(&ptr);
     return ret;
 }
 
@@ -711,7 +1066,7 @@ virStorageBackendRBDBuildVol(virStoragePoolObjPtr pool,
         goto cleanup;
     }
 
-    if (!(ptr = virStorageBackendRBDNewState(pool)))
+    if (!(ptr = virStorageBackendRBDGetState(pool)))
         goto cleanup;
 
     if ((r = virStorageBackendRBDCreateImage(ptr->ioctx, vol->name,
@@ -724,7 +1079,7 @@ virStorageBackendRBDBuildVol(virStoragePoolObjPtr pool,
     ret = 0;
 
  cleanup:
-    virStorageBackendRBDFreeState(&ptr);
+    virStorageBackendRBDReleaseState(&ptr);
     return ret;
 }
 
@@ -1048,7 +1403,7 @@ virStorageBackendRBDBuildVolFrom(virStoragePoolObjPtr pool,
 
     virCheckFlags(0, -1);
 
-    if (!(ptr = virStorageBackendRBDNewState(pool)))
+    if (!(ptr = virStorageBackendRBDGetState(pool)))
         goto cleanup;
 
     if ((virStorageBackendRBDCloneImage(ptr->ioctx, origvol->name,
@@ -1058,7 +1413,7 @@ virStorageBackendRBDBuildVolFrom(virStoragePoolObjPtr pool,
     ret = 0;
 
  cleanup:
-    virStorageBackendRBDFreeState(&ptr);
+    virStorageBackendRBDReleaseState(&ptr);
     return ret;
 }
 
@@ -1069,7 +1424,7 @@ virStorageBackendRBDRefreshVol(virStoragePoolObjPtr pool ATTRIBUTE_UNUSED,
     virStorageBackendRBDStatePtr ptr = NULL;
     int ret = -1;
 
-    if (!(ptr = virStorageBackendRBDNewState(pool)))
+    if (!(ptr = virStorageBackendRBDGetState(pool)))
         goto cleanup;
 
     if (volStorageBackendRBDRefreshVolInfo(vol, pool, ptr) < 0)
@@ -1078,7 +1433,7 @@ virStorageBackendRBDRefreshVol(virStoragePoolObjPtr pool ATTRIBUTE_UNUSED,
     ret = 0;
 
  cleanup:
-    virStorageBackendRBDFreeState(&ptr);
+    virStorageBackendRBDReleaseState(&ptr);
     return ret;
 }
 
@@ -1095,7 +1450,7 @@ virStorageBackendRBDResizeVol(virStoragePoolObjPtr pool ATTRIBUTE_UNUSED,
 
     virCheckFlags(0, -1);
 
-    if (!(ptr = virStorageBackendRBDNewState(pool)))
+    if (!(ptr = virStorageBackendRBDGetState(pool)))
         goto cleanup;
 
     if ((r = rbd_open(ptr->ioctx, vol->name, &image, NULL)) < 0) {
@@ -1115,7 +1470,7 @@ virStorageBackendRBDResizeVol(virStoragePoolObjPtr pool ATTRIBUTE_UNUSED,
  cleanup:
     if (image != NULL)
        rbd_close(image);
-    virStorageBackendRBDFreeState(&ptr);
+    virStorageBackendRBDReleaseState(&ptr);
     return ret;
 }
 
@@ -1211,7 +1566,7 @@ virStorageBackendRBDVolWipe(virStoragePoolObjPtr pool,
 
     VIR_DEBUG("Wiping RBD image %s/%s", def->source.name, vol->name);
 
-    if (!(ptr = virStorageBackendRBDNewState(pool)))
+    if (!(ptr = virStorageBackendRBDGetState(pool)))
         goto cleanup;
 
     if ((r = rbd_open(ptr->ioctx, vol->name, &image, NULL)) < 0) {
@@ -1270,7 +1625,7 @@ virStorageBackendRBDVolWipe(virStoragePoolObjPtr pool,
     if (image)
         rbd_close(image);
 
-    virStorageBackendRBDFreeState(&ptr);
+    virStorageBackendRBDReleaseState(&ptr);
 
     return ret;
 }
@@ -1279,6 +1634,7 @@ virStorageBackend virStorageBackendRBD = {
     .type = VIR_STORAGE_POOL_RBD,
 
     .refreshPool = virStorageBackendRBDRefreshPool,
+    .stopPool = virStorageBackendRBDStopPool,
     .createVol = virStorageBackendRBDCreateVol,
     .buildVol = virStorageBackendRBDBuildVol,
     .buildVolFrom = virStorageBackendRBDBuildVolFrom,
@@ -377,6 +377,8 @@ storageStateCleanup(void)
     virMutexDestroy(&driver->lock);
     VIR_FREE(driver);
 
+    virStorageFileHeaderCacheClear();
+
     return 0;
 }
 
@@ -1206,7 +1208,12 @@ storagePoolRefresh(virStoragePoolPtr pool,
         goto cleanup;
     }
 
-    virStoragePoolObjClearVols(obj);
+    /* An explicit refresh is how users make us notice changes done
+     * behind our back, so don't trust any cached image headers. */
+    virStorageFileHeaderCacheClear();
+
+    if (!backend->refreshIncremental)
+        virStoragePoolObjClearVols(obj);
     if (backend->refreshPool(obj) < 0) {
         if (backend->stopPool)
             backend->stopPool(obj);
@@ -1522,8 +1529,6 @@ storageVolLookupByName(virStoragePoolPtr pool,
 struct storageVolLookupData {
     virConnectPtr conn;
     const char *key;
-    char *cleanpath;
-    const char *path;
     virStorageVolDefPtr voldef;
 };
 
@@ -1570,94 +1575,45 @@ storageVolLookupByKey(virConnectPtr conn,
 }
 
 
-static bool
-storageVolLookupByPathCallback(virStoragePoolObjPtr obj,
-                               const void *opaque)
-{
-    struct storageVolLookupData *data = (struct storageVolLookupData *) opaque;
-    virStoragePoolDefPtr def;
-    char *stable_path = NULL;
-
-    if (!virStoragePoolObjIsActive(obj))
-        return false;
-
-    def = virStoragePoolObjGetDef(obj);
-
-    switch ((virStoragePoolType) def->type) {
-        case VIR_STORAGE_POOL_DIR:
-        case VIR_STORAGE_POOL_FS:
-        case VIR_STORAGE_POOL_NETFS:
-        case VIR_STORAGE_POOL_LOGICAL:
-        case VIR_STORAGE_POOL_DISK:
-        case VIR_STORAGE_POOL_ISCSI:
-        case VIR_STORAGE_POOL_SCSI:
-        case VIR_STORAGE_POOL_MPATH:
-        case VIR_STORAGE_POOL_VSTORAGE:
-            stable_path = virStorageBackendStablePath(obj, data->cleanpath,
-                                                      false);
-            break;
-
-        case VIR_STORAGE_POOL_GLUSTER:
-        case VIR_STORAGE_POOL_RBD:
-        case VIR_STORAGE_POOL_SHEEPDOG:
-        case VIR_STORAGE_POOL_ZFS:
-        case VIR_STORAGE_POOL_LAST:
-            ignore_value(VIR_STRDUP(stable_path, data->path));
-            break;
-    }
-
-    /* Don't break the whole lookup process if it fails on
-     * getting the stable path for some of the pools. */
-    if (!stable_path) {
-        VIR_WARN("Failed to get stable path for pool '%s'", def->name);
-        return false;
-    }
-
-    data->voldef = virStorageVolDefFindByPath(obj, stable_path);
-    VIR_FREE(stable_path);
-
-    return !!data->voldef;
-}
-
-
 static virStorageVolPtr
 storageVolLookupByPath(virConnectPtr conn,
                        const char *path)
 {
     virStoragePoolObjPtr obj;
     virStoragePoolDefPtr def;
-    struct storageVolLookupData data = {
-        .conn = conn, .path = path, .voldef = NULL };
+    virStorageVolDefPtr voldef;
+    char *cleanpath;
     virStorageVolPtr vol = NULL;
 
-    if (!(data.cleanpath = virFileSanitizePath(path)))
+    if (!(cleanpath = virFileSanitizePath(path)))
         return NULL;
 
-    if ((obj = virStoragePoolObjListSearch(driver->pools,
-                                           storageVolLookupByPathCallback,
-                                           &data)) && data.voldef) {
+    /* The index of volumes of all pools knows both the target paths
+     * of volumes and the device nodes stable paths resolve to */
+    if ((obj = virStoragePoolObjFindByVolPath(driver->pools, cleanpath,
+                                              &voldef))) {
         def = virStoragePoolObjGetDef(obj);
 
-        if (virStorageVolLookupByPathEnsureACL(conn, def, data.voldef) == 0) {
+        if (virStorageVolLookupByPathEnsureACL(conn, def, voldef) == 0) {
             vol = virGetStorageVol(conn, def->name,
-                                   data.voldef->name, data.voldef->key,
+                                   voldef->name, voldef->key,
                                    NULL, NULL);
         }
         virStoragePoolObjEndAPI(&obj);
     }
 
     if (!vol) {
-        if (STREQ(path, data.cleanpath)) {
+        if (STREQ(path, cleanpath)) {
             virReportError(VIR_ERR_NO_STORAGE_VOL,
                            _("no storage vol with matching path '%s'"), path);
         } else {
             virReportError(VIR_ERR_NO_STORAGE_VOL,
                            _("no storage vol with matching path '%s' (%s)"),
-                           path, data.cleanpath);
+                           path, cleanpath);
         }
     }
 
-    VIR_FREE(data.cleanpath);
+    VIR_FREE(cleanpath);
     return vol;
 }
 
@@ -1739,6 +1695,8 @@ storageVolDeleteInternal(virStorageBackendPtr backend,
     if (backend->deleteVol(obj, voldef, flags) < 0)
         goto cleanup;
 
+    virStorageFileHeaderCacheInvalidate(voldef->target.path);
+
     /* The disk backend updated the pool data including removing the
      * voldef from the pool (for both the deleteVol and the createVol
      * failure path. */
@@ -2312,7 +2270,8 @@ virStorageVolPoolRefreshThread(void *opaque)
     if (!(backend = virStorageBackendForType(def->type)))
         goto cleanup;
 
-    virStoragePoolObjClearVols(obj);
+    if (!backend->refreshIncremental)
+        virStoragePoolObjClearVols(obj);
     if (backend->refreshPool(obj) < 0)
         VIR_DEBUG("Failed to refresh storage pool");
 
@@ -2507,6 +2466,8 @@ storageVolResize(virStorageVolPtr vol,
     if (backend->resizeVol(obj, voldef, abs_capacity, flags) < 0)
         goto cleanup;
 
+    virStorageFileHeaderCacheInvalidate(voldef->target.path);
+
     voldef->target.capacity = abs_capacity;
     /* Only update the allocation and pool values if we actually did the
      * allocation; otherwise, this is akin to a create operation with a
@@ -2577,6 +2538,8 @@ storageVolWipePattern(virStorageVolPtr vol,
     if (backend->wipeVol(obj, voldef, algorithm, flags) < 0)
         goto cleanup;
 
+    virStorageFileHeaderCacheInvalidate(voldef->target.path);
+
     /* Instead of using the refreshVol, since much changes on the target
      * volume, let's update using the same function as refreshPool would
      * use when it discovers a volume. The only failure to capture is -1,
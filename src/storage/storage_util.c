@@ -68,6 +68,7 @@
 #include "virstring.h"
 #include "virxml.h"
 #include "virfdstream.h"
+#include "virthread.h"
 
 #define VIR_FROM_THIS VIR_FROM_STORAGE
 
@@ -3675,9 +3676,194 @@ virStorageBackendRefreshVolTargetUpdate(virStorageVolDefPtr vol)
 }
 
 
+/* Minimal number of volumes to probe per worker thread and maximal
+ * number of worker threads probing volumes during pool refresh */
+#define VIR_STORAGE_REFRESH_MIN_VOLS 64
+#define VIR_STORAGE_REFRESH_MAX_WORKERS 8
+
+static void
+virStorageBackendVolStampFromStat(virStorageVolStampPtr stamp,
+                                  const struct stat *sb)
+{
+    struct timespec mtime = get_stat_mtime(sb);
+    struct timespec ctime = get_stat_ctime(sb);
+
+    stamp->valid = true;
+    stamp->ino = sb->st_ino;
+    stamp->size = sb->st_size;
+    stamp->mtime = mtime.tv_sec * 1000000000ULL + mtime.tv_nsec;
+    stamp->ctime = ctime.tv_sec * 1000000000ULL + ctime.tv_nsec;
+}
+
+
+static bool
+virStorageBackendVolStampMatches(const virStorageVolStamp *stamp,
+                                 const struct stat *sb)
+{
+    virStorageVolStamp current;
+
+    if (!stamp->valid)
+        return false;
+
+    virStorageBackendVolStampFromStat(&current, sb);
+
+    return stamp->ino == current.ino &&
+           stamp->size == current.size &&
+           stamp->mtime == current.mtime &&
+           stamp->ctime == current.ctime;
+}
+
+
+/* Probes a single volume found while refreshing a local pool and
+ * records the state of its file so that the next refresh can tell
+ * whether it has to be probed again.
+ *
+ * Returns 0 on success, -2 to ignore the volume, -1 on failure */
+static int
+virStorageBackendRefreshLocalVol(virStorageVolDefPtr vol)
+{
+    struct stat sb;
+    bool haveStat;
+    int ret;
+
+    /* stat before probing so that changes made meanwhile are
+     * caught by the next refresh */
+    haveStat = stat(vol->target.path, &sb) == 0;
+
+    if ((ret = virStorageBackendRefreshVolTargetUpdate(vol)) < 0)
+        return ret;
+
+    if (haveStat)
+        virStorageBackendVolStampFromStat(&vol->stamp, &sb);
+
+    return 0;
+}
+
+
+typedef struct _virStorageBackendRefreshWorker virStorageBackendRefreshWorker;
+typedef virStorageBackendRefreshWorker *virStorageBackendRefreshWorkerPtr;
+struct _virStorageBackendRefreshWorker {
+    virThread thread;
+    bool started;
+
+    /* arrays shared by all workers, each one processing entries
+     * @first, @first + @step, @first + 2 * @step, ... */
+    virStorageVolDefPtr *vols;
+    int *results;
+    size_t nvols;
+    size_t first;
+    size_t step;
+
+    /* error of the first volume failing to be probed */
+    virErrorPtr error;
+};
+
+
+static void
+virStorageBackendRefreshWorkerRun(void *opaque)
+{
+    virStorageBackendRefreshWorkerPtr worker = opaque;
+    size_t i;
+
+    for (i = worker->first; i < worker->nvols; i += worker->step) {
+        worker->results[i] = virStorageBackendRefreshLocalVol(worker->vols[i]);
+
+        if (worker->results[i] == -1) {
+            worker->error = virSaveLastError();
+            break;
+        }
+    }
+}
+
+
+/**
+ * virStorageBackendRefreshLocalVols:
+ * @vols: volumes to probe
+ * @nvols: number of items in @vols
+ * @results: filled with the result of probing each of @vols
+ *
+ * Probes all volumes in @vols. If there are enough of them, the
+ * volumes are probed by several threads in parallel, which helps
+ * when the latency of accessing the files is high, e.g. on NFS.
+ *
+ * Returns 0 on success, -1 if probing of any volume failed.
+ */
+static int
+virStorageBackendRefreshLocalVols(virStorageVolDefPtr *vols,
+                                  size_t nvols,
+                                  int *results)
+{
+    virStorageBackendRefreshWorkerPtr workers = NULL;
+    size_t nworkers = MIN(nvols / VIR_STORAGE_REFRESH_MIN_VOLS,
+                          VIR_STORAGE_REFRESH_MAX_WORKERS);
+    size_t i;
+    int ret = -1;
+
+    if (nworkers <= 1 || VIR_ALLOC_N_QUIET(workers, nworkers) < 0) {
+        for (i = 0; i < nvols; i++) {
+            if ((results[i] = virStorageBackendRefreshLocalVol(vols[i])) == -1)
+                return -1;
+        }
+        return 0;
+    }
+
+    VIR_DEBUG("Probing %zu volumes in %zu threads", nvols, nworkers);
+
+    for (i = 0; i < nworkers; i++) {
+        workers[i].vols = vols;
+        workers[i].results = results;
+        workers[i].nvols = nvols;
+        workers[i].first = i;
+        workers[i].step = nworkers;
+    }
+
+    /* The first share of volumes is probed by the calling thread */
+    for (i = 1; i < nworkers; i++) {
+        if (virThreadCreate(&workers[i].thread, true,
+                            virStorageBackendRefreshWorkerRun,
+                            &workers[i]) < 0) {
+            VIR_WARN("Failed to create volume probing thread");
+            continue;
+        }
+        workers[i].started = true;
+    }
+
+    /* ... as well as shares of workers which failed to start */
+    for (i = 0; i < nworkers; i++) {
+        if (!workers[i].started)
+            virStorageBackendRefreshWorkerRun(&workers[i]);
+    }
+
+    for (i = 0; i < nworkers; i++) {
+        if (workers[i].started)
+            virThreadJoin(&workers[i].thread);
+    }
+
+    for (i = 0; i < nworkers; i++) {
+        if (workers[i].error) {
+            virSetError(workers[i].error);
+            goto cleanup;
+        }
+    }
+
+    ret = 0;
+
+ cleanup:
+    for (i = 0; i < nworkers; i++)
+        virFreeError(workers[i].error);
+    VIR_FREE(workers);
+    return ret;
+}
+
+
 /**
  * Iterate over the pool's directory and enumerate all disk images
  * within it. This is non-recursive.
+ *
+ * The refresh is incremental: volumes already known to the pool whose
+ * file didn't change since they were probed last time (same inode,
+ * size, mtime and ctime) are kept as they are, only new or changed
+ * files are probed and volumes whose file disappeared are removed.
  */
 int
 virStorageBackendRefreshLocal(virStoragePoolObjPtr pool)
@@ -3688,15 +3874,26 @@ virStorageBackendRefreshLocal(virStoragePoolObjPtr pool)
     struct statvfs sb;
     struct stat statbuf;
     virStorageVolDefPtr vol = NULL;
+    virStorageVolDefPtr *vols = NULL;
+    size_t nvols = 0;
+    int *results = NULL;
+    virHashTablePtr found = NULL;
     virStorageSourcePtr target = NULL;
+    char *path = NULL;
+    size_t nunchanged = 0;
+    size_t i;
     int direrr;
     int fd = -1, ret = -1;
 
+    /* names of volumes present in the pool after the refresh */
+    if (!(found = virHashCreate(64, NULL)))
+        goto cleanup;
+
     if (virDirOpen(&dir, def->target.path) < 0)
         goto cleanup;
 
     while ((direrr = virDirRead(dir, &ent, def->target.path)) > 0) {
-        int err;
+        virStorageVolDefPtr oldvol;
 
         if (virStringHasControlChars(ent->d_name)) {
             VIR_WARN("Ignoring file with control characters under '%s'",
@@ -3704,6 +3901,19 @@ virStorageBackendRefreshLocal(virStoragePoolObjPtr pool)
             continue;
         }
 
+        if (virAsprintf(&path, "%s/%s", def->target.path, ent->d_name) < 0)
+            goto cleanup;
+
+        if ((oldvol = virStorageVolDefFindByName(pool, ent->d_name)) &&
+            stat(path, &statbuf) == 0 &&
+            virStorageBackendVolStampMatches(&oldvol->stamp, &statbuf)) {
+            if (virHashAddEntry(found, ent->d_name, (void *) 1) < 0)
+                goto cleanup;
+            nunchanged++;
+            VIR_FREE(path);
+            continue;
+        }
+
         if (VIR_ALLOC(vol) < 0)
             goto cleanup;
 
@@ -3711,32 +3921,45 @@ virStorageBackendRefreshLocal(virStoragePoolObjPtr pool)
             goto cleanup;
 
         vol->type = VIR_STORAGE_VOL_FILE;
-        if (virAsprintf(&vol->target.path, "%s/%s",
-                        def->target.path, vol->name) < 0)
-            goto cleanup;
+        VIR_STEAL_PTR(vol->target.path, path);
 
         if (VIR_STRDUP(vol->key, vol->target.path) < 0)
             goto cleanup;
 
-        if ((err = virStorageBackendRefreshVolTargetUpdate(vol)) < 0) {
-            if (err == -2) {
-                /* Silently ignore non-regular files,
-                 * eg 'lost+found', dangling symbolic link */
-                virStorageVolDefFree(vol);
-                vol = NULL;
-                continue;
-            }
-            goto cleanup;
-        }
-
-        if (virStoragePoolObjAddVol(pool, vol) < 0)
+        if (VIR_APPEND_ELEMENT(vols, nvols, vol) < 0)
             goto cleanup;
-        vol = NULL;
     }
     if (direrr < 0)
         goto cleanup;
     VIR_DIR_CLOSE(dir);
 
+    VIR_DEBUG("Pool '%s': %zu unchanged volumes, %zu to probe",
+              def->name, nunchanged, nvols);
+
+    if (VIR_ALLOC_N(results, nvols) < 0 ||
+        virStorageBackendRefreshLocalVols(vols, nvols, results) < 0)
+        goto cleanup;
+
+    for (i = 0; i < nvols; i++) {
+        virStorageVolDefPtr oldvol;
+
+        /* Silently ignore non-regular files,
+         * eg 'lost+found', dangling symbolic link */
+        if (results[i] == -2)
+            continue;
+
+        if ((oldvol = virStorageVolDefFindByName(pool, vols[i]->name)))
+            virStoragePoolObjRemoveVol(pool, oldvol);
+
+        if (virHashAddEntry(found, vols[i]->name, (void *) 1) < 0 ||
+            virStoragePoolObjAddVol(pool, vols[i]) < 0)
+            goto cleanup;
+        vols[i] = NULL;
+    }
+
+    if (virStoragePoolObjPruneVols(pool, found) < 0)
+        goto cleanup;
+
     if (VIR_ALLOC(target))
         goto cleanup;
 
@@ -3783,6 +4006,12 @@ virStorageBackendRefreshLocal(virStoragePoolObjPtr pool)
     VIR_DIR_CLOSE(dir);
     VIR_FORCE_CLOSE(fd);
     virStorageVolDefFree(vol);
+    for (i = 0; i < nvols; i++)
+        virStorageVolDefFree(vols[i]);
+    VIR_FREE(vols);
+    VIR_FREE(results);
+    VIR_FREE(path);
+    virHashFree(found);
     virStorageSourceFree(target);
     if (ret < 0)
         virStoragePoolObjClearVols(pool);
@@ -5020,7 +5020,6 @@ testStorageVolLookupByName(virStoragePoolPtr pool,
 struct storageVolLookupData {
     virConnectPtr conn;
     const char *key;
-    const char *path;
     virStorageVolDefPtr voldef;
 };
 
@@ -5068,19 +5067,6 @@ testStorageVolLookupByKey(virConnectPtr conn,
 }
 
 
-static bool
-testStorageVolLookupByPathCallback(virStoragePoolObjPtr obj,
-                                   const void *opaque)
-{
-    struct storageVolLookupData *data = (struct storageVolLookupData *) opaque;
-
-    if (virStoragePoolObjIsActive(obj))
-        data->voldef = virStorageVolDefFindByPath(obj, data->path);
-
-    return !!data->voldef;
-}
-
-
 static virStorageVolPtr
 testStorageVolLookupByPath(virConnectPtr conn,
                            const char *path)
@@ -5088,17 +5074,15 @@ testStorageVolLookupByPath(virConnectPtr conn,
     testDriverPtr privconn = conn->privateData;
     virStoragePoolObjPtr obj;
     virStoragePoolDefPtr def;
-    struct storageVolLookupData data = {
-        .conn = conn, .path = path, .voldef = NULL };
+    virStorageVolDefPtr voldef;
     virStorageVolPtr vol = NULL;
 
     testDriverLock(privconn);
-    if ((obj = virStoragePoolObjListSearch(privconn->pools,
-                                           testStorageVolLookupByPathCallback,
-                                           &data)) && data.voldef) {
+    if ((obj = virStoragePoolObjFindByVolPath(privconn->pools, path,
+                                              &voldef))) {
         def = virStoragePoolObjGetDef(obj);
         vol = virGetStorageVol(conn, def->name,
-                               data.voldef->name, data.voldef->key,
+                               voldef->name, voldef->key,
                                NULL, NULL);
         virStoragePoolObjEndAPI(&obj);
     }
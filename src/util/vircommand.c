@@ -26,10 +26,12 @@
 #include <signal.h>
 #include <stdarg.h>
 #include <stdlib.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <passfd.h>
 
 #if WITH_CAPNG
 # include <cap-ng.h>
@@ -68,6 +70,7 @@ enum {
     VIR_EXEC_RUN_SYNC   = (1 << 3),
     VIR_EXEC_ASYNC_IO   = (1 << 4),
     VIR_EXEC_LISTEN_FDS = (1 << 5),
+    VIR_EXEC_SPAWN      = (1 << 6),
 };
 
 typedef struct _virCommandFD virCommandFD;
@@ -117,6 +120,7 @@ struct _virCommand {
     void *opaque;
 
     pid_t pid;
+    int spawnfd; /* set if started by the spawn helper */
     char *pidfile;
     bool reap;
     bool rawStatus;
@@ -492,6 +496,747 @@ virExecCommon(virCommandPtr cmd, gid_t *groups, int ngroups)
     return ret;
 }
 
+/*
+ * The spawn helper is a small process forked off by the daemon while
+ * it is still small and single threaded. virCommandRun hands the
+ * commands which need nothing but their arguments, environment, working
+ * directory and file descriptors over to it, so that starting them
+ * means forking the helper rather than the whole daemon.
+ *
+ * Every command gets its own socket pair, one end of which is passed
+ * to the helper over its control socket. The command socket then
+ * carries a virCommandSpawnRequest, the strings it describes, the
+ * target numbers of the FDs and the FDs themselves. The helper answers
+ * with a virCommandSpawnReply carrying the PID of the child, or the
+ * step which failed, and once the child is gone, with its wait status.
+ */
+typedef struct _virCommandSpawnRequest virCommandSpawnRequest;
+struct _virCommandSpawnRequest {
+    size_t len;     /* of the binary, args, env and pwd strings */
+    size_t nargs;
+    size_t nenv;
+    bool haveEnv;   /* inherit the helper's environment if false */
+    bool havePwd;
+    size_t nfds;
+};
+
+typedef enum {
+    VIR_COMMAND_SPAWN_STEP_READ,      /* reading the request */
+    VIR_COMMAND_SPAWN_STEP_VALIDATE,  /* the request is malformed */
+    VIR_COMMAND_SPAWN_STEP_ALLOC,     /* allocating memory for it */
+    VIR_COMMAND_SPAWN_STEP_RECVFD,    /* receiving one of the FDs */
+    VIR_COMMAND_SPAWN_STEP_FORK,      /* forking the child */
+} virCommandSpawnStep;
+
+typedef struct _virCommandSpawnReply virCommandSpawnReply;
+struct _virCommandSpawnReply {
+    pid_t pid;      /* of the child, or -errno on failure */
+    int step;       /* virCommandSpawnStep which failed */
+    int fd;         /* target of the FD for VIR_COMMAND_SPAWN_STEP_RECVFD */
+};
+
+typedef struct _virCommandSpawnChild virCommandSpawnChild;
+struct _virCommandSpawnChild {
+    pid_t pid;
+    int fd;
+};
+
+# define VIR_COMMAND_SPAWN_MAX_LEN (16 * 1024 * 1024)
+# define VIR_COMMAND_SPAWN_MAX_FDS 1024
+
+static virMutex spawnServerLock = VIR_MUTEX_INITIALIZER;
+static int spawnServerFd = -1;
+static pid_t spawnServerPid = -1;
+static size_t spawnServerCount; /* commands started by the helper */
+
+/* only used inside the helper process */
+static int spawnServerWakeup[2] = {-1, -1};
+
+
+static void
+virCommandSpawnServerChildHandler(int sig ATTRIBUTE_UNUSED)
+{
+    int saved_errno = errno;
+    char c = 0;
+
+    ignore_value(write(spawnServerWakeup[1], &c, sizeof(c)));
+    errno = saved_errno;
+}
+
+
+static const char *
+virCommandSpawnNextString(char **data,
+                          const char *end)
+{
+    char *str = *data;
+
+    if (str >= end)
+        return NULL;
+
+    /* the request data is NUL terminated, so this never runs off */
+    *data += strlen(str) + 1;
+    return str;
+}
+
+
+static void ATTRIBUTE_NORETURN
+virCommandSpawnServerExec(const char *binary,
+                          char **args,
+                          char **env,
+                          const char *pwd,
+                          int *fds,
+                          int *targets,
+                          size_t nfds)
+{
+    struct sigaction sig_action;
+    int maxfd = STDERR_FILENO;
+    int ret = EXIT_CANCELED;
+    size_t i;
+
+    /* Undo the signal setup of the helper */
+    memset(&sig_action, 0, sizeof(sig_action));
+    sig_action.sa_handler = SIG_DFL;
+    sigemptyset(&sig_action.sa_mask);
+    ignore_value(sigaction(SIGCHLD, &sig_action, NULL));
+    ignore_value(sigaction(SIGPIPE, &sig_action, NULL));
+
+    /* Move all FDs out of the way before putting them in place, so
+     * that none of them gets overwritten by another one. The copies
+     * made by dup2 lose the close-on-exec flag, everything else the
+     * helper holds keeps it. */
+    for (i = 0; i < nfds; i++)
+        maxfd = MAX(maxfd, targets[i]);
+
+    for (i = 0; i < nfds; i++) {
+        if ((fds[i] = fcntl(fds[i], F_DUPFD_CLOEXEC, maxfd + 1)) < 0) {
+            virReportSystemError(errno, _("failed to preserve fd %d"),
+                                 targets[i]);
+            goto fork_error;
+        }
+    }
+
+    for (i = 0; i < nfds; i++) {
+        if (dup2(fds[i], targets[i]) != targets[i]) {
+            virReportSystemError(errno, _("failed to preserve fd %d"),
+                                 targets[i]);
+            goto fork_error;
+        }
+    }
+
+    if (pwd && chdir(pwd) < 0) {
+        virReportSystemError(errno, _("Unable to change to %s"), pwd);
+        goto fork_error;
+    }
+
+    if (env)
+        execve(binary, args, env);
+    else
+        execv(binary, args);
+
+    ret = errno == ENOENT ? EXIT_ENOENT : EXIT_CANNOT_INVOKE;
+    virReportSystemError(errno,
+                         _("cannot execute binary %s"),
+                         args[0]);
+
+ fork_error:
+    virDispatchError(NULL);
+    _exit(ret);
+}
+
+
+/*
+ * virCommandSpawnServerHandle:
+ * @sock: command socket
+ * @reply: filled with the outcome
+ *
+ * Reads a request from @sock and forks the child process.
+ */
+static void
+virCommandSpawnServerHandle(int sock,
+                            virCommandSpawnReply *reply)
+{
+    virCommandSpawnRequest req;
+    char *data = NULL;
+    char *p;
+    const char *end;
+    const char *binary;
+    const char *pwd = NULL;
+    char **args = NULL;
+    char **env = NULL;
+    int *targets = NULL;
+    int *fds = NULL;
+    size_t nfds = 0;
+    size_t i;
+    pid_t pid;
+
+    memset(reply, 0, sizeof(*reply));
+    reply->fd = -1;
+
+    reply->step = VIR_COMMAND_SPAWN_STEP_READ;
+    if (saferead(sock, &req, sizeof(req)) != sizeof(req))
+        goto read_error;
+
+    reply->step = VIR_COMMAND_SPAWN_STEP_VALIDATE;
+    if (req.len == 0 || req.len > VIR_COMMAND_SPAWN_MAX_LEN ||
+        req.nargs == 0 || req.nfds > VIR_COMMAND_SPAWN_MAX_FDS)
+        goto invalid;
+
+    reply->step = VIR_COMMAND_SPAWN_STEP_ALLOC;
+    if (VIR_ALLOC_N_QUIET(data, req.len) < 0 ||
+        VIR_ALLOC_N_QUIET(args, req.nargs + 1) < 0 ||
+        VIR_ALLOC_N_QUIET(env, req.nenv + 1) < 0 ||
+        VIR_ALLOC_N_QUIET(targets, req.nfds) < 0 ||
+        VIR_ALLOC_N_QUIET(fds, req.nfds) < 0) {
+        reply->pid = -ENOMEM;
+        goto cleanup;
+    }
+
+    reply->step = VIR_COMMAND_SPAWN_STEP_READ;
+    if (saferead(sock, data, req.len) != (ssize_t) req.len ||
+        saferead(sock, targets, sizeof(*targets) * req.nfds) !=
+        (ssize_t) (sizeof(*targets) * req.nfds))
+        goto read_error;
+
+    reply->step = VIR_COMMAND_SPAWN_STEP_RECVFD;
+    for (nfds = 0; nfds < req.nfds; nfds++) {
+        if ((fds[nfds] = recvfd(sock, O_CLOEXEC)) < 0) {
+            reply->pid = -errno;
+            reply->fd = targets[nfds];
+            goto cleanup;
+        }
+    }
+
+    reply->step = VIR_COMMAND_SPAWN_STEP_VALIDATE;
+    if (data[req.len - 1] != '\0')
+        goto invalid;
+
+    p = data;
+    end = data + req.len;
+    if (!(binary = virCommandSpawnNextString(&p, end)))
+        goto invalid;
+    for (i = 0; i < req.nargs; i++) {
+        if (!(args[i] = (char *) virCommandSpawnNextString(&p, end)))
+            goto invalid;
+    }
+    for (i = 0; i < req.nenv; i++) {
+        if (!(env[i] = (char *) virCommandSpawnNextString(&p, end)))
+            goto invalid;
+    }
+    if (req.havePwd && !(pwd = virCommandSpawnNextString(&p, end)))
+        goto invalid;
+
+    reply->step = VIR_COMMAND_SPAWN_STEP_FORK;
+    if ((pid = fork()) < 0) {
+        reply->pid = -errno;
+        goto cleanup;
+    }
+
+    if (pid == 0)
+        virCommandSpawnServerExec(binary, args, req.haveEnv ? env : NULL,
+                                  pwd, fds, targets, nfds);
+
+    reply->pid = pid;
+
+ cleanup:
+    for (i = 0; i < nfds; i++)
+        VIR_FORCE_CLOSE(fds[i]);
+    VIR_FREE(fds);
+    VIR_FREE(targets);
+    VIR_FREE(env);
+    VIR_FREE(args);
+    VIR_FREE(data);
+    return;
+
+ read_error:
+    /* the daemon closed its end early or the socket failed */
+    reply->pid = -EIO;
+    goto cleanup;
+
+ invalid:
+    reply->pid = -EINVAL;
+    goto cleanup;
+}
+
+
+static void
+virCommandSpawnServerReap(virCommandSpawnChild **children,
+                          size_t *nchildren)
+{
+    size_t i = 0;
+    pid_t rc;
+    int status;
+
+    while (i < *nchildren) {
+        if ((rc = waitpid((*children)[i].pid, &status, WNOHANG)) == 0) {
+            i++;
+            continue;
+        }
+        if (rc < 0 && errno == EINTR)
+            continue;
+
+        /* the caller may have given up on the child already */
+        if (rc > 0)
+            ignore_value(safewrite((*children)[i].fd, &status,
+                                   sizeof(status)));
+        VIR_FORCE_CLOSE((*children)[i].fd);
+        VIR_DELETE_ELEMENT(*children, i, *nchildren);
+    }
+}
+
+
+/*
+ * virCommandSpawnServerRun:
+ * @ctrl: control socket
+ *
+ * Main loop of the spawn helper, runs until the daemon closes the
+ * control socket. Children which are still running then are left
+ * alone.
+ */
+static void ATTRIBUTE_NORETURN
+virCommandSpawnServerRun(int ctrl)
+{
+    virCommandSpawnChild *children = NULL;
+    size_t nchildren = 0;
+    struct sigaction sig_action;
+    int fd, openmax;
+    char buf[64];
+
+    /* Whatever the daemon had open belongs to the daemon */
+    openmax = sysconf(_SC_OPEN_MAX);
+    for (fd = 3; fd < openmax; fd++) {
+        int tmpfd = fd;
+        if (fd != ctrl)
+            VIR_MASS_CLOSE(tmpfd);
+    }
+
+    if (pipe2(spawnServerWakeup, O_CLOEXEC) < 0 ||
+        virSetNonBlock(spawnServerWakeup[0]) < 0 ||
+        virSetNonBlock(spawnServerWakeup[1]) < 0) {
+        virReportSystemError(errno, "%s", _("cannot create pipe"));
+        goto error;
+    }
+
+    memset(&sig_action, 0, sizeof(sig_action));
+    sigemptyset(&sig_action.sa_mask);
+    sig_action.sa_handler = SIG_IGN;
+    if (sigaction(SIGPIPE, &sig_action, NULL) < 0) {
+        virReportSystemError(errno, "%s", _("Could not disable SIGPIPE"));
+        goto error;
+    }
+    sig_action.sa_handler = virCommandSpawnServerChildHandler;
+    sig_action.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    if (sigaction(SIGCHLD, &sig_action, NULL) < 0) {
+        virReportSystemError(errno, "%s", _("Could not handle SIGCHLD"));
+        goto error;
+    }
+
+    for (;;) {
+        struct pollfd fds[2];
+        virCommandSpawnChild child;
+        virCommandSpawnReply reply;
+
+        fds[0].fd = ctrl;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        fds[1].fd = spawnServerWakeup[0];
+        fds[1].events = POLLIN;
+        fds[1].revents = 0;
+
+        if (poll(fds, ARRAY_CARDINALITY(fds), -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            virReportSystemError(errno, "%s", _("unable to poll"));
+            goto error;
+        }
+
+        if (fds[1].revents) {
+            while (read(spawnServerWakeup[0], buf, sizeof(buf)) > 0)
+                ;
+            virCommandSpawnServerReap(&children, &nchildren);
+        }
+
+        if (!fds[0].revents)
+            continue;
+
+        /* Any failure here means the daemon went away */
+        if ((child.fd = recvfd(ctrl, O_CLOEXEC)) < 0)
+            break;
+
+        virCommandSpawnServerHandle(child.fd, &reply);
+        child.pid = reply.pid;
+        if (safewrite(child.fd, &reply, sizeof(reply)) < 0 ||
+            child.pid < 0 ||
+            VIR_APPEND_ELEMENT(children, nchildren, child) < 0)
+            VIR_FORCE_CLOSE(child.fd);
+    }
+
+    _exit(EXIT_SUCCESS);
+
+ error:
+    virDispatchError(NULL);
+    _exit(EXIT_FAILURE);
+}
+
+
+/**
+ * virCommandSpawnServerStart:
+ *
+ * Fork off the spawn helper, which then starts the commands run via
+ * virCommandRun that need no special setup in the child. This should
+ * be called early, while the process is still single threaded.
+ *
+ * Returns 0 on success, -1 on failure.
+ */
+int
+virCommandSpawnServerStart(void)
+{
+    int pair[2] = {-1, -1};
+    pid_t pid;
+    int ret = -1;
+
+    virMutexLock(&spawnServerLock);
+
+    if (spawnServerFd >= 0) {
+        ret = 0;
+        goto cleanup;
+    }
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) < 0 ||
+        virSetCloseExec(pair[0]) < 0 ||
+        virSetCloseExec(pair[1]) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("unable to create socket pair"));
+        goto cleanup;
+    }
+
+    if ((pid = virFork()) < 0)
+        goto cleanup;
+
+    if (pid == 0) {
+        VIR_FORCE_CLOSE(pair[0]);
+        virCommandSpawnServerRun(pair[1]);
+    }
+
+    VIR_DEBUG("Started spawn helper with PID %lld", (long long) pid);
+    spawnServerFd = pair[0];
+    pair[0] = -1;
+    spawnServerPid = pid;
+    ret = 0;
+
+ cleanup:
+    VIR_FORCE_CLOSE(pair[0]);
+    VIR_FORCE_CLOSE(pair[1]);
+    virMutexUnlock(&spawnServerLock);
+    return ret;
+}
+
+
+static void
+virCommandSpawnServerDropLocked(void)
+{
+    if (spawnServerFd < 0)
+        return;
+
+    VIR_FORCE_CLOSE(spawnServerFd);
+    virProcessAbort(spawnServerPid);
+    spawnServerPid = -1;
+}
+
+
+/**
+ * virCommandSpawnServerGetPid:
+ *
+ * Returns the PID of the spawn helper, or -1 if it is not running.
+ */
+pid_t
+virCommandSpawnServerGetPid(void)
+{
+    pid_t pid;
+
+    virMutexLock(&spawnServerLock);
+    pid = spawnServerFd >= 0 ? spawnServerPid : -1;
+    virMutexUnlock(&spawnServerLock);
+
+    return pid;
+}
+
+
+/**
+ * virCommandSpawnServerGetCount:
+ *
+ * Returns the number of commands started through the spawn helper so
+ * far.
+ */
+size_t
+virCommandSpawnServerGetCount(void)
+{
+    size_t count;
+
+    virMutexLock(&spawnServerLock);
+    count = spawnServerCount;
+    virMutexUnlock(&spawnServerLock);
+
+    return count;
+}
+
+
+/**
+ * virCommandSpawnServerStop:
+ *
+ * Stop the spawn helper, commands are forked directly afterwards.
+ * Commands started by the helper which are still running are not
+ * affected.
+ */
+void
+virCommandSpawnServerStop(void)
+{
+    virMutexLock(&spawnServerLock);
+    if (spawnServerFd >= 0) {
+        VIR_FORCE_CLOSE(spawnServerFd);
+        /* the helper exits once it sees the control socket close */
+        if (virProcessWait(spawnServerPid, NULL, false) < 0)
+            virResetLastError();
+        spawnServerPid = -1;
+    }
+    virMutexUnlock(&spawnServerLock);
+}
+
+
+static bool
+virCommandSpawnUsable(virCommandPtr cmd)
+{
+    if (!(cmd->flags & VIR_EXEC_SPAWN) ||
+        (cmd->flags & (VIR_EXEC_DAEMON |
+                       VIR_EXEC_CLEAR_CAPS |
+                       VIR_EXEC_LISTEN_FDS)))
+        return false;
+
+    if (cmd->hook || cmd->handshake || cmd->pidfile || cmd->mask)
+        return false;
+
+    if (cmd->uid != (uid_t)-1 || cmd->gid != (gid_t)-1 ||
+        cmd->capabilities)
+        return false;
+
+    if (cmd->maxMemLock || cmd->maxProcesses || cmd->maxFiles ||
+        cmd->setMaxCore)
+        return false;
+
+# if defined(WITH_SECDRIVER_SELINUX)
+    if (cmd->seLinuxLabel)
+        return false;
+# endif
+# if defined(WITH_SECDRIVER_APPARMOR)
+    if (cmd->appArmorProfile)
+        return false;
+# endif
+
+    return true;
+}
+
+
+static void
+virCommandSpawnReportError(const virCommandSpawnReply *reply)
+{
+    int err = reply->pid < 0 ? -reply->pid : EINVAL;
+
+    switch ((virCommandSpawnStep) reply->step) {
+    case VIR_COMMAND_SPAWN_STEP_READ:
+        virReportSystemError(err, "%s",
+                             _("spawn helper could not read the command"));
+        break;
+    case VIR_COMMAND_SPAWN_STEP_VALIDATE:
+        virReportSystemError(err, "%s",
+                             _("spawn helper got a malformed command"));
+        break;
+    case VIR_COMMAND_SPAWN_STEP_ALLOC:
+        virReportSystemError(err, "%s",
+                             _("spawn helper could not allocate the command"));
+        break;
+    case VIR_COMMAND_SPAWN_STEP_RECVFD:
+        virReportSystemError(err,
+                             _("spawn helper could not receive fd %d"),
+                             reply->fd);
+        break;
+    case VIR_COMMAND_SPAWN_STEP_FORK:
+        virReportSystemError(err, "%s",
+                             _("spawn helper cannot fork child process"));
+        break;
+    default:
+        virReportSystemError(err, "%s",
+                             _("unexpected reply from spawn helper"));
+        break;
+    }
+}
+
+
+/*
+ * virCommandSpawn:
+ * @cmd: command to start
+ * @binary: resolved path of the binary
+ * @childin, @childout, @childerr: stdio of the child
+ *
+ * Start @cmd through the spawn helper.
+ *
+ * Returns the PID of the child on success, 0 if there's no spawn
+ * helper to use, or -1 on failure.
+ */
+static pid_t
+virCommandSpawn(virCommandPtr cmd,
+                const char *binary,
+                int childin,
+                int childout,
+                int childerr)
+{
+    virCommandSpawnRequest req;
+    virCommandSpawnReply reply;
+    int pair[2] = {-1, -1};
+    char *data = NULL;
+    char *p;
+    int *fds = NULL;
+    int *targets = NULL;
+    int senderr = 0;
+    int sendfailed = -1;
+    size_t i;
+    pid_t pid = -1;
+
+    virMutexLock(&spawnServerLock);
+
+    if (spawnServerFd < 0) {
+        virMutexUnlock(&spawnServerLock);
+        return 0;
+    }
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) < 0 ||
+        virSetCloseExec(pair[0]) < 0 ||
+        virSetCloseExec(pair[1]) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("unable to create socket pair"));
+        virMutexUnlock(&spawnServerLock);
+        goto cleanup;
+    }
+
+    if (sendfd(spawnServerFd, pair[1]) < 0) {
+        char ebuf[1024];
+
+        VIR_WARN("Spawn helper is gone, forking commands directly: %s",
+                 virStrerror(errno, ebuf, sizeof(ebuf)));
+        virCommandSpawnServerDropLocked();
+        virMutexUnlock(&spawnServerLock);
+        pid = 0;
+        goto cleanup;
+    }
+
+    virMutexUnlock(&spawnServerLock);
+    VIR_FORCE_CLOSE(pair[1]);
+
+    memset(&req, 0, sizeof(req));
+    req.len = strlen(binary) + 1;
+    req.nargs = cmd->nargs;
+    for (i = 0; i < cmd->nargs; i++)
+        req.len += strlen(cmd->args[i]) + 1;
+    req.nenv = cmd->nenv;
+    req.haveEnv = !!cmd->env;
+    for (i = 0; i < cmd->nenv; i++)
+        req.len += strlen(cmd->env[i]) + 1;
+    req.havePwd = !!cmd->pwd;
+    if (cmd->pwd)
+        req.len += strlen(cmd->pwd) + 1;
+    req.nfds = 3 + cmd->npassfd;
+
+    if (VIR_ALLOC_N(data, req.len) < 0 ||
+        VIR_ALLOC_N(fds, req.nfds) < 0 ||
+        VIR_ALLOC_N(targets, req.nfds) < 0)
+        goto cleanup;
+
+    p = stpcpy(data, binary) + 1;
+    for (i = 0; i < cmd->nargs; i++)
+        p = stpcpy(p, cmd->args[i]) + 1;
+    for (i = 0; i < cmd->nenv; i++)
+        p = stpcpy(p, cmd->env[i]) + 1;
+    if (cmd->pwd)
+        p = stpcpy(p, cmd->pwd) + 1;
+
+    fds[0] = childin;
+    targets[0] = STDIN_FILENO;
+    fds[1] = childout;
+    targets[1] = STDOUT_FILENO;
+    fds[2] = childerr;
+    targets[2] = STDERR_FILENO;
+    for (i = 0; i < cmd->npassfd; i++)
+        fds[3 + i] = targets[3 + i] = cmd->passfd[i].fd;
+
+    /* If the helper gives up on the command half way through, it still
+     * replies with the step which failed before closing its end */
+    if (safewrite(pair[0], &req, sizeof(req)) < 0 ||
+        safewrite(pair[0], data, req.len) < 0 ||
+        safewrite(pair[0], targets, sizeof(*targets) * req.nfds) < 0) {
+        senderr = errno;
+    } else {
+        for (i = 0; i < req.nfds; i++) {
+            if (sendfd(pair[0], fds[i]) < 0) {
+                senderr = errno;
+                sendfailed = targets[i];
+                break;
+            }
+        }
+    }
+
+    if (saferead(pair[0], &reply, sizeof(reply)) != sizeof(reply)) {
+        if (sendfailed >= 0)
+            virReportSystemError(senderr, _("failed to preserve fd %d"),
+                                 sendfailed);
+        else if (senderr)
+            virReportSystemError(senderr, "%s",
+                                 _("cannot pass command to spawn helper"));
+        else
+            virReportSystemError(EIO, "%s",
+                                 _("no reply from spawn helper"));
+        goto cleanup;
+    }
+
+    if (reply.pid <= 0) {
+        virCommandSpawnReportError(&reply);
+        goto cleanup;
+    }
+
+    pid = reply.pid;
+    cmd->spawnfd = pair[0];
+    pair[0] = -1;
+
+    virMutexLock(&spawnServerLock);
+    spawnServerCount++;
+    virMutexUnlock(&spawnServerLock);
+
+ cleanup:
+    VIR_FORCE_CLOSE(pair[0]);
+    VIR_FORCE_CLOSE(pair[1]);
+    VIR_FREE(targets);
+    VIR_FREE(fds);
+    VIR_FREE(data);
+    return pid;
+}
+
+
+/*
+ * virCommandSpawnAbort:
+ * @cmd: command started through the spawn helper
+ *
+ * Kill the child unless the helper has reported it gone already, in
+ * which case its PID may have been reused.
+ */
+static void
+virCommandSpawnAbort(virCommandPtr cmd)
+{
+    struct pollfd pfd = { .fd = cmd->spawnfd, .events = POLLIN };
+    int saved_errno = errno;
+
+    if (poll(&pfd, 1, 0) == 0)
+        ignore_value(kill(cmd->pid, SIGKILL));
+    VIR_FORCE_CLOSE(cmd->spawnfd);
+    errno = saved_errno;
+}
+
 /*
  * virExec:
  * @cmd virCommandPtr containing all information about the program to
@@ -584,13 +1329,20 @@ virExec(virCommandPtr cmd)
         childerr = null;
     }
 
-    if ((ngroups = virGetGroupList(cmd->uid, cmd->gid, &groups)) < 0)
+    pid = 0;
+    if (virCommandSpawnUsable(cmd) &&
+        (pid = virCommandSpawn(cmd, binary, childin, childout, childerr)) < 0)
         goto cleanup;
 
-    pid = virFork();
+    if (pid == 0) {
+        if ((ngroups = virGetGroupList(cmd->uid, cmd->gid, &groups)) < 0)
+            goto cleanup;
 
-    if (pid < 0)
-        goto cleanup;
+        pid = virFork();
+
+        if (pid < 0)
+            goto cleanup;
+    }
 
     if (pid) { /* parent */
         VIR_FORCE_CLOSE(null);
@@ -871,6 +1623,31 @@ virFork(void)
     return -1;
 }
 
+int
+virCommandSpawnServerStart(void)
+{
+    virReportSystemError(ENOSYS, "%s",
+                         _("spawn helper is not supported on this platform"));
+    return -1;
+}
+
+void
+virCommandSpawnServerStop(void)
+{
+}
+
+pid_t
+virCommandSpawnServerGetPid(void)
+{
+    return -1;
+}
+
+size_t
+virCommandSpawnServerGetCount(void)
+{
+    return 0;
+}
+
 #endif /* WIN32 */
 
 
@@ -913,6 +1690,7 @@ virCommandNewArgs(const char *const*args)
 
     cmd->infd = cmd->inpipe = cmd->outfd = cmd->errfd = -1;
     cmd->pid = -1;
+    cmd->spawnfd = -1;
     cmd->uid = -1;
     cmd->gid = -1;
 
@@ -2474,7 +3252,12 @@ virCommandRunAsync(virCommandPtr cmd, pid_t *pid)
     }
 
     VIR_DEBUG("About to run %s", str ? str : cmd->args[0]);
+    /* The spawn helper reaps its children itself, so only commands
+     * whose PID is never handed out to the caller can use it */
+    if (synchronous)
+        cmd->flags |= VIR_EXEC_SPAWN;
     ret = virExec(cmd);
+    cmd->flags &= ~VIR_EXEC_SPAWN;
     VIR_DEBUG("Command result %d, with PID %d",
               ret, (int)cmd->pid);
 
@@ -2517,6 +3300,33 @@ virCommandRunAsync(virCommandPtr cmd, pid_t *pid)
 }
 
 
+/*
+ * virCommandSpawnWait:
+ * @cmd: command started through the spawn helper
+ * @status: filled with the raw wait status
+ *
+ * Wait for the spawn helper to report the child of @cmd gone.
+ */
+static int
+virCommandSpawnWait(virCommandPtr cmd,
+                    int *status)
+{
+    ssize_t rc = saferead(cmd->spawnfd, status, sizeof(*status));
+    int saved_errno = errno;
+
+    VIR_FORCE_CLOSE(cmd->spawnfd);
+
+    if (rc != sizeof(*status)) {
+        virReportSystemError(rc < 0 ? saved_errno : EIO,
+                             _("unable to wait for process %lld"),
+                             (long long) cmd->pid);
+        return -1;
+    }
+
+    return 0;
+}
+
+
 /**
  * virCommandWait:
  * @cmd: command to wait on
@@ -2568,7 +3378,10 @@ virCommandWait(virCommandPtr cmd, int *exitstatus)
      * message is not as detailed as what we can provide.  So, we
      * guarantee that virProcessWait only fails due to failure to wait,
      * and repeat the exitstatus check code ourselves.  */
-    ret = virProcessWait(cmd->pid, &status, true);
+    if (cmd->spawnfd >= 0)
+        ret = virCommandSpawnWait(cmd, &status);
+    else
+        ret = virProcessWait(cmd->pid, &status, true);
     if (cmd->flags & VIR_EXEC_ASYNC_IO) {
         cmd->flags &= ~VIR_EXEC_ASYNC_IO;
         virThreadJoin(cmd->asyncioThread);
@@ -2623,7 +3436,10 @@ virCommandAbort(virCommandPtr cmd)
 {
     if (!cmd || cmd->pid == -1)
         return;
-    virProcessAbort(cmd->pid);
+    if (cmd->spawnfd >= 0)
+        virCommandSpawnAbort(cmd);
+    else
+        virProcessAbort(cmd->pid);
     cmd->pid = -1;
     cmd->reap = false;
 }
@@ -2836,6 +3652,7 @@ virCommandFree(virCommandPtr cmd)
 
     if (cmd->reap)
         virCommandAbort(cmd);
+    VIR_FORCE_CLOSE(cmd->spawnfd);
 
 #if defined(WITH_SECDRIVER_SELINUX)
     VIR_FREE(cmd->seLinuxLabel);
@@ -198,6 +198,10 @@ void virCommandFree(virCommandPtr cmd);
 
 void virCommandDoAsyncIO(virCommandPtr cmd);
 
+int virCommandSpawnServerStart(void);
+
+void virCommandSpawnServerStop(void);
+
 typedef int (*virCommandRunRegexFunc)(char **const groups,
                                       void *data);
 typedef int (*virCommandRunNulFunc)(size_t n_tokens,
@@ -40,4 +40,8 @@ void virCommandSetDryRun(virBufferPtr buf,
                          virCommandDryRunCallback cb,
                          void *opaque);
 
+pid_t virCommandSpawnServerGetPid(void);
+
+size_t virCommandSpawnServerGetCount(void);
+
 #endif /* __VIR_COMMAND_PRIV_H__ */
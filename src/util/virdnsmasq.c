@@ -45,6 +45,7 @@
 #include "virerror.h"
 #include "virlog.h"
 #include "virfile.h"
+#include "virhash.h"
 #include "virstring.h"
 
 #define VIR_FROM_THIS VIR_FROM_NETWORK
@@ -53,11 +54,15 @@ VIR_LOG_INIT("util.dnsmasq");
 
 #define DNSMASQ_HOSTSFILE_SUFFIX "hostsfile"
 #define DNSMASQ_ADDNHOSTSFILE_SUFFIX "addnhosts"
+#define DNSMASQ_HOSTSDIR_SUFFIX "hostsdir"
+
+#define DNSMASQ_FILE_MAX_LEN (16 * 1024 * 1024)
 
 static void
 dhcphostFree(dnsmasqDhcpHost *host)
 {
     VIR_FREE(host->host);
+    VIR_FREE(host->ip);
 }
 
 static void
@@ -173,96 +178,122 @@ addnhostsNew(const char *name,
     return NULL;
 }
 
+/*
+ * Atomically replace the content of @path, going through @tmp so that
+ * dnsmasq never reads a partially written file. Returns 0 on success
+ * or -errno on failure.
+ */
 static int
-addnhostsWrite(const char *path,
-               dnsmasqAddnHost *hosts,
-               unsigned int nhosts)
+genericFileWrite(const char *path,
+                 const char *tmp,
+                 const char *content)
 {
-    char *tmp;
-    FILE *f;
-    bool istmp = true;
-    size_t i, j;
-    int rc = 0;
+    int err;
 
-    /* even if there are 0 hosts, create a 0 length file, to allow
-     * for runtime addition.
-     */
-
-    if (virAsprintf(&tmp, "%s.new", path) < 0)
-        return -ENOMEM;
+    if (virFileWriteStr(tmp, content, 0644) < 0) {
+        err = errno;
+        unlink(tmp);
 
-    if (!(f = fopen(tmp, "w"))) {
-        istmp = false;
-        if (!(f = fopen(path, "w"))) {
-            rc = -errno;
-            goto cleanup;
-        }
+        /* not being able to create the temporary file should not
+         * stop us from updating the config file itself */
+        if (virFileWriteStr(path, content, 0644) < 0)
+            return -(errno ? errno : err);
+        return 0;
     }
 
-    for (i = 0; i < nhosts; i++) {
-        if (fputs(hosts[i].ip, f) == EOF || fputc('\t', f) == EOF) {
-            rc = -errno;
-            VIR_FORCE_FCLOSE(f);
-
-            if (istmp)
-                unlink(tmp);
-
-            goto cleanup;
-        }
-
-        for (j = 0; j < hosts[i].nhostnames; j++) {
-            if (fputs(hosts[i].hostnames[j], f) == EOF || fputc('\t', f) == EOF) {
-                rc = -errno;
-                VIR_FORCE_FCLOSE(f);
-
-                if (istmp)
-                    unlink(tmp);
+    if (rename(tmp, path) < 0) {
+        err = errno;
+        unlink(tmp);
+        return -err;
+    }
 
-                goto cleanup;
-            }
-        }
+    return 0;
+}
 
-        if (fputc('\n', f) == EOF) {
-            rc = -errno;
-            VIR_FORCE_FCLOSE(f);
+/*
+ * genericFileSave:
+ * @path: config file to save
+ * @tmp: temporary file to write through, or NULL for "@path.new"
+ * @content: the wanted content of @path
+ * @changed: set to true if @path had to be (re)written, may be NULL
+ *
+ * Files which already hold @content are left untouched, so that
+ * dnsmasq is only made to re-read what actually changed.
+ */
+static int
+genericFileSave(const char *path,
+                const char *tmp,
+                const char *content,
+                bool *changed)
+{
+    char *newtmp = NULL;
+    char *old = NULL;
+    int err;
+    int ret = -1;
 
-            if (istmp)
-                unlink(tmp);
+    if (virFileReadAllQuiet(path, DNSMASQ_FILE_MAX_LEN, &old) >= 0 &&
+        STREQ(old, content)) {
+        if (changed)
+            *changed = false;
+        ret = 0;
+        goto cleanup;
+    }
 
+    if (!tmp) {
+        if (virAsprintf(&newtmp, "%s.new", path) < 0)
             goto cleanup;
-        }
+        tmp = newtmp;
     }
 
-    if (VIR_FCLOSE(f) == EOF) {
-        rc = -errno;
+    if ((err = genericFileWrite(path, tmp, content)) < 0) {
+        virReportSystemError(-err, _("cannot write config file '%s'"),
+                             path);
         goto cleanup;
     }
 
-    if (istmp && rename(tmp, path) < 0) {
-        rc = -errno;
-        unlink(tmp);
-        goto cleanup;
-    }
+    if (changed)
+        *changed = true;
+    ret = 0;
 
  cleanup:
-    VIR_FREE(tmp);
+    VIR_FREE(newtmp);
+    VIR_FREE(old);
+    return ret;
+}
 
-    return rc;
+static void
+addnhostsFormat(virBufferPtr buf,
+                dnsmasqAddnHost *hosts,
+                unsigned int nhosts)
+{
+    size_t i, j;
+
+    for (i = 0; i < nhosts; i++) {
+        virBufferAsprintf(buf, "%s\t", hosts[i].ip);
+
+        for (j = 0; j < hosts[i].nhostnames; j++)
+            virBufferAsprintf(buf, "%s\t", hosts[i].hostnames[j]);
+
+        virBufferAddChar(buf, '\n');
+    }
 }
 
 static int
-addnhostsSave(dnsmasqAddnHostsfile *addnhostsfile)
+addnhostsSave(dnsmasqAddnHostsfile *addnhostsfile,
+              bool *changed)
 {
-    int err = addnhostsWrite(addnhostsfile->path, addnhostsfile->hosts,
-                             addnhostsfile->nhosts);
+    virBuffer buf = VIR_BUFFER_INITIALIZER;
+    int ret;
 
-    if (err < 0) {
-        virReportSystemError(-err, _("cannot write config file '%s'"),
-                             addnhostsfile->path);
+    addnhostsFormat(&buf, addnhostsfile->hosts, addnhostsfile->nhosts);
+
+    if (virBufferCheckError(&buf) < 0)
         return -1;
-    }
 
-    return 0;
+    ret = genericFileSave(addnhostsfile->path, NULL,
+                          virBufferCurrentContent(&buf), changed);
+    virBufferFreeAndReset(&buf);
+    return ret;
 }
 
 static int
@@ -295,6 +326,7 @@ hostsfileFree(dnsmasqHostsfile *hostsfile)
     }
 
     VIR_FREE(hostsfile->path);
+    VIR_FREE(hostsfile->dir);
 
     VIR_FREE(hostsfile);
 }
@@ -345,7 +377,7 @@ hostsfileAdd(dnsmasqHostsfile *hostsfile,
                         mac, ipstr) < 0)
             goto error;
     }
-    VIR_FREE(ipstr);
+    VIR_STEAL_PTR(hostsfile->hosts[hostsfile->nhosts].ip, ipstr);
 
     hostsfile->nhosts++;
 
@@ -378,6 +410,16 @@ hostsfileNew(const char *name,
 
     if (!(hostsfile->path = virBufferContentAndReset(&buf)))
         goto error;
+
+    virBufferAsprintf(&buf, "%s", config_dir);
+    virBufferEscapeString(&buf, "/%s", name);
+    virBufferAsprintf(&buf, ".%s", DNSMASQ_HOSTSDIR_SUFFIX);
+
+    if (virBufferCheckError(&buf) < 0)
+        goto error;
+
+    if (!(hostsfile->dir = virBufferContentAndReset(&buf)))
+        goto error;
     return hostsfile;
 
  error:
@@ -386,74 +428,145 @@ hostsfileNew(const char *name,
     return NULL;
 }
 
+static void
+hostsfileFormat(virBufferPtr buf,
+                dnsmasqDhcpHost *hosts,
+                unsigned int nhosts,
+                const char *ip)
+{
+    size_t i;
+
+    for (i = 0; i < nhosts; i++) {
+        if (ip && STRNEQ(hosts[i].ip, ip))
+            continue;
+        virBufferAsprintf(buf, "%s\n", hosts[i].host);
+    }
+}
+
+static int
+hostsfileSave(dnsmasqHostsfile *hostsfile,
+              bool *changed)
+{
+    virBuffer buf = VIR_BUFFER_INITIALIZER;
+    int ret;
+
+    hostsfileFormat(&buf, hostsfile->hosts, hostsfile->nhosts, NULL);
+
+    if (virBufferCheckError(&buf) < 0)
+        return -1;
+
+    ret = genericFileSave(hostsfile->path, NULL,
+                          virBufferCurrentContent(&buf), changed);
+    virBufferFreeAndReset(&buf);
+    return ret;
+}
+
+/*
+ * hostsdirSave:
+ * @hostsfile: the DHCP hosts of the network
+ * @reload: set to true if dnsmasq has to be reloaded
+ *
+ * Syncs the dhcp-hostsdir of the network with @hostsfile. The hosts
+ * are stored in one file per IP address, so adding or removing a host
+ * only ever touches its own file. dnsmasq watches the directory with
+ * inotify and picks up new hosts by itself, but it never forgets hosts
+ * whose file got changed or removed, which still needs a reload.
+ */
 static int
-hostsfileWrite(const char *path,
-               dnsmasqDhcpHost *hosts,
-               unsigned int nhosts)
+hostsdirSave(dnsmasqHostsfile *hostsfile,
+             bool *reload)
 {
-    char *tmp;
-    FILE *f;
-    bool istmp = true;
+    virHashTablePtr ips = NULL;
+    DIR *dir = NULL;
+    struct dirent *ent;
+    char *path = NULL;
+    char *tmp = NULL;
     size_t i;
-    int rc = 0;
+    int rc;
+    int ret = -1;
 
-    /* even if there are 0 hosts, create a 0 length file, to allow
-     * for runtime addition.
-     */
+    if (virFileMakePath(hostsfile->dir) < 0) {
+        virReportSystemError(errno, _("cannot create config directory '%s'"),
+                             hostsfile->dir);
+        return -1;
+    }
 
-    if (virAsprintf(&tmp, "%s.new", path) < 0)
-        return -ENOMEM;
+    if (!(ips = virHashCreate(hostsfile->nhosts + 1, NULL)))
+        return -1;
 
-    if (!(f = fopen(tmp, "w"))) {
-        istmp = false;
-        if (!(f = fopen(path, "w"))) {
-            rc = -errno;
+    for (i = 0; i < hostsfile->nhosts; i++) {
+        if (virHashUpdateEntry(ips, hostsfile->hosts[i].ip, hostsfile) < 0)
             goto cleanup;
-        }
     }
 
-    for (i = 0; i < nhosts; i++) {
-        if (fputs(hosts[i].host, f) == EOF || fputc('\n', f) == EOF) {
-            rc = -errno;
-            VIR_FORCE_FCLOSE(f);
+    if (virDirOpen(&dir, hostsfile->dir) < 0)
+        goto cleanup;
 
-            if (istmp)
-                unlink(tmp);
+    /* drop the files of hosts which are gone */
+    while ((rc = virDirRead(dir, &ent, hostsfile->dir)) > 0) {
+        if (ent->d_name[0] != '.' && virHashLookup(ips, ent->d_name))
+            continue;
 
+        if (virAsprintf(&path, "%s/%s", hostsfile->dir, ent->d_name) < 0)
+            goto cleanup;
+
+        if (unlink(path) < 0 && errno != ENOENT) {
+            virReportSystemError(errno, _("cannot remove config file '%s'"),
+                                 path);
             goto cleanup;
         }
-    }
 
-    if (VIR_FCLOSE(f) == EOF) {
-        rc = -errno;
-        goto cleanup;
+        /* leftovers of an interrupted write were never read by dnsmasq */
+        if (ent->d_name[0] != '.')
+            *reload = true;
+        VIR_FREE(path);
     }
-
-    if (istmp && rename(tmp, path) < 0) {
-        rc = -errno;
-        unlink(tmp);
+    if (rc < 0)
         goto cleanup;
-    }
 
- cleanup:
-    VIR_FREE(tmp);
+    for (i = 0; i < hostsfile->nhosts; i++) {
+        const char *ip = hostsfile->hosts[i].ip;
+        virBuffer buf = VIR_BUFFER_INITIALIZER;
+        bool existed;
+        bool changed;
 
-    return rc;
-}
+        /* hosts sharing an IP address share a file */
+        if (!virHashLookup(ips, ip))
+            continue;
+        ignore_value(virHashRemoveEntry(ips, ip));
 
-static int
-hostsfileSave(dnsmasqHostsfile *hostsfile)
-{
-    int err = hostsfileWrite(hostsfile->path, hostsfile->hosts,
-                             hostsfile->nhosts);
+        hostsfileFormat(&buf, hostsfile->hosts, hostsfile->nhosts, ip);
+        if (virBufferCheckError(&buf) < 0)
+            goto cleanup;
 
-    if (err < 0) {
-        virReportSystemError(-err, _("cannot write config file '%s'"),
-                             hostsfile->path);
-        return -1;
+        /* dnsmasq ignores hidden files in the directory */
+        if (virAsprintf(&path, "%s/%s", hostsfile->dir, ip) < 0 ||
+            virAsprintf(&tmp, "%s/.%s.new", hostsfile->dir, ip) < 0) {
+            virBufferFreeAndReset(&buf);
+            goto cleanup;
+        }
+
+        existed = virFileExists(path);
+        rc = genericFileSave(path, tmp, virBufferCurrentContent(&buf),
+                             &changed);
+        virBufferFreeAndReset(&buf);
+        if (rc < 0)
+            goto cleanup;
+
+        if (existed && changed)
+            *reload = true;
+        VIR_FREE(path);
+        VIR_FREE(tmp);
     }
 
-    return 0;
+    ret = 0;
+
+ cleanup:
+    VIR_DIR_CLOSE(dir);
+    virHashFree(ips);
+    VIR_FREE(path);
+    VIR_FREE(tmp);
+    return ret;
 }
 
 /**
@@ -547,15 +660,38 @@ dnsmasqAddHost(dnsmasqContext *ctx,
 }
 
 /**
- * dnsmasqSave:
+ * dnsmasqUseHostsdir:
  * @ctx: pointer to the dnsmasq context for each network
+ * @use: whether to store DHCP hosts in a dhcp-hostsdir
  *
- * Saves all the configurations associated with a context to disk.
+ * Selects between a single dhcp-hostsfile and a dhcp-hostsdir with one
+ * file per host for the DHCP hosts of the network. The latter must only
+ * be used if dnsmasq supports DNSMASQ_CAPS_DHCP_HOSTSDIR.
+ */
+void
+dnsmasqUseHostsdir(dnsmasqContext *ctx,
+                   bool use)
+{
+    if (ctx->hostsfile)
+        ctx->hostsfile->usedir = use;
+}
+
+/**
+ * dnsmasqUpdate:
+ * @ctx: pointer to the dnsmasq context for each network
+ * @reload: set to true if dnsmasq has to be reloaded
+ *
+ * Updates the configuration files associated with a context on disk,
+ * rewriting only those whose content changed. @reload is set to false
+ * when the running dnsmasq picks up all the changes by itself.
  */
 int
-dnsmasqSave(const dnsmasqContext *ctx)
+dnsmasqUpdate(const dnsmasqContext *ctx,
+              bool *reload)
 {
-    int ret = 0;
+    bool changed;
+
+    *reload = false;
 
     if (virFileMakePath(ctx->config_dir) < 0) {
         virReportSystemError(errno, _("cannot create config directory '%s'"),
@@ -563,14 +699,50 @@ dnsmasqSave(const dnsmasqContext *ctx)
         return -1;
     }
 
-    if (ctx->hostsfile)
-        ret = hostsfileSave(ctx->hostsfile);
-    if (ret == 0) {
-        if (ctx->addnhostsfile)
-            ret = addnhostsSave(ctx->addnhostsfile);
+    if (ctx->hostsfile) {
+        if (ctx->hostsfile->usedir) {
+            if (hostsdirSave(ctx->hostsfile, reload) < 0)
+                return -1;
+        } else {
+            if (hostsfileSave(ctx->hostsfile, &changed) < 0)
+                return -1;
+            if (changed)
+                *reload = true;
+        }
     }
 
-    return ret;
+    if (ctx->addnhostsfile) {
+        if (addnhostsSave(ctx->addnhostsfile, &changed) < 0)
+            return -1;
+        if (changed)
+            *reload = true;
+    }
+
+    return 0;
+}
+
+/**
+ * dnsmasqSave:
+ * @ctx: pointer to the dnsmasq context for each network
+ *
+ * Saves all the configurations associated with a context to disk.
+ */
+int
+dnsmasqSave(const dnsmasqContext *ctx)
+{
+    bool reload;
+
+    if (dnsmasqUpdate(ctx, &reload) < 0)
+        return -1;
+
+    /* remove the DHCP hosts left behind by the other layout */
+    if (ctx->hostsfile) {
+        if (ctx->hostsfile->usedir)
+            return genericFileDelete(ctx->hostsfile->path);
+        return virFileDeleteTree(ctx->hostsfile->dir);
+    }
+
+    return 0;
 }
 
 
@@ -585,8 +757,11 @@ dnsmasqDelete(const dnsmasqContext *ctx)
 {
     int ret = 0;
 
-    if (ctx->hostsfile)
+    if (ctx->hostsfile) {
         ret = genericFileDelete(ctx->hostsfile->path);
+        if (virFileDeleteTree(ctx->hostsfile->dir) < 0)
+            ret = -1;
+    }
     if (ctx->addnhostsfile)
         ret = genericFileDelete(ctx->addnhostsfile->path);
 
@@ -691,13 +866,18 @@ dnsmasqCapsSetFromBuffer(dnsmasqCapsPtr caps, const char *buf)
     if (strstr(buf, "--ra-param"))
         dnsmasqCapsSet(caps, DNSMASQ_CAPS_RA_PARAM);
 
+    if (strstr(buf, "--dhcp-hostsdir"))
+        dnsmasqCapsSet(caps, DNSMASQ_CAPS_DHCP_HOSTSDIR);
+
     VIR_INFO("dnsmasq version is %d.%d, --bind-dynamic is %spresent, "
-             "SO_BINDTODEVICE is %sin use, --ra-param is %spresent",
+             "SO_BINDTODEVICE is %sin use, --ra-param is %spresent, "
+             "--dhcp-hostsdir is %spresent",
              (int)caps->version / 1000000,
              (int)(caps->version % 1000000) / 1000,
              dnsmasqCapsGet(caps, DNSMASQ_CAPS_BIND_DYNAMIC) ? "" : "NOT ",
              dnsmasqCapsGet(caps, DNSMASQ_CAPS_BINDTODEVICE) ? "" : "NOT ",
-             dnsmasqCapsGet(caps, DNSMASQ_CAPS_RA_PARAM) ? "" : "NOT ");
+             dnsmasqCapsGet(caps, DNSMASQ_CAPS_RA_PARAM) ? "" : "NOT ",
+             dnsmasqCapsGet(caps, DNSMASQ_CAPS_DHCP_HOSTSDIR) ? "" : "NOT ");
     return 0;
 
  fail:
@@ -34,6 +34,7 @@ typedef struct
      * "01:23:45:67:89:0a,foo,10.0.0.3".
      */
     char *host;
+    char *ip;    /* names the host's file in a dhcp-hostsdir */
 
 } dnsmasqDhcpHost;
 
@@ -43,6 +44,8 @@ typedef struct
     dnsmasqDhcpHost *hosts;
 
     char            *path;  /* Absolute path of dnsmasq's hostsfile. */
+    char            *dir;   /* Absolute path of dnsmasq's hostsdir. */
+    bool             usedir;
 } dnsmasqHostsfile;
 
 typedef struct
@@ -72,6 +75,7 @@ typedef enum {
    DNSMASQ_CAPS_BIND_DYNAMIC = 0, /* support for --bind-dynamic */
    DNSMASQ_CAPS_BINDTODEVICE = 1, /* uses SO_BINDTODEVICE for --bind-interfaces */
    DNSMASQ_CAPS_RA_PARAM = 2,     /* support for --ra-param */
+   DNSMASQ_CAPS_DHCP_HOSTSDIR = 3, /* support for --dhcp-hostsdir */
 
    DNSMASQ_CAPS_LAST,             /* this must always be the last item */
 } dnsmasqCapsFlags;
@@ -92,7 +96,11 @@ int              dnsmasqAddDhcpHost(dnsmasqContext *ctx,
 int              dnsmasqAddHost(dnsmasqContext *ctx,
                                 virSocketAddr *ip,
                                 const char *name);
+void             dnsmasqUseHostsdir(dnsmasqContext *ctx,
+                                    bool use);
 int              dnsmasqSave(const dnsmasqContext *ctx);
+int              dnsmasqUpdate(const dnsmasqContext *ctx,
+                               bool *reload);
 int              dnsmasqDelete(const dnsmasqContext *ctx);
 int              dnsmasqReload(pid_t pid);
 
@@ -25,12 +25,20 @@
 #include "virlease.h"
 
 #include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#if HAVE_MMAP
+# include <sys/mman.h>
+#endif
 
 #include "virfile.h"
 #include "virstring.h"
 #include "virerror.h"
 #include "viralloc.h"
 #include "virutil.h"
+#include "virsocketaddr.h"
+#include "stat-time.h"
 
 #define VIR_FROM_THIS VIR_FROM_NETWORK
 
@@ -295,3 +303,466 @@ virLeaseNew(virJSONValuePtr *lease_ret,
     virJSONValueFree(lease_new);
     return ret;
 }
+
+
+/*
+ * Lease index
+ *
+ * The custom leases file is a JSON array which has to be parsed as a
+ * whole to look up a single lease. To make lookups from the NSS module
+ * cheap, the leases helper writes next to each $interface.status file an
+ * $interface.index file which is a header followed by an array of fixed
+ * size records sorted by hostname and an array of record indexes sorted
+ * by MAC address. Both can be binary searched directly in the mmap()-ed
+ * file. The header records the identity of the .status file the index was
+ * generated from so that readers can detect a stale index and fall back
+ * to parsing the JSON.
+ */
+#define VIR_LEASE_INDEX_MAGIC "LVLIDX\0\0"
+#define VIR_LEASE_INDEX_VERSION 1
+#define VIR_LEASE_INDEX_SIZE_MAX (64 * 1024 * 1024)
+
+typedef struct _virLeaseIndexHeader virLeaseIndexHeader;
+typedef virLeaseIndexHeader *virLeaseIndexHeaderPtr;
+struct _virLeaseIndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint64_t nrecords;
+
+    /* identity of the .status file this index was generated from */
+    uint64_t statusDev;
+    uint64_t statusIno;
+    uint64_t statusSize;
+    int64_t statusMtimeSec;
+    int64_t statusMtimeNsec;
+};
+
+struct _virLeaseIndex {
+    void *map;
+    size_t mapLen;
+
+    const virLeaseIndexHeader *header;
+    const virLeaseIndexRecord *records; /* sorted by hostname */
+    const uint32_t *macOrder; /* indexes to @records, sorted by MAC */
+};
+
+
+/**
+ * virLeaseIndexFileName:
+ * @status_file: path to the custom leases file
+ *
+ * Returns the path of the index kept next to @status_file, or NULL
+ * on OOM (without reporting an error).
+ */
+char *
+virLeaseIndexFileName(const char *status_file)
+{
+    char *ret = NULL;
+    size_t len = strlen(status_file);
+
+    if (virFileHasSuffix(status_file, ".status"))
+        len -= strlen(".status");
+
+    ignore_value(virAsprintfQuiet(&ret, "%.*s.index", (int) len, status_file));
+    return ret;
+}
+
+
+/**
+ * virLeaseDeleteFile:
+ * @status_file: path to the custom leases file
+ *
+ * Remove @status_file together with its index.
+ */
+void
+virLeaseDeleteFile(const char *status_file)
+{
+    char *index_file;
+
+    unlink(status_file);
+
+    if ((index_file = virLeaseIndexFileName(status_file))) {
+        unlink(index_file);
+        VIR_FREE(index_file);
+    }
+}
+
+
+static void
+virLeaseIndexHeaderSetStatus(virLeaseIndexHeaderPtr header,
+                             const struct stat *sb)
+{
+    struct timespec mtime = get_stat_mtime(sb);
+
+    header->statusDev = sb->st_dev;
+    header->statusIno = sb->st_ino;
+    header->statusSize = sb->st_size;
+    header->statusMtimeSec = mtime.tv_sec;
+    header->statusMtimeNsec = mtime.tv_nsec;
+}
+
+
+static int
+virLeaseIndexRecordCompareHostname(const void *a,
+                                   const void *b)
+{
+    const virLeaseIndexRecord *ra = a;
+    const virLeaseIndexRecord *rb = b;
+
+    return strcmp(ra->hostname, rb->hostname);
+}
+
+
+typedef struct _virLeaseIndexWriteData virLeaseIndexWriteData;
+struct _virLeaseIndexWriteData {
+    virLeaseIndexHeader header;
+    virLeaseIndexRecord *records;
+    uint32_t *macOrder;
+};
+
+
+static int
+virLeaseIndexRecordCompareMAC(const void *a,
+                              const void *b)
+{
+    const virLeaseIndexRecord *const *ra = a;
+    const virLeaseIndexRecord *const *rb = b;
+
+    return strcmp((*ra)->mac, (*rb)->mac);
+}
+
+
+static int
+virLeaseIndexWriteFile(int fd,
+                       const void *opaque)
+{
+    const virLeaseIndexWriteData *data = opaque;
+    size_t n = data->header.nrecords;
+
+    if (safewrite(fd, &data->header, sizeof(data->header)) < 0 ||
+        (n && safewrite(fd, data->records, n * sizeof(*data->records)) < 0) ||
+        (n && safewrite(fd, data->macOrder, n * sizeof(*data->macOrder)) < 0))
+        return -1;
+
+    return 0;
+}
+
+
+static int
+virLeaseIndexRecordFill(virLeaseIndexRecordPtr rec,
+                        virJSONValuePtr lease)
+{
+    const char *ip;
+    const char *mac;
+    const char *hostname;
+    long long expirytime;
+    virSocketAddr sa;
+
+    if (!(ip = virJSONValueObjectGetString(lease, "ip-address")) ||
+        virJSONValueObjectGetNumberLong(lease, "expiry-time", &expirytime) < 0 ||
+        virSocketAddrParse(&sa, ip, AF_UNSPEC) < 0)
+        return -1;
+
+    mac = virJSONValueObjectGetString(lease, "mac-address");
+    hostname = virJSONValueObjectGetString(lease, "hostname");
+
+    /* Nothing that could be looked up by the NSS module can have such a
+     * long name, don't bother indexing it. */
+    if ((hostname && strlen(hostname) >= sizeof(rec->hostname)) ||
+        (mac && strlen(mac) >= sizeof(rec->mac)))
+        return 1;
+
+    memset(rec, 0, sizeof(*rec));
+    if (hostname)
+        strcpy(rec->hostname, hostname);
+    if (mac)
+        strcpy(rec->mac, mac);
+    rec->expirytime = expirytime;
+
+    if (VIR_SOCKET_ADDR_IS_FAMILY(&sa, AF_INET)) {
+        rec->family = AF_INET;
+        memcpy(rec->addr, &sa.data.inet4.sin_addr.s_addr, 4);
+    } else {
+        rec->family = AF_INET6;
+        memcpy(rec->addr, &sa.data.inet6.sin6_addr.s6_addr, 16);
+    }
+
+    return 0;
+}
+
+
+/**
+ * virLeaseWriteIndex:
+ * @leases_array: leases as stored in @status_file
+ * @status_file: path to the custom leases file
+ *
+ * Writes the lease index for @status_file. The index has to be written
+ * after @status_file is updated, as the index is tied to its identity.
+ *
+ * Returns 0 on success, -1 on error with error reported.
+ */
+int
+virLeaseWriteIndex(virJSONValuePtr leases_array,
+                   const char *status_file)
+{
+    virLeaseIndexWriteData data;
+    virLeaseIndexRecordPtr *byMAC = NULL;
+    char *index_file = NULL;
+    struct stat sb;
+    size_t nleases = virJSONValueArraySize(leases_array);
+    size_t i;
+    int ret = -1;
+
+    memset(&data, 0, sizeof(data));
+
+    if (!(index_file = virLeaseIndexFileName(status_file))) {
+        virReportOOMError();
+        goto cleanup;
+    }
+
+    if (stat(status_file, &sb) < 0) {
+        virReportSystemError(errno, _("unable to stat: %s"), status_file);
+        goto cleanup;
+    }
+
+    if (VIR_ALLOC_N(data.records, nleases) < 0 ||
+        VIR_ALLOC_N(data.macOrder, nleases) < 0 ||
+        VIR_ALLOC_N(byMAC, nleases) < 0)
+        goto cleanup;
+
+    for (i = 0; i < nleases; i++) {
+        virJSONValuePtr lease = virJSONValueArrayGet(leases_array, i);
+        virLeaseIndexRecordPtr rec = &data.records[data.header.nrecords];
+
+        if (!lease || virLeaseIndexRecordFill(rec, lease) != 0)
+            continue;
+
+        data.header.nrecords++;
+    }
+
+    qsort(data.records, data.header.nrecords, sizeof(*data.records),
+          virLeaseIndexRecordCompareHostname);
+
+    for (i = 0; i < data.header.nrecords; i++)
+        byMAC[i] = &data.records[i];
+    qsort(byMAC, data.header.nrecords, sizeof(*byMAC),
+          virLeaseIndexRecordCompareMAC);
+    for (i = 0; i < data.header.nrecords; i++)
+        data.macOrder[i] = byMAC[i] - data.records;
+
+    memcpy(data.header.magic, VIR_LEASE_INDEX_MAGIC, sizeof(data.header.magic));
+    data.header.version = VIR_LEASE_INDEX_VERSION;
+    data.header.recordSize = sizeof(virLeaseIndexRecord);
+    virLeaseIndexHeaderSetStatus(&data.header, &sb);
+
+    if (virFileRewrite(index_file, 0644, virLeaseIndexWriteFile, &data) < 0)
+        goto cleanup;
+
+    ret = 0;
+ cleanup:
+    VIR_FREE(data.records);
+    VIR_FREE(data.macOrder);
+    VIR_FREE(byMAC);
+    VIR_FREE(index_file);
+    return ret;
+}
+
+
+#if HAVE_MMAP
+/**
+ * virLeaseIndexOpen:
+ * @status_file: path to the custom leases file
+ *
+ * Maps the lease index for @status_file into memory. This function is
+ * meant to be used from the NSS module and thus reports no errors.
+ *
+ * Returns the index, or NULL if it is missing, corrupted or was not
+ * generated from the current @status_file.
+ */
+virLeaseIndexPtr
+virLeaseIndexOpen(const char *status_file)
+{
+    virLeaseIndexPtr idx = NULL;
+    virLeaseIndexHeader expect;
+    char *index_file = NULL;
+    struct stat sb;
+    int fd = -1;
+    uint64_t n;
+
+    memset(&expect, 0, sizeof(expect));
+
+    if (!(index_file = virLeaseIndexFileName(status_file)))
+        goto error;
+
+    if (stat(status_file, &sb) < 0)
+        goto error;
+    virLeaseIndexHeaderSetStatus(&expect, &sb);
+
+    if ((fd = open(index_file, O_RDONLY | O_CLOEXEC)) < 0 ||
+        fstat(fd, &sb) < 0 ||
+        sb.st_size < (off_t) sizeof(virLeaseIndexHeader) ||
+        sb.st_size > VIR_LEASE_INDEX_SIZE_MAX)
+        goto error;
+
+    if (VIR_ALLOC_QUIET(idx) < 0)
+        goto error;
+
+    idx->mapLen = sb.st_size;
+    if ((idx->map = mmap(NULL, idx->mapLen, PROT_READ,
+                         MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+        idx->map = NULL;
+        goto error;
+    }
+
+    idx->header = idx->map;
+    n = idx->header->nrecords;
+
+    if (memcmp(idx->header->magic, VIR_LEASE_INDEX_MAGIC,
+               sizeof(idx->header->magic)) != 0 ||
+        idx->header->version != VIR_LEASE_INDEX_VERSION ||
+        idx->header->recordSize != sizeof(virLeaseIndexRecord) ||
+        n > VIR_LEASE_INDEX_SIZE_MAX / sizeof(virLeaseIndexRecord) ||
+        idx->mapLen != sizeof(virLeaseIndexHeader) +
+                       n * (sizeof(virLeaseIndexRecord) + sizeof(uint32_t)))
+        goto error;
+
+    if (idx->header->statusDev != expect.statusDev ||
+        idx->header->statusIno != expect.statusIno ||
+        idx->header->statusSize != expect.statusSize ||
+        idx->header->statusMtimeSec != expect.statusMtimeSec ||
+        idx->header->statusMtimeNsec != expect.statusMtimeNsec)
+        goto error;
+
+    idx->records = (const virLeaseIndexRecord *) (idx->header + 1);
+    idx->macOrder = (const uint32_t *) (idx->records + n);
+
+    VIR_FORCE_CLOSE(fd);
+    VIR_FREE(index_file);
+    return idx;
+
+ error:
+    VIR_FORCE_CLOSE(fd);
+    VIR_FREE(index_file);
+    virLeaseIndexFree(idx);
+    return NULL;
+}
+
+
+void
+virLeaseIndexFree(virLeaseIndexPtr idx)
+{
+    if (!idx)
+        return;
+
+    if (idx->map)
+        munmap(idx->map, idx->mapLen);
+    VIR_FREE(idx);
+}
+
+#else /* !HAVE_MMAP */
+
+virLeaseIndexPtr
+virLeaseIndexOpen(const char *status_file ATTRIBUTE_UNUSED)
+{
+    return NULL;
+}
+
+
+void
+virLeaseIndexFree(virLeaseIndexPtr idx)
+{
+    VIR_FREE(idx);
+}
+#endif /* !HAVE_MMAP */
+
+
+/**
+ * virLeaseIndexForEachHostname:
+ * @idx: lease index
+ * @hostname: hostname to look up
+ * @iter: callback
+ * @opaque: opaque data passed to @iter
+ *
+ * Calls @iter on every lease of @hostname.
+ *
+ * Returns 0 on success, or the first negative value returned by @iter.
+ */
+int
+virLeaseIndexForEachHostname(virLeaseIndexPtr idx,
+                             const char *hostname,
+                             virLeaseIndexIterator iter,
+                             void *opaque)
+{
+    size_t lo = 0;
+    size_t hi = idx->header->nrecords;
+    int rc;
+
+    /* find the first record not sorting before @hostname */
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (strcmp(idx->records[mid].hostname, hostname) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    for (; lo < idx->header->nrecords; lo++) {
+        if (STRNEQ(idx->records[lo].hostname, hostname))
+            break;
+        if ((rc = iter(&idx->records[lo], opaque)) < 0)
+            return rc;
+    }
+
+    return 0;
+}
+
+
+/**
+ * virLeaseIndexForEachMAC:
+ * @idx: lease index
+ * @mac: MAC address to look up
+ * @iter: callback
+ * @opaque: opaque data passed to @iter
+ *
+ * Calls @iter on every lease of @mac.
+ *
+ * Returns 0 on success, or the first negative value returned by @iter.
+ */
+int
+virLeaseIndexForEachMAC(virLeaseIndexPtr idx,
+                        const char *mac,
+                        virLeaseIndexIterator iter,
+                        void *opaque)
+{
+    size_t n = idx->header->nrecords;
+    size_t lo = 0;
+    size_t hi = n;
+    int rc;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (idx->macOrder[mid] >= n)
+            return 0;
+        if (strcmp(idx->records[idx->macOrder[mid]].mac, mac) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    for (; lo < n; lo++) {
+        const virLeaseIndexRecord *rec;
+
+        if (idx->macOrder[lo] >= n)
+            break;
+        rec = &idx->records[idx->macOrder[lo]];
+        if (STRNEQ(rec->mac, mac))
+            break;
+        if ((rc = iter(rec, opaque)) < 0)
+            return rc;
+    }
+
+    return 0;
+}
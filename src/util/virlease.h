@@ -24,6 +24,23 @@
 # define __VIR_LEASE_H_
 
 # include "virjson.h"
+# include "virmacaddr.h"
+
+typedef struct _virLeaseIndex virLeaseIndex;
+typedef virLeaseIndex *virLeaseIndexPtr;
+
+typedef struct _virLeaseIndexRecord virLeaseIndexRecord;
+typedef virLeaseIndexRecord *virLeaseIndexRecordPtr;
+struct _virLeaseIndexRecord {
+    char hostname[256];
+    char mac[VIR_MAC_STRING_BUFLEN];
+    uint8_t family; /* AF_INET or AF_INET6 */
+    unsigned char addr[16]; /* network byte order */
+    int64_t expirytime;
+};
+
+typedef int (*virLeaseIndexIterator)(const virLeaseIndexRecord *record,
+                                     void *opaque);
 
 int virLeaseReadCustomLeaseFile(virJSONValuePtr leases_array_new,
                                 const char *custom_lease_file,
@@ -41,4 +58,22 @@ int virLeaseNew(virJSONValuePtr *lease_ret,
                 const char *hostname,
                 const char *iaid,
                 const char *server_duid);
+
+char *virLeaseIndexFileName(const char *status_file);
+void virLeaseDeleteFile(const char *status_file);
+
+int virLeaseWriteIndex(virJSONValuePtr leases_array,
+                       const char *status_file);
+
+virLeaseIndexPtr virLeaseIndexOpen(const char *status_file);
+void virLeaseIndexFree(virLeaseIndexPtr idx);
+
+int virLeaseIndexForEachHostname(virLeaseIndexPtr idx,
+                                 const char *hostname,
+                                 virLeaseIndexIterator iter,
+                                 void *opaque);
+int virLeaseIndexForEachMAC(virLeaseIndexPtr idx,
+                            const char *mac,
+                            virLeaseIndexIterator iter,
+                            void *opaque);
 #endif /* __VIR_LEASE_H */
@@ -23,6 +23,12 @@
 
 #include <config.h>
 
+#include <fcntl.h>
+#include <sys/stat.h>
+#if HAVE_MMAP
+# include <sys/mman.h>
+#endif
+
 #include "virmacmap.h"
 #include "virobject.h"
 #include "virlog.h"
@@ -31,6 +37,8 @@
 #include "virhash.h"
 #include "virstring.h"
 #include "viralloc.h"
+#include "virmacaddr.h"
+#include "stat-time.h"
 
 #define VIR_FROM_THIS VIR_FROM_NETWORK
 
@@ -43,6 +51,7 @@ VIR_LOG_INIT("util.virmacmap");
  */
 #define VIR_MAC_MAP_FILE_SIZE_MAX (32 * 1024 * 1024)
 
+
 struct virMacMap {
     virObjectLockable parent;
 
@@ -274,11 +283,218 @@ virMacMapDumpStrLocked(virMacMapPtr mgr,
 }
 
 
+/*
+ * Mac map index
+ *
+ * Looking up a domain in the mac maps file means parsing the whole JSON
+ * array. To keep lookups from the NSS module cheap, an index is written
+ * next to the file every time the file is written. It is a header
+ * followed by an array of fixed size (domain, MAC) records sorted by
+ * domain name which can be binary searched directly in the mmap()-ed
+ * file. Like the lease index (see virlease.c), the header records the
+ * identity of the mac maps file the index was generated from so that
+ * readers can detect a stale index and fall back to parsing the JSON.
+ * The JSON file itself is rewritten on every change so that readers
+ * which don't know about the index never see an outdated map.
+ */
+#define VIR_MAC_MAP_INDEX_MAGIC "LVMIDX\0\0"
+#define VIR_MAC_MAP_INDEX_VERSION 1
+
+typedef struct _virMacMapIndexRecord virMacMapIndexRecord;
+typedef virMacMapIndexRecord *virMacMapIndexRecordPtr;
+struct _virMacMapIndexRecord {
+    char domain[256];
+    char mac[VIR_MAC_STRING_BUFLEN];
+};
+
+typedef struct _virMacMapIndexHeader virMacMapIndexHeader;
+typedef virMacMapIndexHeader *virMacMapIndexHeaderPtr;
+struct _virMacMapIndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint64_t nrecords;
+
+    /* identity of the mac maps file this index was generated from */
+    uint64_t fileDev;
+    uint64_t fileIno;
+    uint64_t fileSize;
+    int64_t fileMtimeSec;
+    int64_t fileMtimeNsec;
+};
+
+struct _virMacMapIndex {
+    void *map;
+    size_t mapLen;
+
+    const virMacMapIndexHeader *header;
+    const virMacMapIndexRecord *records; /* sorted by domain */
+};
+
+
+static char *
+virMacMapIndexFileName(const char *file)
+{
+    char *ret = NULL;
+
+    ignore_value(virAsprintfQuiet(&ret, "%s.index", file));
+    return ret;
+}
+
+
+static void
+virMacMapIndexHeaderSetFile(virMacMapIndexHeaderPtr header,
+                            const struct stat *sb)
+{
+    struct timespec mtime = get_stat_mtime(sb);
+
+    header->fileDev = sb->st_dev;
+    header->fileIno = sb->st_ino;
+    header->fileSize = sb->st_size;
+    header->fileMtimeSec = mtime.tv_sec;
+    header->fileMtimeNsec = mtime.tv_nsec;
+}
+
+
+static int
+virMacMapIndexRecordCompare(const void *a,
+                            const void *b)
+{
+    const virMacMapIndexRecord *ra = a;
+    const virMacMapIndexRecord *rb = b;
+    int rc;
+
+    if ((rc = strcmp(ra->domain, rb->domain)) != 0)
+        return rc;
+
+    return strcmp(ra->mac, rb->mac);
+}
+
+
+typedef struct _virMacMapIndexWriteData virMacMapIndexWriteData;
+struct _virMacMapIndexWriteData {
+    virMacMapIndexHeader header;
+    virMacMapIndexRecordPtr records;
+    size_t nrecords;
+    bool skipped;
+};
+
+
+static int
+virMacMapIndexCollect(void *payload,
+                      const void *name,
+                      void *opaque)
+{
+    virMacMapIndexWriteData *data = opaque;
+    const char *const *macs = payload;
+    const char *domain = name;
+    size_t i;
+
+    for (i = 0; macs[i]; i++) {
+        virMacMapIndexRecord rec;
+
+        /* Such a name can't be looked up by the NSS module anyway */
+        if (strlen(domain) >= sizeof(rec.domain) ||
+            strlen(macs[i]) >= sizeof(rec.mac)) {
+            data->skipped = true;
+            continue;
+        }
+
+        memset(&rec, 0, sizeof(rec));
+        strcpy(rec.domain, domain);
+        strcpy(rec.mac, macs[i]);
+
+        if (VIR_APPEND_ELEMENT(data->records, data->nrecords, rec) < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+
+static int
+virMacMapIndexWriteFile(int fd,
+                        const void *opaque)
+{
+    const virMacMapIndexWriteData *data = opaque;
+
+    if (safewrite(fd, &data->header, sizeof(data->header)) < 0 ||
+        (data->nrecords &&
+         safewrite(fd, data->records,
+                   data->nrecords * sizeof(*data->records)) < 0))
+        return -1;
+
+    return 0;
+}
+
+
+/*
+ * Writes the index for @file, which has to be written already.
+ */
+static int
+virMacMapWriteIndexLocked(virMacMapPtr mgr,
+                          const char *file)
+{
+    virMacMapIndexWriteData data;
+    char *index_file = NULL;
+    struct stat sb;
+    int ret = -1;
+
+    memset(&data, 0, sizeof(data));
+
+    if (!(index_file = virMacMapIndexFileName(file))) {
+        virReportOOMError();
+        goto cleanup;
+    }
+
+    if (stat(file, &sb) < 0) {
+        virReportSystemError(errno, _("unable to stat: %s"), file);
+        goto cleanup;
+    }
+
+    if (virHashForEach(mgr->macs, virMacMapIndexCollect, &data) < 0)
+        goto cleanup;
+
+    if (data.skipped) {
+        /* Readers would miss the skipped entries, make them parse the
+         * file instead */
+        VIR_DEBUG("Not indexing %s", file);
+        if (unlink(index_file) < 0 && errno != ENOENT) {
+            virReportSystemError(errno, _("Unable to remove '%s'"),
+                                 index_file);
+            goto cleanup;
+        }
+        ret = 0;
+        goto cleanup;
+    }
+
+    if (data.nrecords)
+        qsort(data.records, data.nrecords, sizeof(*data.records),
+              virMacMapIndexRecordCompare);
+
+    memcpy(data.header.magic, VIR_MAC_MAP_INDEX_MAGIC,
+           sizeof(data.header.magic));
+    data.header.version = VIR_MAC_MAP_INDEX_VERSION;
+    data.header.recordSize = sizeof(virMacMapIndexRecord);
+    data.header.nrecords = data.nrecords;
+    virMacMapIndexHeaderSetFile(&data.header, &sb);
+
+    if (virFileRewrite(index_file, 0644, virMacMapIndexWriteFile, &data) < 0)
+        goto cleanup;
+
+    ret = 0;
+ cleanup:
+    VIR_FREE(data.records);
+    VIR_FREE(index_file);
+    return ret;
+}
+
+
 static int
 virMacMapWriteFileLocked(virMacMapPtr mgr,
                          const char *file)
 {
-    char *str;
+    char *str = NULL;
     int ret = -1;
 
     if (virMacMapDumpStrLocked(mgr, &str) < 0)
@@ -287,6 +503,10 @@ virMacMapWriteFileLocked(virMacMapPtr mgr,
     if (virFileRewriteStr(file, 0644, str) < 0)
         goto cleanup;
 
+    /* The index is tied to the identity of the file just written */
+    if (virMacMapWriteIndexLocked(mgr, file) < 0)
+        goto cleanup;
+
     ret = 0;
  cleanup:
     VIR_FREE(str);
@@ -365,6 +585,90 @@ virMacMapRemove(virMacMapPtr mgr,
 }
 
 
+/**
+ * virMacMapAddPersistent:
+ * @mgr: mac map
+ * @file: mac maps file @mgr was loaded from
+ * @domain: domain name
+ * @mac: MAC address
+ *
+ * Like virMacMapAdd() but also writes the change to @file and its
+ * index before returning, so that any reader of @file sees it.
+ *
+ * Returns 0 on success, -1 otherwise.
+ */
+int
+virMacMapAddPersistent(virMacMapPtr mgr,
+                       const char *file,
+                       const char *domain,
+                       const char *mac)
+{
+    int ret = -1;
+
+    virObjectLock(mgr);
+    if (virMacMapAddLocked(mgr, domain, mac) < 0 ||
+        virMacMapWriteFileLocked(mgr, file) < 0)
+        goto cleanup;
+
+    ret = 0;
+ cleanup:
+    virObjectUnlock(mgr);
+    return ret;
+}
+
+
+/**
+ * virMacMapRemovePersistent:
+ * @mgr: mac map
+ * @file: mac maps file @mgr was loaded from
+ * @domain: domain name
+ * @mac: MAC address
+ *
+ * Like virMacMapRemove() but also records the change on disk, see
+ * virMacMapAddPersistent().
+ *
+ * Returns 0 on success, -1 otherwise.
+ */
+int
+virMacMapRemovePersistent(virMacMapPtr mgr,
+                          const char *file,
+                          const char *domain,
+                          const char *mac)
+{
+    int ret = -1;
+
+    virObjectLock(mgr);
+    if (virMacMapRemoveLocked(mgr, domain, mac) < 0 ||
+        virMacMapWriteFileLocked(mgr, file) < 0)
+        goto cleanup;
+
+    ret = 0;
+ cleanup:
+    virObjectUnlock(mgr);
+    return ret;
+}
+
+
+/**
+ * virMacMapDeleteFile:
+ * @file: mac maps file
+ *
+ * Remove @file together with its index.
+ */
+void
+virMacMapDeleteFile(const char *file)
+{
+    char *index_file;
+
+    unlink(file);
+
+    if ((index_file = virMacMapIndexFileName(file))) {
+        unlink(index_file);
+        VIR_FREE(index_file);
+    }
+}
+
+
 const char *const *
 virMacMapLookup(virMacMapPtr mgr,
                 const char *domain)
@@ -402,3 +706,169 @@ virMacMapDumpStr(virMacMapPtr mgr,
     virObjectUnlock(mgr);
     return ret;
 }
+
+
+#if HAVE_MMAP
+/**
+ * virMacMapIndexOpen:
+ * @file: mac maps file
+ *
+ * Maps the index of @file into memory. This function is meant to be
+ * used from the NSS module and thus reports no errors.
+ *
+ * Returns the index, or NULL if it is missing, corrupted or was not
+ * generated from the current @file.
+ */
+virMacMapIndexPtr
+virMacMapIndexOpen(const char *file)
+{
+    virMacMapIndexPtr idx = NULL;
+    virMacMapIndexHeader expect;
+    char *index_file = NULL;
+    struct stat sb;
+    int fd = -1;
+    uint64_t n;
+
+    memset(&expect, 0, sizeof(expect));
+
+    if (!(index_file = virMacMapIndexFileName(file)))
+        goto error;
+
+    if (stat(file, &sb) < 0)
+        goto error;
+    virMacMapIndexHeaderSetFile(&expect, &sb);
+
+    if ((fd = open(index_file, O_RDONLY | O_CLOEXEC)) < 0 ||
+        fstat(fd, &sb) < 0 ||
+        sb.st_size < (off_t) sizeof(virMacMapIndexHeader) ||
+        sb.st_size > VIR_MAC_MAP_FILE_SIZE_MAX)
+        goto error;
+
+    if (VIR_ALLOC_QUIET(idx) < 0)
+        goto error;
+
+    idx->mapLen = sb.st_size;
+    if ((idx->map = mmap(NULL, idx->mapLen, PROT_READ,
+                         MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+        idx->map = NULL;
+        goto error;
+    }
+
+    idx->header = idx->map;
+    n = idx->header->nrecords;
+
+    if (memcmp(idx->header->magic, VIR_MAC_MAP_INDEX_MAGIC,
+               sizeof(idx->header->magic)) != 0 ||
+        idx->header->version != VIR_MAC_MAP_INDEX_VERSION ||
+        idx->header->recordSize != sizeof(virMacMapIndexRecord) ||
+        n > VIR_MAC_MAP_FILE_SIZE_MAX / sizeof(virMacMapIndexRecord) ||
+        idx->mapLen != sizeof(virMacMapIndexHeader) +
+                       n * sizeof(virMacMapIndexRecord))
+        goto error;
+
+    if (idx->header->fileDev != expect.fileDev ||
+        idx->header->fileIno != expect.fileIno ||
+        idx->header->fileSize != expect.fileSize ||
+        idx->header->fileMtimeSec != expect.fileMtimeSec ||
+        idx->header->fileMtimeNsec != expect.fileMtimeNsec)
+        goto error;
+
+    idx->records = (const virMacMapIndexRecord *) (idx->header + 1);
+
+    VIR_FORCE_CLOSE(fd);
+    VIR_FREE(index_file);
+    return idx;
+
+ error:
+    VIR_FORCE_CLOSE(fd);
+    VIR_FREE(index_file);
+    virMacMapIndexFree(idx);
+    return NULL;
+}
+
+
+void
+virMacMapIndexFree(virMacMapIndexPtr idx)
+{
+    if (!idx)
+        return;
+
+    if (idx->map)
+        munmap(idx->map, idx->mapLen);
+    VIR_FREE(idx);
+}
+
+#else /* !HAVE_MMAP */
+
+virMacMapIndexPtr
+virMacMapIndexOpen(const char *file ATTRIBUTE_UNUSED)
+{
+    return NULL;
+}
+
+
+void
+virMacMapIndexFree(virMacMapIndexPtr idx)
+{
+    VIR_FREE(idx);
+}
+#endif /* !HAVE_MMAP */
+
+
+/**
+ * virMacMapIndexLookup:
+ * @idx: mac map index
+ * @domain: domain name
+ * @macs: filled with a NULL terminated list of MACs of @domain
+ *
+ * Looks up the MACs of @domain in @idx. If there are none, @macs is
+ * set to NULL. The caller is responsible for freeing @macs with
+ * virStringListFree(). No errors are reported.
+ *
+ * Returns 0 on success, -1 on OOM.
+ */
+int
+virMacMapIndexLookup(virMacMapIndexPtr idx,
+                     const char *domain,
+                     char ***macs)
+{
+    size_t lo = 0;
+    size_t hi = idx->header->nrecords;
+    size_t first;
+    size_t i;
+    char **ret = NULL;
+
+    *macs = NULL;
+
+    /* find the first record not sorting before @domain */
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (strcmp(idx->records[mid].domain, domain) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    first = lo;
+    for (; lo < idx->header->nrecords; lo++) {
+        if (STRNEQ(idx->records[lo].domain, domain))
+            break;
+    }
+
+    if (lo == first)
+        return 0;
+
+    if (VIR_ALLOC_N_QUIET(ret, lo - first + 1) < 0)
+        return -1;
+
+    for (i = first; i < lo; i++) {
+        if (VIR_STRDUP_QUIET(ret[i - first], idx->records[i].mac) < 0) {
+            virStringListFree(ret);
+            return -1;
+        }
+    }
+
+    *macs = ret;
+    return 0;
+}
@@ -27,6 +27,9 @@
 typedef struct virMacMap virMacMap;
 typedef virMacMap *virMacMapPtr;
 
+typedef struct _virMacMapIndex virMacMapIndex;
+typedef virMacMapIndex *virMacMapIndexPtr;
+
 char *
 virMacMapFileName(const char *dnsmasqStateDir,
                   const char *bridge);
@@ -41,6 +44,18 @@ int virMacMapRemove(virMacMapPtr mgr,
                     const char *domain,
                     const char *mac);
 
+int virMacMapAddPersistent(virMacMapPtr mgr,
+                           const char *file,
+                           const char *domain,
+                           const char *mac);
+
+int virMacMapRemovePersistent(virMacMapPtr mgr,
+                              const char *file,
+                              const char *domain,
+                              const char *mac);
+
+void virMacMapDeleteFile(const char *file);
+
 const char *const *virMacMapLookup(virMacMapPtr mgr,
                                    const char *domain);
 
@@ -49,4 +64,11 @@ int virMacMapWriteFile(virMacMapPtr mgr,
 
 int virMacMapDumpStr(virMacMapPtr mgr,
                      char **str);
+
+virMacMapIndexPtr virMacMapIndexOpen(const char *file);
+void virMacMapIndexFree(virMacMapIndexPtr idx);
+
+int virMacMapIndexLookup(virMacMapIndexPtr idx,
+                         const char *domain,
+                         char ***macs);
 #endif /* __VIR_MACMAPPING_H__ */
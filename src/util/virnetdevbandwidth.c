@@ -43,9 +43,8 @@ virNetDevBandwidthFree(virNetDevBandwidthPtr def)
     VIR_FREE(def);
 }
 
-static void
-virNetDevBandwidthCmdAddOptimalQuantum(virCommandPtr cmd,
-                                       const virNetDevBandwidthRate *rate)
+static unsigned long long
+virNetDevBandwidthOptimalQuantum(const virNetDevBandwidthRate *rate)
 {
     const unsigned long long mtu = 1500;
     unsigned long long r2q;
@@ -62,8 +61,58 @@ virNetDevBandwidthCmdAddOptimalQuantum(virCommandPtr cmd,
     if (!r2q)
         r2q = 1;
 
-    virCommandAddArg(cmd, "quantum");
-    virCommandAddArgFormat(cmd, "%llu", r2q);
+    return r2q;
+}
+
+
+/**
+ * virNetDevBandwidthRunBatch:
+ * @batch: tc commands, one per line
+ * @force: whether failing commands should be tolerated
+ *
+ * Setting up QoS takes a handful of tc commands per interface.
+ * Rather than spawning tc for each of them, the commands are
+ * collected in @batch and fed to a single 'tc -batch' process.
+ * If @force is true, tc carries on after a command fails and the
+ * failure is ignored. This is meant for removing objects which
+ * might not exist. @batch is emptied in any case.
+ *
+ * Returns: 0 on success,
+ *         -1 otherwise (with error reported).
+ */
+static int
+virNetDevBandwidthRunBatch(virBufferPtr batch,
+                           bool force)
+{
+    int ret = -1;
+    int status; /* for ignoring the exit status */
+    virCommandPtr cmd = NULL;
+    char *input = NULL;
+
+    if (virBufferCheckError(batch) < 0)
+        goto cleanup;
+
+    if (!(input = virBufferContentAndReset(batch))) {
+        /* nothing to be done */
+        ret = 0;
+        goto cleanup;
+    }
+
+    cmd = virCommandNew(TC);
+    if (force)
+        virCommandAddArg(cmd, "-force");
+    virCommandAddArgList(cmd, "-batch", "-", NULL);
+    virCommandSetInputBuffer(cmd, input);
+
+    if (virCommandRun(cmd, force ? &status : NULL) < 0)
+        goto cleanup;
+
+    ret = 0;
+ cleanup:
+    virBufferFreeAndReset(batch);
+    virCommandFree(cmd);
+    VIR_FREE(input);
+    return ret;
 }
 
 /**
@@ -72,8 +121,8 @@ virNetDevBandwidthCmdAddOptimalQuantum(virCommandPtr cmd,
  * @ifmac_ptr: MAC of the interface to create filter over
  * @id: filter ID
  * @class_id: where to place traffic
- * @remove_old: whether to remove the filter
- * @create_new: whether to create the filter
+ * @remove_batch: where to add command removing the filter (may be NULL)
+ * @create_batch: where to add command creating the filter (may be NULL)
  *
  * TC filters are as crucial for traffic shaping as QDiscs. While
  * QDiscs act like black boxes deciding which packets should be
@@ -91,8 +140,9 @@ virNetDevBandwidthCmdAddOptimalQuantum(virCommandPtr cmd,
  * tells into which QDisc should filter place the traffic.
  *
  * This function can be used for both, removing stale filter
- * (@remove_old set to true) and creating new one (@create_new
- * set to true). Both at once for the same price!
+ * (@remove_batch set) and creating new one (@create_batch set).
+ * Both at once for the same price! The commands are only queued,
+ * it's up to the caller to run the batches.
  *
  * Returns: 0 on success,
  *         -1 otherwise (with error reported).
@@ -102,16 +152,15 @@ virNetDevBandwidthManipulateFilter(const char *ifname,
                                    const virMacAddr *ifmac_ptr,
                                    unsigned int id,
                                    const char *class_id,
-                                   bool remove_old,
-                                   bool create_new)
+                                   virBufferPtr remove_batch,
+                                   virBufferPtr create_batch)
 {
     int ret = -1;
     char *filter_id = NULL;
-    virCommandPtr cmd = NULL;
     unsigned char ifmac[VIR_MAC_BUFLEN];
     char *mac[2] = {NULL, NULL};
 
-    if (!(remove_old || create_new)) {
+    if (!(remove_batch || create_batch)) {
         virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
                        _("filter creation API error"));
         goto cleanup;
@@ -121,19 +170,13 @@ virNetDevBandwidthManipulateFilter(const char *ifname,
     if (virAsprintf(&filter_id, "800::%u", id) < 0)
         goto cleanup;
 
-    if (remove_old) {
-        int cmd_ret = 0;
-
-        cmd = virCommandNew(TC);
-        virCommandAddArgList(cmd, "filter", "del", "dev", ifname,
-                             "prio", "2", "handle",  filter_id, "u32", NULL);
-
-        if (virCommandRun(cmd, &cmd_ret) < 0)
-            goto cleanup;
-
+    if (remove_batch) {
+        virBufferAsprintf(remove_batch,
+                          "filter del dev %s prio 2 handle %s u32\n",
+                          ifname, filter_id);
     }
 
-    if (create_new) {
+    if (create_batch) {
         virMacAddrGetRaw(ifmac_ptr, ifmac);
 
         if (virAsprintf(&mac[0], "0x%02x%02x%02x%02x", ifmac[2],
@@ -141,22 +184,18 @@ virNetDevBandwidthManipulateFilter(const char *ifname,
             virAsprintf(&mac[1], "0x%02x%02x", ifmac[0], ifmac[1]) < 0)
             goto cleanup;
 
-        virCommandFree(cmd);
-        cmd = virCommandNew(TC);
         /* Okay, this not nice. But since libvirt does not necessarily track
          * interface IP address(es), and tc fw filter simply refuse to use
          * ebtables marks, we need to use u32 selector to match MAC address.
          * If libvirt will ever know something, remove this FIXME
          */
-        virCommandAddArgList(cmd, "filter", "add", "dev", ifname, "protocol", "ip",
-                             "prio", "2", "handle", filter_id, "u32",
-                             "match", "u16", "0x0800", "0xffff", "at", "-2",
-                             "match", "u32", mac[0], "0xffffffff", "at", "-12",
-                             "match", "u16", mac[1], "0xffff", "at", "-14",
-                             "flowid", class_id, NULL);
-
-        if (virCommandRun(cmd, NULL) < 0)
-            goto cleanup;
+        virBufferAsprintf(create_batch,
+                          "filter add dev %s protocol ip prio 2 handle %s u32 "
+                          "match u16 0x0800 0xffff at -2 "
+                          "match u32 %s 0xffffffff at -12 "
+                          "match u16 %s 0xffff at -14 "
+                          "flowid %s\n",
+                          ifname, filter_id, mac[0], mac[1], class_id);
     }
 
     ret = 0;
@@ -164,7 +203,6 @@ virNetDevBandwidthManipulateFilter(const char *ifname,
     VIR_FREE(mac[1]);
     VIR_FREE(mac[0]);
     VIR_FREE(filter_id);
-    virCommandFree(cmd);
     return ret;
 }
 
@@ -200,7 +238,7 @@ virNetDevBandwidthSet(const char *ifname,
 {
     int ret = -1;
     virNetDevBandwidthRatePtr rx = NULL, tx = NULL; /* From domain POV */
-    virCommandPtr cmd = NULL;
+    virBuffer batch = VIR_BUFFER_INITIALIZER;
     char *average = NULL;
     char *peak = NULL;
     char *burst = NULL;
@@ -245,12 +283,9 @@ virNetDevBandwidthSet(const char *ifname,
             (virAsprintf(&burst, "%llukb", tx->burst) < 0))
             goto cleanup;
 
-        cmd = virCommandNew(TC);
-        virCommandAddArgList(cmd, "qdisc", "add", "dev", ifname, "root",
-                             "handle", "1:", "htb", "default",
-                             hierarchical_class ? "2" : "1", NULL);
-        if (virCommandRun(cmd, NULL) < 0)
-            goto cleanup;
+        virBufferAsprintf(&batch,
+                          "qdisc add dev %s root handle 1: htb default %s\n",
+                          ifname, hierarchical_class ? "2" : "1");
 
         /* If we are creating a hierarchical class, all non guaranteed traffic
          * goes to the 1:2 class which will adjust 'rate' dynamically as NICs
@@ -316,49 +351,32 @@ virNetDevBandwidthSet(const char *ifname,
          * it before you dig into the code.
          */
         if (hierarchical_class) {
-            virCommandFree(cmd);
-            cmd = virCommandNew(TC);
-            virCommandAddArgList(cmd, "class", "add", "dev", ifname, "parent",
-                                 "1:", "classid", "1:1", "htb", "rate", average,
-                                 "ceil", peak ? peak : average, NULL);
-            virNetDevBandwidthCmdAddOptimalQuantum(cmd, tx);
-            if (virCommandRun(cmd, NULL) < 0)
-                goto cleanup;
+            virBufferAsprintf(&batch,
+                              "class add dev %s parent 1: classid 1:1 htb "
+                              "rate %s ceil %s quantum %llu\n",
+                              ifname, average, peak ? peak : average,
+                              virNetDevBandwidthOptimalQuantum(tx));
         }
-        virCommandFree(cmd);
-        cmd = virCommandNew(TC);
-        virCommandAddArgList(cmd, "class", "add", "dev", ifname, "parent",
-                             hierarchical_class ? "1:1" : "1:", "classid",
-                             hierarchical_class ? "1:2" : "1:1", "htb",
-                             "rate", average, NULL);
 
+        virBufferAsprintf(&batch,
+                          "class add dev %s parent %s classid %s htb rate %s",
+                          ifname, hierarchical_class ? "1:1" : "1:",
+                          hierarchical_class ? "1:2" : "1:1", average);
         if (peak)
-            virCommandAddArgList(cmd, "ceil", peak, NULL);
+            virBufferAsprintf(&batch, " ceil %s", peak);
         if (burst)
-            virCommandAddArgList(cmd, "burst", burst, NULL);
-
-        virNetDevBandwidthCmdAddOptimalQuantum(cmd, tx);
-        if (virCommandRun(cmd, NULL) < 0)
-            goto cleanup;
+            virBufferAsprintf(&batch, " burst %s", burst);
+        virBufferAsprintf(&batch, " quantum %llu\n",
+                          virNetDevBandwidthOptimalQuantum(tx));
 
-        virCommandFree(cmd);
-        cmd = virCommandNew(TC);
-        virCommandAddArgList(cmd, "qdisc", "add", "dev", ifname, "parent",
-                             hierarchical_class ? "1:2" : "1:1",
-                             "handle", "2:", "sfq", "perturb",
-                             "10", NULL);
+        virBufferAsprintf(&batch,
+                          "qdisc add dev %s parent %s handle 2: sfq perturb 10\n",
+                          ifname, hierarchical_class ? "1:2" : "1:1");
 
-        if (virCommandRun(cmd, NULL) < 0)
-            goto cleanup;
-
-        virCommandFree(cmd);
-        cmd = virCommandNew(TC);
-        virCommandAddArgList(cmd, "filter", "add", "dev", ifname, "parent",
-                             "1:0", "protocol", "all", "prio", "1", "handle",
-                             "1", "fw", "flowid", "1", NULL);
-
-        if (virCommandRun(cmd, NULL) < 0)
-            goto cleanup;
+        virBufferAsprintf(&batch,
+                          "filter add dev %s parent 1:0 protocol all prio 1 "
+                          "handle 1 fw flowid 1\n",
+                          ifname);
 
         VIR_FREE(average);
         VIR_FREE(peak);
@@ -371,31 +389,23 @@ virNetDevBandwidthSet(const char *ifname,
         if (virAsprintf(&burst, "%llukb", rx->burst ? rx->burst : rx->average) < 0)
             goto cleanup;
 
-        virCommandFree(cmd);
-        cmd = virCommandNew(TC);
-            virCommandAddArgList(cmd, "qdisc", "add", "dev", ifname,
-                                 "ingress", NULL);
+        virBufferAsprintf(&batch, "qdisc add dev %s ingress\n", ifname);
 
-        if (virCommandRun(cmd, NULL) < 0)
-            goto cleanup;
-
-        virCommandFree(cmd);
-        cmd = virCommandNew(TC);
         /* Set filter to match all ingress traffic */
-        virCommandAddArgList(cmd, "filter", "add", "dev", ifname, "parent",
-                             "ffff:", "protocol", "all", "u32", "match", "u32",
-                             "0", "0", "police", "rate", average,
-                             "burst", burst, "mtu", "64kb", "drop", "flowid",
-                             ":1", NULL);
-
-        if (virCommandRun(cmd, NULL) < 0)
-            goto cleanup;
+        virBufferAsprintf(&batch,
+                          "filter add dev %s parent ffff: protocol all u32 "
+                          "match u32 0 0 police rate %s burst %s mtu 64kb "
+                          "drop flowid :1\n",
+                          ifname, average, burst);
     }
 
+    if (virNetDevBandwidthRunBatch(&batch, false) < 0)
+        goto cleanup;
+
     ret = 0;
 
  cleanup:
-    virCommandFree(cmd);
+    virBufferFreeAndReset(&batch);
     VIR_FREE(average);
     VIR_FREE(peak);
     VIR_FREE(burst);
@@ -415,30 +425,15 @@ virNetDevBandwidthSet(const char *ifname,
 int
 virNetDevBandwidthClear(const char *ifname)
 {
-    int ret = 0;
-    int dummy; /* for ignoring the exit status */
-    virCommandPtr cmd = NULL;
+    virBuffer batch = VIR_BUFFER_INITIALIZER;
 
     if (!ifname)
        return 0;
 
-    cmd = virCommandNew(TC);
-    virCommandAddArgList(cmd, "qdisc", "del", "dev", ifname, "root", NULL);
-
-    if (virCommandRun(cmd, &dummy) < 0)
-        ret = -1;
-
-    virCommandFree(cmd);
+    virBufferAsprintf(&batch, "qdisc del dev %s root\n", ifname);
+    virBufferAsprintf(&batch, "qdisc del dev %s ingress\n", ifname);
 
-    cmd = virCommandNew(TC);
-    virCommandAddArgList(cmd, "qdisc",  "del", "dev", ifname, "ingress", NULL);
-
-    if (virCommandRun(cmd, &dummy) < 0)
-        ret = -1;
-
-    virCommandFree(cmd);
-
-    return ret;
+    return virNetDevBandwidthRunBatch(&batch, true);
 }
 
 /*
@@ -557,7 +552,7 @@ virNetDevBandwidthPlug(const char *brname,
                        unsigned int id)
 {
     int ret = -1;
-    virCommandPtr cmd = NULL;
+    virBuffer batch = VIR_BUFFER_INITIALIZER;
     char *class_id = NULL;
     char *qdisc_id = NULL;
     char *floor = NULL;
@@ -587,26 +582,21 @@ virNetDevBandwidthPlug(const char *brname,
                     net_bandwidth->in->average) < 0)
         goto cleanup;
 
-    cmd = virCommandNew(TC);
-    virCommandAddArgList(cmd, "class", "add", "dev", brname, "parent", "1:1",
-                         "classid", class_id, "htb", "rate", floor,
-                         "ceil", ceil, NULL);
-    virNetDevBandwidthCmdAddOptimalQuantum(cmd, bandwidth->in);
-
-    if (virCommandRun(cmd, NULL) < 0)
-        goto cleanup;
+    virBufferAsprintf(&batch,
+                      "class add dev %s parent 1:1 classid %s htb "
+                      "rate %s ceil %s quantum %llu\n",
+                      brname, class_id, floor, ceil,
+                      virNetDevBandwidthOptimalQuantum(bandwidth->in));
 
-    virCommandFree(cmd);
-    cmd = virCommandNew(TC);
-    virCommandAddArgList(cmd, "qdisc", "add", "dev", brname, "parent",
-                         class_id, "handle", qdisc_id, "sfq", "perturb",
-                         "10", NULL);
+    virBufferAsprintf(&batch,
+                      "qdisc add dev %s parent %s handle %s sfq perturb 10\n",
+                      brname, class_id, qdisc_id);
 
-    if (virCommandRun(cmd, NULL) < 0)
+    if (virNetDevBandwidthManipulateFilter(brname, ifmac_ptr, id,
+                                           class_id, NULL, &batch) < 0)
         goto cleanup;
 
-    if (virNetDevBandwidthManipulateFilter(brname, ifmac_ptr, id,
-                                           class_id, false, true) < 0)
+    if (virNetDevBandwidthRunBatch(&batch, false) < 0)
         goto cleanup;
 
     ret = 0;
@@ -616,7 +606,7 @@ virNetDevBandwidthPlug(const char *brname,
     VIR_FREE(floor);
     VIR_FREE(qdisc_id);
     VIR_FREE(class_id);
-    virCommandFree(cmd);
+    virBufferFreeAndReset(&batch);
     return ret;
 }
 
@@ -634,8 +624,7 @@ virNetDevBandwidthUnplug(const char *brname,
                          unsigned int id)
 {
     int ret = -1;
-    int cmd_ret = 0;
-    virCommandPtr cmd = NULL;
+    virBuffer batch = VIR_BUFFER_INITIALIZER;
     char *class_id = NULL;
     char *qdisc_id = NULL;
 
@@ -648,25 +637,19 @@ virNetDevBandwidthUnplug(const char *brname,
         virAsprintf(&qdisc_id, "%x:", id) < 0)
         goto cleanup;
 
-    cmd = virCommandNew(TC);
-    virCommandAddArgList(cmd, "qdisc", "del", "dev", brname,
-                         "handle", qdisc_id, NULL);
-
-    /* Don't threat tc errors as fatal, but
-     * try to remove as much as possible */
-    if (virCommandRun(cmd, &cmd_ret) < 0)
-        goto cleanup;
+    virBufferAsprintf(&batch, "qdisc del dev %s handle %s\n",
+                      brname, qdisc_id);
 
     if (virNetDevBandwidthManipulateFilter(brname, NULL, id,
-                                           NULL, true, false) < 0)
+                                           NULL, &batch, NULL) < 0)
         goto cleanup;
 
-    virCommandFree(cmd);
-    cmd = virCommandNew(TC);
-    virCommandAddArgList(cmd, "class", "del", "dev", brname,
-                         "classid", class_id, NULL);
+    virBufferAsprintf(&batch, "class del dev %s classid %s\n",
+                      brname, class_id);
 
-    if (virCommandRun(cmd, &cmd_ret) < 0)
+    /* Don't threat tc errors as fatal, but
+     * try to remove as much as possible */
+    if (virNetDevBandwidthRunBatch(&batch, true) < 0)
         goto cleanup;
 
     ret = 0;
@@ -674,7 +657,7 @@ virNetDevBandwidthUnplug(const char *brname,
  cleanup:
     VIR_FREE(qdisc_id);
     VIR_FREE(class_id);
-    virCommandFree(cmd);
+    virBufferFreeAndReset(&batch);
     return ret;
 }
 
@@ -699,7 +682,7 @@ virNetDevBandwidthUpdateRate(const char *ifname,
                              unsigned long long new_rate)
 {
     int ret = -1;
-    virCommandPtr cmd = NULL;
+    virBuffer batch = VIR_BUFFER_INITIALIZER;
     char *class_id = NULL;
     char *rate = NULL;
     char *ceil = NULL;
@@ -711,19 +694,19 @@ virNetDevBandwidthUpdateRate(const char *ifname,
                     bandwidth->in->average) < 0)
         goto cleanup;
 
-    cmd = virCommandNew(TC);
-    virCommandAddArgList(cmd, "class", "change", "dev", ifname,
-                         "classid", class_id, "htb", "rate", rate,
-                         "ceil", ceil, NULL);
-    virNetDevBandwidthCmdAddOptimalQuantum(cmd, bandwidth->in);
+    virBufferAsprintf(&batch,
+                      "class change dev %s classid %s htb rate %s ceil %s "
+                      "quantum %llu\n",
+                      ifname, class_id, rate, ceil,
+                      virNetDevBandwidthOptimalQuantum(bandwidth->in));
 
-    if (virCommandRun(cmd, NULL) < 0)
+    if (virNetDevBandwidthRunBatch(&batch, false) < 0)
         goto cleanup;
 
     ret = 0;
 
  cleanup:
-    virCommandFree(cmd);
+    virBufferFreeAndReset(&batch);
     VIR_FREE(class_id);
     VIR_FREE(rate);
     VIR_FREE(ceil);
@@ -753,17 +736,27 @@ virNetDevBandwidthUpdateFilter(const char *ifname,
                                unsigned int id)
 {
     int ret = -1;
+    virBuffer remove_batch = VIR_BUFFER_INITIALIZER;
+    virBuffer create_batch = VIR_BUFFER_INITIALIZER;
     char *class_id = NULL;
 
     if (virAsprintf(&class_id, "1:%x", id) < 0)
         goto cleanup;
 
     if (virNetDevBandwidthManipulateFilter(ifname, ifmac_ptr, id,
-                                           class_id, true, true) < 0)
+                                           class_id, &remove_batch,
+                                           &create_batch) < 0)
+        goto cleanup;
+
+    /* The old filter may not exist */
+    if (virNetDevBandwidthRunBatch(&remove_batch, true) < 0 ||
+        virNetDevBandwidthRunBatch(&create_batch, false) < 0)
         goto cleanup;
 
     ret = 0;
  cleanup:
+    virBufferFreeAndReset(&remove_batch);
+    virBufferFreeAndReset(&create_batch);
     VIR_FREE(class_id);
     return ret;
 }
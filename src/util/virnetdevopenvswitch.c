@@ -32,6 +32,7 @@
 #include "vircommand.h"
 #include "viralloc.h"
 #include "virerror.h"
+#include "virjson.h"
 #include "virmacaddr.h"
 #include "virstring.h"
 #include "virlog.h"
@@ -325,83 +326,200 @@ int virNetDevOpenvswitchSetMigrateData(char *migrate, const char *ifname)
     return ret;
 }
 
+/* Returns the member of @stats corresponding to the OVS statistics
+ * counter @name or NULL if it's not reported. The TX/RX fields appear
+ * to be swapped here because this is the host view. */
+static long long *
+virNetDevOpenvswitchInterfaceStatsMember(virDomainInterfaceStatsPtr stats,
+                                         const char *name)
+{
+    if (STREQ(name, "rx_bytes"))
+        return &stats->tx_bytes;
+    if (STREQ(name, "rx_packets"))
+        return &stats->tx_packets;
+    if (STREQ(name, "rx_errors"))
+        return &stats->tx_errs;
+    if (STREQ(name, "rx_dropped"))
+        return &stats->tx_drop;
+    if (STREQ(name, "tx_bytes"))
+        return &stats->rx_bytes;
+    if (STREQ(name, "tx_packets"))
+        return &stats->rx_packets;
+    if (STREQ(name, "tx_errors"))
+        return &stats->rx_errs;
+    if (STREQ(name, "tx_dropped"))
+        return &stats->rx_drop;
+
+    return NULL;
+}
+
+
+/* Parses the statistics column of a row of the Interface table, which
+ * is formatted as ["map", [["name", value], ...]].
+ * Returns the number of counters found or -1 on error. */
+static int
+virNetDevOpenvswitchParseInterfaceStats(virJSONValuePtr map,
+                                        virDomainInterfaceStatsPtr stats)
+{
+    virJSONValuePtr pairs;
+    size_t i;
+    int found = 0;
+
+    if (!map || !virJSONValueIsArray(map) ||
+        STRNEQ_NULLABLE(virJSONValueGetString(virJSONValueArrayGet(map, 0)),
+                        "map") ||
+        !(pairs = virJSONValueArrayGet(map, 1)) ||
+        !virJSONValueIsArray(pairs))
+        return -1;
+
+    for (i = 0; i < virJSONValueArraySize(pairs); i++) {
+        virJSONValuePtr pair = virJSONValueArrayGet(pairs, i);
+        const char *name;
+        long long *member;
+
+        if (!pair ||
+            !(name = virJSONValueGetString(virJSONValueArrayGet(pair, 0))))
+            return -1;
+
+        if (!(member = virNetDevOpenvswitchInterfaceStatsMember(stats, name)))
+            continue;
+
+        if (virJSONValueGetNumberLong(virJSONValueArrayGet(pair, 1),
+                                      member) < 0)
+            return -1;
+
+        found++;
+    }
+
+    return found;
+}
+
+
 /**
- * virNetDevOpenvswitchInterfaceStats:
- * @ifname: the name of the interface
- * @stats: the retreived domain interface stat
+ * virNetDevOpenvswitchInterfaceStatsList:
+ * @ifnames: names of the interfaces
+ * @nifnames: number of items in @ifnames and @stats
+ * @stats: filled with the statistics of the interfaces
  *
- * Retrieves the OVS interfaces stats
+ * Retrieves the statistics of all OVS interfaces listed in @ifnames with
+ * a single ovs-vsctl call. Entries of @ifnames may be NULL. Counters which
+ * are not reported by OVS, including all counters of interfaces which are
+ * not known to OVS, are set to -1.
  *
- * Returns 0 in case of success or -1 in case of failure
+ * Returns the number of interfaces with at least one counter reported
+ * or -1 in case of failure.
  */
 int
-virNetDevOpenvswitchInterfaceStats(const char *ifname,
-                                   virDomainInterfaceStatsPtr stats)
+virNetDevOpenvswitchInterfaceStatsList(const char **ifnames,
+                                       size_t nifnames,
+                                       virDomainInterfaceStatsPtr stats)
 {
     virCommandPtr cmd = NULL;
-    char *output;
-    char *tmp;
-    bool gotStats = false;
+    char *output = NULL;
+    virJSONValuePtr json = NULL;
+    virJSONValuePtr headings;
+    virJSONValuePtr data;
+    ssize_t nameIdx = -1;
+    ssize_t statsIdx = -1;
+    size_t i;
+    size_t j;
     int ret = -1;
 
-    /* Just ensure the interface exists in ovs */
+    for (i = 0; i < nifnames; i++)
+        memset(&stats[i], -1, sizeof(stats[i]));
+
     cmd = virCommandNew(OVSVSCTL);
     virNetDevOpenvswitchAddTimeout(cmd);
-    virCommandAddArgList(cmd, "get", "Interface", ifname, "name", NULL);
+    virCommandAddArgList(cmd, "--format=json", "--columns=name,statistics",
+                         "list", "Interface", NULL);
     virCommandSetOutputBuffer(cmd, &output);
 
-    if (virCommandRun(cmd, NULL) < 0) {
-        /* no ovs-vsctl or interface 'ifname' doesn't exists in ovs */
-        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                       _("Interface not found"));
+    if (virCommandRun(cmd, NULL) < 0)
         goto cleanup;
-    }
 
-#define GET_STAT(name, member) \
-    do { \
-        VIR_FREE(output); \
-        virCommandFree(cmd); \
-        cmd = virCommandNew(OVSVSCTL); \
-        virNetDevOpenvswitchAddTimeout(cmd); \
-        virCommandAddArgList(cmd, "get", "Interface", ifname, \
-                             "statistics:" name, NULL); \
-        virCommandSetOutputBuffer(cmd, &output); \
-        if (virCommandRun(cmd, NULL) < 0) { \
-            stats->member = -1; \
-        } else { \
-            if (virStrToLong_ll(output, &tmp, 10, &stats->member) < 0 || \
-                *tmp != '\n') { \
-                virReportError(VIR_ERR_INTERNAL_ERROR, "%s", \
-                               _("Fail to parse ovs-vsctl output")); \
-                goto cleanup; \
-            } \
-            gotStats = true; \
-        } \
-    } while (0)
-
-    /* The TX/RX fields appear to be swapped here
-     * because this is the host view. */
-    GET_STAT("rx_bytes", tx_bytes);
-    GET_STAT("rx_packets", tx_packets);
-    GET_STAT("rx_errors", tx_errs);
-    GET_STAT("rx_dropped", tx_drop);
-    GET_STAT("tx_bytes", rx_bytes);
-    GET_STAT("tx_packets", rx_packets);
-    GET_STAT("tx_errors", rx_errs);
-    GET_STAT("tx_dropped", rx_drop);
-
-    if (!gotStats) {
-        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                       _("Interface doesn't have any statistics"));
-        goto cleanup;
+    if (!(json = virJSONValueFromString(output)) ||
+        !(headings = virJSONValueObjectGetArray(json, "headings")) ||
+        !(data = virJSONValueObjectGetArray(json, "data")))
+        goto malformed;
+
+    for (i = 0; i < virJSONValueArraySize(headings); i++) {
+        virJSONValuePtr heading = virJSONValueArrayGet(headings, i);
+
+        if (STREQ_NULLABLE(virJSONValueGetString(heading), "name"))
+            nameIdx = i;
+        else if (STREQ_NULLABLE(virJSONValueGetString(heading), "statistics"))
+            statsIdx = i;
     }
 
+    if (nameIdx < 0 || statsIdx < 0)
+        goto malformed;
+
     ret = 0;
+    for (i = 0; i < virJSONValueArraySize(data); i++) {
+        virJSONValuePtr row = virJSONValueArrayGet(data, i);
+        const char *name;
+        int rc;
+
+        if (!row ||
+            !(name = virJSONValueGetString(virJSONValueArrayGet(row, nameIdx))))
+            goto malformed;
+
+        for (j = 0; j < nifnames; j++) {
+            if (STREQ_NULLABLE(ifnames[j], name))
+                break;
+        }
+
+        if (j == nifnames)
+            continue;
+
+        rc = virNetDevOpenvswitchParseInterfaceStats(virJSONValueArrayGet(row, statsIdx),
+                                                     &stats[j]);
+        if (rc < 0)
+            goto malformed;
+        if (rc > 0)
+            ret++;
+    }
 
  cleanup:
+    virJSONValueFree(json);
     VIR_FREE(output);
     virCommandFree(cmd);
     return ret;
+
+ malformed:
+    virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                   _("Fail to parse ovs-vsctl output"));
+    ret = -1;
+    goto cleanup;
+}
+
+
+/**
+ * virNetDevOpenvswitchInterfaceStats:
+ * @ifname: the name of the interface
+ * @stats: the retreived domain interface stat
+ *
+ * Retrieves the OVS interfaces stats
+ *
+ * Returns 0 in case of success or -1 in case of failure
+ */
+int
+virNetDevOpenvswitchInterfaceStats(const char *ifname,
+                                   virDomainInterfaceStatsPtr stats)
+{
+    int rc;
+
+    if ((rc = virNetDevOpenvswitchInterfaceStatsList(&ifname, 1, stats)) < 0)
+        return -1;
+
+    if (rc == 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Interface '%s' not found or doesn't have any "
+                         "statistics"), ifname);
+        return -1;
+    }
+
+    return 0;
 }
 
 /**
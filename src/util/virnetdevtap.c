@@ -28,8 +28,10 @@
 #include "virnetdevbridge.h"
 #include "virnetdevmidonet.h"
 #include "virnetdevopenvswitch.h"
+#include "virnetlink.h"
 #include "virerror.h"
 #include "virfile.h"
+#include "virhash.h"
 #include "viralloc.h"
 #include "virlog.h"
 #include "virstring.h"
@@ -846,3 +848,223 @@ virNetDevTapInterfaceStats(const char *ifname ATTRIBUTE_UNUSED,
 }
 
 #endif /* __linux__ */
+
+
+/*-------------------- bulk interface stats --------------------*/
+
+struct _virNetDevTapStatsCache {
+    bool populated;
+    virHashTablePtr stats; /* ifname -> virDomainInterfaceStatsPtr (host POV) */
+};
+
+
+/**
+ * virNetDevTapStatsCacheNew:
+ *
+ * Create an empty cache of statistics of host interfaces. The cache is
+ * filled on the first lookup with the statistics of all interfaces at
+ * once and reused by all subsequent lookups, which makes it suitable
+ * for gathering statistics of many interfaces in one go.
+ *
+ * Returns the new cache or NULL on error.
+ */
+virNetDevTapStatsCachePtr
+virNetDevTapStatsCacheNew(void)
+{
+    virNetDevTapStatsCachePtr cache;
+
+    ignore_value(VIR_ALLOC(cache));
+
+    return cache;
+}
+
+
+void
+virNetDevTapStatsCacheFree(virNetDevTapStatsCachePtr cache)
+{
+    if (!cache)
+        return;
+
+    virHashFree(cache->stats);
+    VIR_FREE(cache);
+}
+
+
+#if defined(__linux__) && defined(HAVE_LIBNL)
+static int
+virNetDevTapStatsCacheCallback(const struct nlmsghdr *resp,
+                               void *opaque)
+{
+    virHashTablePtr table = opaque;
+    struct nlattr *tb[IFLA_MAX + 1] = {NULL, };
+    virDomainInterfaceStatsPtr stats = NULL;
+    const char *ifname;
+
+    /* Ignore messages other than link ones */
+    if (resp->nlmsg_type != RTM_NEWLINK)
+        return 0;
+
+    if (nlmsg_parse((struct nlmsghdr *)resp, sizeof(struct ifinfomsg),
+                    tb, IFLA_MAX, NULL) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("malformed netlink response message"));
+        return -1;
+    }
+
+    if (!tb[IFLA_IFNAME] ||
+        !(ifname = nla_get_string(tb[IFLA_IFNAME])))
+        return 0;
+
+    if (VIR_ALLOC(stats) < 0)
+        return -1;
+
+    /* Counters are combined the same way /proc/net/dev does. Older
+     * kernels send shorter structures, newer ones may append fields we
+     * don't know about: use whatever part of the structure we got and
+     * leave the rest zeroed. */
+    if (tb[IFLA_STATS64]) {
+        struct rtnl_link_stats64 link;
+
+        memset(&link, 0, sizeof(link));
+        memcpy(&link, nla_data(tb[IFLA_STATS64]),
+               MIN((size_t) nla_len(tb[IFLA_STATS64]), sizeof(link)));
+        stats->rx_bytes = link.rx_bytes;
+        stats->rx_packets = link.rx_packets;
+        stats->rx_errs = link.rx_errors;
+        stats->rx_drop = link.rx_dropped + link.rx_missed_errors;
+        stats->tx_bytes = link.tx_bytes;
+        stats->tx_packets = link.tx_packets;
+        stats->tx_errs = link.tx_errors;
+        stats->tx_drop = link.tx_dropped;
+    } else if (tb[IFLA_STATS]) {
+        struct rtnl_link_stats link;
+
+        memset(&link, 0, sizeof(link));
+        memcpy(&link, nla_data(tb[IFLA_STATS]),
+               MIN((size_t) nla_len(tb[IFLA_STATS]), sizeof(link)));
+        stats->rx_bytes = link.rx_bytes;
+        stats->rx_packets = link.rx_packets;
+        stats->rx_errs = link.rx_errors;
+        stats->rx_drop = link.rx_dropped + link.rx_missed_errors;
+        stats->tx_bytes = link.tx_bytes;
+        stats->tx_packets = link.tx_packets;
+        stats->tx_errs = link.tx_errors;
+        stats->tx_drop = link.tx_dropped;
+    } else {
+        VIR_FREE(stats);
+        return 0;
+    }
+
+    if (virHashUpdateEntry(table, ifname, stats) < 0) {
+        VIR_FREE(stats);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static int
+virNetDevTapStatsCachePopulate(virNetDevTapStatsCachePtr cache)
+{
+    struct nl_msg *nlmsg = NULL;
+    struct ifinfomsg ifinfo = {
+        .ifi_family = AF_UNSPEC,
+    };
+    virHashTablePtr table = NULL;
+    int ret = -1;
+
+    if (!(table = virHashCreate(32, virHashValueFree)))
+        return -1;
+
+    if (!(nlmsg = nlmsg_alloc_simple(RTM_GETLINK,
+                                     NLM_F_REQUEST | NLM_F_DUMP))) {
+        virReportOOMError();
+        goto cleanup;
+    }
+
+    if (nlmsg_append(nlmsg, &ifinfo, sizeof(ifinfo), NLMSG_ALIGNTO) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("allocated netlink buffer is too small"));
+        goto cleanup;
+    }
+
+    if (virNetlinkDumpCommand(nlmsg, virNetDevTapStatsCacheCallback,
+                              0, 0, NETLINK_ROUTE, 0, table) < 0)
+        goto cleanup;
+
+    VIR_STEAL_PTR(cache->stats, table);
+    ret = 0;
+
+ cleanup:
+    nlmsg_free(nlmsg);
+    virHashFree(table);
+    return ret;
+}
+#else /* !(defined(__linux__) && defined(HAVE_LIBNL)) */
+static int
+virNetDevTapStatsCachePopulate(virNetDevTapStatsCachePtr cache ATTRIBUTE_UNUSED)
+{
+    /* No bulk query available, lookups fall back to
+     * virNetDevTapInterfaceStats() */
+    return 0;
+}
+#endif /* !(defined(__linux__) && defined(HAVE_LIBNL)) */
+
+
+/**
+ * virNetDevTapStatsCacheLookup:
+ * @cache: stats cache
+ * @ifname: interface
+ * @stats: where to store statistics
+ * @swapped: whether to swap RX/TX fields
+ *
+ * Same as virNetDevTapInterfaceStats() except the statistics are taken
+ * from @cache which is filled with a single netlink dump of all host
+ * interfaces on its first use. If that is not possible the statistics
+ * are fetched for @ifname only.
+ *
+ * Returns 0 on success, -1 otherwise (with error reported).
+ */
+int
+virNetDevTapStatsCacheLookup(virNetDevTapStatsCachePtr cache,
+                             const char *ifname,
+                             virDomainInterfaceStatsPtr stats,
+                             bool swapped)
+{
+    virDomainInterfaceStatsPtr found;
+
+    if (!cache->populated) {
+        cache->populated = true;
+
+        if (virNetDevTapStatsCachePopulate(cache) < 0) {
+            VIR_WARN("Unable to fetch statistics of all interfaces: %s",
+                     virGetLastErrorMessage());
+            virResetLastError();
+        }
+    }
+
+    if (!cache->stats)
+        return virNetDevTapInterfaceStats(ifname, stats, swapped);
+
+    if (!(found = virHashLookup(cache->stats, ifname))) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Interface '%s' not found"), ifname);
+        return -1;
+    }
+
+    if (swapped) {
+        stats->rx_bytes = found->tx_bytes;
+        stats->rx_packets = found->tx_packets;
+        stats->rx_errs = found->tx_errs;
+        stats->rx_drop = found->tx_drop;
+        stats->tx_bytes = found->rx_bytes;
+        stats->tx_packets = found->rx_packets;
+        stats->tx_errs = found->rx_errs;
+        stats->tx_drop = found->rx_drop;
+    } else {
+        *stats = *found;
+    }
+
+    return 0;
+}
@@ -96,4 +96,15 @@ int virNetDevTapInterfaceStats(const char *ifname,
                                bool swapped)
     ATTRIBUTE_NONNULL(1) ATTRIBUTE_RETURN_CHECK;
 
+typedef struct _virNetDevTapStatsCache virNetDevTapStatsCache;
+typedef virNetDevTapStatsCache *virNetDevTapStatsCachePtr;
+
+virNetDevTapStatsCachePtr virNetDevTapStatsCacheNew(void);
+void virNetDevTapStatsCacheFree(virNetDevTapStatsCachePtr cache);
+int virNetDevTapStatsCacheLookup(virNetDevTapStatsCachePtr cache,
+                                 const char *ifname,
+                                 virDomainInterfaceStatsPtr stats,
+                                 bool swapped)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2) ATTRIBUTE_RETURN_CHECK;
+
 #endif /* __VIR_NETDEV_TAP_H__ */
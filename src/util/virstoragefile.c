@@ -45,6 +45,8 @@
 #include "virjson.h"
 #include "virstorageencryption.h"
 #include "virsecret.h"
+#include "virthread.h"
+#include "stat-time.h"
 
 #define VIR_FROM_THIS VIR_FROM_STORAGE
 
@@ -4381,6 +4383,272 @@ virStorageFileRead(virStorageSourcePtr src,
 }
 
 
+/*
+ * Image header cache
+ *
+ * Probing a backing chain reads VIR_STORAGE_MAX_HEADER bytes of every
+ * image in the chain each time the chain is (re)detected. Images deep in
+ * the chain are rarely modified, so the raw headers are remembered here
+ * keyed by the unique identifier of the storage file and reused as long
+ * as (dev, ino, size, mtime) reported by stat() did not change and the
+ * header was read with the same uid:gid. Only regular files are cached
+ * since block devices do not update their timestamps on write. Files
+ * modified very recently are not cached either, as a further write within
+ * the timestamp granularity of the filesystem would go unnoticed.
+ */
+#define VIR_STORAGE_FILE_HEADER_CACHE_MAX 256
+#define VIR_STORAGE_FILE_HEADER_CACHE_MIN_AGE 2
+
+typedef struct _virStorageFileHeaderCacheEntry virStorageFileHeaderCacheEntry;
+typedef virStorageFileHeaderCacheEntry *virStorageFileHeaderCacheEntryPtr;
+struct _virStorageFileHeaderCacheEntry {
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    uid_t uid;
+    gid_t gid;
+
+    char *buf;
+    ssize_t len;
+};
+
+static virMutex virStorageFileHeaderCacheLock = VIR_MUTEX_INITIALIZER;
+static virHashTablePtr virStorageFileHeaderCache;
+
+
+static void
+virStorageFileHeaderCacheEntryFree(void *payload,
+                                   const void *name ATTRIBUTE_UNUSED)
+{
+    virStorageFileHeaderCacheEntryPtr entry = payload;
+
+    if (!entry)
+        return;
+
+    VIR_FREE(entry->buf);
+    VIR_FREE(entry);
+}
+
+
+static bool
+virStorageFileHeaderCacheEntryMatch(virStorageFileHeaderCacheEntryPtr entry,
+                                    const struct stat *st,
+                                    uid_t uid,
+                                    gid_t gid)
+{
+    struct timespec mtime = get_stat_mtime(st);
+
+    return entry->dev == st->st_dev &&
+           entry->ino == st->st_ino &&
+           entry->size == st->st_size &&
+           entry->mtime.tv_sec == mtime.tv_sec &&
+           entry->mtime.tv_nsec == mtime.tv_nsec &&
+           entry->uid == uid &&
+           entry->gid == gid;
+}
+
+
+static ssize_t
+virStorageFileHeaderCacheLookup(const char *key,
+                                const struct stat *st,
+                                uid_t uid,
+                                gid_t gid,
+                                char **buf)
+{
+    virStorageFileHeaderCacheEntryPtr entry;
+    ssize_t ret = -1;
+
+    virMutexLock(&virStorageFileHeaderCacheLock);
+
+    if (!virStorageFileHeaderCache ||
+        !(entry = virHashLookup(virStorageFileHeaderCache, key)))
+        goto cleanup;
+
+    if (!virStorageFileHeaderCacheEntryMatch(entry, st, uid, gid)) {
+        VIR_DEBUG("stale header cache entry for '%s'", key);
+        virHashRemoveEntry(virStorageFileHeaderCache, key);
+        goto cleanup;
+    }
+
+    if (VIR_ALLOC_N_QUIET(*buf, entry->len ? entry->len : 1) < 0)
+        goto cleanup;
+
+    memcpy(*buf, entry->buf, entry->len);
+    ret = entry->len;
+
+ cleanup:
+    virMutexUnlock(&virStorageFileHeaderCacheLock);
+    return ret;
+}
+
+
+static void
+virStorageFileHeaderCacheStore(const char *key,
+                               const struct stat *st,
+                               uid_t uid,
+                               gid_t gid,
+                               const char *buf,
+                               ssize_t len)
+{
+    virStorageFileHeaderCacheEntryPtr entry = NULL;
+    time_t now = time(NULL);
+
+    if (now == (time_t) -1 ||
+        now - get_stat_mtime(st).tv_sec < VIR_STORAGE_FILE_HEADER_CACHE_MIN_AGE)
+        return;
+
+    if (VIR_ALLOC_QUIET(entry) < 0 ||
+        VIR_ALLOC_N_QUIET(entry->buf, len ? len : 1) < 0)
+        goto error;
+
+    entry->dev = st->st_dev;
+    entry->ino = st->st_ino;
+    entry->size = st->st_size;
+    entry->mtime = get_stat_mtime(st);
+    entry->uid = uid;
+    entry->gid = gid;
+    memcpy(entry->buf, buf, len);
+    entry->len = len;
+
+    virMutexLock(&virStorageFileHeaderCacheLock);
+
+    if (!virStorageFileHeaderCache &&
+        !(virStorageFileHeaderCache =
+          virHashCreate(32, virStorageFileHeaderCacheEntryFree))) {
+        virMutexUnlock(&virStorageFileHeaderCacheLock);
+        virResetLastError();
+        goto error;
+    }
+
+    /* Keep the memory footprint bounded. Chains are re-probed as a whole,
+     * so simply starting over is good enough. */
+    if (virHashSize(virStorageFileHeaderCache) >=
+        VIR_STORAGE_FILE_HEADER_CACHE_MAX)
+        virHashRemoveAll(virStorageFileHeaderCache);
+
+    if (virHashUpdateEntry(virStorageFileHeaderCache, key, entry) < 0) {
+        virMutexUnlock(&virStorageFileHeaderCacheLock);
+        virResetLastError();
+        goto error;
+    }
+
+    virMutexUnlock(&virStorageFileHeaderCacheLock);
+    return;
+
+ error:
+    virStorageFileHeaderCacheEntryFree(entry, NULL);
+}
+
+
+/**
+ * virStorageFileHeaderCacheInvalidate:
+ * @path: path or unique identifier of a storage file
+ *
+ * Drop the cached header of @path (if any) so that the next backing
+ * chain probe re-reads it from storage.
+ */
+void
+virStorageFileHeaderCacheInvalidate(const char *path)
+{
+    char *canonpath = NULL;
+
+    if (!path)
+        return;
+
+    if (path[0] == '/')
+        canonpath = canonicalize_file_name(path);
+
+    virMutexLock(&virStorageFileHeaderCacheLock);
+    if (virStorageFileHeaderCache) {
+        virHashRemoveEntry(virStorageFileHeaderCache, path);
+        if (canonpath)
+            virHashRemoveEntry(virStorageFileHeaderCache, canonpath);
+    }
+    virMutexUnlock(&virStorageFileHeaderCacheLock);
+
+    VIR_FREE(canonpath);
+}
+
+
+/**
+ * virStorageFileHeaderCacheInvalidateChain:
+ * @src: top of a backing chain
+ *
+ * Drop cached headers of all local images in the backing chain of @src.
+ */
+void
+virStorageFileHeaderCacheInvalidateChain(virStorageSourcePtr src)
+{
+    virStorageSourcePtr n;
+
+    for (n = src; virStorageSourceIsBacking(n); n = n->backingStore) {
+        if (virStorageSourceIsLocalStorage(n))
+            virStorageFileHeaderCacheInvalidate(n->path);
+    }
+}
+
+
+/**
+ * virStorageFileHeaderCacheClear:
+ *
+ * Drop all cached image headers.
+ */
+void
+virStorageFileHeaderCacheClear(void)
+{
+    virMutexLock(&virStorageFileHeaderCacheLock);
+    virHashFree(virStorageFileHeaderCache);
+    virStorageFileHeaderCache = NULL;
+    virMutexUnlock(&virStorageFileHeaderCacheLock);
+}
+
+
+/**
+ * virStorageFileReadHeader:
+ * @src: initialized storage file
+ * @uniqueName: unique identifier of @src
+ * @buf: filled with a newly allocated header buffer
+ *
+ * Read the header of @src used for metadata probing, reusing the cached
+ * copy if the file did not change since it was last read.
+ *
+ * Returns the length of the header or -1 on error with libvirt error
+ * reported.
+ */
+static ssize_t
+virStorageFileReadHeader(virStorageSourcePtr src,
+                         const char *uniqueName,
+                         char **buf)
+{
+    struct stat st;
+    ssize_t ret;
+    bool cacheable = false;
+
+    if (virStorageFileStat(src, &st) == 0 && S_ISREG(st.st_mode)) {
+        cacheable = true;
+
+        if ((ret = virStorageFileHeaderCacheLookup(uniqueName, &st,
+                                                   src->drv->uid,
+                                                   src->drv->gid, buf)) >= 0) {
+            VIR_DEBUG("using cached header of '%s' (%zd bytes)",
+                      uniqueName, ret);
+            return ret;
+        }
+    }
+
+    if ((ret = virStorageFileRead(src, 0, VIR_STORAGE_MAX_HEADER, buf)) < 0)
+        return -1;
+
+    if (cacheable)
+        virStorageFileHeaderCacheStore(uniqueName, &st,
+                                       src->drv->uid, src->drv->gid,
+                                       *buf, ret);
+
+    return ret;
+}
+
+
 /*
  * virStorageFileGetUniqueIdentifier: Get a unique string describing the volume
  *
@@ -4556,8 +4824,7 @@ virStorageFileGetMetadataRecurse(virStorageSourcePtr src,
     if (virHashAddEntry(cycle, uniqueName, (void *)1) < 0)
         goto cleanup;
 
-    if ((headerLen = virStorageFileRead(src, 0, VIR_STORAGE_MAX_HEADER,
-                                        &buf)) < 0)
+    if ((headerLen = virStorageFileReadHeader(src, uniqueName, &buf)) < 0)
         goto cleanup;
 
     if (virStorageFileGetMetadataInternal(src, buf, headerLen,
@@ -463,6 +463,10 @@ ssize_t virStorageFileRead(virStorageSourcePtr src,
                            size_t len,
                            char **buf);
 const char *virStorageFileGetUniqueIdentifier(virStorageSourcePtr src);
+
+void virStorageFileHeaderCacheInvalidate(const char *path);
+void virStorageFileHeaderCacheInvalidateChain(virStorageSourcePtr src);
+void virStorageFileHeaderCacheClear(void);
 int virStorageFileAccess(virStorageSourcePtr src, int mode);
 int virStorageFileChown(const virStorageSource *src, uid_t uid, gid_t gid);
 
@@ -27,23 +27,61 @@
 #include <config.h>
 
 #include "virthreadpool.h"
+#define __VIR_THREAD_POOL_PRIV_H_ALLOW__
+#include "virthreadpoolpriv.h"
 #include "viralloc.h"
 #include "virthread.h"
 #include "virerror.h"
+#include "virhash.h"
+#include "virstring.h"
+#include "virtime.h"
+#include "virutil.h"
 
 #define VIR_FROM_THIS VIR_FROM_NONE
 
 typedef struct _virThreadPoolJob virThreadPoolJob;
 typedef virThreadPoolJob *virThreadPoolJobPtr;
 
+typedef struct _virThreadPoolFlow virThreadPoolFlow;
+typedef virThreadPoolFlow *virThreadPoolFlowPtr;
+
 struct _virThreadPoolJob {
     virThreadPoolJobPtr prev;
     virThreadPoolJobPtr next;
     unsigned int priority;
 
+    virThreadPoolFlowPtr flow;
+    virThreadPoolJobPtr flowPrev;
+    virThreadPoolJobPtr flowNext;
+    long long charge;               /* service time charged up front */
+    unsigned long long started;     /* monotonic, in us */
+
     void *data;
 };
 
+/* The jobs of a flow are run in the order they were sent. Ordinary
+ * workers always serve the flow which has received the least service
+ * time so far, divided by its weight, so that a flow sending many slow
+ * jobs cannot starve the others. A flow is charged its average job
+ * duration when a job is taken and the difference to the real duration
+ * once the job is done. Flows with queued jobs are kept in a min-heap
+ * on their service time, ties going to the flow queued first. The flow
+ * of jobs sent without a name exists as long as the pool does. */
+struct _virThreadPoolFlow {
+    char *name;
+    unsigned int weight;
+    long long vtime;                /* service time in ns divided by weight */
+    unsigned long long cost;        /* average job duration, in us */
+
+    ssize_t heapIndex;              /* -1 unless jobs are queued */
+    unsigned long long seq;         /* when it was last put in the heap */
+
+    size_t nqueued;
+    size_t nrunning;
+    virThreadPoolJobPtr head;
+    virThreadPoolJobPtr tail;
+};
+
 typedef struct _virThreadPoolJobList virThreadPoolJobList;
 typedef virThreadPoolJobList *virThreadPoolJobListPtr;
 
@@ -63,6 +101,15 @@ struct _virThreadPool {
     virThreadPoolJobList jobList;
     size_t jobQueueDepth;
 
+    virThreadPoolFlowPtr defaultFlow;
+    virHashTablePtr flows;          /* named flows, by name */
+    virThreadPoolFlowPtr *heap;     /* flows with queued jobs */
+    size_t nheap;
+    size_t heapAlloc;
+    unsigned long long heapSeq;
+    long long vtime;                /* of the last flow served */
+    virThreadPoolClockFunc clock;
+
     virMutex mutex;
     virCond cond;
     virCond quit_cond;
@@ -93,6 +140,256 @@ static inline bool virThreadPoolWorkerQuitHelper(size_t count, size_t limit)
     return count > limit;
 }
 
+static void
+virThreadPoolFlowFree(virThreadPoolFlowPtr flow)
+{
+    if (!flow)
+        return;
+
+    VIR_FREE(flow->name);
+    VIR_FREE(flow);
+}
+
+static void
+virThreadPoolFlowHashFree(void *payload,
+                          const void *name ATTRIBUTE_UNUSED)
+{
+    virThreadPoolFlowFree(payload);
+}
+
+static virThreadPoolFlowPtr
+virThreadPoolFlowNew(virThreadPoolPtr pool,
+                     const char *name)
+{
+    virThreadPoolFlowPtr flow;
+
+    if (VIR_ALLOC(flow) < 0 ||
+        VIR_STRDUP(flow->name, name) < 0) {
+        virThreadPoolFlowFree(flow);
+        return NULL;
+    }
+
+    flow->heapIndex = -1;
+    flow->vtime = pool->vtime;
+    return flow;
+}
+
+static bool
+virThreadPoolFlowBefore(virThreadPoolFlowPtr a,
+                        virThreadPoolFlowPtr b)
+{
+    if (a->vtime != b->vtime)
+        return a->vtime < b->vtime;
+    return a->seq < b->seq;
+}
+
+static void
+virThreadPoolHeapSet(virThreadPoolPtr pool,
+                     size_t i,
+                     virThreadPoolFlowPtr flow)
+{
+    pool->heap[i] = flow;
+    flow->heapIndex = i;
+}
+
+static void
+virThreadPoolHeapUp(virThreadPoolPtr pool,
+                    size_t i)
+{
+    virThreadPoolFlowPtr flow = pool->heap[i];
+
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+
+        if (!virThreadPoolFlowBefore(flow, pool->heap[parent]))
+            break;
+        virThreadPoolHeapSet(pool, i, pool->heap[parent]);
+        i = parent;
+    }
+    virThreadPoolHeapSet(pool, i, flow);
+}
+
+static void
+virThreadPoolHeapDown(virThreadPoolPtr pool,
+                      size_t i)
+{
+    virThreadPoolFlowPtr flow = pool->heap[i];
+
+    while (true) {
+        size_t child = 2 * i + 1;
+
+        if (child >= pool->nheap)
+            break;
+        if (child + 1 < pool->nheap &&
+            virThreadPoolFlowBefore(pool->heap[child + 1], pool->heap[child]))
+            child++;
+        if (!virThreadPoolFlowBefore(pool->heap[child], flow))
+            break;
+        virThreadPoolHeapSet(pool, i, pool->heap[child]);
+        i = child;
+    }
+    virThreadPoolHeapSet(pool, i, flow);
+}
+
+/* Restores the heap after the service time of @flow changed */
+static void
+virThreadPoolHeapUpdate(virThreadPoolPtr pool,
+                        virThreadPoolFlowPtr flow)
+{
+    if (flow->heapIndex < 0)
+        return;
+
+    virThreadPoolHeapUp(pool, flow->heapIndex);
+    virThreadPoolHeapDown(pool, flow->heapIndex);
+}
+
+static int
+virThreadPoolHeapPush(virThreadPoolPtr pool,
+                      virThreadPoolFlowPtr flow)
+{
+    if (VIR_RESIZE_N(pool->heap, pool->heapAlloc, pool->nheap, 1) < 0)
+        return -1;
+
+    flow->seq = pool->heapSeq++;
+    virThreadPoolHeapSet(pool, pool->nheap++, flow);
+    virThreadPoolHeapUp(pool, flow->heapIndex);
+    return 0;
+}
+
+static void
+virThreadPoolHeapRemove(virThreadPoolPtr pool,
+                        virThreadPoolFlowPtr flow)
+{
+    size_t i = flow->heapIndex;
+
+    flow->heapIndex = -1;
+    if (i == --pool->nheap)
+        return;
+
+    virThreadPoolHeapSet(pool, i, pool->heap[pool->nheap]);
+    virThreadPoolHeapUpdate(pool, pool->heap[i]);
+}
+
+static virThreadPoolFlowPtr
+virThreadPoolFlowGet(virThreadPoolPtr pool,
+                     const char *name,
+                     unsigned int weight)
+{
+    virThreadPoolFlowPtr flow;
+
+    if (!name) {
+        flow = pool->defaultFlow;
+    } else if (!(flow = virHashLookup(pool->flows, name))) {
+        if (!(flow = virThreadPoolFlowNew(pool, name)))
+            return NULL;
+
+        if (virHashAddEntry(pool->flows, name, flow) < 0) {
+            virThreadPoolFlowFree(flow);
+            return NULL;
+        }
+    }
+
+    if (!flow->nqueued) {
+        /* Idle flows must not bank service time they did not use */
+        flow->vtime = MAX(flow->vtime, pool->vtime);
+    }
+
+    flow->weight = weight ? weight : 1;
+    return flow;
+}
+
+static void
+virThreadPoolFlowRelease(virThreadPoolPtr pool,
+                         virThreadPoolFlowPtr flow)
+{
+    if (flow->nqueued || flow->nrunning || !flow->name)
+        return;
+
+    virHashRemoveEntry(pool->flows, flow->name);
+}
+
+static virThreadPoolJobPtr
+virThreadPoolNextJob(virThreadPoolPtr pool,
+                     bool priority)
+{
+    if (priority)
+        return pool->jobList.firstPrio;
+
+    return pool->nheap ? pool->heap[0]->head : NULL;
+}
+
+static void
+virThreadPoolJobTake(virThreadPoolPtr pool,
+                     virThreadPoolJobPtr job)
+{
+    virThreadPoolFlowPtr flow = job->flow;
+
+    if (job == pool->jobList.firstPrio) {
+        virThreadPoolJobPtr tmp = job->next;
+        while (tmp) {
+            if (tmp->priority)
+                break;
+            tmp = tmp->next;
+        }
+        pool->jobList.firstPrio = tmp;
+    }
+
+    if (job->prev)
+        job->prev->next = job->next;
+    else
+        pool->jobList.head = job->next;
+    if (job->next)
+        job->next->prev = job->prev;
+    else
+        pool->jobList.tail = job->prev;
+
+    if (job->flowPrev)
+        job->flowPrev->flowNext = job->flowNext;
+    else
+        flow->head = job->flowNext;
+    if (job->flowNext)
+        job->flowNext->flowPrev = job->flowPrev;
+    else
+        flow->tail = job->flowPrev;
+
+    pool->jobQueueDepth--;
+    flow->nqueued--;
+    flow->nrunning++;
+
+    pool->vtime = MAX(pool->vtime, flow->vtime);
+    job->charge = MAX(flow->cost, 1) * 1000 / flow->weight;
+    flow->vtime += job->charge;
+
+    if (!flow->nqueued)
+        virThreadPoolHeapRemove(pool, flow);
+    else
+        virThreadPoolHeapUpdate(pool, flow);
+
+    if (pool->clock(&job->started) < 0)
+        job->started = 0;
+}
+
+static void
+virThreadPoolJobDone(virThreadPoolPtr pool,
+                     virThreadPoolJobPtr job)
+{
+    virThreadPoolFlowPtr flow = job->flow;
+    unsigned long long now;
+    unsigned long long elapsed = 0;
+
+    if (job->started && pool->clock(&now) == 0 &&
+        now > job->started)
+        elapsed = now - job->started;
+
+    flow->cost = (flow->cost * 7 + elapsed) / 8;
+    flow->vtime += (long long) MAX(elapsed, 1) * 1000 / flow->weight -
+                   job->charge;
+    flow->nrunning--;
+    virThreadPoolHeapUpdate(pool, flow);
+
+    virThreadPoolFlowRelease(pool, flow);
+}
+
 static void virThreadPoolWorker(void *opaque)
 {
     struct virThreadPoolWorkerData *data = opaque;
@@ -136,37 +433,15 @@ static void virThreadPoolWorker(void *opaque)
         if (pool->quit)
             break;
 
-        if (priority) {
-            job = pool->jobList.firstPrio;
-        } else {
-            job = pool->jobList.head;
-        }
-
-        if (job == pool->jobList.firstPrio) {
-            virThreadPoolJobPtr tmp = job->next;
-            while (tmp) {
-                if (tmp->priority)
-                    break;
-                tmp = tmp->next;
-            }
-            pool->jobList.firstPrio = tmp;
-        }
-
-        if (job->prev)
-            job->prev->next = job->next;
-        else
-            pool->jobList.head = job->next;
-        if (job->next)
-            job->next->prev = job->prev;
-        else
-            pool->jobList.tail = job->prev;
-
-        pool->jobQueueDepth--;
+        job = virThreadPoolNextJob(pool, priority);
+        virThreadPoolJobTake(pool, job);
 
         virMutexUnlock(&pool->mutex);
         (pool->jobFunc)(job->data, pool->jobOpaque);
-        VIR_FREE(job);
         virMutexLock(&pool->mutex);
+
+        virThreadPoolJobDone(pool, job);
+        VIR_FREE(job);
     }
 
  out:
@@ -234,6 +509,14 @@ virThreadPoolNewFull(size_t minWorkers,
         return NULL;
 
     pool->jobList.tail = pool->jobList.head = NULL;
+    pool->clock = virTimeMonotonicMicrosNowRaw;
+
+    if (!(pool->defaultFlow = virThreadPoolFlowNew(pool, NULL)) ||
+        !(pool->flows = virHashCreate(32, virThreadPoolFlowHashFree))) {
+        virThreadPoolFlowFree(pool->defaultFlow);
+        VIR_FREE(pool);
+        return NULL;
+    }
 
     pool->jobFunc = func;
     pool->jobFuncName = funcName;
@@ -294,6 +577,10 @@ void virThreadPoolFree(virThreadPoolPtr pool)
         VIR_FREE(job);
     }
 
+    virHashFree(pool->flows);
+    virThreadPoolFlowFree(pool->defaultFlow);
+    VIR_FREE(pool->heap);
+
     VIR_FREE(pool->workers);
     virMutexUnlock(&pool->mutex);
     virMutexDestroy(&pool->mutex);
@@ -380,6 +667,26 @@ size_t virThreadPoolGetJobQueueDepth(virThreadPoolPtr pool)
 int virThreadPoolSendJob(virThreadPoolPtr pool,
                          unsigned int priority,
                          void *jobData)
+{
+    return virThreadPoolSendJobFull(pool, priority, NULL, 1, jobData);
+}
+
+/*
+ * @priority - job priority
+ * @flow - name of the flow the job belongs to, or NULL
+ * @weight - share of the workers the flow is entitled to
+ *
+ * Jobs of the same @flow are run in order, while the ordinary workers
+ * are shared between flows according to their @weight. Jobs sent
+ * without a flow all belong to a single one.
+ *
+ * Return: 0 on success, -1 otherwise
+ */
+int virThreadPoolSendJobFull(virThreadPoolPtr pool,
+                             unsigned int priority,
+                             const char *flow,
+                             unsigned int weight,
+                             void *jobData)
 {
     virThreadPoolJobPtr job;
 
@@ -395,9 +702,31 @@ int virThreadPoolSendJob(virThreadPoolPtr pool,
     if (VIR_ALLOC(job) < 0)
         goto error;
 
+    if (!(job->flow = virThreadPoolFlowGet(pool, flow, weight))) {
+        VIR_FREE(job);
+        goto error;
+    }
+
+    if (!job->flow->nqueued &&
+        virThreadPoolHeapPush(pool, job->flow) < 0) {
+        virThreadPoolFlowRelease(pool, job->flow);
+        VIR_FREE(job);
+        goto error;
+    }
+
     job->data = jobData;
     job->priority = priority;
 
+    job->flowPrev = job->flow->tail;
+    if (job->flow->tail)
+        job->flow->tail->flowNext = job;
+    job->flow->tail = job;
+
+    if (!job->flow->head)
+        job->flow->head = job;
+
+    job->flow->nqueued++;
+
     job->prev = pool->jobList.tail;
     if (pool->jobList.tail)
         pool->jobList.tail->next = job;
@@ -473,3 +802,21 @@ virThreadPoolSetParameters(virThreadPoolPtr pool,
     virMutexUnlock(&pool->mutex);
     return -1;
 }
+
+
+/**
+ * virThreadPoolSetClock:
+ * @pool: the thread pool
+ * @clock: replacement for virTimeMonotonicMicrosNowRaw
+ *
+ * Makes @pool measure the service time of jobs with @clock, so that
+ * tests don't depend on how long their jobs really run.
+ */
+void
+virThreadPoolSetClock(virThreadPoolPtr pool,
+                      virThreadPoolClockFunc clock)
+{
+    virMutexLock(&pool->mutex);
+    pool->clock = clock;
+    virMutexUnlock(&pool->mutex);
+}
@@ -57,6 +57,13 @@ int virThreadPoolSendJob(virThreadPoolPtr pool,
                          void *jobdata) ATTRIBUTE_NONNULL(1)
                                         ATTRIBUTE_RETURN_CHECK;
 
+int virThreadPoolSendJobFull(virThreadPoolPtr pool,
+                             unsigned int priority,
+                             const char *flow,
+                             unsigned int weight,
+                             void *jobdata) ATTRIBUTE_NONNULL(1)
+                                            ATTRIBUTE_RETURN_CHECK;
+
 int virThreadPoolSetParameters(virThreadPoolPtr pool,
                                long long int minWorkers,
                                long long int maxWorkers,
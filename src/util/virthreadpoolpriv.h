@@ -0,0 +1,34 @@
+/*
+ * virthreadpoolpriv.h: Functions for testing virThreadPool APIs
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __VIR_THREAD_POOL_PRIV_H_ALLOW__
+# error "virthreadpoolpriv.h may only be included by virthreadpool.c or test suites"
+#endif
+
+#ifndef __VIR_THREAD_POOL_PRIV_H__
+# define __VIR_THREAD_POOL_PRIV_H__
+
+# include "virthreadpool.h"
+
+typedef int (*virThreadPoolClockFunc)(unsigned long long *now);
+
+void virThreadPoolSetClock(virThreadPoolPtr pool,
+                           virThreadPoolClockFunc clock);
+
+#endif /* __VIR_THREAD_POOL_PRIV_H__ */
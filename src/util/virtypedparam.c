@@ -1563,3 +1563,571 @@ virTypedParamsSerialize(virTypedParameterPtr params,
     virTypedParamsRemoteFree(params_val, nparams);
     return rv;
 }
+
+
+/**
+ * virTypedParamsDictNew:
+ *
+ * Creates an empty dictionary for virTypedParamsPack.
+ *
+ * Returns the new dictionary or NULL on error.
+ */
+virTypedParamsDictPtr
+virTypedParamsDictNew(void)
+{
+    virTypedParamsDictPtr dict;
+
+    if (VIR_ALLOC(dict) < 0)
+        return NULL;
+
+    if (!(dict->index = virHashCreate(64, NULL))) {
+        VIR_FREE(dict);
+        return NULL;
+    }
+
+    return dict;
+}
+
+
+void
+virTypedParamsDictFree(virTypedParamsDictPtr dict)
+{
+    if (!dict)
+        return;
+
+    virHashFree(dict->index);
+    virStringListFreeCount(dict->fields, dict->nfields);
+    VIR_FREE(dict->types);
+    VIR_FREE(dict);
+}
+
+
+static int
+virTypedParamsDictLookup(virTypedParamsDictPtr dict,
+                         const char *field,
+                         int type,
+                         unsigned int *key)
+{
+    size_t pos = (size_t) virHashLookup(dict->index, field);
+    char *name = NULL;
+    size_t i;
+
+    if (pos && dict->types[pos - 1] == type) {
+        *key = pos - 1;
+        return 0;
+    }
+
+    /* The same field with a different type is rare enough to be looked up
+     * the slow way. */
+    if (pos) {
+        for (i = pos; i < dict->nfields; i++) {
+            if (dict->types[i] == type && STREQ(dict->fields[i], field)) {
+                *key = i;
+                return 0;
+            }
+        }
+    }
+
+    if (VIR_STRDUP(name, field) < 0 ||
+        VIR_REALLOC_N(dict->types, dict->nfields + 1) < 0 ||
+        VIR_APPEND_ELEMENT_COPY(dict->fields, dict->nfields, name) < 0) {
+        VIR_FREE(name);
+        return -1;
+    }
+    dict->types[dict->nfields - 1] = type;
+    *key = dict->nfields - 1;
+
+    if (!pos &&
+        virHashAddEntry(dict->index, field, (void *) (size_t) dict->nfields) < 0)
+        return -1;
+
+    return 0;
+}
+
+
+/**
+ * virTypedParamsPack:
+ * @dict: dictionary of field names shared by all packed arrays
+ * @params: array of parameters to be packed
+ * @nparams: number of elements in @params
+ * @keys: filled with indexes into @dict, one for each packed parameter
+ * @values: filled with the value of each packed parameter
+ * @nvalues: the number of elements in @keys and @values
+ * @strings: filled with values of string parameters
+ * @nstrings: number of elements in @strings
+ * @flags: bitwise-OR of virTypedParameterFlags
+ *
+ * This is a more compact alternative to virTypedParamsSerialize for
+ * APIs which return many arrays with the same fields, such as
+ * virConnectGetAllDomainStats. Field names are added to @dict and each
+ * parameter is represented only by the index of its field and a 64-bit
+ * value. Values of string parameters are stored in @strings and the
+ * corresponding value holds the index into @strings.
+ *
+ * Parameters with no type and string parameters if @flags does not
+ * contain VIR_TYPED_PARAM_STRING_OKAY are skipped, similarly to
+ * virTypedParamsSerialize.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virTypedParamsPack(virTypedParamsDictPtr dict,
+                   virTypedParameterPtr params,
+                   int nparams,
+                   unsigned int **keys,
+                   unsigned long long **values,
+                   unsigned int *nvalues,
+                   char ***strings,
+                   unsigned int *nstrings,
+                   unsigned int flags)
+{
+    unsigned int *k = NULL;
+    unsigned long long *v = NULL;
+    char **str = NULL;
+    size_t nstr = 0;
+    size_t i;
+    size_t j;
+    int ret = -1;
+
+    if (VIR_ALLOC_N(k, nparams) < 0 ||
+        VIR_ALLOC_N(v, nparams) < 0)
+        goto cleanup;
+
+    for (i = 0, j = 0; i < nparams; i++) {
+        virTypedParameterPtr param = params + i;
+
+        if (!param->type ||
+            (!(flags & VIR_TYPED_PARAM_STRING_OKAY) &&
+             param->type == VIR_TYPED_PARAM_STRING))
+            continue;
+
+        switch (param->type) {
+        case VIR_TYPED_PARAM_INT:
+            v[j] = (long long) param->value.i;
+            break;
+        case VIR_TYPED_PARAM_UINT:
+            v[j] = param->value.ui;
+            break;
+        case VIR_TYPED_PARAM_LLONG:
+            v[j] = param->value.l;
+            break;
+        case VIR_TYPED_PARAM_ULLONG:
+            v[j] = param->value.ul;
+            break;
+        case VIR_TYPED_PARAM_DOUBLE:
+            verify(sizeof(param->value.d) == sizeof(v[j]));
+            memcpy(&v[j], &param->value.d, sizeof(v[j]));
+            break;
+        case VIR_TYPED_PARAM_BOOLEAN:
+            v[j] = !!param->value.b;
+            break;
+        case VIR_TYPED_PARAM_STRING: {
+            char *tmp = NULL;
+
+            v[j] = nstr;
+            if (VIR_STRDUP(tmp, param->value.s) < 0 ||
+                VIR_APPEND_ELEMENT(str, nstr, tmp) < 0) {
+                VIR_FREE(tmp);
+                goto cleanup;
+            }
+            break;
+        }
+        default:
+            virReportError(VIR_ERR_RPC, _("unknown parameter type: %d"),
+                           param->type);
+            goto cleanup;
+        }
+
+        if (virTypedParamsDictLookup(dict, param->field, param->type, &k[j]) < 0)
+            goto cleanup;
+        j++;
+    }
+
+    VIR_STEAL_PTR(*keys, k);
+    VIR_STEAL_PTR(*values, v);
+    *nvalues = j;
+    VIR_STEAL_PTR(*strings, str);
+    *nstrings = nstr;
+    ret = 0;
+
+ cleanup:
+    if (ret < 0)
+        virStringListFreeCount(str, nstr);
+    VIR_FREE(k);
+    VIR_FREE(v);
+    return ret;
+}
+
+
+/**
+ * virTypedParamsUnpack:
+ * @fields: field names of the dictionary used by virTypedParamsPack
+ * @types: types of the fields in @fields
+ * @nfields: number of elements in @fields and @types
+ * @keys: indexes into @fields
+ * @values: packed values
+ * @nvalues: number of elements in @keys and @values
+ * @strings: values of string parameters
+ * @nstrings: number of elements in @strings
+ * @limit: user specified maximum limit to @nvalues
+ * @params: pointer which will hold the unpacked parameters
+ * @nparams: number of entries in @params
+ *
+ * Expands parameters packed by virTypedParamsPack back into an array of
+ * typed parameters. All indexes coming from the remote side are checked.
+ *
+ * Returns 0 on success or -1 in case of an error.
+ */
+int
+virTypedParamsUnpack(char **fields,
+                     const int *types,
+                     unsigned int nfields,
+                     const unsigned int *keys,
+                     const unsigned long long *values,
+                     unsigned int nvalues,
+                     char **strings,
+                     unsigned int nstrings,
+                     int limit,
+                     virTypedParameterPtr *params,
+                     int *nparams)
+{
+    virTypedParameterPtr p = NULL;
+    size_t i;
+    int ret = -1;
+
+    if (limit && nvalues > limit) {
+        virReportError(VIR_ERR_RPC,
+                       _("too many parameters '%u' for limit '%d'"),
+                       nvalues, limit);
+        goto cleanup;
+    }
+
+    if (VIR_ALLOC_N(p, nvalues) < 0)
+        goto cleanup;
+
+    for (i = 0; i < nvalues; i++) {
+        virTypedParameterPtr param = p + i;
+        unsigned long long value = values[i];
+
+        if (keys[i] >= nfields) {
+            virReportError(VIR_ERR_RPC,
+                           _("parameter key '%u' out of range"), keys[i]);
+            goto cleanup;
+        }
+
+        if (virStrcpyStatic(param->field, fields[keys[i]]) == NULL) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("parameter %s too big for destination"),
+                           fields[keys[i]]);
+            goto cleanup;
+        }
+
+        param->type = types[keys[i]];
+        switch (param->type) {
+        case VIR_TYPED_PARAM_INT:
+            param->value.i = (long long) value;
+            break;
+        case VIR_TYPED_PARAM_UINT:
+            param->value.ui = value;
+            break;
+        case VIR_TYPED_PARAM_LLONG:
+            param->value.l = value;
+            break;
+        case VIR_TYPED_PARAM_ULLONG:
+            param->value.ul = value;
+            break;
+        case VIR_TYPED_PARAM_DOUBLE:
+            memcpy(&param->value.d, &value, sizeof(param->value.d));
+            break;
+        case VIR_TYPED_PARAM_BOOLEAN:
+            param->value.b = !!value;
+            break;
+        case VIR_TYPED_PARAM_STRING:
+            if (value >= nstrings) {
+                virReportError(VIR_ERR_RPC,
+                               _("string index '%llu' out of range"), value);
+                goto cleanup;
+            }
+            if (VIR_STRDUP(param->value.s, strings[value]) < 0)
+                goto cleanup;
+            break;
+        default:
+            virReportError(VIR_ERR_RPC, _("unknown parameter type: %d"),
+                           param->type);
+            goto cleanup;
+        }
+    }
+
+    *params = p;
+    *nparams = nvalues;
+    p = NULL;
+    ret = 0;
+
+ cleanup:
+    virTypedParamsFree(p, nvalues);
+    return ret;
+}
+
+
+/**
+ * virTypedParamListNew:
+ * @count: expected number of parameters
+ *
+ * Creates a new typed parameter list with space for @count parameters
+ * preallocated. @count is only a hint, the list grows as needed.
+ *
+ * Returns the new list or NULL on error.
+ */
+virTypedParamListPtr
+virTypedParamListNew(size_t count)
+{
+    virTypedParamListPtr list;
+
+    if (VIR_ALLOC(list) < 0)
+        return NULL;
+
+    if (virTypedParamListReserve(list, count) < 0) {
+        VIR_FREE(list);
+        return NULL;
+    }
+
+    return list;
+}
+
+
+void
+virTypedParamListFree(virTypedParamListPtr list)
+{
+    if (!list)
+        return;
+
+    virTypedParamsFree(list->par, list->npar);
+    VIR_FREE(list);
+}
+
+
+/**
+ * virTypedParamListReserve:
+ * @list: typed parameter list
+ * @count: number of parameters about to be added
+ *
+ * Makes sure @list can accommodate @count more parameters without
+ * reallocating. The array grows geometrically, so reserving space for
+ * one parameter at a time is amortized too.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virTypedParamListReserve(virTypedParamListPtr list,
+                         size_t count)
+{
+    return VIR_RESIZE_N(list->par, list->par_alloc, list->npar, count);
+}
+
+
+/**
+ * virTypedParamListSetPrefix:
+ * @list: typed parameter list
+ * @fmt: printf-style format of the prefix
+ *
+ * Sets the prefix prepended to names of all parameters subsequently added
+ * to @list, e.g. "net.%zu.". The prefix is formatted only once, adding a
+ * parameter then just concatenates it with the name passed by the caller.
+ *
+ * Returns 0 on success, -1 if the prefix is too long.
+ */
+int
+virTypedParamListSetPrefix(virTypedParamListPtr list,
+                           const char *fmt, ...)
+{
+    va_list ap;
+    int len;
+
+    va_start(ap, fmt);
+    len = vsnprintf(list->prefix, sizeof(list->prefix), fmt, ap);
+    va_end(ap);
+
+    if (len < 0 || len >= sizeof(list->prefix)) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Parameter name prefix '%s' too long"), fmt);
+        virTypedParamListClearPrefix(list);
+        return -1;
+    }
+
+    list->prefixlen = len;
+    return 0;
+}
+
+
+void
+virTypedParamListClearPrefix(virTypedParamListPtr list)
+{
+    list->prefix[0] = '\0';
+    list->prefixlen = 0;
+}
+
+
+/* Returns a pointer to a new parameter in @list with its field and type
+ * set, or NULL on error. The caller fills in the value. */
+static virTypedParameterPtr
+virTypedParamListAdd(virTypedParamListPtr list,
+                     const char *name,
+                     int type)
+{
+    virTypedParameterPtr param;
+    size_t len = strlen(name);
+
+    if (list->prefixlen + len >= VIR_TYPED_PARAM_FIELD_LENGTH) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Parameter name '%s%s' too long"),
+                       list->prefix, name);
+        return NULL;
+    }
+
+    if (virTypedParamListReserve(list, 1) < 0)
+        return NULL;
+
+    param = list->par + list->npar;
+    memcpy(param->field, list->prefix, list->prefixlen);
+    memcpy(param->field + list->prefixlen, name, len + 1);
+    param->type = type;
+    list->npar++;
+
+    return param;
+}
+
+
+int
+virTypedParamListAddInt(virTypedParamListPtr list,
+                        const char *name,
+                        int value)
+{
+    virTypedParameterPtr param;
+
+    if (!(param = virTypedParamListAdd(list, name, VIR_TYPED_PARAM_INT)))
+        return -1;
+
+    param->value.i = value;
+    return 0;
+}
+
+
+int
+virTypedParamListAddUInt(virTypedParamListPtr list,
+                         const char *name,
+                         unsigned int value)
+{
+    virTypedParameterPtr param;
+
+    if (!(param = virTypedParamListAdd(list, name, VIR_TYPED_PARAM_UINT)))
+        return -1;
+
+    param->value.ui = value;
+    return 0;
+}
+
+
+int
+virTypedParamListAddLLong(virTypedParamListPtr list,
+                          const char *name,
+                          long long value)
+{
+    virTypedParameterPtr param;
+
+    if (!(param = virTypedParamListAdd(list, name, VIR_TYPED_PARAM_LLONG)))
+        return -1;
+
+    param->value.l = value;
+    return 0;
+}
+
+
+int
+virTypedParamListAddULLong(virTypedParamListPtr list,
+                           const char *name,
+                           unsigned long long value)
+{
+    virTypedParameterPtr param;
+
+    if (!(param = virTypedParamListAdd(list, name, VIR_TYPED_PARAM_ULLONG)))
+        return -1;
+
+    param->value.ul = value;
+    return 0;
+}
+
+
+int
+virTypedParamListAddDouble(virTypedParamListPtr list,
+                           const char *name,
+                           double value)
+{
+    virTypedParameterPtr param;
+
+    if (!(param = virTypedParamListAdd(list, name, VIR_TYPED_PARAM_DOUBLE)))
+        return -1;
+
+    param->value.d = value;
+    return 0;
+}
+
+
+int
+virTypedParamListAddBoolean(virTypedParamListPtr list,
+                            const char *name,
+                            bool value)
+{
+    virTypedParameterPtr param;
+
+    if (!(param = virTypedParamListAdd(list, name, VIR_TYPED_PARAM_BOOLEAN)))
+        return -1;
+
+    param->value.b = !!value;
+    return 0;
+}
+
+
+int
+virTypedParamListAddString(virTypedParamListPtr list,
+                           const char *name,
+                           const char *value)
+{
+    virTypedParameterPtr param;
+    char *str;
+
+    if (VIR_STRDUP(str, value) < 0)
+        return -1;
+
+    if (!(param = virTypedParamListAdd(list, name, VIR_TYPED_PARAM_STRING))) {
+        VIR_FREE(str);
+        return -1;
+    }
+
+    param->value.s = str;
+    return 0;
+}
+
+
+/**
+ * virTypedParamListStealParams:
+ * @list: typed parameter list
+ * @params: filled with the array of parameters
+ *
+ * Transfers ownership of the parameters built in @list to the caller
+ * and empties @list.
+ *
+ * Returns the number of parameters stored in @params.
+ */
+size_t
+virTypedParamListStealParams(virTypedParamListPtr list,
+                             virTypedParameterPtr *params)
+{
+    size_t ret = list->npar;
+
+    *params = list->par;
+    list->par = NULL;
+    list->npar = 0;
+    list->par_alloc = 0;
+
+    return ret;
+}
@@ -25,6 +25,7 @@
 
 # include "internal.h"
 # include "virutil.h"
+# include "virhash.h"
 
 /**
  * VIR_TYPED_PARAM_MULTIPLE:
@@ -118,6 +119,110 @@ int virTypedParamsSerialize(virTypedParameterPtr params,
                             unsigned int *remote_params_len,
                             unsigned int flags);
 
+/*
+ * Dictionary of field names shared by several arrays of typed parameters
+ * in the packed representation. Every distinct pair of field name and type
+ * is stored only once and the packed arrays refer to it by its index.
+ */
+typedef struct _virTypedParamsDict virTypedParamsDict;
+typedef virTypedParamsDict *virTypedParamsDictPtr;
+struct _virTypedParamsDict {
+    char **fields;
+    int *types;
+    size_t nfields;
+
+    virHashTablePtr index; /* field name -> position in @fields + 1 */
+};
+
+virTypedParamsDictPtr virTypedParamsDictNew(void);
+
+void virTypedParamsDictFree(virTypedParamsDictPtr dict);
+
+int virTypedParamsPack(virTypedParamsDictPtr dict,
+                       virTypedParameterPtr params,
+                       int nparams,
+                       unsigned int **keys,
+                       unsigned long long **values,
+                       unsigned int *nvalues,
+                       char ***strings,
+                       unsigned int *nstrings,
+                       unsigned int flags);
+
+int virTypedParamsUnpack(char **fields,
+                         const int *types,
+                         unsigned int nfields,
+                         const unsigned int *keys,
+                         const unsigned long long *values,
+                         unsigned int nvalues,
+                         char **strings,
+                         unsigned int nstrings,
+                         int limit,
+                         virTypedParameterPtr *params,
+                         int *nparams);
+
+/*
+ * Builder for arrays of typed parameters. Unlike virTypedParamsAdd* it
+ * allows reserving space for the expected number of parameters up front
+ * and composing parameter names from a prefix formatted only once (e.g.
+ * "block.3.") and a constant suffix (e.g. "rd.bytes").
+ */
+typedef struct _virTypedParamList virTypedParamList;
+typedef virTypedParamList *virTypedParamListPtr;
+struct _virTypedParamList {
+    virTypedParameterPtr par;
+    size_t npar;
+    size_t par_alloc;
+
+    char prefix[VIR_TYPED_PARAM_FIELD_LENGTH];
+    size_t prefixlen;
+};
+
+virTypedParamListPtr virTypedParamListNew(size_t count);
+
+void virTypedParamListFree(virTypedParamListPtr list);
+
+int virTypedParamListReserve(virTypedParamListPtr list,
+                             size_t count)
+    ATTRIBUTE_RETURN_CHECK;
+
+int virTypedParamListSetPrefix(virTypedParamListPtr list,
+                               const char *fmt, ...)
+    ATTRIBUTE_FMT_PRINTF(2, 3) ATTRIBUTE_RETURN_CHECK;
+
+void virTypedParamListClearPrefix(virTypedParamListPtr list);
+
+int virTypedParamListAddInt(virTypedParamListPtr list,
+                            const char *name,
+                            int value)
+    ATTRIBUTE_RETURN_CHECK;
+int virTypedParamListAddUInt(virTypedParamListPtr list,
+                             const char *name,
+                             unsigned int value)
+    ATTRIBUTE_RETURN_CHECK;
+int virTypedParamListAddLLong(virTypedParamListPtr list,
+                              const char *name,
+                              long long value)
+    ATTRIBUTE_RETURN_CHECK;
+int virTypedParamListAddULLong(virTypedParamListPtr list,
+                               const char *name,
+                               unsigned long long value)
+    ATTRIBUTE_RETURN_CHECK;
+int virTypedParamListAddDouble(virTypedParamListPtr list,
+                               const char *name,
+                               double value)
+    ATTRIBUTE_RETURN_CHECK;
+int virTypedParamListAddBoolean(virTypedParamListPtr list,
+                                const char *name,
+                                bool value)
+    ATTRIBUTE_RETURN_CHECK;
+int virTypedParamListAddString(virTypedParamListPtr list,
+                               const char *name,
+                               const char *value)
+    ATTRIBUTE_RETURN_CHECK;
+
+size_t virTypedParamListStealParams(virTypedParamListPtr list,
+                                    virTypedParameterPtr *params);
+
 VIR_ENUM_DECL(virTypedParameter)
 
 # define VIR_TYPED_PARAMS_DEBUG(params, nparams) \
@@ -33,6 +33,8 @@
 #include "internal.h"
 #include "viralloc.h"
 #include "vircommand.h"
+#define __VIR_COMMAND_PRIV_H_ALLOW__
+#include "vircommandpriv.h"
 #include "virfile.h"
 #include "virpidfile.h"
 #include "virerror.h"
@@ -1138,6 +1140,69 @@ static int test25(const void *unused ATTRIBUTE_UNUSED)
 }
 
 
+struct testSpawnData {
+    int (*func)(const void *);
+    bool spawned;
+};
+
+/*
+ * Run a test with the spawn helper running and check whether its
+ * commands were started through the helper.
+ */
+static int testSpawn(const void *opaque)
+{
+    const struct testSpawnData *data = opaque;
+    size_t count = virCommandSpawnServerGetCount();
+
+    if (data->func(NULL) < 0)
+        return -1;
+
+    if ((virCommandSpawnServerGetCount() != count) != data->spawned) {
+        fprintf(stderr, "expected commands %s the spawn helper\n",
+                data->spawned ? "started by" : "not started by");
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Run a shell with the spawn helper running, it must be a child of the
+ * helper rather than of the test.
+ */
+static int testSpawnParent(const void *unused ATTRIBUTE_UNUSED)
+{
+    virCommandPtr cmd = virCommandNewArgList("/bin/sh", "-c",
+                                             "echo $PPID", NULL);
+    char *output = NULL;
+    char *expect = NULL;
+    int ret = -1;
+
+    virCommandSetOutputBuffer(cmd, &output);
+
+    if (virCommandRun(cmd, NULL) < 0) {
+        printf("Cannot run child %s\n", virGetLastErrorMessage());
+        goto cleanup;
+    }
+
+    if (virAsprintf(&expect, "%lld\n",
+                    (long long) virCommandSpawnServerGetPid()) < 0)
+        goto cleanup;
+
+    if (STRNEQ_NULLABLE(output, expect)) {
+        virTestDifference(stderr, expect, NULLSTR(output));
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    VIR_FREE(expect);
+    VIR_FREE(output);
+    virCommandFree(cmd);
+    return ret;
+}
+
 static void virCommandThreadWorker(void *opaque)
 {
     virCommandTestDataPtr test = opaque;
@@ -1292,6 +1357,34 @@ mymain(void)
     DO_TEST(test24);
     DO_TEST(test25);
 
+# define DO_TEST_SPAWN(NAME, SPAWNED) \
+    do { \
+        struct testSpawnData data = { NAME, SPAWNED }; \
+        if (virTestRun("Command Exec " #NAME " spawn helper test", \
+                       testSpawn, &data) < 0) \
+            ret = -1; \
+    } while (0)
+
+    /* Rerun the plain synchronous commands through the spawn helper,
+     * test15 sets a umask and falls back to forking directly */
+    if (virCommandSpawnServerStart() < 0) {
+        printf("Cannot start spawn helper %s\n", virGetLastErrorMessage());
+        ret = -1;
+    } else {
+        DO_TEST_SPAWN(test0, true);
+        DO_TEST_SPAWN(test1, true);
+        DO_TEST_SPAWN(test2, true);
+        DO_TEST_SPAWN(test3, true);
+        DO_TEST_SPAWN(test14, true);
+        DO_TEST_SPAWN(test15, false);
+
+        if (virTestRun("Command Exec spawn helper parent test",
+                       testSpawnParent, NULL) < 0)
+            ret = -1;
+
+        virCommandSpawnServerStop();
+    }
+
     virMutexLock(&test->lock);
     if (test->running) {
         test->quit = true;
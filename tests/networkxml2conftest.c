@@ -111,6 +111,9 @@ mymain(void)
         = dnsmasqCapsNewFromBuffer("Dnsmasq version 2.63\n--bind-dynamic", DNSMASQ);
     dnsmasqCapsPtr dhcpv6
         = dnsmasqCapsNewFromBuffer("Dnsmasq version 2.64\n--bind-dynamic", DNSMASQ);
+    dnsmasqCapsPtr hostsdir
+        = dnsmasqCapsNewFromBuffer("Dnsmasq version 2.73\n--bind-dynamic\n"
+                                   "--dhcp-hostsdir", DNSMASQ);
 
 #define DO_TEST(xname, xcaps) \
     do { \
@@ -133,6 +136,7 @@ mymain(void)
     DO_TEST("routed-network-no-dns", full);
     DO_TEST("open-network", full);
     DO_TEST("nat-network", dhcpv6);
+    DO_TEST("nat-network-dhcp-hostsdir", hostsdir);
     DO_TEST("nat-network-dns-txt-record", full);
     DO_TEST("nat-network-dns-srv-record", full);
     DO_TEST("nat-network-dns-hosts", full);
@@ -145,6 +149,7 @@ mymain(void)
     DO_TEST("dhcp6host-routed-network", dhcpv6);
     DO_TEST("ptr-domains-auto", dhcpv6);
 
+    virObjectUnref(hostsdir);
     virObjectUnref(dhcpv6);
     virObjectUnref(full);
     virObjectUnref(restricted);
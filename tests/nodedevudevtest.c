@@ -0,0 +1,104 @@
+/*
+ * nodedevudevtest.c: Test the udev node device backend
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "testutils.h"
+#include "node_device/node_device_udevpriv.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+#define PF "/sys/devices/pci0000:00/0000:00:03.0/0000:02:00.0"
+#define VF0 "/sys/devices/pci0000:00/0000:00:03.0/0000:02:10.0"
+#define VF1 "/sys/devices/pci0000:00/0000:00:03.0/0000:02:10.1"
+#define NET0 VF0 "/net/eth0"
+
+struct testBatchInfo {
+    const char **syspaths;
+    size_t nevents;
+    const size_t *handle;
+    size_t nhandle;
+};
+
+
+/* Every device is handled once, in order */
+static const char *distinct[] = { PF, VF0, VF1 };
+static const size_t distinctHandle[] = { 0, 1, 2 };
+
+/* A device changing several times is handled once, using its last
+ * uevent */
+static const char *repeated[] = { VF0, VF0, VF0 };
+static const size_t repeatedHandle[] = { 2 };
+
+/* VFs created along with their net devices and changed again, the
+ * VF is still handled before its net device */
+static const char *burst[] = { VF0, NET0, VF1, VF0, NET0, VF1, PF };
+static const size_t burstHandle[] = { 3, 4, 5, 6 };
+
+
+static int
+testEventBatchCoalesce(const void *opaque)
+{
+    const struct testBatchInfo *info = opaque;
+    size_t handle[32];
+    size_t nhandle;
+    size_t i;
+
+    nhandle = udevEventBatchCoalesce(info->syspaths, info->nevents, handle);
+
+    if (nhandle != info->nhandle) {
+        fprintf(stderr, "Expected %zu uevents to handle, got %zu\n",
+                info->nhandle, nhandle);
+        return -1;
+    }
+
+    for (i = 0; i < nhandle; i++) {
+        if (handle[i] != info->handle[i]) {
+            fprintf(stderr, "Expected uevent %zu at position %zu, got %zu\n",
+                    info->handle[i], i, handle[i]);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+static int
+mymain(void)
+{
+    int ret = 0;
+
+#define DO_TEST(name, s, h) \
+    do { \
+        struct testBatchInfo info = { \
+            .syspaths = s, .nevents = ARRAY_CARDINALITY(s), \
+            .handle = h, .nhandle = ARRAY_CARDINALITY(h) }; \
+        if (virTestRun("Event batch " name, \
+                       testEventBatchCoalesce, &info) < 0) \
+            ret = -1; \
+    } while (0)
+
+    DO_TEST("distinct", distinct, distinctHandle);
+    DO_TEST("repeated", repeated, repeatedHandle);
+    DO_TEST("burst", burst, burstHandle);
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN(mymain)
@@ -28,6 +28,8 @@
 # include <arpa/inet.h>
 # include "libvirt_nss.h"
 # include "virsocketaddr.h"
+# include "virlease.h"
+# include "virfile.h"
 
 # define VIR_FROM_THIS VIR_FROM_NONE
 
@@ -169,6 +171,127 @@ testGetHostByName(const void *opaque)
     return ret;
 }
 
+
+# if !defined(LIBVIRT_NSS_GUEST)
+static int
+testLeaseIndexCount(const virLeaseIndexRecord *record ATTRIBUTE_UNUSED,
+                    void *opaque)
+{
+    size_t *count = opaque;
+
+    (*count)++;
+    return 0;
+}
+
+
+#  define SCRATCHDIRTEMPLATE abs_builddir "/nsstestdir-XXXXXX"
+
+static int
+testLeaseIndex(const void *opaque ATTRIBUTE_UNUSED)
+{
+    char scratchdir[] = SCRATCHDIRTEMPLATE;
+    char *srcfile = NULL;
+    char *statusfile = NULL;
+    char *indexfile = NULL;
+    char *content = NULL;
+    virJSONValuePtr leases = NULL;
+    virLeaseIndexPtr idx = NULL;
+    size_t count;
+    int ret = -1;
+
+    if (!mkdtemp(scratchdir)) {
+        virReportSystemError(errno, "%s", "Cannot create scratch dir");
+        return -1;
+    }
+
+    if (virAsprintf(&srcfile, "%s/nssdata/virbr0.status", abs_srcdir) < 0 ||
+        virAsprintf(&statusfile, "%s/virbr0.status", scratchdir) < 0 ||
+        !(indexfile = virLeaseIndexFileName(statusfile)) ||
+        virFileReadAll(srcfile, 1024 * 1024, &content) < 0 ||
+        virFileWriteStr(statusfile, content, 0644) < 0)
+        goto cleanup;
+
+    if (!(leases = virJSONValueNewArray()) ||
+        virLeaseReadCustomLeaseFile(leases, statusfile, NULL, NULL) < 0 ||
+        virLeaseWriteIndex(leases, statusfile) < 0)
+        goto cleanup;
+
+    if (!(idx = virLeaseIndexOpen(statusfile))) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       "Unable to open lease index");
+        goto cleanup;
+    }
+
+    count = 0;
+    if (virLeaseIndexForEachHostname(idx, "fedora",
+                                     testLeaseIndexCount, &count) < 0 ||
+        count != 2) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       "Expected 2 leases of fedora, got %zu", count);
+        goto cleanup;
+    }
+
+    count = 0;
+    if (virLeaseIndexForEachMAC(idx, "52:54:00:3a:b5:0c",
+                                testLeaseIndexCount, &count) < 0 ||
+        count != 1) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       "Expected 1 lease of 52:54:00:3a:b5:0c, got %zu",
+                       count);
+        goto cleanup;
+    }
+
+    count = 0;
+    if (virLeaseIndexForEachHostname(idx, "non-existent",
+                                     testLeaseIndexCount, &count) < 0 ||
+        count != 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       "Expected no leases of non-existent, got %zu", count);
+        goto cleanup;
+    }
+
+    virLeaseIndexFree(idx);
+
+    /* Rewriting the leases file must invalidate the index */
+    if (virFileRewriteStr(statusfile, 0644, "[]") < 0)
+        goto cleanup;
+
+    if ((idx = virLeaseIndexOpen(statusfile))) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       "Stale lease index was not detected");
+        goto cleanup;
+    }
+
+    /* Removing the leases file must remove the index too */
+    if (!virFileExists(indexfile)) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       "Lease index '%s' does not exist", indexfile);
+        goto cleanup;
+    }
+
+    virLeaseDeleteFile(statusfile);
+
+    if (virFileExists(statusfile) || virFileExists(indexfile)) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       "Leases file or its index was not removed");
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    virLeaseIndexFree(idx);
+    virJSONValueFree(leases);
+    if (getenv("LIBVIRT_SKIP_CLEANUP") == NULL)
+        virFileDeleteTree(scratchdir);
+    VIR_FREE(content);
+    VIR_FREE(indexfile);
+    VIR_FREE(statusfile);
+    VIR_FREE(srcfile);
+    return ret;
+}
+# endif /* !defined(LIBVIRT_NSS_GUEST) */
+
+
 static int
 mymain(void)
 {
@@ -190,6 +313,9 @@ mymain(void)
     DO_TEST("gentoo", AF_INET6, "2001:1234:dead:beef::2");
     DO_TEST("gentoo", AF_UNSPEC, "192.168.122.254");
     DO_TEST("non-existent", AF_UNSPEC, NULL);
+
+    if (virTestRun("lease index", testLeaseIndex, NULL) < 0)
+        ret = -1;
 # else /* defined(LIBVIRT_NSS_GUEST) */
     DO_TEST("debian", AF_INET, "192.168.122.2");
     DO_TEST("suse", AF_INET, "192.168.122.3");
@@ -25,6 +25,7 @@
 
 #include "virerror.h"
 #include "virxml.h"
+#include "virtime.h"
 
 #define VIR_FROM_THIS VIR_FROM_NONE
 
@@ -198,6 +199,16 @@ nodeDeviceLifecycleCb(virConnectPtr conn ATTRIBUTE_UNUSED,
         counter->deletedEvents++;
 }
 
+static void
+domainNoopCb(virConnectPtr conn ATTRIBUTE_UNUSED,
+             virDomainPtr dom ATTRIBUTE_UNUSED,
+             void *opaque)
+{
+    int *counter = opaque;
+
+    (*counter)++;
+}
+
 static int
 testDomainCreateXMLOld(const void *data)
 {
@@ -472,6 +483,89 @@ testDomainStartStopEvent(const void *data)
     return ret;
 }
 
+#define DISPATCH_IDLE_CALLBACKS 1000
+#define DISPATCH_CYCLES 200
+
+/* Dispatching must not get slower with callbacks waiting for other
+ * events being registered. */
+static int
+testDomainEventDispatchRate(const void *data)
+{
+    const objecteventTest *test = data;
+    lifecycleEventCounter counter;
+    int ids[DISPATCH_IDLE_CALLBACKS];
+    int noopEvents = 0;
+    int id = -1;
+    virDomainPtr dom = NULL;
+    unsigned long long then;
+    unsigned long long now;
+    size_t i;
+    int ret = -1;
+
+    lifecycleEventCounter_reset(&counter);
+
+    for (i = 0; i < DISPATCH_IDLE_CALLBACKS; i++)
+        ids[i] = -1;
+
+    if (!(dom = virDomainLookupByName(test->conn, "test")))
+        goto cleanup;
+
+    for (i = 0; i < DISPATCH_IDLE_CALLBACKS; i++) {
+        ids[i] = virConnectDomainEventRegisterAny(test->conn, NULL,
+                                                  VIR_DOMAIN_EVENT_ID_REBOOT,
+                               VIR_DOMAIN_EVENT_CALLBACK(&domainNoopCb),
+                                                  &noopEvents, NULL);
+        if (ids[i] < 0)
+            goto cleanup;
+    }
+
+    id = virConnectDomainEventRegisterAny(test->conn, dom,
+                                          VIR_DOMAIN_EVENT_ID_LIFECYCLE,
+                           VIR_DOMAIN_EVENT_CALLBACK(&domainLifecycleCb),
+                                          &counter, NULL);
+    if (id < 0)
+        goto cleanup;
+
+    if (virTimeMillisNow(&then) < 0)
+        goto cleanup;
+
+    for (i = 0; i < DISPATCH_CYCLES; i++) {
+        if (virDomainDestroy(dom) < 0 ||
+            virDomainCreate(dom) < 0)
+            goto cleanup;
+    }
+
+    if (virEventRunDefaultImpl() < 0)
+        goto cleanup;
+
+    if (virTimeMillisNow(&now) < 0)
+        goto cleanup;
+
+    VIR_TEST_DEBUG("Dispatched %d events with %d idle callbacks in %llu ms",
+                   counter.startEvents + counter.stopEvents,
+                   DISPATCH_IDLE_CALLBACKS, now - then);
+
+    if (counter.startEvents != DISPATCH_CYCLES ||
+        counter.stopEvents != DISPATCH_CYCLES ||
+        noopEvents != 0 ||
+        counter.unexpectedEvents > 0)
+        goto cleanup;
+
+    ret = 0;
+ cleanup:
+    if (id >= 0)
+        virConnectDomainEventDeregisterAny(test->conn, id);
+    for (i = 0; i < DISPATCH_IDLE_CALLBACKS; i++) {
+        if (ids[i] >= 0)
+            virConnectDomainEventDeregisterAny(test->conn, ids[i]);
+    }
+    if (dom)
+        virDomainFree(dom);
+
+    return ret;
+}
+
+
 static int
 testNetworkCreateXML(const void *data)
 {
@@ -864,6 +958,9 @@ mymain(void)
         ret = EXIT_FAILURE;
     if (virTestRun("Domain start stop events", testDomainStartStopEvent, &test) < 0)
         ret = EXIT_FAILURE;
+    if (virTestRun("Domain event dispatch rate",
+                   testDomainEventDispatchRate, &test) < 0)
+        ret = EXIT_FAILURE;
 
     /* Network event tests */
     /* Tests requiring the test network not to be set up*/
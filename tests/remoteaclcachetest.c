@@ -0,0 +1,205 @@
+/*
+ * remoteaclcachetest.c: Test the cache of event access control decisions
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include <unistd.h>
+
+#include "testutils.h"
+#include "remote/remote_daemon_aclcache.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+static const unsigned char uuid1[VIR_UUID_BUFLEN] = "0123456789abcdef";
+static const unsigned char uuid2[VIR_UUID_BUFLEN] = "fedcba9876543210";
+
+
+static int
+testACLCacheExpect(remoteACLCachePtr cache,
+                   const char *kind,
+                   const unsigned char *uuid,
+                   const char *name,
+                   bool found,
+                   bool allowed)
+{
+    bool actual = !allowed;
+
+    if (remoteACLCacheLookup(cache, kind, uuid, name, &actual) != found) {
+        fprintf(stderr, "%s:%s: expected %s\n", kind, NULLSTR(name),
+                found ? "a hit" : "a miss");
+        return -1;
+    }
+
+    if (found && actual != allowed) {
+        fprintf(stderr, "%s:%s: expected %s, got %s\n", kind, NULLSTR(name),
+                allowed ? "allowed" : "denied",
+                actual ? "allowed" : "denied");
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static int
+testACLCacheHit(const void *opaque ATTRIBUTE_UNUSED)
+{
+    remoteACLCachePtr cache;
+    int ret = -1;
+
+    if (!(cache = remoteACLCacheNew(REMOTE_ACL_CACHE_TTL)))
+        return -1;
+
+    remoteACLCacheStore(cache, "domain", uuid1, "dom1", true);
+    remoteACLCacheStore(cache, "domain", uuid2, "dom2", false);
+    remoteACLCacheStore(cache, "node-device", NULL, "dev1", true);
+
+    if (testACLCacheExpect(cache, "domain", uuid1, "dom1", true, true) < 0 ||
+        testACLCacheExpect(cache, "domain", uuid2, "dom2", true, false) < 0 ||
+        testACLCacheExpect(cache, "node-device", NULL, "dev1", true, true) < 0)
+        goto cleanup;
+
+    /* Overwriting a decision replaces it */
+    remoteACLCacheStore(cache, "domain", uuid1, "dom1", false);
+    if (testACLCacheExpect(cache, "domain", uuid1, "dom1", true, false) < 0)
+        goto cleanup;
+
+    ret = 0;
+ cleanup:
+    remoteACLCacheFree(cache);
+    return ret;
+}
+
+
+static int
+testACLCacheMiss(const void *opaque ATTRIBUTE_UNUSED)
+{
+    remoteACLCachePtr cache;
+    int ret = -1;
+
+    if (!(cache = remoteACLCacheNew(REMOTE_ACL_CACHE_TTL)))
+        return -1;
+
+    if (testACLCacheExpect(cache, "domain", uuid1, "dom1", false, false) < 0)
+        goto cleanup;
+
+    remoteACLCacheStore(cache, "domain", uuid1, "dom1", true);
+
+    /* Same UUID, but renamed */
+    if (testACLCacheExpect(cache, "domain", uuid1, "other", false, false) < 0)
+        goto cleanup;
+
+    /* Same name, but a different object */
+    if (testACLCacheExpect(cache, "domain", uuid2, "dom1", false, false) < 0)
+        goto cleanup;
+
+    /* Same object, but a different event kind */
+    if (testACLCacheExpect(cache, "qemu-monitor", uuid1, "dom1",
+                           false, false) < 0)
+        goto cleanup;
+
+    /* No UUID at all */
+    if (testACLCacheExpect(cache, "domain", NULL, "dom1", false, false) < 0)
+        goto cleanup;
+
+    ret = 0;
+ cleanup:
+    remoteACLCacheFree(cache);
+    return ret;
+}
+
+
+static int
+testACLCacheFlush(const void *opaque ATTRIBUTE_UNUSED)
+{
+    remoteACLCachePtr cache1 = NULL;
+    remoteACLCachePtr cache2 = NULL;
+    int ret = -1;
+
+    if (!(cache1 = remoteACLCacheNew(REMOTE_ACL_CACHE_TTL)) ||
+        !(cache2 = remoteACLCacheNew(REMOTE_ACL_CACHE_TTL)))
+        goto cleanup;
+
+    remoteACLCacheStore(cache1, "domain", uuid1, "dom1", true);
+    remoteACLCacheStore(cache2, "network", uuid2, "net1", false);
+
+    if (testACLCacheExpect(cache1, "domain", uuid1, "dom1", true, true) < 0 ||
+        testACLCacheExpect(cache2, "network", uuid2, "net1", true, false) < 0)
+        goto cleanup;
+
+    /* Invalidates the decisions of every cache */
+    remoteACLCacheFlushAll();
+
+    if (testACLCacheExpect(cache1, "domain", uuid1, "dom1", false, false) < 0 ||
+        testACLCacheExpect(cache2, "network", uuid2, "net1", false, false) < 0)
+        goto cleanup;
+
+    /* Decisions made after the flush are cached again */
+    remoteACLCacheStore(cache1, "domain", uuid1, "dom1", false);
+    if (testACLCacheExpect(cache1, "domain", uuid1, "dom1", true, false) < 0)
+        goto cleanup;
+
+    ret = 0;
+ cleanup:
+    remoteACLCacheFree(cache1);
+    remoteACLCacheFree(cache2);
+    return ret;
+}
+
+
+static int
+testACLCacheExpire(const void *opaque ATTRIBUTE_UNUSED)
+{
+    remoteACLCachePtr cache;
+    int ret = -1;
+
+    /* Decisions stay valid for a millisecond only */
+    if (!(cache = remoteACLCacheNew(1)))
+        return -1;
+
+    remoteACLCacheStore(cache, "domain", uuid1, "dom1", true);
+    usleep(10 * 1000);
+
+    if (testACLCacheExpect(cache, "domain", uuid1, "dom1", false, false) < 0)
+        goto cleanup;
+
+    ret = 0;
+ cleanup:
+    remoteACLCacheFree(cache);
+    return ret;
+}
+
+
+static int
+mymain(void)
+{
+    int ret = 0;
+
+    if (virTestRun("Hit", testACLCacheHit, NULL) < 0)
+        ret = -1;
+    if (virTestRun("Miss", testACLCacheMiss, NULL) < 0)
+        ret = -1;
+    if (virTestRun("Flush", testACLCacheFlush, NULL) < 0)
+        ret = -1;
+    if (virTestRun("Expire", testACLCacheExpire, NULL) < 0)
+        ret = -1;
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN(mymain)
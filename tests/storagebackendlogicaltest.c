@@ -0,0 +1,261 @@
+/*
+ * storagebackendlogicaltest.c: LVM report parsing of the logical backend
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+
+#include "testutils.h"
+#include "virbuffer.h"
+#include "virfile.h"
+#include "virstring.h"
+
+#include "storage/storage_backend_logical_priv.h"
+
+#define __VIR_COMMAND_PRIV_H_ALLOW__
+#include "vircommandpriv.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+#define TEST_VG_NAME "vg_test"
+
+struct testGetReportData {
+    const char *name;
+    const char *lvname;
+    bool json;
+    bool fail;
+    bool probeFail;     /* probing for JSON support fails as with a
+                         * locked VG rather than a rejected option */
+};
+
+static unsigned int testProbes;
+
+
+/*
+ * Pretend to be lvs or vgs, replying with the captured output matching
+ * the command and the report format: "NAME.lvs" and "NAME.vgs" for the
+ * plain output, "NAME.lvs.json" and "NAME.vgs.json" for JSON reports.
+ */
+static void
+testRunLVM(const char *const *args,
+           const char *const *env ATTRIBUTE_UNUSED,
+           const char *input ATTRIBUTE_UNUSED,
+           char **output,
+           char **error,
+           int *status,
+           void *opaque)
+{
+    const struct testGetReportData *data = opaque;
+    const char *cmd = STREQ(args[0], VGS) ? "vgs" : "lvs";
+    bool json = virStringListHasString((const char **)args, "--reportformat");
+    bool report = virStringListHasString((const char **)args, "--units");
+    char *target = NULL;
+    char *file = NULL;
+    size_t nargs = virStringListLength(args);
+
+    *status = 1;
+
+    /* Probe for JSON support, older versions reject the option */
+    if (json && !report) {
+        testProbes++;
+        if (data->probeFail) {
+            *status = 5;
+            if (error)
+                ignore_value(VIR_STRDUP(*error,
+                                        "  Unable to obtain global lock.\n"));
+        } else if (!data->json) {
+            *status = 3;
+            if (error)
+                ignore_value(VIR_STRDUP(*error,
+                                        "  lvs: unrecognized option '--reportformat'\n"
+                                        "  Error during parsing of command line.\n"));
+        } else {
+            *status = 0;
+        }
+        return;
+    }
+
+    if (!output || json != data->json)
+        return;
+
+    if (data->lvname) {
+        if (virAsprintf(&target, "%s/%s", TEST_VG_NAME, data->lvname) < 0)
+            return;
+    } else {
+        if (VIR_STRDUP(target, TEST_VG_NAME) < 0)
+            return;
+    }
+
+    if (STRNEQ(args[nargs - 1], target))
+        goto cleanup;
+
+    if (virAsprintf(&file, "%s/storagebackendlogicaldata/%s.%s%s",
+                    abs_srcdir, data->name, cmd, json ? ".json" : "") < 0)
+        goto cleanup;
+
+    /* Running a command the test has no output for fails */
+    if (virFileExists(file) &&
+        virTestLoadFile(file, output) == 0)
+        *status = 0;
+
+ cleanup:
+    VIR_FREE(target);
+    VIR_FREE(file);
+}
+
+
+static char *
+testFormatReport(virStorageBackendLogicalReportPtr report,
+                 bool vgStats)
+{
+    virBuffer buf = VIR_BUFFER_INITIALIZER;
+    size_t i, j;
+
+    if (vgStats)
+        virBufferAsprintf(&buf, "vg size=%llu free=%llu\n",
+                          report->vgSize, report->vgFree);
+
+    for (i = 0; i < report->nvols; i++) {
+        virStorageVolDefPtr vol = report->vols[i];
+
+        virBufferAsprintf(&buf, "lv %s key=%s path=%s allocation=%llu",
+                          vol->name, vol->key, vol->target.path,
+                          vol->target.allocation);
+        if (vol->target.sparse)
+            virBufferAddLit(&buf, " sparse");
+        if (vol->target.backingStore)
+            virBufferAsprintf(&buf, " backing=%s",
+                              vol->target.backingStore->path);
+        virBufferAddLit(&buf, "\n");
+
+        for (j = 0; j < vol->source.nextent; j++)
+            virBufferAsprintf(&buf, "  extent %s %llu-%llu\n",
+                              vol->source.extents[j].path,
+                              vol->source.extents[j].start,
+                              vol->source.extents[j].end);
+    }
+
+    if (virBufferCheckError(&buf) < 0)
+        return NULL;
+
+    return virBufferContentAndReset(&buf);
+}
+
+
+static int
+testGetReport(const void *opaque)
+{
+    const struct testGetReportData *data = opaque;
+    virStorageBackendLogicalReport report;
+    char *outFile = NULL;
+    char *actual = NULL;
+    int rc;
+    int ret = -1;
+
+    memset(&report, 0, sizeof(report));
+
+    virStorageBackendLogicalResetJSONReport();
+    testProbes = 0;
+    virCommandSetDryRun(NULL, testRunLVM, (void *)data);
+
+    if (virAsprintf(&outFile, "%s/storagebackendlogicaldata/%s.txt",
+                    abs_srcdir, data->name) < 0)
+        goto cleanup;
+
+    rc = virStorageBackendLogicalGetReport(TEST_VG_NAME, data->lvname,
+                                           "/dev/vg_test", &report);
+
+    if (data->fail) {
+        if (rc == 0) {
+            VIR_TEST_DEBUG("parsing of '%s' should have failed", data->name);
+            goto cleanup;
+        }
+        ret = 0;
+        goto cleanup;
+    }
+
+    if (rc < 0)
+        goto cleanup;
+
+    if (!(actual = testFormatReport(&report, !data->lvname)))
+        goto cleanup;
+
+    if (virTestCompareToFile(actual, outFile) < 0)
+        goto cleanup;
+
+    /* The support of JSON reports is probed only once, unless the
+     * probe failed for reasons other than lvm rejecting the option */
+    virStorageBackendLogicalReportClear(&report);
+    if (virStorageBackendLogicalGetReport(TEST_VG_NAME, data->lvname,
+                                          "/dev/vg_test", &report) < 0)
+        goto cleanup;
+
+    if (testProbes != (data->probeFail ? 2 : 1)) {
+        VIR_TEST_DEBUG("expected %d probes for JSON support, got %u",
+                       data->probeFail ? 2 : 1, testProbes);
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virCommandSetDryRun(NULL, NULL, NULL);
+    virStorageBackendLogicalReportClear(&report);
+    VIR_FREE(outFile);
+    VIR_FREE(actual);
+    return ret;
+}
+
+
+static int
+mymain(void)
+{
+    int ret = 0;
+
+#define DO_TEST_FULL(name, lvname, fail) \
+    do { \
+        struct testGetReportData data = { name, lvname, true, fail, false }; \
+        if (virTestRun("LVM JSON report " name, \
+                       testGetReport, &data) < 0) \
+            ret = -1; \
+        data.json = false; \
+        if (virTestRun("LVM plain report " name, \
+                       testGetReport, &data) < 0) \
+            ret = -1; \
+        data.probeFail = true; \
+        if (virTestRun("LVM plain report " name " after failed probe", \
+                       testGetReport, &data) < 0) \
+            ret = -1; \
+    } while (0)
+
+#define DO_TEST(name) DO_TEST_FULL(name, NULL, false)
+#define DO_TEST_FAIL(name) DO_TEST_FULL(name, NULL, true)
+
+    DO_TEST("pool");
+    DO_TEST("emptyvg");
+    DO_TEST_FULL("singlevol", "mirror", false);
+    DO_TEST_FAIL("malformed");
+
+#undef DO_TEST
+#undef DO_TEST_FAIL
+#undef DO_TEST_FULL
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN(mymain)
@@ -0,0 +1,261 @@
+/*
+ * storagebackendrbdmock.c: mocked librados/librbd for the RBD backend
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "internal.h"
+#include "viralloc.h"
+#include "virstring.h"
+#include "rados/librados.h"
+#include "rbd/librbd.h"
+
+/*
+ * The mocked cluster has a pool "rbd" holding images "img00" ... "img39"
+ * of 1 MiB, 2 MiB, ... 40 MiB respectively and an image "gone", which is
+ * listed but can't be opened as if it was removed meanwhile.
+ *
+ * The total number of connections made so far is reported as the number
+ * of bytes used by the pool so that tests can tell when a connection was
+ * reused. The first stat of pool "flaky" fails as if the cluster went
+ * away.
+ */
+#define MOCK_IMAGES 40
+
+struct mockCluster {
+    bool connected;
+};
+
+struct mockIoctx {
+    struct mockCluster *cluster;
+    char *pool;
+};
+
+struct mockImage {
+    char *name;
+    int idx;
+};
+
+static int mockConnections;
+static bool mockFlakyFailed;
+
+
+int
+rados_create(rados_t *cluster,
+             const char * const id ATTRIBUTE_UNUSED)
+{
+    struct mockCluster *c;
+
+    if (VIR_ALLOC_QUIET(c) < 0)
+        return -ENOMEM;
+
+    *cluster = c;
+    return 0;
+}
+
+
+int
+rados_conf_set(rados_t cluster ATTRIBUTE_UNUSED,
+               const char *option ATTRIBUTE_UNUSED,
+               const char *value ATTRIBUTE_UNUSED)
+{
+    return 0;
+}
+
+
+int
+rados_connect(rados_t cluster)
+{
+    struct mockCluster *c = cluster;
+
+    c->connected = true;
+    mockConnections++;
+    return 0;
+}
+
+
+void
+rados_shutdown(rados_t cluster)
+{
+    struct mockCluster *c = cluster;
+
+    VIR_FREE(c);
+}
+
+
+int
+rados_cluster_stat(rados_t cluster,
+                   struct rados_cluster_stat_t *result)
+{
+    struct mockCluster *c = cluster;
+
+    if (!c->connected)
+        return -ENOTCONN;
+
+    memset(result, 0, sizeof(*result));
+    result->kb = 1024 * 1024;
+    result->kb_avail = 512 * 1024;
+    return 0;
+}
+
+
+int
+rados_ioctx_create(rados_t cluster,
+                   const char *pool_name,
+                   rados_ioctx_t *ioctx)
+{
+    struct mockIoctx *io;
+
+    if (STRNEQ(pool_name, "rbd") && STRNEQ(pool_name, "flaky"))
+        return -ENOENT;
+
+    if (VIR_ALLOC_QUIET(io) < 0 ||
+        VIR_STRDUP_QUIET(io->pool, pool_name) < 0) {
+        VIR_FREE(io);
+        return -ENOMEM;
+    }
+
+    io->cluster = cluster;
+    *ioctx = io;
+    return 0;
+}
+
+
+void
+rados_ioctx_destroy(rados_ioctx_t ioctx)
+{
+    struct mockIoctx *io = ioctx;
+
+    VIR_FREE(io->pool);
+    VIR_FREE(io);
+}
+
+
+int
+rados_ioctx_pool_stat(rados_ioctx_t ioctx,
+                      struct rados_pool_stat_t *stats)
+{
+    struct mockIoctx *io = ioctx;
+
+    if (STREQ(io->pool, "flaky") && !mockFlakyFailed) {
+        mockFlakyFailed = true;
+        return -ETIMEDOUT;
+    }
+
+    memset(stats, 0, sizeof(*stats));
+    stats->num_bytes = mockConnections;
+    return 0;
+}
+
+
+int
+rbd_list(rados_ioctx_t ioctx,
+         char *names,
+         size_t *size)
+{
+    struct mockIoctx *io = ioctx;
+    size_t needed = 0;
+    size_t i;
+    char *p = names;
+
+    if (STRNEQ(io->pool, "rbd")) {
+        if (*size < 1) {
+            *size = 1;
+            return -ERANGE;
+        }
+        names[0] = '\0';
+        return 0;
+    }
+
+    needed = MOCK_IMAGES * strlen("imgXX") + MOCK_IMAGES +
+             strlen("gone") + 1 + 1;
+    if (*size < needed) {
+        *size = needed;
+        return -ERANGE;
+    }
+
+    for (i = 0; i < MOCK_IMAGES; i++)
+        p += sprintf(p, "img%02zu", i) + 1;
+    p += sprintf(p, "gone") + 1;
+    *p = '\0';
+
+    return needed;
+}
+
+
+int
+rbd_open_read_only(rados_ioctx_t ioctx ATTRIBUTE_UNUSED,
+                   const char *name,
+                   rbd_image_t *image,
+                   const char *snap_name ATTRIBUTE_UNUSED)
+{
+    struct mockImage *img;
+    int idx;
+
+    if (!STRPREFIX(name, "img") ||
+        virStrToLong_i(name + 3, NULL, 10, &idx) < 0)
+        return -ENOENT;
+
+    if (VIR_ALLOC_QUIET(img) < 0 ||
+        VIR_STRDUP_QUIET(img->name, name) < 0) {
+        VIR_FREE(img);
+        return -ENOMEM;
+    }
+
+    img->idx = idx;
+    *image = img;
+    return 0;
+}
+
+
+int
+rbd_close(rbd_image_t image)
+{
+    struct mockImage *img = image;
+
+    VIR_FREE(img->name);
+    VIR_FREE(img);
+    return 0;
+}
+
+
+int
+rbd_stat(rbd_image_t image,
+         rbd_image_info_t *info,
+         size_t infosize ATTRIBUTE_UNUSED)
+{
+    struct mockImage *img = image;
+
+    memset(info, 0, sizeof(*info));
+    info->size = (img->idx + 1) * 1024ULL * 1024ULL;
+    info->obj_size = 4 * 1024 * 1024;
+    info->num_objs = 1;
+    return 0;
+}
+
+
+int
+rbd_get_features(rbd_image_t image ATTRIBUTE_UNUSED,
+                 uint64_t *features)
+{
+    *features = 0;
+    return 0;
+}
@@ -0,0 +1,239 @@
+/*
+ * storagebackendrbdtest.c: RBD storage backend with mocked librados
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+
+#include "testutils.h"
+#include "virstring.h"
+#include "virstorageobj.h"
+#include "storage/storage_backend.h"
+#include "storage/storage_backend_rbd.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+#define TEST_POOL_XML(name, uuid, source) \
+    "<pool type='rbd'>" \
+    "  <name>" name "</name>" \
+    "  <uuid>" uuid "</uuid>" \
+    "  <source>" \
+    "    <name>" source "</name>" \
+    "    <host name='localhost' port='6789'/>" \
+    "  </source>" \
+    "</pool>"
+
+static virStorageBackendPtr backend;
+
+
+static virStoragePoolObjPtr
+testPoolNew(const char *xml)
+{
+    virStoragePoolObjPtr obj;
+    virStoragePoolDefPtr def;
+
+    if (!(def = virStoragePoolDefParseString(xml)))
+        return NULL;
+
+    if (!(obj = virStoragePoolObjNew())) {
+        virStoragePoolDefFree(def);
+        return NULL;
+    }
+
+    virStoragePoolObjSetDef(obj, def);
+    return obj;
+}
+
+
+static int
+testRefresh(virStoragePoolObjPtr obj)
+{
+    virStoragePoolObjClearVols(obj);
+    return backend->refreshPool(obj);
+}
+
+
+static int
+testRBDRefreshPool(const void *opaque ATTRIBUTE_UNUSED)
+{
+    virStoragePoolObjPtr obj;
+    virStorageVolDefPtr vol;
+    int ret = -1;
+
+    if (!(obj = testPoolNew(TEST_POOL_XML("ceph",
+                                          "47c1faee-0207-e741-f5ae-d9b019b98fe2",
+                                          "rbd"))))
+        return -1;
+
+    if (testRefresh(obj) < 0)
+        goto cleanup;
+
+    /* "gone" vanished between listing and opening it */
+    if (virStoragePoolObjGetVolumesCount(obj) != 40) {
+        VIR_TEST_DEBUG("Expected 40 volumes, got %zu",
+                       virStoragePoolObjGetVolumesCount(obj));
+        goto cleanup;
+    }
+
+    if (!(vol = virStorageVolDefFindByName(obj, "img07"))) {
+        VIR_TEST_DEBUG("Volume 'img07' not found");
+        goto cleanup;
+    }
+
+    if (vol->target.capacity != 8 * 1024 * 1024 ||
+        vol->target.allocation != 4 * 1024 * 1024 ||
+        STRNEQ_NULLABLE(vol->key, "rbd/img07") ||
+        STRNEQ_NULLABLE(vol->target.path, "rbd/img07")) {
+        VIR_TEST_DEBUG("Unexpected data of volume 'img07'");
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    backend->stopPool(obj);
+    virStoragePoolObjEndAPI(&obj);
+    return ret;
+}
+
+
+static int
+testRBDConnectionReuse(const void *opaque ATTRIBUTE_UNUSED)
+{
+    virStoragePoolObjPtr obj;
+    virStoragePoolDefPtr def;
+    unsigned long long connections;
+    int ret = -1;
+
+    if (!(obj = testPoolNew(TEST_POOL_XML("ceph",
+                                          "47c1faee-0207-e741-f5ae-d9b019b98fe2",
+                                          "rbd"))))
+        return -1;
+    def = virStoragePoolObjGetDef(obj);
+
+    /* The mock reports the number of connections made as allocation */
+    if (testRefresh(obj) < 0)
+        goto cleanup;
+    connections = def->allocation;
+
+    if (testRefresh(obj) < 0)
+        goto cleanup;
+
+    if (def->allocation != connections) {
+        VIR_TEST_DEBUG("Connection was not reused");
+        goto cleanup;
+    }
+
+    /* Stopping the pool closes the connection */
+    backend->stopPool(obj);
+
+    if (testRefresh(obj) < 0)
+        goto cleanup;
+
+    if (def->allocation != connections + 1) {
+        VIR_TEST_DEBUG("Connection was not reopened after stopping the pool");
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    backend->stopPool(obj);
+    virStoragePoolObjEndAPI(&obj);
+    return ret;
+}
+
+
+static int
+testRBDReconnect(const void *opaque ATTRIBUTE_UNUSED)
+{
+    virStoragePoolObjPtr healthy;
+    virStoragePoolObjPtr flaky = NULL;
+    unsigned long long connections;
+    int ret = -1;
+
+    if (!(healthy = testPoolNew(TEST_POOL_XML("ceph",
+                                              "47c1faee-0207-e741-f5ae-d9b019b98fe2",
+                                              "rbd"))))
+        return -1;
+
+    if (!(flaky = testPoolNew(TEST_POOL_XML("flaky",
+                                            "8c39a6b1-8b37-4d86-a1b0-4d3f5b7d07a4",
+                                            "flaky"))))
+        goto cleanup;
+
+    if (testRefresh(healthy) < 0)
+        goto cleanup;
+    connections = virStoragePoolObjGetDef(healthy)->allocation;
+
+    /* The connection of the flaky pool breaks on first use ... */
+    if (testRefresh(flaky) == 0) {
+        VIR_TEST_DEBUG("Refresh of the flaky pool should have failed");
+        goto cleanup;
+    }
+
+    /* ... so the next refresh has to open a new one, without touching
+     * connections of other pools */
+    if (testRefresh(flaky) < 0)
+        goto cleanup;
+
+    if (virStoragePoolObjGetDef(flaky)->allocation != connections + 2) {
+        VIR_TEST_DEBUG("Broken connection was not replaced");
+        goto cleanup;
+    }
+
+    if (testRefresh(healthy) < 0)
+        goto cleanup;
+
+    if (virStoragePoolObjGetDef(healthy)->allocation != connections + 2) {
+        VIR_TEST_DEBUG("Connection of the healthy pool was not reused");
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    backend->stopPool(healthy);
+    virStoragePoolObjEndAPI(&healthy);
+    if (flaky)
+        backend->stopPool(flaky);
+    virStoragePoolObjEndAPI(&flaky);
+    return ret;
+}
+
+
+static int
+mymain(void)
+{
+    int ret = 0;
+
+    if (virStorageBackendRBDRegister() < 0 ||
+        !(backend = virStorageBackendForType(VIR_STORAGE_POOL_RBD)))
+        return EXIT_FAILURE;
+
+    if (virTestRun("RBD refresh pool", testRBDRefreshPool, NULL) < 0)
+        ret = -1;
+    if (virTestRun("RBD connection reuse", testRBDConnectionReuse, NULL) < 0)
+        ret = -1;
+    if (virTestRun("RBD reconnect", testRBDReconnect, NULL) < 0)
+        ret = -1;
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN_PRELOAD(mymain, abs_builddir "/.libs/storagebackendrbdmock.so")
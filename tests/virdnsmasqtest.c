@@ -0,0 +1,385 @@
+/*
+ * virdnsmasqtest.c: Test the dnsmasq configuration files handling
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "testutils.h"
+#include "virdnsmasq.h"
+#include "virfile.h"
+#include "virstring.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+#define SCRATCHDIRTEMPLATE abs_builddir "/virdnsmasqtestdir-XXXXXX"
+
+typedef struct _testHost testHost;
+struct _testHost {
+    const char *mac;
+    const char *ip;
+    const char *name;
+};
+
+static const testHost hostsTwo[] = {
+    { "52:54:00:00:00:01", "192.168.122.10", "one" },
+    { "52:54:00:00:00:02", "192.168.122.11", "two" },
+    { NULL, NULL, NULL },
+};
+
+static const testHost hostsChanged[] = {
+    { "52:54:00:00:00:01", "192.168.122.10", "one" },
+    { "52:54:00:00:00:02", "192.168.122.11", "other" },
+    { NULL, NULL, NULL },
+};
+
+static const testHost hostsOne[] = {
+    { "52:54:00:00:00:01", "192.168.122.10", "one" },
+    { NULL, NULL, NULL },
+};
+
+static const testHost hostsNone[] = {
+    { NULL, NULL, NULL },
+};
+
+
+static dnsmasqContext *
+testDnsmasqNew(const char *config_dir,
+               const testHost *hosts,
+               bool usedir)
+{
+    dnsmasqContext *ctx;
+    size_t i;
+
+    if (!(ctx = dnsmasqContextNew("default", config_dir)))
+        return NULL;
+
+    dnsmasqUseHostsdir(ctx, usedir);
+
+    for (i = 0; hosts[i].ip; i++) {
+        virSocketAddr ip;
+
+        if (virSocketAddrParse(&ip, hosts[i].ip, AF_UNSPEC) < 0 ||
+            dnsmasqAddDhcpHost(ctx, hosts[i].mac, &ip,
+                               hosts[i].name, NULL, false) < 0) {
+            dnsmasqContextFree(ctx);
+            return NULL;
+        }
+    }
+
+    return ctx;
+}
+
+
+/* Runs dnsmasqUpdate() for @hosts and checks whether it asked for
+ * a reload of dnsmasq */
+static int
+testDnsmasqUpdate(const char *config_dir,
+                  const testHost *hosts,
+                  bool expectReload)
+{
+    dnsmasqContext *ctx;
+    bool reload;
+    int ret = -1;
+
+    if (!(ctx = testDnsmasqNew(config_dir, hosts, true)))
+        return -1;
+
+    if (dnsmasqUpdate(ctx, &reload) < 0)
+        goto cleanup;
+
+    if (reload != expectReload) {
+        fprintf(stderr, "Expected reload %s, got %s\n",
+                expectReload ? "true" : "false", reload ? "true" : "false");
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    dnsmasqContextFree(ctx);
+    return ret;
+}
+
+
+static int
+testDnsmasqSave(const char *config_dir,
+                const testHost *hosts,
+                bool usedir)
+{
+    dnsmasqContext *ctx;
+    int ret;
+
+    if (!(ctx = testDnsmasqNew(config_dir, hosts, usedir)))
+        return -1;
+
+    ret = dnsmasqSave(ctx);
+    dnsmasqContextFree(ctx);
+    return ret;
+}
+
+
+/* Checks that @file in @dir holds @content, or doesn't exist if
+ * @content is NULL */
+static int
+testCheckFile(const char *dir,
+              const char *file,
+              const char *content)
+{
+    char *path = NULL;
+    char *actual = NULL;
+    int ret = -1;
+
+    if (virAsprintf(&path, "%s/%s", dir, file) < 0)
+        return -1;
+
+    if (!content) {
+        if (virFileExists(path)) {
+            fprintf(stderr, "Unexpected file %s\n", path);
+            goto cleanup;
+        }
+        ret = 0;
+        goto cleanup;
+    }
+
+    if (virFileReadAll(path, 1024, &actual) < 0)
+        goto cleanup;
+
+    if (STRNEQ(actual, content)) {
+        fprintf(stderr, "%s: expected '%s', got '%s'\n",
+                path, content, actual);
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    VIR_FREE(actual);
+    VIR_FREE(path);
+    return ret;
+}
+
+
+/* Checks that @dir holds exactly @nfiles files */
+static int
+testCheckDirCount(const char *dir,
+                  size_t nfiles)
+{
+    DIR *dh = NULL;
+    struct dirent *ent;
+    size_t n = 0;
+    int rc;
+
+    if (virDirOpen(&dh, dir) < 0)
+        return -1;
+
+    while ((rc = virDirRead(dh, &ent, dir)) > 0)
+        n++;
+    VIR_DIR_CLOSE(dh);
+
+    if (rc < 0)
+        return -1;
+
+    if (n != nfiles) {
+        fprintf(stderr, "%s: expected %zu files, got %zu\n", dir, nfiles, n);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+struct testInfo {
+    int (*func)(const char *config_dir,
+                const char *hostsdir);
+};
+
+static int
+testDnsmasqScratch(const void *opaque)
+{
+    const struct testInfo *info = opaque;
+    char scratchdir[] = SCRATCHDIRTEMPLATE;
+    char *hostsdir = NULL;
+    int ret = -1;
+
+    if (!mkdtemp(scratchdir)) {
+        virReportSystemError(errno, "%s", "Cannot create scratch dir");
+        return -1;
+    }
+
+    if (virAsprintf(&hostsdir, "%s/default.hostsdir", scratchdir) < 0)
+        goto cleanup;
+
+    ret = info->func(scratchdir, hostsdir);
+
+ cleanup:
+    if (getenv("LIBVIRT_SKIP_CLEANUP") == NULL)
+        virFileDeleteTree(scratchdir);
+    VIR_FREE(hostsdir);
+    return ret;
+}
+
+
+static int
+testHostsdirAdd(const char *config_dir,
+                const char *hostsdir)
+{
+    /* The very first update writes the addnhosts file too */
+    if (testDnsmasqUpdate(config_dir, hostsNone, true) < 0 ||
+        testCheckDirCount(hostsdir, 0) < 0)
+        return -1;
+
+    /* dnsmasq picks up new hosts by itself */
+    if (testDnsmasqUpdate(config_dir, hostsTwo, false) < 0 ||
+        testCheckDirCount(hostsdir, 2) < 0 ||
+        testCheckFile(hostsdir, "192.168.122.10",
+                      "52:54:00:00:00:01,192.168.122.10,one\n") < 0 ||
+        testCheckFile(hostsdir, "192.168.122.11",
+                      "52:54:00:00:00:02,192.168.122.11,two\n") < 0)
+        return -1;
+
+    /* Nothing changed, nothing to do */
+    if (testDnsmasqUpdate(config_dir, hostsTwo, false) < 0 ||
+        testCheckDirCount(hostsdir, 2) < 0)
+        return -1;
+
+    return 0;
+}
+
+
+static int
+testHostsdirChange(const char *config_dir,
+                   const char *hostsdir)
+{
+    if (testDnsmasqUpdate(config_dir, hostsTwo, true) < 0)
+        return -1;
+
+    /* dnsmasq doesn't forget the old entry of a changed host */
+    if (testDnsmasqUpdate(config_dir, hostsChanged, true) < 0 ||
+        testCheckDirCount(hostsdir, 2) < 0 ||
+        testCheckFile(hostsdir, "192.168.122.10",
+                      "52:54:00:00:00:01,192.168.122.10,one\n") < 0 ||
+        testCheckFile(hostsdir, "192.168.122.11",
+                      "52:54:00:00:00:02,192.168.122.11,other\n") < 0)
+        return -1;
+
+    return 0;
+}
+
+
+static int
+testHostsdirRemove(const char *config_dir,
+                   const char *hostsdir)
+{
+    if (testDnsmasqUpdate(config_dir, hostsTwo, true) < 0)
+        return -1;
+
+    /* nor the entry of a removed one */
+    if (testDnsmasqUpdate(config_dir, hostsOne, true) < 0 ||
+        testCheckDirCount(hostsdir, 1) < 0 ||
+        testCheckFile(hostsdir, "192.168.122.10",
+                      "52:54:00:00:00:01,192.168.122.10,one\n") < 0 ||
+        testCheckFile(hostsdir, "192.168.122.11", NULL) < 0)
+        return -1;
+
+    return 0;
+}
+
+
+static int
+testHostsdirLeftovers(const char *config_dir,
+                      const char *hostsdir)
+{
+    char *hidden = NULL;
+    char *stale = NULL;
+    int ret = -1;
+
+    if (testDnsmasqUpdate(config_dir, hostsOne, true) < 0)
+        return -1;
+
+    if (virAsprintf(&hidden, "%s/.192.168.122.11.new", hostsdir) < 0 ||
+        virAsprintf(&stale, "%s/192.168.122.99", hostsdir) < 0)
+        goto cleanup;
+
+    /* An interrupted write was never seen by dnsmasq */
+    if (virFileWriteStr(hidden, "garbage", 0644) < 0 ||
+        testDnsmasqUpdate(config_dir, hostsOne, false) < 0 ||
+        testCheckDirCount(hostsdir, 1) < 0)
+        goto cleanup;
+
+    /* But a stale host file was */
+    if (virFileWriteStr(stale,
+                        "52:54:00:00:00:99,192.168.122.99,stale\n", 0644) < 0 ||
+        testDnsmasqUpdate(config_dir, hostsOne, true) < 0 ||
+        testCheckDirCount(hostsdir, 1) < 0 ||
+        testCheckFile(hostsdir, "192.168.122.10",
+                      "52:54:00:00:00:01,192.168.122.10,one\n") < 0)
+        goto cleanup;
+
+    ret = 0;
+ cleanup:
+    VIR_FREE(stale);
+    VIR_FREE(hidden);
+    return ret;
+}
+
+
+static int
+testHostsfileSwitch(const char *config_dir,
+                    const char *hostsdir)
+{
+    if (testDnsmasqSave(config_dir, hostsTwo, false) < 0 ||
+        testCheckFile(config_dir, "default.hostsfile",
+                      "52:54:00:00:00:01,192.168.122.10,one\n"
+                      "52:54:00:00:00:02,192.168.122.11,two\n") < 0 ||
+        testCheckFile(config_dir, "default.hostsdir", NULL) < 0)
+        return -1;
+
+    if (testDnsmasqSave(config_dir, hostsTwo, true) < 0 ||
+        testCheckFile(config_dir, "default.hostsfile", NULL) < 0 ||
+        testCheckDirCount(hostsdir, 2) < 0)
+        return -1;
+
+    if (testDnsmasqSave(config_dir, hostsOne, false) < 0 ||
+        testCheckFile(config_dir, "default.hostsfile",
+                      "52:54:00:00:00:01,192.168.122.10,one\n") < 0 ||
+        testCheckFile(config_dir, "default.hostsdir", NULL) < 0)
+        return -1;
+
+    return 0;
+}
+
+
+static int
+mymain(void)
+{
+    int ret = 0;
+
+#define DO_TEST(name, f) \
+    do { \
+        struct testInfo info = { .func = f }; \
+        if (virTestRun(name, testDnsmasqScratch, &info) < 0) \
+            ret = -1; \
+    } while (0)
+
+    DO_TEST("hostsdir add", testHostsdirAdd);
+    DO_TEST("hostsdir change", testHostsdirChange);
+    DO_TEST("hostsdir remove", testHostsdirRemove);
+    DO_TEST("hostsdir leftovers", testHostsdirLeftovers);
+    DO_TEST("hostsfile to hostsdir", testHostsfileSwitch);
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN(mymain)
@@ -22,6 +22,8 @@
 
 #include "testutils.h"
 #include "virmacmap.h"
+#include "virfile.h"
+#include "virstring.h"
 
 #define VIR_FROM_THIS VIR_FROM_NONE
 
@@ -151,6 +153,157 @@ testMACFlush(const void *opaque)
 }
 
 
+#define SCRATCHDIRTEMPLATE abs_builddir "/virmacmaptestdir-XXXXXX"
+
+static int
+testMACFileCompare(const char *file,
+                   const char *expected)
+{
+    virMacMapPtr mgr = NULL;
+    char *str = NULL;
+    char *expectedFile = NULL;
+    int ret = -1;
+
+    if (virAsprintf(&expectedFile, "%s/virmacmaptestdata/%s.json",
+                    abs_srcdir, expected) < 0)
+        goto cleanup;
+
+    if (!(mgr = virMacMapNew(file)))
+        goto cleanup;
+
+    if (virMacMapDumpStr(mgr, &str) < 0)
+        goto cleanup;
+
+    if (virTestCompareToFile(str, expectedFile) < 0)
+        goto cleanup;
+
+    ret = 0;
+ cleanup:
+    VIR_FREE(expectedFile);
+    VIR_FREE(str);
+    virObjectUnref(mgr);
+    return ret;
+}
+
+
+static int
+testMACIndexExpect(virMacMapIndexPtr idx,
+                   const char *domain,
+                   const char * const *expected)
+{
+    char **macs = NULL;
+    size_t i;
+    int ret = -1;
+
+    if (virMacMapIndexLookup(idx, domain, &macs) < 0)
+        goto cleanup;
+
+    for (i = 0; expected[i]; i++) {
+        if (!macs || !macs[i] || STRNEQ(macs[i], expected[i])) {
+            fprintf(stderr, "Expected %s of %s in the index\n",
+                    expected[i], domain);
+            goto cleanup;
+        }
+    }
+
+    if (macs && macs[i]) {
+        fprintf(stderr, "Unexpected %s of %s in the index\n",
+                macs[i], domain);
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    virStringListFree(macs);
+    return ret;
+}
+
+
+static int
+testMACPersistent(const void *opaque ATTRIBUTE_UNUSED)
+{
+    char scratchdir[] = SCRATCHDIRTEMPLATE;
+    virMacMapPtr mgr = NULL;
+    virMacMapIndexPtr idx = NULL;
+    char *file = NULL;
+    char *indexFile = NULL;
+    const char * const f24[] = { "a1:b2:c3:d4:e5:f6", "aa:bb:cc:dd:ee:ff", NULL };
+    const char * const f25[] = { "00:11:22:33:44:55", "aa:bb:cc:00:11:22", NULL };
+    const char * const none[] = { NULL };
+    int ret = -1;
+
+    if (!mkdtemp(scratchdir)) {
+        virReportSystemError(errno, "%s", "Cannot create scratch dir");
+        return -1;
+    }
+
+    if (virAsprintf(&file, "%s/virbr0.macs", scratchdir) < 0 ||
+        virAsprintf(&indexFile, "%s.index", file) < 0)
+        goto cleanup;
+
+    if (!(mgr = virMacMapNew(file)))
+        goto cleanup;
+
+    if (virMacMapAddPersistent(mgr, file, "f24", "aa:bb:cc:dd:ee:ff") < 0 ||
+        virMacMapAddPersistent(mgr, file, "f24", "a1:b2:c3:d4:e5:f6") < 0 ||
+        virMacMapAddPersistent(mgr, file, "f25", "00:11:22:33:44:55") < 0 ||
+        virMacMapAddPersistent(mgr, file, "f25", "aa:bb:cc:00:11:22") < 0 ||
+        virMacMapAddPersistent(mgr, file, "f26", "12:34:56:78:9a:bc") < 0)
+        goto cleanup;
+
+    if (!(idx = virMacMapIndexOpen(file))) {
+        fprintf(stderr, "Unable to open index of %s\n", file);
+        goto cleanup;
+    }
+    virMacMapIndexFree(idx);
+
+    /* Every change is visible in the file right away, even to readers
+     * which don't know about the index */
+    if (virMacMapRemovePersistent(mgr, file, "f26", "12:34:56:78:9a:bc") < 0 ||
+        testMACFileCompare(file, "simple2") < 0)
+        goto cleanup;
+
+    if (!(idx = virMacMapIndexOpen(file))) {
+        fprintf(stderr, "Unable to open index of %s\n", file);
+        goto cleanup;
+    }
+
+    if (testMACIndexExpect(idx, "f24", f24) < 0 ||
+        testMACIndexExpect(idx, "f25", f25) < 0 ||
+        testMACIndexExpect(idx, "f26", none) < 0 ||
+        testMACIndexExpect(idx, "f2", none) < 0)
+        goto cleanup;
+
+    virMacMapIndexFree(idx);
+
+    /* An index not matching the file must not be used */
+    if (virFileRewriteStr(file, 0644, "[]") < 0)
+        goto cleanup;
+
+    if ((idx = virMacMapIndexOpen(file))) {
+        fprintf(stderr, "Stale index of %s was not detected\n", file);
+        goto cleanup;
+    }
+
+    virMacMapDeleteFile(file);
+
+    if (virFileExists(file) || virFileExists(indexFile)) {
+        fprintf(stderr, "%s or its index was not removed\n", file);
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    if (getenv("LIBVIRT_SKIP_CLEANUP") == NULL)
+        virFileDeleteTree(scratchdir);
+    virMacMapIndexFree(idx);
+    VIR_FREE(indexFile);
+    VIR_FREE(file);
+    virObjectUnref(mgr);
+    return ret;
+}
+
+
 static int
 mymain(void)
 {
@@ -230,6 +383,10 @@ mymain(void)
     DO_TEST_FLUSH("dom1", "9e:89:49:99:51:0e", "89:b4:3f:08:88:2c", "54:0b:4c:e2:0a:39");
     DO_TEST_FLUSH("dom1", "bb:88:07:19:51:9d", "b7:f1:1a:40:a2:95", "88:94:39:a3:90:b4");
     DO_TEST_FLUSH_EPILOGUE("complex");
+
+    if (virTestRun("Persistent changes", testMACPersistent, NULL) < 0)
+        ret = -1;
+
  cleanup:
     return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
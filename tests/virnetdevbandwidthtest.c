@@ -41,6 +41,13 @@ struct testSetStruct {
     const bool hierarchical_class;
 };
 
+struct testPlugStruct {
+    const char *net_band;
+    const char *band;
+    const char *exp_cmd;
+    unsigned int id;
+};
+
 #define PARSE(xml, var) \
     do { \
         int rc; \
@@ -64,6 +71,53 @@ struct testSetStruct {
             goto cleanup; \
     } while (0)
 
+/* tc commands are fed to 'tc -batch' on its stdin, so append them
+ * to the dry run buffer right after the tc command line. */
+static void
+testVirNetDevBandwidthBatchCb(const char *const*args ATTRIBUTE_UNUSED,
+                              const char *const*env ATTRIBUTE_UNUSED,
+                              const char *input,
+                              char **output ATTRIBUTE_UNUSED,
+                              char **error ATTRIBUTE_UNUSED,
+                              int *status ATTRIBUTE_UNUSED,
+                              void *opaque)
+{
+    virBufferPtr buf = opaque;
+
+    if (input)
+        virBufferAdd(buf, input, -1);
+}
+
+static int
+testVirNetDevBandwidthCheckCmd(virBufferPtr buf,
+                               const char *exp_cmd)
+{
+    char *actual_cmd = NULL;
+    int ret = -1;
+
+    if (!(actual_cmd = virBufferContentAndReset(buf))) {
+        int err = virBufferError(buf);
+        if (err) {
+            fprintf(stderr, "buffer's in error state: %d", err);
+            goto cleanup;
+        }
+        /* This is interesting, no command has been executed.
+         * Maybe that's expected, actually. */
+    }
+
+    if (STRNEQ_NULLABLE(exp_cmd, actual_cmd)) {
+        virTestDifference(stderr,
+                          NULLSTR(exp_cmd),
+                          NULLSTR(actual_cmd));
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    VIR_FREE(actual_cmd);
+    return ret;
+}
+
 static int
 testVirNetDevBandwidthSet(const void *data)
 {
@@ -72,41 +126,56 @@ testVirNetDevBandwidthSet(const void *data)
     const char *iface = info->iface;
     virNetDevBandwidthPtr band = NULL;
     virBuffer buf = VIR_BUFFER_INITIALIZER;
-    char *actual_cmd = NULL;
 
     PARSE(info->band, band);
 
     if (!iface)
         iface = "eth0";
 
-    virCommandSetDryRun(&buf, NULL, NULL);
+    virCommandSetDryRun(&buf, testVirNetDevBandwidthBatchCb, &buf);
 
     if (virNetDevBandwidthSet(iface, band, info->hierarchical_class, true) < 0)
         goto cleanup;
 
-    if (!(actual_cmd = virBufferContentAndReset(&buf))) {
-        int err = virBufferError(&buf);
-        if (err) {
-            fprintf(stderr, "buffer's in error state: %d", err);
-            goto cleanup;
-        }
-        /* This is interesting, no command has been executed.
-         * Maybe that's expected, actually. */
-    }
+    if (testVirNetDevBandwidthCheckCmd(&buf, info->exp_cmd) < 0)
+        goto cleanup;
 
-    if (STRNEQ_NULLABLE(info->exp_cmd, actual_cmd)) {
-        virTestDifference(stderr,
-                          NULLSTR(info->exp_cmd),
-                          NULLSTR(actual_cmd));
+    ret = 0;
+ cleanup:
+    virCommandSetDryRun(NULL, NULL, NULL);
+    virNetDevBandwidthFree(band);
+    virBufferFreeAndReset(&buf);
+    return ret;
+}
+
+static int
+testVirNetDevBandwidthPlug(const void *data)
+{
+    int ret = -1;
+    const struct testPlugStruct *info = data;
+    virNetDevBandwidthPtr net_band = NULL;
+    virNetDevBandwidthPtr band = NULL;
+    virMacAddr mac = { .addr = { 0x52, 0x54, 0x00, 0x12, 0x34, 0x56 } };
+    virBuffer buf = VIR_BUFFER_INITIALIZER;
+
+    PARSE(info->net_band, net_band);
+    PARSE(info->band, band);
+
+    virCommandSetDryRun(&buf, testVirNetDevBandwidthBatchCb, &buf);
+
+    if (virNetDevBandwidthPlug("virbr0", net_band, &mac, band, info->id) < 0 ||
+        virNetDevBandwidthUnplug("virbr0", info->id) < 0)
+        goto cleanup;
+
+    if (testVirNetDevBandwidthCheckCmd(&buf, info->exp_cmd) < 0)
         goto cleanup;
-    }
 
     ret = 0;
  cleanup:
     virCommandSetDryRun(NULL, NULL, NULL);
+    virNetDevBandwidthFree(net_band);
     virNetDevBandwidthFree(band);
     virBufferFreeAndReset(&buf);
-    VIR_FREE(actual_cmd);
     return ret;
 }
 
@@ -134,36 +203,88 @@ mymain(void)
     DO_TEST_SET(("<bandwidth>"
                  "  <inbound average='1024'/>"
                  "</bandwidth>"),
-                (TC " qdisc del dev eth0 root\n"
-                 TC " qdisc del dev eth0 ingress\n"
-                 TC " qdisc add dev eth0 root handle 1: htb default 1\n"
-                 TC " class add dev eth0 parent 1: classid 1:1 htb rate 1024kbps quantum 87\n"
-                 TC " qdisc add dev eth0 parent 1:1 handle 2: sfq perturb 10\n"
-                 TC " filter add dev eth0 parent 1:0 protocol all prio 1 handle 1 fw flowid 1\n"));
+                (TC " -force -batch -\n"
+                 "qdisc del dev eth0 root\n"
+                 "qdisc del dev eth0 ingress\n"
+                 TC " -batch -\n"
+                 "qdisc add dev eth0 root handle 1: htb default 1\n"
+                 "class add dev eth0 parent 1: classid 1:1 htb rate 1024kbps quantum 87\n"
+                 "qdisc add dev eth0 parent 1:1 handle 2: sfq perturb 10\n"
+                 "filter add dev eth0 parent 1:0 protocol all prio 1 handle 1 fw flowid 1\n"));
 
     DO_TEST_SET(("<bandwidth>"
                  "  <outbound average='1024'/>"
                  "</bandwidth>"),
-                (TC " qdisc del dev eth0 root\n"
-                 TC " qdisc del dev eth0 ingress\n"
-                 TC " qdisc add dev eth0 ingress\n"
-                 TC " filter add dev eth0 parent ffff: protocol all u32 match u32 0 0 "
+                (TC " -force -batch -\n"
+                 "qdisc del dev eth0 root\n"
+                 "qdisc del dev eth0 ingress\n"
+                 TC " -batch -\n"
+                 "qdisc add dev eth0 ingress\n"
+                 "filter add dev eth0 parent ffff: protocol all u32 match u32 0 0 "
                  "police rate 1024kbps burst 1024kb mtu 64kb drop flowid :1\n"));
 
     DO_TEST_SET(("<bandwidth>"
                  "  <inbound average='1' peak='2' floor='3' burst='4'/>"
                  "  <outbound average='5' peak='6' burst='7'/>"
                  "</bandwidth>"),
-                (TC " qdisc del dev eth0 root\n"
-                 TC " qdisc del dev eth0 ingress\n"
-                 TC " qdisc add dev eth0 root handle 1: htb default 1\n"
-                 TC " class add dev eth0 parent 1: classid 1:1 htb rate 1kbps ceil 2kbps burst 4kb quantum 1\n"
-                 TC " qdisc add dev eth0 parent 1:1 handle 2: sfq perturb 10\n"
-                 TC " filter add dev eth0 parent 1:0 protocol all prio 1 handle 1 fw flowid 1\n"
-                 TC " qdisc add dev eth0 ingress\n"
-                 TC " filter add dev eth0 parent ffff: protocol all u32 match u32 0 0 "
+                (TC " -force -batch -\n"
+                 "qdisc del dev eth0 root\n"
+                 "qdisc del dev eth0 ingress\n"
+                 TC " -batch -\n"
+                 "qdisc add dev eth0 root handle 1: htb default 1\n"
+                 "class add dev eth0 parent 1: classid 1:1 htb rate 1kbps ceil 2kbps burst 4kb quantum 1\n"
+                 "qdisc add dev eth0 parent 1:1 handle 2: sfq perturb 10\n"
+                 "filter add dev eth0 parent 1:0 protocol all prio 1 handle 1 fw flowid 1\n"
+                 "qdisc add dev eth0 ingress\n"
+                 "filter add dev eth0 parent ffff: protocol all u32 match u32 0 0 "
                  "police rate 5kbps burst 7kb mtu 64kb drop flowid :1\n"));
 
+    DO_TEST_SET(("<bandwidth>"
+                 "  <inbound average='1000' peak='2000'/>"
+                 "</bandwidth>"),
+                (TC " -force -batch -\n"
+                 "qdisc del dev eth0 root\n"
+                 "qdisc del dev eth0 ingress\n"
+                 TC " -batch -\n"
+                 "qdisc add dev eth0 root handle 1: htb default 2\n"
+                 "class add dev eth0 parent 1: classid 1:1 htb rate 1000kbps ceil 2000kbps quantum 85\n"
+                 "class add dev eth0 parent 1:1 classid 1:2 htb rate 1000kbps ceil 2000kbps quantum 85\n"
+                 "qdisc add dev eth0 parent 1:2 handle 2: sfq perturb 10\n"
+                 "filter add dev eth0 parent 1:0 protocol all prio 1 handle 1 fw flowid 1\n"),
+                .hierarchical_class = true);
+
+#define DO_TEST_PLUG(Net_band, Band, Id, Exp_cmd) \
+    do { \
+        struct testPlugStruct data = {.net_band = Net_band, \
+                                      .band = Band, \
+                                      .id = Id, \
+                                      .exp_cmd = Exp_cmd}; \
+        if (virTestRun("virNetDevBandwidthPlug", \
+                       testVirNetDevBandwidthPlug, \
+                       &data) < 0) \
+            ret = -1; \
+    } while (0)
+
+    DO_TEST_PLUG(("<bandwidth>"
+                  "  <inbound average='1000' peak='2000'/>"
+                  "</bandwidth>"),
+                 ("<bandwidth>"
+                  "  <inbound average='100' floor='200'/>"
+                  "</bandwidth>"),
+                 42,
+                 (TC " -batch -\n"
+                  "class add dev virbr0 parent 1:1 classid 1:2a htb rate 200kbps ceil 2000kbps quantum 8\n"
+                  "qdisc add dev virbr0 parent 1:2a handle 2a: sfq perturb 10\n"
+                  "filter add dev virbr0 protocol ip prio 2 handle 800::42 u32 "
+                  "match u16 0x0800 0xffff at -2 "
+                  "match u32 0x00123456 0xffffffff at -12 "
+                  "match u16 0x5254 0xffff at -14 "
+                  "flowid 1:2a\n"
+                  TC " -force -batch -\n"
+                  "qdisc del dev virbr0 handle 2a:\n"
+                  "filter del dev virbr0 prio 2 handle 800::42 u32\n"
+                  "class del dev virbr0 classid 1:2a\n"));
+
     return ret;
 }
 
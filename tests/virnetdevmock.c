@@ -26,6 +26,7 @@
 # include <stdio.h>
 # include "virstring.h"
 # include "virnetdev.h"
+# include "virnetlink.h"
 
 # define NET_DEV_TEST_DATA_PREFIX abs_srcdir "/virnetdevtestdata/sys/class/net"
 
@@ -43,6 +44,91 @@ virNetDevSysfsFile(char **pf_sysfs_device_link,
 
     return 0;
 }
+
+# ifdef HAVE_LIBNL
+struct testNetlinkLink {
+    const char *ifname;
+    unsigned long long rx_bytes;
+    unsigned long long rx_packets;
+    unsigned long long tx_bytes;
+    unsigned long long tx_packets;
+    size_t statslen; /* length of IFLA_STATS64, 0 for the full struct */
+};
+
+static struct testNetlinkLink testNetlinkLinks[] = {
+    { "lo", 4096, 64, 4096, 64 },
+    { "eth0", 1ULL << 33, 1000, 2000, 20 },
+    { "vnet0", 3000, 30, 4000, 40 },
+    { "vnet1", 5000, 50, 6000, 60 },
+    /* As sent by kernels which know only the basic counters */
+    { "vnet3", 7000, 70, 8000, 80,
+      offsetof(struct rtnl_link_stats64, rx_errors) },
+};
+
+static unsigned int testNetlinkDumps;
+
+/* Replies to a RTM_GETLINK dump with the links above. The number of dumps
+ * done so far is reported in rx_missed_errors so that tests can check the
+ * statistics are not fetched more often than expected. */
+int
+virNetlinkDumpCommand(struct nl_msg *nl_msg,
+                      virNetlinkDumpCallback callback,
+                      uint32_t src_pid ATTRIBUTE_UNUSED,
+                      uint32_t dst_pid ATTRIBUTE_UNUSED,
+                      unsigned int protocol,
+                      unsigned int groups ATTRIBUTE_UNUSED,
+                      void *opaque)
+{
+    size_t i;
+
+    if (protocol != NETLINK_ROUTE ||
+        nlmsg_hdr(nl_msg)->nlmsg_type != RTM_GETLINK) {
+        fprintf(stderr, "Unexpected netlink dump request\n");
+        abort();
+    }
+
+    testNetlinkDumps++;
+
+    for (i = 0; i < ARRAY_CARDINALITY(testNetlinkLinks); i++) {
+        struct ifinfomsg ifinfo = {
+            .ifi_family = AF_UNSPEC,
+            .ifi_index = i + 1,
+        };
+        struct rtnl_link_stats64 stats = {
+            .rx_bytes = testNetlinkLinks[i].rx_bytes,
+            .rx_packets = testNetlinkLinks[i].rx_packets,
+            .tx_bytes = testNetlinkLinks[i].tx_bytes,
+            .tx_packets = testNetlinkLinks[i].tx_packets,
+            .rx_errors = 1,
+            .tx_errors = 2,
+            .rx_dropped = 3,
+            .tx_dropped = 4,
+            .rx_missed_errors = testNetlinkDumps,
+        };
+        size_t statslen = testNetlinkLinks[i].statslen;
+        struct nl_msg *msg;
+        int rc;
+
+        if (!statslen)
+            statslen = sizeof(stats);
+
+        if (!(msg = nlmsg_alloc_simple(RTM_NEWLINK, NLM_F_MULTI)) ||
+            nlmsg_append(msg, &ifinfo, sizeof(ifinfo), NLMSG_ALIGNTO) < 0 ||
+            nla_put_string(msg, IFLA_IFNAME, testNetlinkLinks[i].ifname) < 0 ||
+            nla_put(msg, IFLA_STATS64, statslen, &stats) < 0) {
+            fprintf(stderr, "Unable to build netlink message\n");
+            abort();
+        }
+
+        rc = callback(nlmsg_hdr(msg), opaque);
+        nlmsg_free(msg);
+        if (rc < 0)
+            return -1;
+    }
+
+    return 0;
+}
+# endif /* HAVE_LIBNL */
 #else
 /* Nothing to override on non-__linux__ platforms */
 #endif
@@ -0,0 +1,244 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "testutils.h"
+
+#ifdef WIN32
+int
+main(void)
+{
+    return EXIT_AM_SKIP;
+}
+#else
+# define __VIR_COMMAND_PRIV_H_ALLOW__
+
+# include "vircommandpriv.h"
+# include "virnetdevopenvswitch.h"
+
+# define VIR_FROM_THIS VIR_FROM_NONE
+
+static const char *ovsInterfaceListOutput =
+    "{\"data\":["
+      "[\"vhost-user1\",[\"map\",[[\"rx_bytes\",1000],[\"rx_dropped\",1],"
+        "[\"rx_errors\",2],[\"rx_packets\",10],[\"tx_bytes\",2000],"
+        "[\"tx_dropped\",3],[\"tx_errors\",4],[\"tx_packets\",20]]]],"
+      "[\"br0\",[\"map\",[[\"rx_bytes\",5],[\"tx_bytes\",6]]]],"
+      "[\"vhost-user2\",[\"map\",[[\"rx_bytes\",3000],[\"rx_packets\",30],"
+        "[\"collisions\",0],[\"tx_bytes\",4000],[\"tx_packets\",40]]]],"
+      "[\"vhost-user3\",[\"map\",[]]]"
+    "],\"headings\":[\"name\",\"statistics\"]}";
+
+struct testStatsInfo {
+    const char *output;
+    size_t nruns;
+};
+
+static void
+testOvsVsctlCb(const char *const*args,
+               const char *const*env ATTRIBUTE_UNUSED,
+               const char *input ATTRIBUTE_UNUSED,
+               char **output,
+               char **error ATTRIBUTE_UNUSED,
+               int *status,
+               void *opaque)
+{
+    struct testStatsInfo *info = opaque;
+
+    info->nruns++;
+
+    if (args[0] && STREQ(args[0], OVSVSCTL) &&
+        args[1] && STRPREFIX(args[1], "--timeout=") &&
+        args[2] && STREQ(args[2], "--format=json") &&
+        args[3] && STREQ(args[3], "--columns=name,statistics") &&
+        args[4] && STREQ(args[4], "list") &&
+        args[5] && STREQ(args[5], "Interface") &&
+        args[6] == NULL && info->output) {
+        ignore_value(VIR_STRDUP(*output, info->output));
+    } else {
+        *status = -1;
+    }
+}
+
+
+static int
+testCompareStats(const char *ifname,
+                 virDomainInterfaceStatsPtr actual,
+                 const struct _virDomainInterfaceStats *expected)
+{
+    if (actual->rx_bytes != expected->rx_bytes ||
+        actual->rx_packets != expected->rx_packets ||
+        actual->rx_errs != expected->rx_errs ||
+        actual->rx_drop != expected->rx_drop ||
+        actual->tx_bytes != expected->tx_bytes ||
+        actual->tx_packets != expected->tx_packets ||
+        actual->tx_errs != expected->tx_errs ||
+        actual->tx_drop != expected->tx_drop) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       "Unexpected statistics of interface '%s': "
+                       "rx %lld %lld %lld %lld tx %lld %lld %lld %lld",
+                       NULLSTR(ifname),
+                       actual->rx_bytes, actual->rx_packets,
+                       actual->rx_errs, actual->rx_drop,
+                       actual->tx_bytes, actual->tx_packets,
+                       actual->tx_errs, actual->tx_drop);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static int
+testInterfaceStatsList(const void *opaque ATTRIBUTE_UNUSED)
+{
+    struct testStatsInfo info = { ovsInterfaceListOutput, 0 };
+    const char *ifnames[] = {
+        "vhost-user2", NULL, "vhost-user1", "vhost-user3", "vhost-user4",
+    };
+    const struct _virDomainInterfaceStats expected[] = {
+        { 4000, 40, -1, -1, 3000, 30, -1, -1 },
+        { -1, -1, -1, -1, -1, -1, -1, -1 },
+        { 2000, 20, 4, 3, 1000, 10, 2, 1 },
+        { -1, -1, -1, -1, -1, -1, -1, -1 },
+        { -1, -1, -1, -1, -1, -1, -1, -1 },
+    };
+    struct _virDomainInterfaceStats stats[ARRAY_CARDINALITY(ifnames)];
+    size_t i;
+    int rc;
+    int ret = -1;
+
+    virCommandSetDryRun(NULL, testOvsVsctlCb, &info);
+
+    rc = virNetDevOpenvswitchInterfaceStatsList(ifnames,
+                                                ARRAY_CARDINALITY(ifnames),
+                                                stats);
+    if (rc != 2) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       "Expected 2 interfaces with statistics, got %d", rc);
+        goto cleanup;
+    }
+
+    if (info.nruns != 1) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       "Expected a single ovs-vsctl call, got %zu",
+                       info.nruns);
+        goto cleanup;
+    }
+
+    for (i = 0; i < ARRAY_CARDINALITY(ifnames); i++) {
+        if (testCompareStats(ifnames[i], &stats[i], &expected[i]) < 0)
+            goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virCommandSetDryRun(NULL, NULL, NULL);
+    return ret;
+}
+
+
+static int
+testInterfaceStats(const void *opaque ATTRIBUTE_UNUSED)
+{
+    struct testStatsInfo info = { ovsInterfaceListOutput, 0 };
+    const struct _virDomainInterfaceStats expected = {
+        2000, 20, 4, 3, 1000, 10, 2, 1
+    };
+    struct _virDomainInterfaceStats stats;
+    int ret = -1;
+
+    virCommandSetDryRun(NULL, testOvsVsctlCb, &info);
+
+    if (virNetDevOpenvswitchInterfaceStats("vhost-user1", &stats) < 0 ||
+        testCompareStats("vhost-user1", &stats, &expected) < 0)
+        goto cleanup;
+
+    if (virNetDevOpenvswitchInterfaceStats("vhost-user3", &stats) == 0 ||
+        virNetDevOpenvswitchInterfaceStats("vhost-user4", &stats) == 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       "Expected failure for interface without statistics");
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virCommandSetDryRun(NULL, NULL, NULL);
+    return ret;
+}
+
+
+static int
+testInterfaceStatsInvalid(const void *opaque)
+{
+    struct testStatsInfo info = { opaque, 0 };
+    const char *ifname = "vhost-user1";
+    struct _virDomainInterfaceStats stats;
+    int ret = -1;
+
+    virCommandSetDryRun(NULL, testOvsVsctlCb, &info);
+
+    if (virNetDevOpenvswitchInterfaceStatsList(&ifname, 1, &stats) >= 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       "Expected failure on invalid ovs-vsctl output");
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virCommandSetDryRun(NULL, NULL, NULL);
+    return ret;
+}
+
+
+static int
+mymain(void)
+{
+    int ret = 0;
+
+    if (virTestRun("Interface stats list", testInterfaceStatsList, NULL) < 0)
+        ret = -1;
+    if (virTestRun("Interface stats", testInterfaceStats, NULL) < 0)
+        ret = -1;
+
+# define DO_TEST_INVALID(name, output) \
+    do { \
+        if (virTestRun("Interface stats invalid " name, \
+                       testInterfaceStatsInvalid, output) < 0) \
+            ret = -1; \
+    } while (0)
+
+    DO_TEST_INVALID("command failure", NULL);
+    DO_TEST_INVALID("not JSON", "vhost-user1 1000");
+    DO_TEST_INVALID("no headings", "{\"data\":[]}");
+    DO_TEST_INVALID("no statistics column",
+                    "{\"data\":[[\"vhost-user1\"]],\"headings\":[\"name\"]}");
+    DO_TEST_INVALID("not a map",
+                    "{\"data\":[[\"vhost-user1\",[\"set\",[]]]],"
+                    "\"headings\":[\"name\",\"statistics\"]}");
+    DO_TEST_INVALID("counter not a number",
+                    "{\"data\":[[\"vhost-user1\",[\"map\",[[\"rx_bytes\",\"x\"]]]]],"
+                    "\"headings\":[\"name\",\"statistics\"]}");
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN(mymain)
+#endif /* WIN32 */
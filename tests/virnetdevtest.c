@@ -25,6 +25,7 @@
 #ifdef __linux__
 
 # include "virnetdev.h"
+# include "virnetdevtap.h"
 
 # define VIR_FROM_THIS VIR_FROM_NONE
 
@@ -64,6 +65,81 @@ testVirNetDevGetLinkInfo(const void *opaque)
     return ret;
 }
 
+# ifdef HAVE_LIBNL
+struct testVirNetDevTapStatsData {
+    const char *ifname;
+    bool swapped;
+    struct _virDomainInterfaceStats stats; /* expected stats */
+};
+
+static int
+testVirNetDevTapStatsCompare(const char *ifname,
+                             virDomainInterfaceStatsPtr actual,
+                             virDomainInterfaceStatsPtr expected)
+{
+    if (memcmp(actual, expected, sizeof(*actual)) != 0) {
+        fprintf(stderr,
+                "Fetched stats of '%s' (rx %lld %lld %lld %lld, "
+                "tx %lld %lld %lld %lld) don't match the expected ones "
+                "(rx %lld %lld %lld %lld, tx %lld %lld %lld %lld)\n",
+                ifname,
+                actual->rx_bytes, actual->rx_packets,
+                actual->rx_errs, actual->rx_drop,
+                actual->tx_bytes, actual->tx_packets,
+                actual->tx_errs, actual->tx_drop,
+                expected->rx_bytes, expected->rx_packets,
+                expected->rx_errs, expected->rx_drop,
+                expected->tx_bytes, expected->tx_packets,
+                expected->tx_errs, expected->tx_drop);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int
+testVirNetDevTapStatsCache(const void *opaque ATTRIBUTE_UNUSED)
+{
+    int ret = -1;
+    virNetDevTapStatsCachePtr cache = NULL;
+    struct _virDomainInterfaceStats stats;
+    size_t i;
+    /* rx_drop of every link includes the number of netlink dumps done so
+     * far, i.e. it's 3 + 1 for the first cache created */
+    struct testVirNetDevTapStatsData data[] = {
+        { "vnet0", true, { 4000, 40, 2, 4, 3000, 30, 1, 4 } },
+        { "eth0", false, { 1LL << 33, 1000, 1, 4, 2000, 20, 2, 4 } },
+        { "vnet1", true, { 6000, 60, 2, 4, 5000, 50, 1, 4 } },
+        { "vnet0", false, { 3000, 30, 1, 4, 4000, 40, 2, 4 } },
+        /* short IFLA_STATS64, missing counters read as zero */
+        { "vnet3", false, { 7000, 70, 0, 0, 8000, 80, 0, 0 } },
+    };
+
+    if (!(cache = virNetDevTapStatsCacheNew()))
+        goto cleanup;
+
+    for (i = 0; i < ARRAY_CARDINALITY(data); i++) {
+        if (virNetDevTapStatsCacheLookup(cache, data[i].ifname, &stats,
+                                         data[i].swapped) < 0)
+            goto cleanup;
+
+        if (testVirNetDevTapStatsCompare(data[i].ifname,
+                                         &stats, &data[i].stats) < 0)
+            goto cleanup;
+    }
+
+    if (virNetDevTapStatsCacheLookup(cache, "vnet2", &stats, true) == 0) {
+        fprintf(stderr, "Lookup of an unknown interface succeeded\n");
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    virNetDevTapStatsCacheFree(cache);
+    return ret;
+}
+# endif /* HAVE_LIBNL */
+
 static int
 mymain(void)
 {
@@ -81,6 +157,11 @@ mymain(void)
     DO_TEST_LINK("lo", VIR_NETDEV_IF_STATE_UNKNOWN, 0);
     DO_TEST_LINK("eth0-broken", VIR_NETDEV_IF_STATE_DOWN, 0);
 
+# ifdef HAVE_LIBNL
+    if (virTestRun("Tap stats cache", testVirNetDevTapStatsCache, NULL) < 0)
+        ret = -1;
+# endif
+
     return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
@@ -0,0 +1,302 @@
+/*
+ * virnodedeviceobjtest.c: Test the node device object list
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "testutils.h"
+#include "virnodedeviceobj.h"
+#include "virstring.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+#define TEST_SYSFS_PATH_A "/sys/devices/pci0000:00/0000:00:02.0/drm/renderD128"
+#define TEST_SYSFS_PATH_B "/sys/devices/pci0000:00/0000:00:02.0/drm/renderD129"
+
+#define TEST_WWNN "2001001b32a9da4e"
+#define TEST_WWPN "2101001b32a9da4e"
+#define TEST_FABRIC_WWN "2002000573de9a81"
+
+
+static int
+testDevAssign(virNodeDeviceObjListPtr devs,
+              const char *xml)
+{
+    virNodeDeviceDefPtr def;
+    virNodeDeviceObjPtr obj;
+
+    if (!(def = virNodeDeviceDefParseString(xml, EXISTING_DEVICE, NULL)))
+        return -1;
+
+    if (!(obj = virNodeDeviceObjListAssignDef(devs, def))) {
+        virNodeDeviceDefFree(def);
+        return -1;
+    }
+
+    virNodeDeviceObjEndAPI(&obj);
+    return 0;
+}
+
+
+static int
+testDevAssignDRM(virNodeDeviceObjListPtr devs,
+                 const char *name,
+                 const char *path)
+{
+    char *xml = NULL;
+    int ret;
+
+    if (virAsprintf(&xml,
+                    "<device>"
+                    "  <name>%s</name>"
+                    "  <path>%s</path>"
+                    "  <capability type='drm'><type>render</type></capability>"
+                    "</device>", name, path) < 0)
+        return -1;
+
+    ret = testDevAssign(devs, xml);
+    VIR_FREE(xml);
+    return ret;
+}
+
+
+static int
+testDevRemove(virNodeDeviceObjListPtr devs,
+              const char *name)
+{
+    virNodeDeviceObjPtr obj;
+
+    if (!(obj = virNodeDeviceObjListFindByName(devs, name)))
+        return -1;
+
+    virNodeDeviceObjListRemove(devs, obj);
+    virObjectUnref(obj);
+    return 0;
+}
+
+
+/* Checks that @path resolves to the device named @name, or to no
+ * device at all if @name is NULL */
+static int
+testSysfsPathExpect(virNodeDeviceObjListPtr devs,
+                    const char *path,
+                    const char *name)
+{
+    virNodeDeviceObjPtr obj;
+    const char *actual = NULL;
+    int ret = -1;
+
+    if ((obj = virNodeDeviceObjListFindBySysfsPath(devs, path)))
+        actual = virNodeDeviceObjGetDef(obj)->name;
+
+    if (STRNEQ_NULLABLE(actual, name)) {
+        fprintf(stderr, "%s: expected device '%s', got '%s'\n",
+                path, NULLSTR(name), NULLSTR(actual));
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    virNodeDeviceObjEndAPI(&obj);
+    return ret;
+}
+
+
+static int
+testSysfsPath(const void *opaque ATTRIBUTE_UNUSED)
+{
+    virNodeDeviceObjListPtr devs;
+    int ret = -1;
+
+    if (!(devs = virNodeDeviceObjListNew()))
+        return -1;
+
+    if (testDevAssignDRM(devs, "drm_renderD128", TEST_SYSFS_PATH_A) < 0 ||
+        testSysfsPathExpect(devs, TEST_SYSFS_PATH_A, "drm_renderD128") < 0 ||
+        testSysfsPathExpect(devs, TEST_SYSFS_PATH_B, NULL) < 0)
+        goto cleanup;
+
+    /* Redefining a device moves it to its new path */
+    if (testDevAssignDRM(devs, "drm_renderD128", TEST_SYSFS_PATH_B) < 0 ||
+        testSysfsPathExpect(devs, TEST_SYSFS_PATH_A, NULL) < 0 ||
+        testSysfsPathExpect(devs, TEST_SYSFS_PATH_B, "drm_renderD128") < 0)
+        goto cleanup;
+
+    /* The device defined last wins the path, and removing the one
+     * which lost it keeps the entry of the winner */
+    if (testDevAssignDRM(devs, "drm_renderD129", TEST_SYSFS_PATH_B) < 0 ||
+        testSysfsPathExpect(devs, TEST_SYSFS_PATH_B, "drm_renderD129") < 0 ||
+        testDevRemove(devs, "drm_renderD128") < 0 ||
+        testSysfsPathExpect(devs, TEST_SYSFS_PATH_B, "drm_renderD129") < 0)
+        goto cleanup;
+
+    if (testDevRemove(devs, "drm_renderD129") < 0 ||
+        testSysfsPathExpect(devs, TEST_SYSFS_PATH_B, NULL) < 0)
+        goto cleanup;
+
+    ret = 0;
+ cleanup:
+    virNodeDeviceObjListFree(devs);
+    return ret;
+}
+
+
+static const char *testDevSCSIHost =
+    "<device>"
+    "  <name>scsi_host0</name>"
+    "  <capability type='scsi_host'><host>0</host></capability>"
+    "</device>";
+
+static const char *testDevFCHost =
+    "<device>"
+    "  <name>scsi_host5</name>"
+    "  <capability type='scsi_host'>"
+    "    <host>5</host>"
+    "    <capability type='fc_host'>"
+    "      <wwnn>" TEST_WWNN "</wwnn>"
+    "      <wwpn>" TEST_WWPN "</wwpn>"
+    "      <fabric_wwn>" TEST_FABRIC_WWN "</fabric_wwn>"
+    "    </capability>"
+    "    <capability type='vport_ops'>"
+    "      <max_vports>127</max_vports>"
+    "      <vports>0</vports>"
+    "    </capability>"
+    "  </capability>"
+    "</device>";
+
+static const char *testDevFCHostNoVports =
+    "<device>"
+    "  <name>scsi_host5</name>"
+    "  <capability type='scsi_host'>"
+    "    <host>5</host>"
+    "    <capability type='fc_host'>"
+    "      <wwnn>" TEST_WWNN "</wwnn>"
+    "      <wwpn>" TEST_WWPN "</wwpn>"
+    "      <fabric_wwn>" TEST_FABRIC_WWN "</fabric_wwn>"
+    "    </capability>"
+    "  </capability>"
+    "</device>";
+
+static const char *testVportByWWNs =
+    "<device>"
+    "  <parent wwnn='" TEST_WWNN "' wwpn='" TEST_WWPN "'/>"
+    "  <capability type='scsi_host'>"
+    "    <capability type='fc_host'/>"
+    "  </capability>"
+    "</device>";
+
+static const char *testVportByFabricWWN =
+    "<device>"
+    "  <parent fabric_wwn='" TEST_FABRIC_WWN "'/>"
+    "  <capability type='scsi_host'>"
+    "    <capability type='fc_host'/>"
+    "  </capability>"
+    "</device>";
+
+static const char *testVportAnyParent =
+    "<device>"
+    "  <capability type='scsi_host'>"
+    "    <capability type='fc_host'/>"
+    "  </capability>"
+    "</device>";
+
+
+/* Checks the parent host found for the vport described by @xml */
+static int
+testParentHostExpect(virNodeDeviceObjListPtr devs,
+                     const char *xml,
+                     int host)
+{
+    virNodeDeviceDefPtr def;
+    int actual;
+
+    if (!(def = virNodeDeviceDefParseString(xml, CREATE_DEVICE, "QEMU")))
+        return -1;
+
+    actual = virNodeDeviceObjListGetParentHost(devs, def);
+    virNodeDeviceDefFree(def);
+
+    if (actual != host) {
+        fprintf(stderr, "expected parent host %d, got %d\n", host, actual);
+        return -1;
+    }
+
+    if (host < 0)
+        virResetLastError();
+
+    return 0;
+}
+
+
+static int
+testParentHost(const void *opaque ATTRIBUTE_UNUSED)
+{
+    virNodeDeviceObjListPtr devs;
+    int ret = -1;
+
+    if (!(devs = virNodeDeviceObjListNew()))
+        return -1;
+
+    if (testDevAssignDRM(devs, "drm_renderD128", TEST_SYSFS_PATH_A) < 0 ||
+        testDevAssign(devs, testDevSCSIHost) < 0)
+        goto cleanup;
+
+    /* No device capable of vport operations yet */
+    if (testParentHostExpect(devs, testVportByWWNs, -1) < 0 ||
+        testParentHostExpect(devs, testVportByFabricWWN, -1) < 0 ||
+        testParentHostExpect(devs, testVportAnyParent, -1) < 0)
+        goto cleanup;
+
+    if (testDevAssign(devs, testDevFCHost) < 0 ||
+        testParentHostExpect(devs, testVportByWWNs, 5) < 0 ||
+        testParentHostExpect(devs, testVportByFabricWWN, 5) < 0 ||
+        testParentHostExpect(devs, testVportAnyParent, 5) < 0)
+        goto cleanup;
+
+    /* A redefined device is found by its new capabilities only */
+    if (testDevAssign(devs, testDevFCHostNoVports) < 0 ||
+        testParentHostExpect(devs, testVportByWWNs, -1) < 0 ||
+        testParentHostExpect(devs, testVportAnyParent, -1) < 0)
+        goto cleanup;
+
+    if (testDevAssign(devs, testDevFCHost) < 0 ||
+        testDevRemove(devs, "scsi_host5") < 0 ||
+        testParentHostExpect(devs, testVportByWWNs, -1) < 0 ||
+        testParentHostExpect(devs, testVportAnyParent, -1) < 0)
+        goto cleanup;
+
+    ret = 0;
+ cleanup:
+    virNodeDeviceObjListFree(devs);
+    return ret;
+}
+
+
+static int
+mymain(void)
+{
+    int ret = 0;
+
+    if (virTestRun("sysfs path", testSysfsPath, NULL) < 0)
+        ret = -1;
+    if (virTestRun("parent host", testParentHost, NULL) < 0)
+        ret = -1;
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN(mymain)
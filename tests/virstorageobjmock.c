@@ -0,0 +1,39 @@
+/*
+ * virstorageobjmock.c: Mock symlinks of storage volumes
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "internal.h"
+#include "virfile.h"
+#include "virstring.h"
+
+/* Every file with "-lun-" in its name is a symlink to the device node
+ * named after the part of its name following the last '-', everything
+ * else is not a symlink. */
+int
+virFileResolveAllLinks(const char *linkpath,
+                       char **resultpath)
+{
+    const char *dev;
+
+    if (strstr(linkpath, "-lun-") &&
+        (dev = strrchr(linkpath, '-')))
+        return virAsprintfQuiet(resultpath, "/dev/%s", dev + 1) < 0 ? -1 : 0;
+
+    return VIR_STRDUP_QUIET(*resultpath, linkpath) < 0 ? -1 : 0;
+}
@@ -0,0 +1,408 @@
+/*
+ * virstorageobjtest.c: Test the storage pool and volume object lists
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "testutils.h"
+#include "virstorageobj.h"
+#include "virstring.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+#define TEST_POOL_PATH "/var/lib/libvirt/images"
+#define TEST_VOL_PATH TEST_POOL_PATH "/vol.img"
+#define TEST_BY_PATH "/dev/disk/by-path"
+
+
+static int
+testPoolAddPath(virStoragePoolObjListPtr pools,
+                const char *name,
+                const char *uuid,
+                const char *path)
+{
+    virStoragePoolDefPtr def = NULL;
+    virStoragePoolObjPtr obj;
+    char *xml = NULL;
+    int ret = -1;
+
+    if (virAsprintf(&xml,
+                    "<pool type='dir'>"
+                    "  <name>%s</name>"
+                    "  <uuid>%s</uuid>"
+                    "  <target><path>%s</path></target>"
+                    "</pool>", name, uuid, path) < 0)
+        goto cleanup;
+
+    if (!(def = virStoragePoolDefParseString(xml)))
+        goto cleanup;
+
+    if (!(obj = virStoragePoolObjAssignDef(pools, def)))
+        goto cleanup;
+    def = NULL;
+
+    virStoragePoolObjSetActive(obj, true);
+    virStoragePoolObjEndAPI(&obj);
+    ret = 0;
+
+ cleanup:
+    virStoragePoolDefFree(def);
+    VIR_FREE(xml);
+    return ret;
+}
+
+
+static int
+testPoolAdd(virStoragePoolObjListPtr pools,
+            const char *name,
+            const char *uuid)
+{
+    return testPoolAddPath(pools, name, uuid, TEST_POOL_PATH);
+}
+
+
+static int
+testPoolRemove(virStoragePoolObjListPtr pools,
+               const char *name)
+{
+    virStoragePoolObjPtr obj;
+
+    if (!(obj = virStoragePoolObjFindByName(pools, name)))
+        return -1;
+
+    virStoragePoolObjRemove(pools, obj);
+    virStoragePoolObjEndAPI(&obj);
+    return 0;
+}
+
+
+static int
+testVolAdd(virStoragePoolObjListPtr pools,
+           const char *poolname,
+           const char *volname,
+           const char *path)
+{
+    virStoragePoolObjPtr obj;
+    virStorageVolDefPtr voldef = NULL;
+    char *xml = NULL;
+    int ret = -1;
+
+    if (!(obj = virStoragePoolObjFindByName(pools, poolname)))
+        return -1;
+
+    if (virAsprintf(&xml,
+                    "<volume>"
+                    "  <name>%s</name>"
+                    "  <key>%s</key>"
+                    "  <capacity>0</capacity>"
+                    "  <target><path>%s</path></target>"
+                    "</volume>", volname, path, path) < 0)
+        goto cleanup;
+
+    if (!(voldef = virStorageVolDefParseString(virStoragePoolObjGetDef(obj),
+                                               xml, 0)))
+        goto cleanup;
+
+    if (virStoragePoolObjAddVol(obj, voldef) < 0)
+        goto cleanup;
+    voldef = NULL;
+
+    ret = 0;
+
+ cleanup:
+    virStorageVolDefFree(voldef);
+    virStoragePoolObjEndAPI(&obj);
+    VIR_FREE(xml);
+    return ret;
+}
+
+
+static int
+testVolRemove(virStoragePoolObjListPtr pools,
+              const char *poolname,
+              const char *volname)
+{
+    virStoragePoolObjPtr obj;
+    virStorageVolDefPtr voldef;
+    int ret = -1;
+
+    if (!(obj = virStoragePoolObjFindByName(pools, poolname)))
+        return -1;
+
+    if ((voldef = virStorageVolDefFindByName(obj, volname))) {
+        virStoragePoolObjRemoveVol(obj, voldef);
+        ret = 0;
+    }
+
+    virStoragePoolObjEndAPI(&obj);
+    return ret;
+}
+
+
+/* Checks that @path is found in the pool @poolname as volume @volname,
+ * or not found at all if @poolname is NULL */
+static int
+testExpectVolPath(virStoragePoolObjListPtr pools,
+                  const char *path,
+                  const char *poolname,
+                  const char *volname)
+{
+    virStoragePoolObjPtr obj;
+    virStorageVolDefPtr voldef;
+    int ret = -1;
+
+    obj = virStoragePoolObjFindByVolPath(pools, path, &voldef);
+
+    if (!poolname) {
+        if (obj) {
+            fprintf(stderr, "%s: expected no pool, got '%s'\n",
+                    path, virStoragePoolObjGetDef(obj)->name);
+            goto cleanup;
+        }
+        return 0;
+    }
+
+    if (!obj) {
+        fprintf(stderr, "%s: expected pool '%s', got none\n", path, poolname);
+        return -1;
+    }
+
+    if (STRNEQ(virStoragePoolObjGetDef(obj)->name, poolname) ||
+        STRNEQ(voldef->name, volname)) {
+        fprintf(stderr, "%s: expected '%s/%s', got '%s/%s'\n", path,
+                poolname, volname,
+                virStoragePoolObjGetDef(obj)->name, voldef->name);
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virStoragePoolObjEndAPI(&obj);
+    return ret;
+}
+
+
+static virStoragePoolObjListPtr
+testPoolsNew(void)
+{
+    virStoragePoolObjListPtr pools;
+
+    if (!(pools = virStoragePoolObjListNew()))
+        return NULL;
+
+    if (testPoolAdd(pools, "pool1", "70a7eb15-6c34-ee9c-bf57-69e8e5ff3fb2") < 0 ||
+        testPoolAdd(pools, "pool2", "35bb2ad9-388a-cdfe-461a-b8907f6e53fe") < 0) {
+        virObjectUnref(pools);
+        return NULL;
+    }
+
+    return pools;
+}
+
+
+static int
+testVolPathAdd(const void *opaque ATTRIBUTE_UNUSED)
+{
+    virStoragePoolObjListPtr pools;
+    int ret = -1;
+
+    if (!(pools = testPoolsNew()))
+        return -1;
+
+    if (testExpectVolPath(pools, TEST_VOL_PATH, NULL, NULL) < 0)
+        goto cleanup;
+
+    if (testVolAdd(pools, "pool1", "vol", TEST_VOL_PATH) < 0 ||
+        testVolAdd(pools, "pool2", "other", TEST_POOL_PATH "/other.img") < 0)
+        goto cleanup;
+
+    if (testExpectVolPath(pools, TEST_VOL_PATH, "pool1", "vol") < 0 ||
+        testExpectVolPath(pools, TEST_POOL_PATH "/other.img",
+                          "pool2", "other") < 0 ||
+        testExpectVolPath(pools, TEST_POOL_PATH "/missing.img",
+                          NULL, NULL) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    virObjectUnref(pools);
+    return ret;
+}
+
+
+static int
+testVolPathRemove(const void *opaque ATTRIBUTE_UNUSED)
+{
+    virStoragePoolObjListPtr pools;
+    int ret = -1;
+
+    if (!(pools = testPoolsNew()))
+        return -1;
+
+    if (testVolAdd(pools, "pool1", "vol", TEST_VOL_PATH) < 0 ||
+        testVolRemove(pools, "pool1", "vol") < 0)
+        goto cleanup;
+
+    if (testExpectVolPath(pools, TEST_VOL_PATH, NULL, NULL) < 0)
+        goto cleanup;
+
+    /* Re-adding after a removal is found again */
+    if (testVolAdd(pools, "pool1", "vol", TEST_VOL_PATH) < 0 ||
+        testExpectVolPath(pools, TEST_VOL_PATH, "pool1", "vol") < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    virObjectUnref(pools);
+    return ret;
+}
+
+
+static int
+testVolPathPoolRemove(const void *opaque ATTRIBUTE_UNUSED)
+{
+    virStoragePoolObjListPtr pools;
+    int ret = -1;
+
+    if (!(pools = testPoolsNew()))
+        return -1;
+
+    if (testVolAdd(pools, "pool1", "vol", TEST_VOL_PATH) < 0 ||
+        testVolAdd(pools, "pool2", "other", TEST_POOL_PATH "/other.img") < 0 ||
+        testPoolRemove(pools, "pool1") < 0)
+        goto cleanup;
+
+    if (testExpectVolPath(pools, TEST_VOL_PATH, NULL, NULL) < 0 ||
+        testExpectVolPath(pools, TEST_POOL_PATH "/other.img",
+                          "pool2", "other") < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    virObjectUnref(pools);
+    return ret;
+}
+
+
+static int
+testVolPathDuplicate(const void *opaque ATTRIBUTE_UNUSED)
+{
+    virStoragePoolObjListPtr pools;
+    int ret = -1;
+
+    if (!(pools = testPoolsNew()))
+        return -1;
+
+    /* Both pools point at the same directory */
+    if (testVolAdd(pools, "pool1", "vol1", TEST_VOL_PATH) < 0 ||
+        testVolAdd(pools, "pool2", "vol2", TEST_VOL_PATH) < 0)
+        goto cleanup;
+
+    if (testExpectVolPath(pools, TEST_VOL_PATH, "pool1", "vol1") < 0)
+        goto cleanup;
+
+    /* Removing the volume from the first pool leaves the second claim */
+    if (testVolRemove(pools, "pool1", "vol1") < 0 ||
+        testExpectVolPath(pools, TEST_VOL_PATH, "pool2", "vol2") < 0)
+        goto cleanup;
+
+    /* So does removing the whole first pool */
+    if (testVolAdd(pools, "pool1", "vol1", TEST_VOL_PATH) < 0 ||
+        testExpectVolPath(pools, TEST_VOL_PATH, "pool2", "vol2") < 0 ||
+        testPoolRemove(pools, "pool1") < 0 ||
+        testExpectVolPath(pools, TEST_VOL_PATH, "pool2", "vol2") < 0)
+        goto cleanup;
+
+    if (testVolRemove(pools, "pool2", "vol2") < 0 ||
+        testExpectVolPath(pools, TEST_VOL_PATH, NULL, NULL) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    virObjectUnref(pools);
+    return ret;
+}
+
+
+/* Volumes of pools under /dev are found by the device node their
+ * symlink resolves to as well, see virstorageobjmock.c */
+static int
+testVolPathDevice(const void *opaque ATTRIBUTE_UNUSED)
+{
+    virStoragePoolObjListPtr pools;
+    int ret = -1;
+
+    if (!(pools = virStoragePoolObjListNew()))
+        return -1;
+
+    if (testPoolAddPath(pools, "pool1", "70a7eb15-6c34-ee9c-bf57-69e8e5ff3fb2",
+                        TEST_BY_PATH) < 0 ||
+        testPoolAdd(pools, "pool2", "35bb2ad9-388a-cdfe-461a-b8907f6e53fe") < 0)
+        goto cleanup;
+
+    if (testVolAdd(pools, "pool1", "lun1", TEST_BY_PATH "/ip-lun-sdb") < 0 ||
+        testVolAdd(pools, "pool2", "other", TEST_POOL_PATH "/ip-lun-sdc") < 0)
+        goto cleanup;
+
+    if (testExpectVolPath(pools, TEST_BY_PATH "/ip-lun-sdb",
+                          "pool1", "lun1") < 0 ||
+        testExpectVolPath(pools, "/dev/sdb", "pool1", "lun1") < 0)
+        goto cleanup;
+
+    /* Only pools under /dev get their volumes aliased */
+    if (testExpectVolPath(pools, "/dev/sdc", NULL, NULL) < 0)
+        goto cleanup;
+
+    /* The alias goes away with the volume */
+    if (testVolRemove(pools, "pool1", "lun1") < 0 ||
+        testExpectVolPath(pools, "/dev/sdb", NULL, NULL) < 0 ||
+        testExpectVolPath(pools, TEST_BY_PATH "/ip-lun-sdb", NULL, NULL) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    virObjectUnref(pools);
+    return ret;
+}
+
+
+static int
+mymain(void)
+{
+    int ret = 0;
+
+    if (virTestRun("Volume path add", testVolPathAdd, NULL) < 0)
+        ret = -1;
+    if (virTestRun("Volume path remove", testVolPathRemove, NULL) < 0)
+        ret = -1;
+    if (virTestRun("Volume path pool remove", testVolPathPoolRemove, NULL) < 0)
+        ret = -1;
+    if (virTestRun("Volume path duplicate", testVolPathDuplicate, NULL) < 0)
+        ret = -1;
+    if (virTestRun("Volume path device", testVolPathDevice, NULL) < 0)
+        ret = -1;
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN_PRELOAD(mymain, abs_builddir "/.libs/virstorageobjmock.so")
@@ -21,6 +21,8 @@
 #include <config.h>
 
 #include <stdlib.h>
+#include <fcntl.h>
+#include <sys/time.h>
 
 #include "testutils.h"
 #include "vircommand.h"
@@ -714,6 +716,131 @@ testBackingParse(const void *args)
 }
 
 
+static void
+testHeaderCacheWriteBE(char *buf, unsigned long long val, size_t len)
+{
+    while (len--) {
+        buf[len] = val & 0xff;
+        val >>= 8;
+    }
+}
+
+
+/* Writes a minimal qcow2 header of a 1024 byte image backed by @backing
+ * to @path, keeping the inode of an existing file, and sets its mtime
+ * to @mtime */
+static int
+testHeaderCacheWriteImage(const char *path,
+                          const char *backing,
+                          time_t mtime)
+{
+    char buf[72 + 3] = { 0 };
+    struct timeval times[2] = { { mtime, 0 }, { mtime, 0 } };
+    int fd;
+    int ret = -1;
+
+    if (strlen(backing) != 3)
+        return -1;
+
+    memcpy(buf, "QFI\xfb", 4);
+    testHeaderCacheWriteBE(buf + 4, 2, 4);      /* version */
+    testHeaderCacheWriteBE(buf + 8, 72, 8);     /* backing file offset */
+    testHeaderCacheWriteBE(buf + 16, 3, 4);     /* backing file size */
+    testHeaderCacheWriteBE(buf + 20, 16, 4);    /* cluster bits */
+    testHeaderCacheWriteBE(buf + 24, 1024, 8);  /* image size */
+    memcpy(buf + 72, backing, 3);
+
+    if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600)) < 0)
+        return -1;
+
+    if (safewrite(fd, buf, sizeof(buf)) != sizeof(buf))
+        goto cleanup;
+
+    if (VIR_CLOSE(fd) < 0)
+        goto cleanup;
+
+    if (utimes(path, times) < 0)
+        goto cleanup;
+
+    ret = 0;
+ cleanup:
+    VIR_FORCE_CLOSE(fd);
+    return ret;
+}
+
+
+static int
+testHeaderCacheCheck(const char *path,
+                     const char *expBacking)
+{
+    virStorageSourcePtr src;
+    int ret = -1;
+
+    if (!(src = testStorageFileGetMetadata(path, VIR_STORAGE_FILE_QCOW2,
+                                           -1, -1, false)))
+        return -1;
+
+    if (STRNEQ_NULLABLE(src->backingStoreRaw, expBacking)) {
+        fprintf(stderr, "expected backing '%s', got '%s'\n",
+                expBacking, NULLSTR(src->backingStoreRaw));
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    virStorageSourceFree(src);
+    return ret;
+}
+
+
+static int
+testHeaderCache(const void *args ATTRIBUTE_UNUSED)
+{
+    const char *path = datadir "/cache";
+    time_t mtime = time(NULL) - 3600;
+
+    virStorageFileHeaderCacheClear();
+
+    if (virFileWriteStr(datadir "/aaa", "", 0600) < 0 ||
+        virFileWriteStr(datadir "/bbb", "", 0600) < 0)
+        return -1;
+
+    /* Populate the cache */
+    if (testHeaderCacheWriteImage(path, "aaa", mtime) < 0 ||
+        testHeaderCacheCheck(path, "aaa") < 0)
+        return -1;
+
+    /* Same (dev, ino, size, mtime): the cached header is used */
+    if (testHeaderCacheWriteImage(path, "bbb", mtime) < 0 ||
+        testHeaderCacheCheck(path, "aaa") < 0)
+        return -1;
+
+    /* Changed mtime invalidates the entry */
+    if (testHeaderCacheWriteImage(path, "bbb", mtime + 1) < 0 ||
+        testHeaderCacheCheck(path, "bbb") < 0)
+        return -1;
+
+    /* Explicit invalidation */
+    if (testHeaderCacheWriteImage(path, "aaa", mtime + 1) < 0 ||
+        testHeaderCacheCheck(path, "bbb") < 0)
+        return -1;
+
+    virStorageFileHeaderCacheInvalidate(path);
+
+    if (testHeaderCacheCheck(path, "aaa") < 0)
+        return -1;
+
+    /* Clearing the whole cache */
+    if (testHeaderCacheWriteImage(path, "bbb", mtime + 1) < 0 ||
+        testHeaderCacheCheck(path, "aaa") < 0)
+        return -1;
+
+    virStorageFileHeaderCacheClear();
+
+    return testHeaderCacheCheck(path, "bbb");
+}
+
+
 static int
 mymain(void)
 {
@@ -1630,6 +1757,9 @@ mymain(void)
                        "</source>\n");
 #endif /* WITH_YAJL */
 
+    if (virTestRun("Image header cache", testHeaderCache, NULL) < 0)
+        ret = -1;
+
  cleanup:
     /* Final cleanup */
     virStorageSourceFree(chain);
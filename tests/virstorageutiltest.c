@@ -17,6 +17,7 @@
 #include <config.h>
 
 #include <stdlib.h>
+#include <unistd.h>
 
 #include "testutils.h"
 #include "virerror.h"
@@ -24,12 +25,15 @@
 #include "virlog.h"
 #include "virstring.h"
 
+#include "virstorageobj.h"
 #include "storage/storage_util.h"
 
 #define VIR_FROM_THIS VIR_FROM_NONE
 
 VIR_LOG_INIT("tests.storageutiltest");
 
+#define SCRATCHDIRTEMPLATE abs_builddir "/virstorageutiltestdir-XXXXXX"
+
 
 struct testGlusterExtractPoolSourcesData {
     const char *srcxml;
@@ -74,6 +78,245 @@ testGlusterExtractPoolSources(const void *opaque)
 }
 
 
+static int
+testRefreshWriteFile(const char *dir,
+                     const char *name,
+                     const char *content)
+{
+    char *path = NULL;
+    int ret = -1;
+
+    if (virAsprintf(&path, "%s/%s", dir, name) < 0)
+        return -1;
+
+    if (virFileWriteStr(path, content, 0600) < 0) {
+        fprintf(stderr, "cannot write '%s'\n", path);
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    VIR_FREE(path);
+    return ret;
+}
+
+
+static int
+testRefreshUnlinkFile(const char *dir,
+                      const char *name)
+{
+    char *path = NULL;
+    int ret = -1;
+
+    if (virAsprintf(&path, "%s/%s", dir, name) < 0)
+        return -1;
+
+    if (unlink(path) < 0) {
+        fprintf(stderr, "cannot unlink '%s'\n", path);
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    VIR_FREE(path);
+    return ret;
+}
+
+
+static virStoragePoolObjListPtr
+testRefreshPoolsNew(const char *dir)
+{
+    virStoragePoolObjListPtr pools = NULL;
+    virStoragePoolDefPtr def = NULL;
+    virStoragePoolObjPtr obj;
+    char *xml = NULL;
+
+    if (virAsprintf(&xml,
+                    "<pool type='dir'>"
+                    "  <name>pool</name>"
+                    "  <uuid>70a7eb15-6c34-ee9c-bf57-69e8e5ff3fb2</uuid>"
+                    "  <target><path>%s</path></target>"
+                    "</pool>", dir) < 0)
+        goto error;
+
+    if (!(def = virStoragePoolDefParseString(xml)) ||
+        !(pools = virStoragePoolObjListNew()))
+        goto error;
+
+    if (!(obj = virStoragePoolObjAssignDef(pools, def)))
+        goto error;
+    def = NULL;
+
+    virStoragePoolObjSetActive(obj, true);
+    virStoragePoolObjEndAPI(&obj);
+    VIR_FREE(xml);
+    return pools;
+
+ error:
+    virStoragePoolDefFree(def);
+    virObjectUnref(pools);
+    VIR_FREE(xml);
+    return NULL;
+}
+
+
+static int
+testRefresh(virStoragePoolObjListPtr pools)
+{
+    virStoragePoolObjPtr obj;
+    int ret;
+
+    if (!(obj = virStoragePoolObjFindByName(pools, "pool")))
+        return -1;
+
+    ret = virStorageBackendRefreshLocal(obj);
+    virStoragePoolObjEndAPI(&obj);
+    return ret;
+}
+
+
+/* Checks that the pool holds @nvols volumes and, unless @name is NULL,
+ * that volume @name has @capacity. If @voldef is not NULL, it is either
+ * filled with the definition of the volume or, if already set, checked
+ * to be (@same is true) or not to be the definition of the volume. */
+static int
+testRefreshExpectVol(virStoragePoolObjListPtr pools,
+                     int nvols,
+                     const char *name,
+                     unsigned long long capacity,
+                     virStorageVolDefPtr *voldef,
+                     bool same)
+{
+    virStoragePoolObjPtr obj;
+    virStorageVolDefPtr actual;
+    int n;
+    int ret = -1;
+
+    if (!(obj = virStoragePoolObjFindByName(pools, "pool")))
+        return -1;
+
+    if ((n = virStoragePoolObjNumOfVolumes(obj, NULL, NULL)) != nvols) {
+        fprintf(stderr, "expected %d volumes, got %d\n", nvols, n);
+        goto cleanup;
+    }
+
+    if (!name) {
+        ret = 0;
+        goto cleanup;
+    }
+
+    if (!(actual = virStorageVolDefFindByName(obj, name))) {
+        fprintf(stderr, "volume '%s' not found\n", name);
+        goto cleanup;
+    }
+
+    if (actual->target.capacity != capacity) {
+        fprintf(stderr, "volume '%s': expected capacity %llu, got %llu\n",
+                name, capacity, actual->target.capacity);
+        goto cleanup;
+    }
+
+    if (voldef) {
+        if (!*voldef) {
+            *voldef = actual;
+        } else if ((*voldef == actual) != same) {
+            fprintf(stderr, "volume '%s' was %s\n", name,
+                    same ? "probed again" : "not probed again");
+            goto cleanup;
+        }
+    }
+
+    ret = 0;
+ cleanup:
+    virStoragePoolObjEndAPI(&obj);
+    return ret;
+}
+
+
+static int
+testRefreshLocal(const void *opaque ATTRIBUTE_UNUSED)
+{
+    char scratchdir[] = SCRATCHDIRTEMPLATE;
+    virStoragePoolObjListPtr pools = NULL;
+    virStorageVolDefPtr kept = NULL;
+    virStorageVolDefPtr changed = NULL;
+    virStoragePoolObjPtr obj;
+    virStorageVolDefPtr voldef;
+    char *path = NULL;
+    int ret = -1;
+
+    if (!mkdtemp(scratchdir)) {
+        virReportSystemError(errno, "%s", "Cannot create scratch dir");
+        return -1;
+    }
+
+    if (testRefreshWriteFile(scratchdir, "kept.img", "kept") < 0 ||
+        testRefreshWriteFile(scratchdir, "changed.img", "changed") < 0 ||
+        testRefreshWriteFile(scratchdir, "vanished.img", "vanished") < 0)
+        goto cleanup;
+
+    if (!(pools = testRefreshPoolsNew(scratchdir)) ||
+        testRefresh(pools) < 0 ||
+        testRefreshExpectVol(pools, 3, "kept.img", 4, &kept, true) < 0 ||
+        testRefreshExpectVol(pools, 3, "changed.img", 7, &changed, true) < 0 ||
+        testRefreshExpectVol(pools, 3, "vanished.img", 8, NULL, true) < 0)
+        goto cleanup;
+
+    if (testRefreshWriteFile(scratchdir, "changed.img", "changed again") < 0 ||
+        testRefreshUnlinkFile(scratchdir, "vanished.img") < 0 ||
+        testRefreshWriteFile(scratchdir, "added.img", "added") < 0)
+        goto cleanup;
+
+    /* Only the new and the changed volume are probed */
+    if (testRefresh(pools) < 0 ||
+        testRefreshExpectVol(pools, 3, "kept.img", 4, &kept, true) < 0 ||
+        testRefreshExpectVol(pools, 3, "changed.img", 13, &changed, false) < 0 ||
+        testRefreshExpectVol(pools, 3, "added.img", 5, NULL, true) < 0)
+        goto cleanup;
+
+    if (virAsprintf(&path, "%s/vanished.img", scratchdir) < 0)
+        goto cleanup;
+
+    if ((obj = virStoragePoolObjFindByVolPath(pools, path, &voldef))) {
+        fprintf(stderr, "vanished volume still found by path\n");
+        virStoragePoolObjEndAPI(&obj);
+        goto cleanup;
+    }
+
+    /* A failed refresh leaves no stale volumes behind */
+    if (virFileDeleteTree(scratchdir) < 0)
+        goto cleanup;
+
+    if (testRefresh(pools) == 0) {
+        fprintf(stderr, "refresh of a missing directory succeeded\n");
+        goto cleanup;
+    }
+    virResetLastError();
+
+    if (testRefreshExpectVol(pools, 0, NULL, 0, NULL, true) < 0)
+        goto cleanup;
+
+    VIR_FREE(path);
+    if (virAsprintf(&path, "%s/kept.img", scratchdir) < 0)
+        goto cleanup;
+
+    if ((obj = virStoragePoolObjFindByVolPath(pools, path, &voldef))) {
+        fprintf(stderr, "volume of a failed refresh still found by path\n");
+        virStoragePoolObjEndAPI(&obj);
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    if (getenv("LIBVIRT_SKIP_CLEANUP") == NULL && virFileExists(scratchdir))
+        virFileDeleteTree(scratchdir);
+    virObjectUnref(pools);
+    VIR_FREE(path);
+    return ret;
+}
+
+
 static int
 mymain(void)
 {
@@ -108,6 +351,9 @@ mymain(void)
 #undef DO_TEST_GLUSTER_EXTRACT_POOL_SOURCES_NETFS
 #undef DO_TEST_GLUSTER_EXTRACT_POOL_SOURCES_FULL
 
+    if (virTestRun("refresh local pool", testRefreshLocal, NULL) < 0)
+        ret = -1;
+
     return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
@@ -0,0 +1,504 @@
+/*
+ * virthreadpooltest.c: Test the scheduling of thread pool jobs
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "testutils.h"
+
+#include "viralloc.h"
+#include "viratomic.h"
+#include "virthread.h"
+#include "virthreadpool.h"
+#define __VIR_THREAD_POOL_PRIV_H_ALLOW__
+#include "virthreadpoolpriv.h"
+#include "virtime.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+/* How long to wait for the workers before giving up, in ms */
+#define TEST_TIMEOUT 10000
+
+/* Job IDs tell the flows apart in the order the jobs ran */
+#define TEST_ID_A 100
+#define TEST_ID_B 200
+#define TEST_ID_GATE -1
+
+typedef struct _testPool testPool;
+typedef testPool *testPoolPtr;
+struct _testPool {
+    virThreadPoolPtr pool;
+
+    virMutex lock;
+    virCond cond;
+
+    /* A gate job keeps its worker busy until the gate is opened, so
+     * that the jobs sent meanwhile queue up */
+    bool gateTaken;
+    bool gateOpen;
+
+    int order[64];
+    size_t norder;
+};
+
+typedef struct _testJob testJob;
+typedef testJob *testJobPtr;
+struct _testJob {
+    int id;
+    unsigned int us;    /* how long the job runs */
+};
+
+
+/* The pools measure how long jobs run on this clock, which only jobs
+ * advance, so that the service time of flows does not depend on how
+ * busy the machine running the test is. It never reads zero, which the
+ * pool takes for a clock failure. */
+static volatile int testClockUs = 1000000;
+
+static int
+testClockNow(unsigned long long *now)
+{
+    *now = virAtomicIntGet(&testClockUs);
+    return 0;
+}
+
+
+static void
+testJobRun(void *jobdata,
+           void *opaque)
+{
+    testJobPtr job = jobdata;
+    testPoolPtr test = opaque;
+
+    if (job->id != TEST_ID_GATE && job->us)
+        virAtomicIntAdd(&testClockUs, job->us);
+
+    virMutexLock(&test->lock);
+    if (job->id == TEST_ID_GATE) {
+        test->gateTaken = true;
+        virCondBroadcast(&test->cond);
+        while (!test->gateOpen)
+            ignore_value(virCondWait(&test->cond, &test->lock));
+    } else if (test->norder < ARRAY_CARDINALITY(test->order)) {
+        test->order[test->norder++] = job->id;
+        virCondBroadcast(&test->cond);
+    }
+    virMutexUnlock(&test->lock);
+
+    VIR_FREE(job);
+}
+
+
+static int
+testPoolInit(testPoolPtr test,
+             size_t workers,
+             size_t prioWorkers)
+{
+    memset(test, 0, sizeof(*test));
+    test->gateOpen = true;
+
+    if (virMutexInit(&test->lock) < 0)
+        return -1;
+
+    if (virCondInit(&test->cond) < 0) {
+        virMutexDestroy(&test->lock);
+        return -1;
+    }
+
+    if (!(test->pool = virThreadPoolNew(workers, workers, prioWorkers,
+                                        testJobRun, test))) {
+        virCondDestroy(&test->cond);
+        virMutexDestroy(&test->lock);
+        return -1;
+    }
+
+    virThreadPoolSetClock(test->pool, testClockNow);
+    return 0;
+}
+
+
+static void
+testPoolOpenGate(testPoolPtr test)
+{
+    virMutexLock(&test->lock);
+    test->gateOpen = true;
+    virCondBroadcast(&test->cond);
+    virMutexUnlock(&test->lock);
+}
+
+
+static void
+testPoolFree(testPoolPtr test)
+{
+    testPoolOpenGate(test);
+    virThreadPoolFree(test->pool);
+    virCondDestroy(&test->cond);
+    virMutexDestroy(&test->lock);
+}
+
+
+static int
+testPoolSend(testPoolPtr test,
+             unsigned int priority,
+             const char *flow,
+             unsigned int weight,
+             int id,
+             unsigned int us)
+{
+    testJobPtr job;
+
+    if (VIR_ALLOC(job) < 0)
+        return -1;
+
+    job->id = id;
+    job->us = us;
+
+    if (virThreadPoolSendJobFull(test->pool, priority, flow, weight, job) < 0) {
+        VIR_FREE(job);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/* Waits until either the gate job was taken, or @norder jobs ran */
+static int
+testPoolWait(testPoolPtr test,
+             bool gate,
+             size_t norder)
+{
+    unsigned long long deadline;
+    int ret = 0;
+
+    if (virTimeMillisNow(&deadline) < 0)
+        return -1;
+    deadline += TEST_TIMEOUT;
+
+    virMutexLock(&test->lock);
+    while (gate ? !test->gateTaken : test->norder < norder) {
+        if (virCondWaitUntil(&test->cond, &test->lock, deadline) < 0) {
+            fprintf(stderr, "timed out waiting for %s\n",
+                    gate ? "the gate job" : "jobs to run");
+            ret = -1;
+            break;
+        }
+    }
+    virMutexUnlock(&test->lock);
+
+    return ret;
+}
+
+
+/* Occupies the only ordinary worker until testPoolOpenGate */
+static int
+testPoolCloseGate(testPoolPtr test,
+                  const char *flow)
+{
+    virMutexLock(&test->lock);
+    test->gateOpen = false;
+    test->gateTaken = false;
+    virMutexUnlock(&test->lock);
+
+    if (testPoolSend(test, 0, flow, 1, TEST_ID_GATE, 0) < 0)
+        return -1;
+
+    return testPoolWait(test, true, 0);
+}
+
+
+static size_t
+testPoolCount(testPoolPtr test,
+              size_t from,
+              size_t to,
+              int base)
+{
+    size_t count = 0;
+    size_t i;
+
+    for (i = from; i < to && i < test->norder; i++) {
+        if (test->order[i] >= base && test->order[i] < base + 100)
+            count++;
+    }
+
+    return count;
+}
+
+
+static void
+testPoolPrintOrder(testPoolPtr test)
+{
+    size_t i;
+
+    fprintf(stderr, "jobs ran in order:");
+    for (i = 0; i < test->norder; i++)
+        fprintf(stderr, " %d", test->order[i]);
+    fprintf(stderr, "\n");
+}
+
+
+/* Jobs of a flow run in the order they were sent */
+static int
+testFlowOrder(const void *opaque ATTRIBUTE_UNUSED)
+{
+    testPool test;
+    int last[2] = { TEST_ID_A - 1, TEST_ID_B - 1 };
+    size_t i;
+    int ret = -1;
+
+    if (testPoolInit(&test, 1, 0) < 0)
+        return -1;
+
+    if (testPoolCloseGate(&test, "gate") < 0)
+        goto cleanup;
+
+    for (i = 0; i < 8; i++) {
+        if (testPoolSend(&test, 0, "a", 1, TEST_ID_A + i, (i % 3) * 500) < 0 ||
+            testPoolSend(&test, 0, "b", 2, TEST_ID_B + i, (i % 2) * 500) < 0)
+            goto cleanup;
+    }
+
+    testPoolOpenGate(&test);
+    if (testPoolWait(&test, false, 16) < 0)
+        goto cleanup;
+
+    for (i = 0; i < test.norder; i++) {
+        int *prev = &last[test.order[i] >= TEST_ID_B];
+
+        if (test.order[i] != *prev + 1) {
+            testPoolPrintOrder(&test);
+            goto cleanup;
+        }
+        *prev = test.order[i];
+    }
+
+    ret = 0;
+
+ cleanup:
+    testPoolFree(&test);
+    return ret;
+}
+
+
+/* Jobs sent without a flow, as virNetServer does with fair queuing
+ * disabled, run first come, first served */
+static int
+testNoFlowOrder(const void *opaque ATTRIBUTE_UNUSED)
+{
+    testPool test;
+    size_t i;
+    int ret = -1;
+
+    if (testPoolInit(&test, 1, 0) < 0)
+        return -1;
+
+    if (testPoolCloseGate(&test, NULL) < 0)
+        goto cleanup;
+
+    for (i = 0; i < 12; i++) {
+        testJobPtr job;
+
+        /* Some jobs are slower than others, which must not matter */
+        if (VIR_ALLOC(job) < 0)
+            goto cleanup;
+        job->id = i;
+        job->us = (i % 3) * 1000;
+
+        if (virThreadPoolSendJob(test.pool, 0, job) < 0) {
+            VIR_FREE(job);
+            goto cleanup;
+        }
+    }
+
+    testPoolOpenGate(&test);
+    if (testPoolWait(&test, false, 12) < 0)
+        goto cleanup;
+
+    for (i = 0; i < test.norder; i++) {
+        if (test.order[i] != i) {
+            testPoolPrintOrder(&test);
+            goto cleanup;
+        }
+    }
+
+    ret = 0;
+
+ cleanup:
+    testPoolFree(&test);
+    return ret;
+}
+
+
+/* Two busy flows share the worker according to their weights */
+static int
+testWeightedShare(const void *opaque ATTRIBUTE_UNUSED)
+{
+    testPool test;
+    size_t a, b;
+    size_t i;
+    int ret = -1;
+
+    if (testPoolInit(&test, 1, 0) < 0)
+        return -1;
+
+    if (testPoolCloseGate(&test, "gate") < 0)
+        goto cleanup;
+
+    for (i = 0; i < 12; i++) {
+        if (testPoolSend(&test, 0, "a", 1, TEST_ID_A + i, 2000) < 0 ||
+            testPoolSend(&test, 0, "b", 3, TEST_ID_B + i, 2000) < 0)
+            goto cleanup;
+    }
+
+    testPoolOpenGate(&test);
+    if (testPoolWait(&test, false, 24) < 0)
+        goto cleanup;
+
+    /* While both flows have jobs queued, "b" gets three times the
+     * service "a" gets, two of the first eight jobs belong to "a" */
+    a = testPoolCount(&test, 0, 8, TEST_ID_A);
+    b = testPoolCount(&test, 0, 8, TEST_ID_B);
+    if (a != 2 || b != 6) {
+        testPoolPrintOrder(&test);
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    testPoolFree(&test);
+    return ret;
+}
+
+
+/* Priority workers take priority jobs even if all ordinary workers
+ * are busy */
+static int
+testPriority(const void *opaque ATTRIBUTE_UNUSED)
+{
+    testPool test;
+    int ret = -1;
+
+    if (testPoolInit(&test, 1, 1) < 0)
+        return -1;
+
+    if (testPoolCloseGate(&test, NULL) < 0)
+        goto cleanup;
+
+    if (testPoolSend(&test, 0, "a", 1, TEST_ID_A, 0) < 0 ||
+        testPoolSend(&test, 1, "b", 1, TEST_ID_B, 0) < 0)
+        goto cleanup;
+
+    if (testPoolWait(&test, false, 1) < 0)
+        goto cleanup;
+
+    testPoolOpenGate(&test);
+    if (testPoolWait(&test, false, 2) < 0)
+        goto cleanup;
+
+    if (test.order[0] != TEST_ID_B || test.order[1] != TEST_ID_A) {
+        testPoolPrintOrder(&test);
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    testPoolFree(&test);
+    return ret;
+}
+
+
+/* A flow which stayed idle while another one was served does not get
+ * the worker to itself once it has jobs again */
+static int
+testIdleCredit(const void *opaque ATTRIBUTE_UNUSED)
+{
+    testPool test;
+    size_t i;
+    int ret = -1;
+
+    if (testPoolInit(&test, 1, 0) < 0)
+        return -1;
+
+    /* The flow of jobs sent without a name stays idle meanwhile */
+    if (testPoolCloseGate(&test, "gate") < 0)
+        goto cleanup;
+
+    for (i = 0; i < 8; i++) {
+        if (testPoolSend(&test, 0, "a", 1, TEST_ID_A + i, 2000) < 0)
+            goto cleanup;
+    }
+
+    testPoolOpenGate(&test);
+    if (testPoolWait(&test, false, 8) < 0)
+        goto cleanup;
+
+    if (testPoolCloseGate(&test, "gate") < 0)
+        goto cleanup;
+
+    for (i = 0; i < 4; i++) {
+        if (testPoolSend(&test, 0, NULL, 1, i, 2000) < 0)
+            goto cleanup;
+    }
+    for (i = 0; i < 4; i++) {
+        if (testPoolSend(&test, 0, "a", 1, TEST_ID_A + 8 + i, 2000) < 0)
+            goto cleanup;
+    }
+
+    testPoolOpenGate(&test);
+    if (testPoolWait(&test, false, 16) < 0)
+        goto cleanup;
+
+    /* Had the idle flow kept its service time from before, all of its
+     * jobs would run first. Instead the flows take turns. */
+    if (testPoolCount(&test, 8, 12, TEST_ID_A) != 2) {
+        testPoolPrintOrder(&test);
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    testPoolFree(&test);
+    return ret;
+}
+
+
+static int
+mymain(void)
+{
+    int ret = 0;
+
+    if (virThreadInitialize() < 0)
+        return EXIT_FAILURE;
+
+    if (virTestRun("Flow order", testFlowOrder, NULL) < 0)
+        ret = -1;
+    if (virTestRun("No flow order", testNoFlowOrder, NULL) < 0)
+        ret = -1;
+    if (virTestRun("Weighted share", testWeightedShare, NULL) < 0)
+        ret = -1;
+    if (virTestRun("Priority", testPriority, NULL) < 0)
+        ret = -1;
+    if (virTestRun("Idle credit", testIdleCredit, NULL) < 0)
+        ret = -1;
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN(mymain)
@@ -25,6 +25,7 @@
 #include <virtypedparam.h>
 
 #include "testutils.h"
+#include "virtime.h"
 
 #define VIR_FROM_THIS VIR_FROM_NONE
 
@@ -285,6 +286,574 @@ testTypedParamsValidator(void)
     return rv;
 }
 
+static int
+testTypedParamsCompare(virTypedParameterPtr a,
+                       int na,
+                       virTypedParameterPtr b,
+                       int nb)
+{
+    size_t i;
+
+    if (na != nb) {
+        VIR_TEST_DEBUG("Expected %d parameters, got %d", na, nb);
+        return -1;
+    }
+
+    for (i = 0; i < na; i++) {
+        bool same;
+
+        if (STRNEQ(a[i].field, b[i].field) || a[i].type != b[i].type) {
+            VIR_TEST_DEBUG("Parameter %zu: expected %s, got %s",
+                           i, a[i].field, b[i].field);
+            return -1;
+        }
+
+        if (a[i].type == VIR_TYPED_PARAM_STRING)
+            same = STREQ(a[i].value.s, b[i].value.s);
+        else
+            same = memcmp(&a[i].value, &b[i].value, sizeof(a[i].value)) == 0;
+
+        if (!same) {
+            VIR_TEST_DEBUG("Parameter %s has a different value", a[i].field);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+static int
+testTypedParamsPackOne(virTypedParamsDictPtr dict,
+                       virTypedParameterPtr params,
+                       int nparams,
+                       virTypedParameterPtr *unpacked,
+                       int *nunpacked)
+{
+    unsigned int *keys = NULL;
+    unsigned long long *values = NULL;
+    unsigned int nvalues = 0;
+    char **strings = NULL;
+    unsigned int nstrings = 0;
+    int ret = -1;
+
+    if (virTypedParamsPack(dict, params, nparams, &keys, &values, &nvalues,
+                           &strings, &nstrings,
+                           VIR_TYPED_PARAM_STRING_OKAY) < 0)
+        goto cleanup;
+
+    if (virTypedParamsUnpack(dict->fields, dict->types, dict->nfields,
+                             keys, values, nvalues, strings, nstrings,
+                             0, unpacked, nunpacked) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    VIR_FREE(keys);
+    VIR_FREE(values);
+    virStringListFreeCount(strings, nstrings);
+    return ret;
+}
+
+
+static int
+testTypedParamsPack(const void *opaque ATTRIBUTE_UNUSED)
+{
+    virTypedParamsDictPtr dict = NULL;
+    virTypedParameterPtr params = NULL;
+    virTypedParameterPtr unpacked = NULL;
+    int nparams = 0;
+    int maxparams = 0;
+    int nunpacked = 0;
+    size_t i;
+    int ret = -1;
+
+    if (!(dict = virTypedParamsDictNew()))
+        goto cleanup;
+
+    for (i = 0; i < 2; i++) {
+        if (virTypedParamsAddInt(&params, &nparams, &maxparams,
+                                 "int", -42 - i) < 0 ||
+            virTypedParamsAddUInt(&params, &nparams, &maxparams,
+                                  "uint", 42 + i) < 0 ||
+            virTypedParamsAddLLong(&params, &nparams, &maxparams,
+                                   "llong", -1234567890123LL) < 0 ||
+            virTypedParamsAddULLong(&params, &nparams, &maxparams,
+                                    "ullong", ULLONG_MAX - i) < 0 ||
+            virTypedParamsAddDouble(&params, &nparams, &maxparams,
+                                    "double", -3.25 * i) < 0 ||
+            virTypedParamsAddBoolean(&params, &nparams, &maxparams,
+                                     "boolean", i == 0) < 0 ||
+            virTypedParamsAddString(&params, &nparams, &maxparams,
+                                    "string", i ? "bar" : "foo") < 0)
+            goto cleanup;
+
+        if (testTypedParamsPackOne(dict, params, nparams,
+                                   &unpacked, &nunpacked) < 0 ||
+            testTypedParamsCompare(params, nparams, unpacked, nunpacked) < 0)
+            goto cleanup;
+
+        virTypedParamsFree(params, nparams);
+        virTypedParamsFree(unpacked, nunpacked);
+        params = unpacked = NULL;
+        nparams = maxparams = nunpacked = 0;
+    }
+
+    /* both arrays share all fields */
+    if (dict->nfields != 7) {
+        VIR_TEST_DEBUG("Expected 7 fields in dictionary, got %zu",
+                       dict->nfields);
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virTypedParamsFree(params, nparams);
+    virTypedParamsFree(unpacked, nunpacked);
+    virTypedParamsDictFree(dict);
+    return ret;
+}
+
+
+static int
+testTypedParamsPackInvalid(const void *opaque ATTRIBUTE_UNUSED)
+{
+    char *fields[] = { (char *) "uint", (char *) "string" };
+    int types[] = { VIR_TYPED_PARAM_UINT, VIR_TYPED_PARAM_STRING };
+    char *strings[] = { (char *) "foo" };
+    unsigned int badKeys[] = { 0, 2 };
+    unsigned int keys[] = { 0, 1 };
+    unsigned long long values[] = { 1, 1 };
+    virTypedParameterPtr params = NULL;
+    int nparams = 0;
+
+    /* key out of range */
+    if (virTypedParamsUnpack(fields, types, 2, badKeys, values, 2,
+                             strings, 1, 0, &params, &nparams) == 0)
+        goto error;
+
+    /* string index out of range */
+    if (virTypedParamsUnpack(fields, types, 2, keys, values, 2,
+                             strings, 1, 0, &params, &nparams) == 0)
+        goto error;
+
+    /* too many values */
+    if (virTypedParamsUnpack(fields, types, 2, keys, values, 2,
+                             strings, 1, 1, &params, &nparams) == 0)
+        goto error;
+
+    return 0;
+
+ error:
+    virTypedParamsFree(params, nparams);
+    return -1;
+}
+
+
+/* Size of the XDR encoding of a string */
+static size_t
+testXDRStringSize(const char *str)
+{
+    return 4 + VIR_ROUND_UP(strlen(str), 4);
+}
+
+
+/* Size of the XDR encoding of a remote_typed_param */
+static size_t
+testXDRTypedParamSize(virTypedParameterPtr param)
+{
+    size_t size = testXDRStringSize(param->field) + 4;
+
+    switch ((virTypedParameterType) param->type) {
+    case VIR_TYPED_PARAM_INT:
+    case VIR_TYPED_PARAM_UINT:
+    case VIR_TYPED_PARAM_BOOLEAN:
+        return size + 4;
+    case VIR_TYPED_PARAM_LLONG:
+    case VIR_TYPED_PARAM_ULLONG:
+    case VIR_TYPED_PARAM_DOUBLE:
+        return size + 8;
+    case VIR_TYPED_PARAM_STRING:
+        return size + testXDRStringSize(param->value.s);
+    case VIR_TYPED_PARAM_LAST:
+        break;
+    }
+
+    return size;
+}
+
+
+#define BENCH_DOMAINS 300
+#define BENCH_DEVICES 16
+
+/* Creates an array resembling a record returned by
+ * virConnectGetAllDomainStats for a domain with several disks and NICs */
+static int
+testTypedParamsBenchRecord(size_t dom,
+                           virTypedParameterPtr *params,
+                           int *nparams)
+{
+    int maxparams = 0;
+    char field[VIR_TYPED_PARAM_FIELD_LENGTH];
+    char name[32];
+    size_t i;
+
+    if (virTypedParamsAddInt(params, nparams, &maxparams,
+                             "state.state", 1) < 0 ||
+        virTypedParamsAddULLong(params, nparams, &maxparams,
+                                "cpu.time", dom * 1000000) < 0 ||
+        virTypedParamsAddULLong(params, nparams, &maxparams,
+                                "balloon.current", 1048576) < 0)
+        return -1;
+
+    for (i = 0; i < BENCH_DEVICES; i++) {
+        snprintf(field, sizeof(field), "block.%zu.name", i);
+        snprintf(name, sizeof(name), "vd%c", (char) ('a' + i));
+        if (virTypedParamsAddString(params, nparams, &maxparams,
+                                    field, name) < 0)
+            return -1;
+
+#define ADD_ULLONG(fmt, val) \
+        snprintf(field, sizeof(field), fmt, i); \
+        if (virTypedParamsAddULLong(params, nparams, &maxparams, \
+                                    field, val) < 0) \
+            return -1
+
+        ADD_ULLONG("block.%zu.rd.reqs", dom + i);
+        ADD_ULLONG("block.%zu.rd.bytes", (dom + i) * 4096);
+        ADD_ULLONG("block.%zu.rd.times", dom * i);
+        ADD_ULLONG("block.%zu.wr.reqs", dom + i);
+        ADD_ULLONG("block.%zu.wr.bytes", (dom + i) * 4096);
+        ADD_ULLONG("block.%zu.wr.times", dom * i);
+        ADD_ULLONG("block.%zu.allocation", 1ULL << 30);
+        ADD_ULLONG("block.%zu.capacity", 10ULL << 30);
+        ADD_ULLONG("net.%zu.rx.bytes", dom * 1500);
+        ADD_ULLONG("net.%zu.rx.pkts", dom);
+        ADD_ULLONG("net.%zu.tx.bytes", dom * 1500);
+        ADD_ULLONG("net.%zu.tx.pkts", dom);
+#undef ADD_ULLONG
+    }
+
+    return 0;
+}
+
+
+static int
+testTypedParamsPackBench(const void *opaque ATTRIBUTE_UNUSED)
+{
+    virTypedParameterPtr params[BENCH_DOMAINS] = { NULL };
+    int nparams[BENCH_DOMAINS] = { 0 };
+    virTypedParamsDictPtr dict = NULL;
+    virTypedParameterPtr out = NULL;
+    int nout = 0;
+    virTypedParameterRemotePtr remote = NULL;
+    unsigned int nremote = 0;
+    unsigned int *keys = NULL;
+    unsigned long long *values = NULL;
+    unsigned int nvalues = 0;
+    char **strings = NULL;
+    unsigned int nstrings = 0;
+    size_t serializedSize = 0;
+    size_t packedSize = 0;
+    unsigned long long start;
+    unsigned long long serializeTime;
+    unsigned long long packTime;
+    size_t i;
+    size_t j;
+    int ret = -1;
+
+    for (i = 0; i < BENCH_DOMAINS; i++) {
+        if (testTypedParamsBenchRecord(i, &params[i], &nparams[i]) < 0)
+            goto cleanup;
+    }
+
+    if (virTimeMillisNowRaw(&start) < 0)
+        goto cleanup;
+
+    for (i = 0; i < BENCH_DOMAINS; i++) {
+        if (virTypedParamsSerialize(params[i], nparams[i], &remote, &nremote,
+                                    VIR_TYPED_PARAM_STRING_OKAY) < 0 ||
+            virTypedParamsDeserialize(remote, nremote, 0, &out, &nout) < 0)
+            goto cleanup;
+
+        serializedSize += 4;
+        for (j = 0; j < nparams[i]; j++)
+            serializedSize += testXDRTypedParamSize(&params[i][j]);
+
+        virTypedParamsRemoteFree(remote, nremote);
+        virTypedParamsFree(out, nout);
+        remote = NULL;
+        out = NULL;
+        nout = 0;
+    }
+
+    if (virTimeMillisNowRaw(&serializeTime) < 0)
+        goto cleanup;
+    serializeTime -= start;
+
+    if (virTimeMillisNowRaw(&start) < 0 ||
+        !(dict = virTypedParamsDictNew()))
+        goto cleanup;
+
+    for (i = 0; i < BENCH_DOMAINS; i++) {
+        if (virTypedParamsPack(dict, params[i], nparams[i], &keys, &values,
+                               &nvalues, &strings, &nstrings,
+                               VIR_TYPED_PARAM_STRING_OKAY) < 0 ||
+            virTypedParamsUnpack(dict->fields, dict->types, dict->nfields,
+                                 keys, values, nvalues, strings, nstrings,
+                                 0, &out, &nout) < 0)
+            goto cleanup;
+
+        if (i == 0 &&
+            testTypedParamsCompare(params[i], nparams[i], out, nout) < 0)
+            goto cleanup;
+
+        packedSize += 4 + 4 * nvalues + 4 + 8 * nvalues + 4;
+        for (j = 0; j < nstrings; j++)
+            packedSize += testXDRStringSize(strings[j]);
+
+        VIR_FREE(keys);
+        VIR_FREE(values);
+        virStringListFreeCount(strings, nstrings);
+        strings = NULL;
+        virTypedParamsFree(out, nout);
+        out = NULL;
+        nout = 0;
+    }
+
+    if (virTimeMillisNowRaw(&packTime) < 0)
+        goto cleanup;
+    packTime -= start;
+
+    packedSize += 4 + 4 + 4 * dict->nfields;
+    for (j = 0; j < dict->nfields; j++)
+        packedSize += testXDRStringSize(dict->fields[j]);
+
+    VIR_TEST_DEBUG("%d domains: serialized %zu bytes in %llu ms, "
+                   "packed %zu bytes in %llu ms",
+                   BENCH_DOMAINS, serializedSize, serializeTime,
+                   packedSize, packTime);
+
+    if (packedSize >= serializedSize) {
+        VIR_TEST_DEBUG("Packed stats are not smaller than serialized ones");
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    for (i = 0; i < BENCH_DOMAINS; i++)
+        virTypedParamsFree(params[i], nparams[i]);
+    virTypedParamsRemoteFree(remote, nremote);
+    virTypedParamsFree(out, nout);
+    VIR_FREE(keys);
+    VIR_FREE(values);
+    virStringListFreeCount(strings, nstrings);
+    virTypedParamsDictFree(dict);
+    return ret;
+}
+
+
+static int
+testTypedParamsList(const void *opaque ATTRIBUTE_UNUSED)
+{
+    virTypedParamListPtr list = NULL;
+    virTypedParameterPtr params = NULL;
+    virTypedParameterPtr expected = NULL;
+    int nexpected = 0;
+    int maxexpected = 0;
+    size_t nparams = 0;
+    int ret = -1;
+
+    if (virTypedParamsAddUInt(&expected, &nexpected, &maxexpected,
+                              "block.count", 1) < 0 ||
+        virTypedParamsAddString(&expected, &nexpected, &maxexpected,
+                                "block.0.name", "vda") < 0 ||
+        virTypedParamsAddULLong(&expected, &nexpected, &maxexpected,
+                                "block.0.rd.bytes", 1234) < 0 ||
+        virTypedParamsAddInt(&expected, &nexpected, &maxexpected,
+                             "vcpu.1.state", -1) < 0 ||
+        virTypedParamsAddLLong(&expected, &nexpected, &maxexpected,
+                               "vcpu.1.time", -5) < 0 ||
+        virTypedParamsAddBoolean(&expected, &nexpected, &maxexpected,
+                                 "vcpu.1.halted", true) < 0 ||
+        virTypedParamsAddDouble(&expected, &nexpected, &maxexpected,
+                                "load", 0.5) < 0)
+        goto cleanup;
+
+    if (!(list = virTypedParamListNew(2)))
+        goto cleanup;
+
+    if (virTypedParamListAddUInt(list, "block.count", 1) < 0 ||
+        virTypedParamListSetPrefix(list, "block.%d.", 0) < 0 ||
+        virTypedParamListAddString(list, "name", "vda") < 0 ||
+        virTypedParamListAddULLong(list, "rd.bytes", 1234) < 0 ||
+        virTypedParamListSetPrefix(list, "vcpu.%u.", 1U) < 0 ||
+        virTypedParamListAddInt(list, "state", -1) < 0 ||
+        virTypedParamListAddLLong(list, "time", -5) < 0 ||
+        virTypedParamListAddBoolean(list, "halted", true) < 0)
+        goto cleanup;
+
+    virTypedParamListClearPrefix(list);
+    if (virTypedParamListAddDouble(list, "load", 0.5) < 0)
+        goto cleanup;
+
+    /* names which don't fit into the field are rejected */
+    if (virTypedParamListSetPrefix(list, "%0*d.", 100, 0) == 0 ||
+        virTypedParamListSetPrefix(list, "%0*d.", 75, 0) < 0 ||
+        virTypedParamListAddUInt(list, "toolong", 0) == 0)
+        goto cleanup;
+
+    nparams = virTypedParamListStealParams(list, &params);
+    if (list->par || list->npar) {
+        VIR_TEST_DEBUG("List not emptied by stealing its parameters");
+        goto cleanup;
+    }
+
+    if (testTypedParamsCompare(expected, nexpected, params, nparams) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    virTypedParamsFree(expected, nexpected);
+    virTypedParamsFree(params, nparams);
+    virTypedParamListFree(list);
+    return ret;
+}
+
+
+/* Builds a record the way the stats code did before virTypedParamList */
+static int
+testTypedParamsBuildLegacy(size_t dom,
+                           virTypedParameterPtr *params,
+                           int *nparams)
+{
+    int maxparams = 0;
+    char field[VIR_TYPED_PARAM_FIELD_LENGTH];
+    size_t i;
+
+    if (virTypedParamsAddInt(params, nparams, &maxparams,
+                             "state.state", 1) < 0 ||
+        virTypedParamsAddULLong(params, nparams, &maxparams,
+                                "cpu.time", dom * 1000000) < 0)
+        return -1;
+
+    for (i = 0; i < BENCH_DEVICES; i++) {
+#define ADD_ULLONG(fmt, val) \
+        snprintf(field, sizeof(field), fmt, i); \
+        if (virTypedParamsAddULLong(params, nparams, &maxparams, \
+                                    field, val) < 0) \
+            return -1
+
+        ADD_ULLONG("block.%zu.rd.reqs", dom + i);
+        ADD_ULLONG("block.%zu.rd.bytes", (dom + i) * 4096);
+        ADD_ULLONG("block.%zu.rd.times", dom * i);
+        ADD_ULLONG("block.%zu.wr.reqs", dom + i);
+        ADD_ULLONG("block.%zu.wr.bytes", (dom + i) * 4096);
+        ADD_ULLONG("block.%zu.wr.times", dom * i);
+        ADD_ULLONG("block.%zu.fl.reqs", dom + i);
+        ADD_ULLONG("block.%zu.fl.times", dom * i);
+        ADD_ULLONG("block.%zu.allocation", 1ULL << 30);
+        ADD_ULLONG("block.%zu.capacity", 10ULL << 30);
+#undef ADD_ULLONG
+    }
+
+    return 0;
+}
+
+
+static int
+testTypedParamsBuildList(size_t dom,
+                         virTypedParameterPtr *params,
+                         int *nparams)
+{
+    virTypedParamListPtr list;
+    size_t i;
+    int ret = -1;
+
+    if (!(list = virTypedParamListNew(2 + 10 * BENCH_DEVICES)))
+        return -1;
+
+    if (virTypedParamListAddInt(list, "state.state", 1) < 0 ||
+        virTypedParamListAddULLong(list, "cpu.time", dom * 1000000) < 0)
+        goto cleanup;
+
+    for (i = 0; i < BENCH_DEVICES; i++) {
+        if (virTypedParamListSetPrefix(list, "block.%zu.", i) < 0 ||
+            virTypedParamListAddULLong(list, "rd.reqs", dom + i) < 0 ||
+            virTypedParamListAddULLong(list, "rd.bytes", (dom + i) * 4096) < 0 ||
+            virTypedParamListAddULLong(list, "rd.times", dom * i) < 0 ||
+            virTypedParamListAddULLong(list, "wr.reqs", dom + i) < 0 ||
+            virTypedParamListAddULLong(list, "wr.bytes", (dom + i) * 4096) < 0 ||
+            virTypedParamListAddULLong(list, "wr.times", dom * i) < 0 ||
+            virTypedParamListAddULLong(list, "fl.reqs", dom + i) < 0 ||
+            virTypedParamListAddULLong(list, "fl.times", dom * i) < 0 ||
+            virTypedParamListAddULLong(list, "allocation", 1ULL << 30) < 0 ||
+            virTypedParamListAddULLong(list, "capacity", 10ULL << 30) < 0)
+            goto cleanup;
+    }
+
+    *nparams = virTypedParamListStealParams(list, params);
+    ret = 0;
+
+ cleanup:
+    virTypedParamListFree(list);
+    return ret;
+}
+
+
+static int
+testTypedParamsListBench(const void *opaque ATTRIBUTE_UNUSED)
+{
+    virTypedParameterPtr legacy = NULL;
+    virTypedParameterPtr built = NULL;
+    int nlegacy = 0;
+    int nbuilt = 0;
+    unsigned long long start;
+    unsigned long long legacyTime;
+    unsigned long long builtTime;
+    size_t i;
+    int ret = -1;
+
+    if (testTypedParamsBuildLegacy(0, &legacy, &nlegacy) < 0 ||
+        testTypedParamsBuildList(0, &built, &nbuilt) < 0 ||
+        testTypedParamsCompare(legacy, nlegacy, built, nbuilt) < 0)
+        goto cleanup;
+
+#define BENCH_LOOP(func, params, nparams, time) \
+    if (virTimeMillisNowRaw(&start) < 0) \
+        goto cleanup; \
+    for (i = 0; i < BENCH_DOMAINS * 10; i++) { \
+        virTypedParamsFree(params, nparams); \
+        params = NULL; \
+        nparams = 0; \
+        if (func(i, &params, &nparams) < 0) \
+            goto cleanup; \
+    } \
+    if (virTimeMillisNowRaw(&time) < 0) \
+        goto cleanup; \
+    time -= start
+
+    BENCH_LOOP(testTypedParamsBuildLegacy, legacy, nlegacy, legacyTime);
+    BENCH_LOOP(testTypedParamsBuildList, built, nbuilt, builtTime);
+#undef BENCH_LOOP
+
+    VIR_TEST_DEBUG("%d records: virTypedParamsAdd* took %llu ms, "
+                   "virTypedParamList took %llu ms",
+                   BENCH_DOMAINS * 10, legacyTime, builtTime);
+
+    ret = 0;
+
+ cleanup:
+    virTypedParamsFree(legacy, nlegacy);
+    virTypedParamsFree(built, nbuilt);
+    return ret;
+}
+
+
 static int
 mymain(void)
 {
@@ -302,6 +871,22 @@ mymain(void)
     if (virTestRun("Add string list", testTypedParamsAddStringList, NULL) < 0)
         rv = -1;
 
+    if (virTestRun("Pack and unpack", testTypedParamsPack, NULL) < 0)
+        rv = -1;
+
+    if (virTestRun("Unpack invalid", testTypedParamsPackInvalid, NULL) < 0)
+        rv = -1;
+
+    if (virTestRun("Pack benchmark", testTypedParamsPackBench, NULL) < 0)
+        rv = -1;
+
+    if (virTestRun("Parameter list", testTypedParamsList, NULL) < 0)
+        rv = -1;
+
+    if (virTestRun("Parameter list benchmark",
+                   testTypedParamsListBench, NULL) < 0)
+        rv = -1;
+
     if (rv < 0)
         return EXIT_FAILURE;
     return EXIT_SUCCESS;
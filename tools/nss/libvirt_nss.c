@@ -82,64 +82,133 @@ typedef struct {
 } leaseAddress;
 
 
+static int
+appendAddrRaw(leaseAddress **tmpAddress,
+              size_t *ntmpAddress,
+              const void *addr,
+              int family,
+              int af)
+{
+    size_t i;
+
+    if (af != AF_UNSPEC && af != family) {
+        DEBUG("Skipping address which family is %d, %d requested", family, af);
+        return 0;
+    }
+
+    for (i = 0; i < *ntmpAddress; i++) {
+        if (memcmp((*tmpAddress)[i].addr, addr,
+                   FAMILY_ADDRESS_SIZE(family)) == 0) {
+            DEBUG("IP address already in the list");
+            return 0;
+        }
+    }
+
+    if (VIR_REALLOC_N_QUIET(*tmpAddress, *ntmpAddress + 1) < 0) {
+        ERROR("Out of memory");
+        return -1;
+    }
+
+    (*tmpAddress)[*ntmpAddress].af = family;
+    memcpy((*tmpAddress)[*ntmpAddress].addr, addr,
+           FAMILY_ADDRESS_SIZE(family));
+    (*ntmpAddress)++;
+    return 0;
+}
+
+
 static int
 appendAddr(leaseAddress **tmpAddress,
            size_t *ntmpAddress,
            virJSONValuePtr lease,
            int af)
 {
-    int ret = -1;
     const char *ipAddr;
     virSocketAddr sa;
     int family;
-    size_t i;
 
     if (!(ipAddr = virJSONValueObjectGetString(lease, "ip-address"))) {
         ERROR("ip-address field missing for %s", name);
-        goto cleanup;
+        return -1;
     }
 
     DEBUG("IP address: %s", ipAddr);
 
     if (virSocketAddrParse(&sa, ipAddr, AF_UNSPEC) < 0) {
         ERROR("Unable to parse %s", ipAddr);
-        goto cleanup;
+        return -1;
     }
 
     family = VIR_SOCKET_ADDR_FAMILY(&sa);
-    if (af != AF_UNSPEC && af != family) {
-        DEBUG("Skipping address which family is %d, %d requested", family, af);
-        ret = 0;
-        goto cleanup;
+
+    return appendAddrRaw(tmpAddress, ntmpAddress,
+                         (family == AF_INET ?
+                          (void *) &sa.data.inet4.sin_addr.s_addr :
+                          (void *) &sa.data.inet6.sin6_addr.s6_addr),
+                         family, af);
+}
+
+
+typedef struct {
+    leaseAddress **tmpAddress;
+    size_t *ntmpAddress;
+    time_t currtime;
+    int af;
+    bool *found;
+} findLeaseInIndexData;
+
+
+static int
+findLeaseInIndexIter(const virLeaseIndexRecord *record,
+                     void *opaque)
+{
+    findLeaseInIndexData *data = opaque;
+
+    /* Do not report expired lease */
+    if (record->expirytime < (long long) data->currtime) {
+        DEBUG("Skipping expired lease for %s", record->hostname);
+        return 0;
     }
 
-    for (i = 0; i < *ntmpAddress; i++) {
-        if (memcmp((*tmpAddress)[i].addr,
-                   (family == AF_INET ?
-                    (void *) &sa.data.inet4.sin_addr.s_addr :
-                    (void *) &sa.data.inet6.sin6_addr.s6_addr),
-                   FAMILY_ADDRESS_SIZE(family)) == 0) {
-            DEBUG("IP address already in the list");
-            ret = 0;
-            goto cleanup;
-        }
+    DEBUG("Found record for %s", record->hostname);
+    *data->found = true;
+
+    return appendAddrRaw(data->tmpAddress, data->ntmpAddress,
+                         record->addr, record->family, data->af);
+}
+
+
+static int
+findLeaseInIndex(leaseAddress **tmpAddress,
+                 size_t *ntmpAddress,
+                 virLeaseIndexPtr idx,
+                 const char *name,
+                 const char **macs,
+                 int af,
+                 bool *found)
+{
+    findLeaseInIndexData data = {
+        .tmpAddress = tmpAddress, .ntmpAddress = ntmpAddress,
+        .af = af, .found = found,
+    };
+    size_t i;
+
+    if ((data.currtime = time(NULL)) == (time_t) - 1) {
+        ERROR("Failed to get current system time");
+        return -1;
     }
 
-    if (VIR_REALLOC_N_QUIET(*tmpAddress, *ntmpAddress + 1) < 0) {
-        ERROR("Out of memory");
-        goto cleanup;
+    if (!macs)
+        return virLeaseIndexForEachHostname(idx, name,
+                                            findLeaseInIndexIter, &data);
+
+    for (i = 0; macs[i]; i++) {
+        if (virLeaseIndexForEachMAC(idx, macs[i],
+                                    findLeaseInIndexIter, &data) < 0)
+            return -1;
     }
 
-    (*tmpAddress)[*ntmpAddress].af = family;
-    memcpy((*tmpAddress)[*ntmpAddress].addr,
-           (family == AF_INET ?
-            (void *) &sa.data.inet4.sin_addr.s_addr :
-            (void *) &sa.data.inet6.sin6_addr.s6_addr),
-           FAMILY_ADDRESS_SIZE(family));
-    (*ntmpAddress)++;
-    ret = 0;
- cleanup:
-    return ret;
+    return 0;
 }
 
 
@@ -253,6 +322,11 @@ findLease(const char *name,
     size_t ntmpAddress = 0;
     virMacMapPtr *macmaps = NULL;
     size_t nMacmaps = 0;
+    virMacMapIndexPtr *macIndexes = NULL;
+    size_t nMacIndexes = 0;
+    virLeaseIndexPtr *indexes = NULL;
+    size_t nIndexes = 0;
+    size_t i;
 
     *address = NULL;
     *naddress = 0;
@@ -282,7 +356,19 @@ findLease(const char *name,
                 goto cleanup;
 
             DEBUG("Processing %s", path);
-            if (virLeaseReadCustomLeaseFile(leases_array, path, NULL, NULL) < 0) {
+
+            /* Prefer the index written by the leases helper, fall back to
+             * parsing the leases file if it is missing or out of date. */
+            if (VIR_REALLOC_N_QUIET(indexes, nIndexes + 1) < 0) {
+                VIR_FREE(path);
+                goto cleanup;
+            }
+
+            if ((indexes[nIndexes] = virLeaseIndexOpen(path))) {
+                DEBUG("Using lease index for %s", path);
+                nIndexes++;
+            } else if (virLeaseReadCustomLeaseFile(leases_array, path,
+                                                   NULL, NULL) < 0) {
                 ERROR("Unable to parse %s", path);
                 VIR_FREE(path);
                 goto cleanup;
@@ -292,18 +378,25 @@ findLease(const char *name,
             if (!(path = virFileBuildPath(leaseDir, entry->d_name, NULL)))
                 goto cleanup;
 
-            if (VIR_REALLOC_N_QUIET(macmaps, nMacmaps + 1) < 0) {
+            if (VIR_REALLOC_N_QUIET(macIndexes, nMacIndexes + 1) < 0 ||
+                VIR_REALLOC_N_QUIET(macmaps, nMacmaps + 1) < 0) {
                 VIR_FREE(path);
                 goto cleanup;
             }
 
             DEBUG("Processing %s", path);
-            if (!(macmaps[nMacmaps] = virMacMapNew(path))) {
+
+            /* Same as with leases, prefer the index if it is current */
+            if ((macIndexes[nMacIndexes] = virMacMapIndexOpen(path))) {
+                DEBUG("Using mac map index for %s", path);
+                nMacIndexes++;
+            } else if ((macmaps[nMacmaps] = virMacMapNew(path))) {
+                nMacmaps++;
+            } else {
                 ERROR("Unable to parse %s", path);
                 VIR_FREE(path);
                 goto cleanup;
             }
-            nMacmaps++;
             VIR_FREE(path);
         }
     }
@@ -319,19 +412,47 @@ findLease(const char *name,
                         name, NULL, af, found) < 0)
         goto cleanup;
 
+    for (i = 0; i < nIndexes; i++) {
+        if (findLeaseInIndex(&tmpAddress, &ntmpAddress,
+                             indexes[i], name, NULL, af, found) < 0)
+            goto cleanup;
+    }
+
 #else /* defined(LIBVIRT_NSS_GUEST) */
 
-    size_t i;
-    for (i = 0; i < nMacmaps; i++) {
-        const char **macs = (const char **) virMacMapLookup(macmaps[i], name);
+    for (i = 0; i < nMacmaps + nMacIndexes; i++) {
+        const char **macs;
+        char **indexMacs = NULL;
+        size_t j;
+
+        if (i < nMacmaps) {
+            macs = (const char **) virMacMapLookup(macmaps[i], name);
+        } else {
+            if (virMacMapIndexLookup(macIndexes[i - nMacmaps],
+                                     name, &indexMacs) < 0)
+                goto cleanup;
+            macs = (const char **) indexMacs;
+        }
 
         if (!macs)
             continue;
 
         if (findLeaseInJSON(&tmpAddress, &ntmpAddress,
                             leases_array, nleases,
-                            name, macs, af, found) < 0)
+                            name, macs, af, found) < 0) {
+            virStringListFree(indexMacs);
             goto cleanup;
+        }
+
+        for (j = 0; j < nIndexes; j++) {
+            if (findLeaseInIndex(&tmpAddress, &ntmpAddress,
+                                 indexes[j], name, macs, af, found) < 0) {
+                virStringListFree(indexMacs);
+                goto cleanup;
+            }
+        }
+
+        virStringListFree(indexMacs);
     }
 
 #endif /* defined(LIBVIRT_NSS_GUEST) */
@@ -351,6 +472,12 @@ findLease(const char *name,
     while (nMacmaps)
         virObjectUnref(macmaps[--nMacmaps]);
     VIR_FREE(macmaps);
+    while (nMacIndexes)
+        virMacMapIndexFree(macIndexes[--nMacIndexes]);
+    VIR_FREE(macIndexes);
+    while (nIndexes)
+        virLeaseIndexFree(indexes[--nIndexes]);
+    VIR_FREE(indexes);
     return ret;
 }
 
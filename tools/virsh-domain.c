@@ -5992,6 +5992,7 @@ cmdDomjobinfo(vshControl *ctl, const vshCmd *cmd)
     unsigned long long value;
     unsigned int flags = 0;
     int ivalue;
+    unsigned int uvalue;
     int op;
     int rc;
 
@@ -6153,6 +6154,22 @@ cmdDomjobinfo(vshControl *ctl, const vshCmd *cmd)
             vshPrint(ctl, "%-17s %-.3lf %s/s\n",
                      _("File bandwidth:"), val, unit);
         }
+
+        if ((rc = virTypedParamsGetUInt(params, nparams,
+                                        VIR_DOMAIN_JOB_DISK_MIRRORS,
+                                        &uvalue)) < 0) {
+            goto save_error;
+        } else if (rc) {
+            vshPrint(ctl, "%-17s %-12u\n", _("Disks started:"), uvalue);
+        }
+
+        if ((rc = virTypedParamsGetUInt(params, nparams,
+                                        VIR_DOMAIN_JOB_DISK_MIRRORS_READY,
+                                        &uvalue)) < 0) {
+            goto save_error;
+        } else if (rc) {
+            vshPrint(ctl, "%-17s %-12u\n", _("Disks ready:"), uvalue);
+        }
     }
 
     if ((rc = virTypedParamsGetULLong(params, nparams,
@@ -6252,6 +6269,25 @@ cmdDomjobinfo(vshControl *ctl, const vshCmd *cmd)
         vshPrint(ctl, "%-17s %-13d\n", _("Auto converge throttle:"), ivalue);
     }
 
+    if ((rc = virTypedParamsGetULLong(params, nparams,
+                                      VIR_DOMAIN_JOB_TUNNEL_PROCESSED,
+                                      &value)) < 0) {
+        goto save_error;
+    } else if (rc) {
+        val = vshPrettyCapacity(value, &unit);
+        vshPrint(ctl, "%-17s %-.3lf %s\n", _("Tunnel processed:"), val, unit);
+    }
+
+    if ((rc = virTypedParamsGetULLong(params, nparams,
+                                      VIR_DOMAIN_JOB_TUNNEL_BPS,
+                                      &value)) < 0) {
+        goto save_error;
+    } else if (rc && value) {
+        val = vshPrettyCapacity(value, &unit);
+        vshPrint(ctl, "%-17s %-.3lf %s/s\n",
+                 _("Tunnel bandwidth:"), val, unit);
+    }
+
     ret = true;
 
  cleanup:
@@ -10545,6 +10581,14 @@ static const vshCmdOptDef opts_migrate[] = {
      .type = VSH_OT_BOOL,
      .help = N_("use TLS for migration")
     },
+    {.name = "parallel",
+     .type = VSH_OT_BOOL,
+     .help = N_("migrate memory over multiple parallel connections")
+    },
+    {.name = "parallel-connections",
+     .type = VSH_OT_INT,
+     .help = N_("number of connections for parallel migration")
+    },
     {.name = NULL}
 };
 
@@ -10687,6 +10731,15 @@ doMigrate(void *opaque)
             goto save_error;
     }
 
+    if ((rv = vshCommandOptInt(ctl, cmd, "parallel-connections", &intOpt)) < 0) {
+        goto out;
+    } else if (rv > 0) {
+        if (virTypedParamsAddInt(&params, &nparams, &maxparams,
+                                 VIR_MIGRATE_PARAM_PARALLEL_CONNECTIONS,
+                                 intOpt) < 0)
+            goto save_error;
+    }
+
     if (vshCommandOptStringReq(ctl, cmd, "xml", &opt) < 0)
         goto out;
     if (opt) {
@@ -10789,6 +10842,9 @@ doMigrate(void *opaque)
     if (vshCommandOptBool(cmd, "tls"))
         flags |= VIR_MIGRATE_TLS;
 
+    if (vshCommandOptBool(cmd, "parallel"))
+        flags |= VIR_MIGRATE_PARALLEL;
+
     if (flags & VIR_MIGRATE_PEER2PEER || vshCommandOptBool(cmd, "direct")) {
         if (virDomainMigrateToURI3(dom, desturi, params, nparams, flags) == 0)
             ret = '0';
@@ -10883,6 +10939,8 @@ cmdMigrate(vshControl *ctl, const vshCmd *cmd)
     VSH_REQUIRE_OPTION("postcopy-after-precopy", "postcopy");
     VSH_REQUIRE_OPTION("timeout-postcopy", "postcopy");
     VSH_REQUIRE_OPTION("persistent-xml", "persistent");
+    VSH_REQUIRE_OPTION("parallel-connections", "parallel");
+    VSH_EXCLUSIVE_OPTIONS("parallel", "tunnelled");
 
     if (!(dom = virshCommandOptDomain(ctl, cmd, NULL)))
         return false;
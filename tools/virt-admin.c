@@ -63,6 +63,13 @@ VIR_ENUM_IMPL(virClientTransport,
               N_("tcp"),
               N_("tls"))
 
+VIR_ENUM_DECL(virThreadPoolFairQueuing)
+VIR_ENUM_IMPL(virThreadPoolFairQueuing,
+              VIR_THREADPOOL_FAIR_QUEUING_LAST,
+              "none",
+              "client",
+              "identity")
+
 static const char *
 vshAdmClientTransportToString(int transport)
 {
@@ -459,8 +466,15 @@ cmdSrvThreadpoolInfo(vshControl *ctl, const vshCmd *cmd)
         goto cleanup;
     }
 
-    for (i = 0; i < nparams; i++)
-        vshPrint(ctl, "%-15s: %u\n", params[i].field, params[i].value.ui);
+    for (i = 0; i < nparams; i++) {
+        const char *mode;
+
+        if (STREQ(params[i].field, VIR_THREADPOOL_FAIR_QUEUING) &&
+            (mode = virThreadPoolFairQueuingTypeToString(params[i].value.ui)))
+            vshPrint(ctl, "%-15s: %s\n", params[i].field, mode);
+        else
+            vshPrint(ctl, "%-15s: %u\n", params[i].field, params[i].value.ui);
+    }
 
     ret = true;
 
@@ -506,6 +520,10 @@ static const vshCmdOptDef opts_srv_threadpool_set[] = {
      .type = VSH_OT_INT,
      .help = N_("Change the current number of priority workers"),
     },
+    {.name = "fair-queuing",
+     .type = VSH_OT_STRING,
+     .help = N_("Share workers between clients: none, client, identity"),
+    },
     {.name = NULL}
 };
 
@@ -517,7 +535,9 @@ cmdSrvThreadpoolSet(vshControl *ctl, const vshCmd *cmd)
     unsigned int val, min, max;
     int maxparams = 0;
     int nparams = 0;
+    int mode;
     const char *srvname = NULL;
+    const char *fairQueuing = NULL;
     virTypedParameterPtr params = NULL;
     virAdmServerPtr srv = NULL;
     vshAdmControlPtr priv = ctl->privData;
@@ -541,10 +561,24 @@ cmdSrvThreadpoolSet(vshControl *ctl, const vshCmd *cmd)
 
 #undef PARSE_CMD_TYPED_PARAM
 
+    if (vshCommandOptStringReq(ctl, cmd, "fair-queuing", &fairQueuing) < 0)
+        goto cleanup;
+
+    if (fairQueuing) {
+        if ((mode = virThreadPoolFairQueuingTypeFromString(fairQueuing)) < 0) {
+            vshError(ctl, _("Unknown fair queuing mode '%s'"), fairQueuing);
+            goto cleanup;
+        }
+
+        if (virTypedParamsAddUInt(&params, &nparams, &maxparams,
+                                  VIR_THREADPOOL_FAIR_QUEUING, mode) < 0)
+            goto save_error;
+    }
+
     if (!nparams) {
         vshError(ctl, "%s",
                  _("At least one of options --min-workers, --max-workers, "
-                   "--priority-workers is mandatory "));
+                   "--priority-workers, --fair-queuing is mandatory "));
             goto cleanup;
     }
 